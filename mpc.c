@@ -1,3830 +1,10660 @@
-#include "mpc.h"
-
-/*
-** State Type
-*/
-
-static mpc_state_t mpc_state_invalid(void) {
-  mpc_state_t s;
-  s.pos = -1;
-  s.row = -1;
-  s.col = -1;
-  return s;
-}
-
-static mpc_state_t mpc_state_new(void) {
-  mpc_state_t s;
-  s.pos = 0;
-  s.row = 0;
-  s.col = 0;
-  return s;
-}
-
-/*
-** Input Type
-*/
-
-/*
-** In mpc the input type has three modes of 
-** operation: String, File and Pipe.
-**
-** String is easy. The whole contents are 
-** loaded into a buffer and scanned through.
-** The cursor can jump around at will making 
-** backtracking easy.
-**
-** The second is a File which is also somewhat
-** easy. The contents are never loaded into 
-** memory but backtracking can still be achieved
-** by seeking in the file at different positions.
-**
-** The final mode is Pipe. This is the difficult
-** one. As we assume pipes cannot be seeked - and 
-** only support a single character lookahead at 
-** any point, when the input is marked for a 
-** potential backtracking we start buffering any 
-** input.
-**
-** This means that if we are requested to seek
-** back we can simply start reading from the
-** buffer instead of the input.
-**
-** Of course using `mpc_predictive` will disable
-** backtracking and make LL(1) grammars easy
-** to parse for all input methods.
-**
-*/
-
-enum {
-  MPC_INPUT_STRING = 0,
-  MPC_INPUT_FILE   = 1,
-  MPC_INPUT_PIPE   = 2
-};
-
-enum {
-  MPC_INPUT_MARKS_MIN = 32
-};
-
-enum {
-  MPC_INPUT_MEM_NUM = 512
-};
-
-typedef struct {
-  char mem[64];
-} mpc_mem_t;
-
-typedef struct {
-
-  int type;
-  char *filename;  
-  mpc_state_t state;
-  
-  char *string;
-  char *buffer;
-  FILE *file;
-  
-  int suppress;
-  int backtrack;
-  int marks_slots;
-  int marks_num;
-  mpc_state_t *marks;
-  
-  char *lasts;
-  char last;
-  
-  size_t mem_index;
-  char mem_full[MPC_INPUT_MEM_NUM];
-  mpc_mem_t mem[MPC_INPUT_MEM_NUM];
-  
-} mpc_input_t;
-
-static mpc_input_t *mpc_input_new_string(const char *filename, const char *string) {
-
-  mpc_input_t *i = malloc(sizeof(mpc_input_t));
-  
-  i->filename = malloc(strlen(filename) + 1);
-  strcpy(i->filename, filename);
-  i->type = MPC_INPUT_STRING;
-  
-  i->state = mpc_state_new();
-  
-  i->string = malloc(strlen(string) + 1);
-  strcpy(i->string, string);
-  i->buffer = NULL;
-  i->file = NULL;
-  
-  i->suppress = 0;
-  i->backtrack = 1;
-  i->marks_num = 0;
-  i->marks_slots = MPC_INPUT_MARKS_MIN;
-  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
-  i->lasts = malloc(sizeof(char) * i->marks_slots);
-  i->last = '\0';
-  
-  i->mem_index = 0;
-  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
-  
-  return i;
-}
-
-static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *string, size_t length) {
-
-  mpc_input_t *i = malloc(sizeof(mpc_input_t));
-  
-  i->filename = malloc(strlen(filename) + 1);
-  strcpy(i->filename, filename);
-  i->type = MPC_INPUT_STRING;
-  
-  i->state = mpc_state_new();
-  
-  i->string = malloc(length + 1);
-  strncpy(i->string, string, length);
-  i->string[length] = '\0';
-  i->buffer = NULL;
-  i->file = NULL;
-  
-  i->suppress = 0;
-  i->backtrack = 1;
-  i->marks_num = 0;
-  i->marks_slots = MPC_INPUT_MARKS_MIN;
-  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
-  i->lasts = malloc(sizeof(char) * i->marks_slots);
-  i->last = '\0';
-  
-  i->mem_index = 0;
-  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
-  
-  return i;
-
-}
-
-static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
-
-  mpc_input_t *i = malloc(sizeof(mpc_input_t));
-  
-  i->filename = malloc(strlen(filename) + 1);
-  strcpy(i->filename, filename);
-  
-  i->type = MPC_INPUT_PIPE;
-  i->state = mpc_state_new();
-  
-  i->string = NULL;
-  i->buffer = NULL;
-  i->file = pipe;
-  
-  i->suppress = 0;
-  i->backtrack = 1;
-  i->marks_num = 0;
-  i->marks_slots = MPC_INPUT_MARKS_MIN;
-  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
-  i->lasts = malloc(sizeof(char) * i->marks_slots);
-  i->last = '\0';
-  
-  i->mem_index = 0;
-  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
-  
-  return i;
-  
-}
-
-static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
-  
-  mpc_input_t *i = malloc(sizeof(mpc_input_t));
-  
-  i->filename = malloc(strlen(filename) + 1);
-  strcpy(i->filename, filename);
-  i->type = MPC_INPUT_FILE;
-  i->state = mpc_state_new();
-  
-  i->string = NULL;
-  i->buffer = NULL;
-  i->file = file;
-  
-  i->suppress = 0;
-  i->backtrack = 1;
-  i->marks_num = 0;
-  i->marks_slots = MPC_INPUT_MARKS_MIN;
-  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
-  i->lasts = malloc(sizeof(char) * i->marks_slots);
-  i->last = '\0';
-  
-  i->mem_index = 0;
-  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
-  
-  return i;
-}
-
-static void mpc_input_delete(mpc_input_t *i) {
-  
-  free(i->filename);
-  
-  if (i->type == MPC_INPUT_STRING) { free(i->string); }
-  if (i->type == MPC_INPUT_PIPE) { free(i->buffer); }
-  
-  free(i->marks);
-  free(i->lasts);
-  free(i);
-}
-
-static int mpc_mem_ptr(mpc_input_t *i, void *p) {
-  return
-    (char*)p >= (char*)(i->mem) &&
-    (char*)p <  (char*)(i->mem) + (MPC_INPUT_MEM_NUM * sizeof(mpc_mem_t));
-}
-
-static void *mpc_malloc(mpc_input_t *i, size_t n) {
-  size_t j;
-  char *p;
-  
-  if (n > sizeof(mpc_mem_t)) { return malloc(n); }
-  
-  j = i->mem_index;
-  do {
-    if (!i->mem_full[i->mem_index]) {
-      p = (void*)(i->mem + i->mem_index);
-      i->mem_full[i->mem_index] = 1;
-      i->mem_index = (i->mem_index+1) % MPC_INPUT_MEM_NUM;
-      return p;
-    }
-    i->mem_index = (i->mem_index+1) % MPC_INPUT_MEM_NUM;
-  } while (j != i->mem_index);
-  
-  return malloc(n);
-}
-
-static void *mpc_calloc(mpc_input_t *i, size_t n, size_t m) {
-  char *x = mpc_malloc(i, n * m);
-  memset(x, 0, n * m);
-  return x;
-}
-
-static void mpc_free(mpc_input_t *i, void *p) {
-  size_t j;
-  if (!mpc_mem_ptr(i, p)) { free(p); return; }
-  j = ((size_t)(((char*)p) - ((char*)i->mem))) / sizeof(mpc_mem_t);
-  i->mem_full[j] = 0;
-}
-
-static void *mpc_realloc(mpc_input_t *i, void *p, size_t n) {
-  
-  char *q = NULL;
-  
-  if (!mpc_mem_ptr(i, p)) { return realloc(p, n); }
-  
-  if (n > sizeof(mpc_mem_t)) {
-    q = malloc(n);
-    memcpy(q, p, sizeof(mpc_mem_t));
-    mpc_free(i, p);
-    return q;
-  }
-  
-  return p;
-}
-
-static void *mpc_export(mpc_input_t *i, void *p) {
-  char *q = NULL;
-  if (!mpc_mem_ptr(i, p)) { return p; }
-  q = malloc(sizeof(mpc_mem_t));
-  memcpy(q, p, sizeof(mpc_mem_t));
-  mpc_free(i, p);
-  return q; 
-}
-
-static void mpc_input_backtrack_disable(mpc_input_t *i) { i->backtrack--; }
-static void mpc_input_backtrack_enable(mpc_input_t *i) { i->backtrack++; }
-
-static void mpc_input_suppress_disable(mpc_input_t *i) { i->suppress--; }
-static void mpc_input_suppress_enable(mpc_input_t *i) { i->suppress++; }
-
-static void mpc_input_mark(mpc_input_t *i) {
-  
-  if (i->backtrack < 1) { return; }
-  
-  i->marks_num++;
-  
-  if (i->marks_num > i->marks_slots) {
-    i->marks_slots = i->marks_num + i->marks_num / 2;
-    i->marks = realloc(i->marks, sizeof(mpc_state_t) * i->marks_slots);
-    i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);
-  }
-
-  i->marks[i->marks_num-1] = i->state;
-  i->lasts[i->marks_num-1] = i->last;
-  
-  if (i->type == MPC_INPUT_PIPE && i->marks_num == 1) {
-    i->buffer = calloc(1, 1);
-  }
-  
-}
-
-static void mpc_input_unmark(mpc_input_t *i) {
-  
-  if (i->backtrack < 1) { return; }
-  
-  i->marks_num--;
-  
-  if (i->marks_slots > i->marks_num + i->marks_num / 2
-  &&  i->marks_slots > MPC_INPUT_MARKS_MIN) {
-    i->marks_slots = 
-      i->marks_num > MPC_INPUT_MARKS_MIN ?
-      i->marks_num : MPC_INPUT_MARKS_MIN;
-    i->marks = realloc(i->marks, sizeof(mpc_state_t) * i->marks_slots);
-    i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);      
-  }
-  
-  if (i->type == MPC_INPUT_PIPE && i->marks_num == 0) {
-    free(i->buffer);
-    i->buffer = NULL;
-  }
-  
-}
-
-static void mpc_input_rewind(mpc_input_t *i) {
-  
-  if (i->backtrack < 1) { return; }
-  
-  i->state = i->marks[i->marks_num-1];
-  i->last  = i->lasts[i->marks_num-1];
-  
-  if (i->type == MPC_INPUT_FILE) {
-    fseek(i->file, i->state.pos, SEEK_SET);
-  }
-  
-  mpc_input_unmark(i);
-}
-
-static int mpc_input_buffer_in_range(mpc_input_t *i) {
-  return i->state.pos < (long)(strlen(i->buffer) + i->marks[0].pos);
-}
-
-static char mpc_input_buffer_get(mpc_input_t *i) {
-  return i->buffer[i->state.pos - i->marks[0].pos];
-}
-
-static int mpc_input_terminated(mpc_input_t *i) {
-  if (i->type == MPC_INPUT_STRING && i->state.pos == (long)strlen(i->string)) { return 1; }
-  if (i->type == MPC_INPUT_FILE && feof(i->file)) { return 1; }
-  if (i->type == MPC_INPUT_PIPE && feof(i->file)) { return 1; }
-  return 0;
-}
-
-static char mpc_input_getc(mpc_input_t *i) {
-  
-  char c = '\0';
-  
-  switch (i->type) {
-    
-    case MPC_INPUT_STRING: return i->string[i->state.pos];
-    case MPC_INPUT_FILE: c = fgetc(i->file); return c;
-    case MPC_INPUT_PIPE:
-    
-      if (!i->buffer) { c = getc(i->file); return c; }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        c = mpc_input_buffer_get(i);
-        return c;
-      } else {
-        c = getc(i->file);
-        return c;
-      }
-    
-    default: return c;
-  }
-}
-
-static char mpc_input_peekc(mpc_input_t *i) {
-  
-  char c = '\0';
-  
-  switch (i->type) {
-    case MPC_INPUT_STRING: return i->string[i->state.pos];
-    case MPC_INPUT_FILE: 
-      
-      c = fgetc(i->file);
-      if (feof(i->file)) { return '\0'; }
-      
-      fseek(i->file, -1, SEEK_CUR);
-      return c;
-    
-    case MPC_INPUT_PIPE:
-      
-      if (!i->buffer) {
-        c = getc(i->file);
-        if (feof(i->file)) { return '\0'; }
-        ungetc(c, i->file);
-        return c;
-      }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        return mpc_input_buffer_get(i);
-      } else {
-        c = getc(i->file);
-        if (feof(i->file)) { return '\0'; }
-        ungetc(c, i->file);
-        return c;
-      }
-    
-    default: return c;
-  }
-  
-}
-
-static int mpc_input_failure(mpc_input_t *i, char c) {
-
-  switch (i->type) {
-    case MPC_INPUT_STRING: { break; }
-    case MPC_INPUT_FILE: fseek(i->file, -1, SEEK_CUR); { break; }
-    case MPC_INPUT_PIPE: {
-      
-      if (!i->buffer) { ungetc(c, i->file); break; }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        break;
-      } else {
-        ungetc(c, i->file); 
-      }
-    }
-    default: { break; }
-  }
-  return 0;
-}
-
-static int mpc_input_success(mpc_input_t *i, char c, char **o) {
-  
-  if (i->type == MPC_INPUT_PIPE
-  &&  i->buffer && !mpc_input_buffer_in_range(i)) {
-    i->buffer = realloc(i->buffer, strlen(i->buffer) + 2);
-    i->buffer[strlen(i->buffer) + 1] = '\0';
-    i->buffer[strlen(i->buffer) + 0] = c;
-  }
-  
-  i->last = c;
-  i->state.pos++;
-  i->state.col++;
-  
-  if (c == '\n') {
-    i->state.col = 0;
-    i->state.row++;
-  }
-  
-  if (o) {
-    (*o) = mpc_malloc(i, 2);
-    (*o)[0] = c;
-    (*o)[1] = '\0';
-  }
-  
-  return 1;
-}
-
-static int mpc_input_any(mpc_input_t *i, char **o) {
-  char x = mpc_input_getc(i);
-  if (mpc_input_terminated(i)) { return 0; }
-  return mpc_input_success(i, x, o);
-}
-
-static int mpc_input_char(mpc_input_t *i, char c, char **o) {
-  char x = mpc_input_getc(i);
-  if (mpc_input_terminated(i)) { return 0; }
-  return x == c ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);
-}
-
-static int mpc_input_range(mpc_input_t *i, char c, char d, char **o) {
-  char x = mpc_input_getc(i);
-  if (mpc_input_terminated(i)) { return 0; }
-  return x >= c && x <= d ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
-}
-
-static int mpc_input_oneof(mpc_input_t *i, const char *c, char **o) {
-  char x = mpc_input_getc(i);
-  if (mpc_input_terminated(i)) { return 0; }
-  return strchr(c, x) != 0 ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
-}
-
-static int mpc_input_noneof(mpc_input_t *i, const char *c, char **o) {
-  char x = mpc_input_getc(i);
-  if (mpc_input_terminated(i)) { return 0; }
-  return strchr(c, x) == 0 ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
-}
-
-static int mpc_input_satisfy(mpc_input_t *i, int(*cond)(char), char **o) {
-  char x = mpc_input_getc(i);
-  if (mpc_input_terminated(i)) { return 0; }
-  return cond(x) ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
-}
-
-static int mpc_input_string(mpc_input_t *i, const char *c, char **o) {
-  
-  const char *x = c;
-
-  mpc_input_mark(i);
-  while (*x) {
-    if (!mpc_input_char(i, *x, NULL)) {
-      mpc_input_rewind(i);
-      return 0;
-    }
-    x++;
-  }
-  mpc_input_unmark(i);
-  
-  *o = mpc_malloc(i, strlen(c) + 1);
-  strcpy(*o, c);
-  return 1;
-}
-
-static int mpc_input_anchor(mpc_input_t* i, int(*f)(char,char), char **o) {
-  *o = NULL;
-  return f(i->last, mpc_input_peekc(i));
-}
-
-static mpc_state_t *mpc_input_state_copy(mpc_input_t *i) {
-  mpc_state_t *r = mpc_malloc(i, sizeof(mpc_state_t));
-  memcpy(r, &i->state, sizeof(mpc_state_t));
-  return r;
-}
-
-/*
-** Error Type
-*/
-
-void mpc_err_delete(mpc_err_t *x) {
-  int i;
-  for (i = 0; i < x->expected_num; i++) { free(x->expected[i]); }
-  free(x->expected);
-  free(x->filename);
-  free(x->failure);
-  free(x);
-}
-
-void mpc_err_print(mpc_err_t *x) {
-  mpc_err_print_to(x, stdout);
-}
-
-void mpc_err_print_to(mpc_err_t *x, FILE *f) {
-  char *str = mpc_err_string(x);
-  fprintf(f, "%s", str);
-  free(str);
-}
-
-static void mpc_err_string_cat(char *buffer, int *pos, int *max, char const *fmt, ...) {
-  /* TODO: Error Checking on Length */
-  int left = ((*max) - (*pos));
-  va_list va;
-  va_start(va, fmt);
-  if (left < 0) { left = 0;}
-  (*pos) += vsprintf(buffer + (*pos), fmt, va);
-  va_end(va);
-}
-
-static char char_unescape_buffer[4];
-
-static const char *mpc_err_char_unescape(char c) {
-  
-  char_unescape_buffer[0] = '\'';
-  char_unescape_buffer[1] = ' ';
-  char_unescape_buffer[2] = '\'';
-  char_unescape_buffer[3] = '\0';
-  
-  switch (c) {
-    case '\a': return "bell";
-    case '\b': return "backspace";
-    case '\f': return "formfeed";
-    case '\r': return "carriage return";
-    case '\v': return "vertical tab";
-    case '\0': return "end of input";
-    case '\n': return "newline";
-    case '\t': return "tab";
-    case ' ' : return "space";
-    default:
-      char_unescape_buffer[1] = c;
-      return char_unescape_buffer;
-  }
-  
-}
-
-char *mpc_err_string(mpc_err_t *x) {
-
-  int i;  
-  int pos = 0; 
-  int max = 1023;
-  char *buffer = calloc(1, 1024);
-  
-  if (x->failure) {
-    mpc_err_string_cat(buffer, &pos, &max,
-    "%s: error: %s\n", x->filename, x->failure);
-    return buffer;
-  }
-  
-  mpc_err_string_cat(buffer, &pos, &max, 
-    "%s:%i:%i: error: expected ", x->filename, x->state.row+1, x->state.col+1);
-  
-  if (x->expected_num == 0) { mpc_err_string_cat(buffer, &pos, &max, "ERROR: NOTHING EXPECTED"); }
-  if (x->expected_num == 1) { mpc_err_string_cat(buffer, &pos, &max, "%s", x->expected[0]); }
-  if (x->expected_num >= 2) {
-  
-    for (i = 0; i < x->expected_num-2; i++) {
-      mpc_err_string_cat(buffer, &pos, &max, "%s, ", x->expected[i]);
-    } 
-    
-    mpc_err_string_cat(buffer, &pos, &max, "%s or %s", 
-      x->expected[x->expected_num-2], 
-      x->expected[x->expected_num-1]);
-  }
-  
-  mpc_err_string_cat(buffer, &pos, &max, " at ");
-  mpc_err_string_cat(buffer, &pos, &max, mpc_err_char_unescape(x->recieved));
-  mpc_err_string_cat(buffer, &pos, &max, "\n");
-  
-  return realloc(buffer, strlen(buffer) + 1);
-}
-
-static mpc_err_t *mpc_err_new(mpc_input_t *i, const char *expected) {
-  mpc_err_t *x;
-  if (i->suppress) { return NULL; }
-  x = mpc_malloc(i, sizeof(mpc_err_t));
-  x->filename = mpc_malloc(i, strlen(i->filename) + 1);
-  strcpy(x->filename, i->filename);
-  x->state = i->state;
-  x->expected_num = 1;
-  x->expected = mpc_malloc(i, sizeof(char*));
-  x->expected[0] = mpc_malloc(i, strlen(expected) + 1);
-  strcpy(x->expected[0], expected);
-  x->failure = NULL;
-  x->recieved = mpc_input_peekc(i);
-  return x;
-}
-
-static mpc_err_t *mpc_err_fail(mpc_input_t *i, const char *failure) {
-  mpc_err_t *x;
-  if (i->suppress) { return NULL; }
-  x = mpc_malloc(i, sizeof(mpc_err_t));
-  x->filename = mpc_malloc(i, strlen(i->filename) + 1);
-  strcpy(x->filename, i->filename);
-  x->state = i->state;
-  x->expected_num = 0;
-  x->expected = NULL;
-  x->failure = mpc_malloc(i, strlen(failure) + 1);
-  strcpy(x->failure, failure);
-  x->recieved = ' ';
-  return x;
-}
-
-static mpc_err_t *mpc_err_file(const char *filename, const char *failure) {
-  mpc_err_t *x;
-  x = malloc(sizeof(mpc_err_t));
-  x->filename = malloc(strlen(filename) + 1);
-  strcpy(x->filename, filename);
-  x->state = mpc_state_new();
-  x->expected_num = 0;
-  x->expected = NULL;
-  x->failure = malloc(strlen(failure) + 1);
-  strcpy(x->failure, failure);
-  x->recieved = ' ';
-  return x;
-}
-
-static void mpc_err_delete_internal(mpc_input_t *i, mpc_err_t *x) {
-  int j;
-  if (x == NULL) { return; }
-  for (j = 0; j < x->expected_num; j++) { mpc_free(i, x->expected[j]); }
-  mpc_free(i, x->expected);
-  mpc_free(i, x->filename);
-  mpc_free(i, x->failure);
-  mpc_free(i, x);
-}
-
-static mpc_err_t *mpc_err_export(mpc_input_t *i, mpc_err_t *x) {
-  int j;
-  for (j = 0; j < x->expected_num; j++) {
-    x->expected[j] = mpc_export(i, x->expected[j]);
-  }
-  x->expected = mpc_export(i, x->expected);
-  x->filename = mpc_export(i, x->filename);
-  x->failure = mpc_export(i, x->failure);
-  return mpc_export(i, x);
-}
-
-static int mpc_err_contains_expected(mpc_input_t *i, mpc_err_t *x, char *expected) {
-  int j;
-  (void)i;
-  for (j = 0; j < x->expected_num; j++) {
-    if (strcmp(x->expected[j], expected) == 0) { return 1; }
-  }
-  return 0;
-}
-
-static void mpc_err_add_expected(mpc_input_t *i, mpc_err_t *x, char *expected) {
-  (void)i;
-  x->expected_num++;
-  x->expected = mpc_realloc(i, x->expected, sizeof(char*) * x->expected_num);
-  x->expected[x->expected_num-1] = mpc_malloc(i, strlen(expected) + 1);
-  strcpy(x->expected[x->expected_num-1], expected);
-}
-
-static mpc_err_t *mpc_err_or(mpc_input_t *i, mpc_err_t** x, int n) {
-  
-  int j, k, fst;
-  mpc_err_t *e;
-  
-  fst = -1;
-  for (j = 0; j < n; j++) {
-    if (x[j] != NULL) { fst = j; }
-  }
-  
-  if (fst == -1) { return NULL; }
-  
-  e = mpc_malloc(i, sizeof(mpc_err_t));
-  e->state = mpc_state_invalid();
-  e->expected_num = 0;
-  e->expected = NULL;
-  e->failure = NULL;
-  e->filename = mpc_malloc(i, strlen(x[fst]->filename)+1);
-  strcpy(e->filename, x[fst]->filename);
-  
-  for (j = 0; j < n; j++) {
-    if (x[j] == NULL) { continue; }
-    if (x[j]->state.pos > e->state.pos) { e->state = x[j]->state; }
-  }
-  
-  for (j = 0; j < n; j++) {
-    if (x[j] == NULL) { continue; }
-    if (x[j]->state.pos < e->state.pos) { continue; }
-    
-    if (x[j]->failure) {
-      e->failure = mpc_malloc(i, strlen(x[j]->failure)+1);
-      strcpy(e->failure, x[j]->failure);
-      break;
-    }
-    
-    e->recieved = x[j]->recieved;
-    
-    for (k = 0; k < x[j]->expected_num; k++) {
-      if (!mpc_err_contains_expected(i, e, x[j]->expected[k])) {
-        mpc_err_add_expected(i, e, x[j]->expected[k]);
-      }
-    }
-  }
-  
-  for (j = 0; j < n; j++) {
-    if (x[j] == NULL) { continue; }
-    mpc_err_delete_internal(i, x[j]);
-  }
-  
-  return e;
-}
-
-static mpc_err_t *mpc_err_repeat(mpc_input_t *i, mpc_err_t *x, const char *prefix) {
-
-  int j = 0;
-  size_t l = 0;
-  char *expect = NULL;
-  
-  if (x == NULL) { return NULL; }
-  
-  if (x->expected_num == 0) {
-    expect = mpc_calloc(i, 1, 1);
-    x->expected_num = 1;
-    x->expected = mpc_realloc(i, x->expected, sizeof(char*) * x->expected_num);
-    x->expected[0] = expect;
-    return x;
-  }
-  
-  else if (x->expected_num == 1) {
-    expect = mpc_malloc(i, strlen(prefix) + strlen(x->expected[0]) + 1);
-    strcpy(expect, prefix);
-    strcat(expect, x->expected[0]);
-    mpc_free(i, x->expected[0]);
-    x->expected[0] = expect;
-    return x;
-  }
-  
-  else if (x->expected_num > 1) {
-    
-    l += strlen(prefix);
-    for (j = 0; j < x->expected_num-2; j++) {
-      l += strlen(x->expected[j]) + strlen(", ");
-    }
-    l += strlen(x->expected[x->expected_num-2]);
-    l += strlen(" or ");
-    l += strlen(x->expected[x->expected_num-1]);
-    
-    expect = mpc_malloc(i, l + 1);
-    
-    strcpy(expect, prefix);
-    for (j = 0; j < x->expected_num-2; j++) {
-      strcat(expect, x->expected[j]); strcat(expect, ", ");
-    }
-    strcat(expect, x->expected[x->expected_num-2]);
-    strcat(expect, " or ");
-    strcat(expect, x->expected[x->expected_num-1]);
-
-    for (j = 0; j < x->expected_num; j++) { mpc_free(i, x->expected[j]); }
-    
-    x->expected_num = 1;
-    x->expected = mpc_realloc(i, x->expected, sizeof(char*) * x->expected_num);
-    x->expected[0] = expect;
-    return x;
-  }
-  
-  return NULL;
-}
-
-static mpc_err_t *mpc_err_many1(mpc_input_t *i, mpc_err_t *x) {
-  return mpc_err_repeat(i, x, "one or more of ");
-}
-
-static mpc_err_t *mpc_err_count(mpc_input_t *i, mpc_err_t *x, int n) {
-  mpc_err_t *y;
-  int digits = n/10 + 1;
-  char *prefix;
-  prefix = mpc_malloc(i, digits + strlen(" of ") + 1);
-  sprintf(prefix, "%i of ", n);
-  y = mpc_err_repeat(i, x, prefix);
-  mpc_free(i, prefix);
-  return y;
-}
-
-static mpc_err_t *mpc_err_merge(mpc_input_t *i, mpc_err_t *x, mpc_err_t *y) {
-  mpc_err_t *errs[2];
-  errs[0] = x;
-  errs[1] = y;
-  return mpc_err_or(i, errs, 2);
-}
-
-/*
-** Parser Type
-*/
-
-enum {
-  MPC_TYPE_UNDEFINED = 0,
-  MPC_TYPE_PASS      = 1,
-  MPC_TYPE_FAIL      = 2,
-  MPC_TYPE_LIFT      = 3,
-  MPC_TYPE_LIFT_VAL  = 4,
-  MPC_TYPE_EXPECT    = 5,
-  MPC_TYPE_ANCHOR    = 6,
-  MPC_TYPE_STATE     = 7,
-  
-  MPC_TYPE_ANY       = 8,
-  MPC_TYPE_SINGLE    = 9,
-  MPC_TYPE_ONEOF     = 10,
-  MPC_TYPE_NONEOF    = 11,
-  MPC_TYPE_RANGE     = 12,
-  MPC_TYPE_SATISFY   = 13,
-  MPC_TYPE_STRING    = 14,
-  
-  MPC_TYPE_APPLY     = 15,
-  MPC_TYPE_APPLY_TO  = 16,
-  MPC_TYPE_PREDICT   = 17,
-  MPC_TYPE_NOT       = 18,
-  MPC_TYPE_MAYBE     = 19,
-  MPC_TYPE_MANY      = 20,
-  MPC_TYPE_MANY1     = 21,
-  MPC_TYPE_COUNT     = 22,
-  
-  MPC_TYPE_OR        = 23,
-  MPC_TYPE_AND       = 24
-};
-
-typedef struct { char *m; } mpc_pdata_fail_t;
-typedef struct { mpc_ctor_t lf; void *x; } mpc_pdata_lift_t;
-typedef struct { mpc_parser_t *x; char *m; } mpc_pdata_expect_t;
-typedef struct { int(*f)(char,char); } mpc_pdata_anchor_t;
-typedef struct { char x; } mpc_pdata_single_t;
-typedef struct { char x; char y; } mpc_pdata_range_t;
-typedef struct { int(*f)(char); } mpc_pdata_satisfy_t;
-typedef struct { char *x; } mpc_pdata_string_t;
-typedef struct { mpc_parser_t *x; mpc_apply_t f; } mpc_pdata_apply_t;
-typedef struct { mpc_parser_t *x; mpc_apply_to_t f; void *d; } mpc_pdata_apply_to_t;
-typedef struct { mpc_parser_t *x; } mpc_pdata_predict_t;
-typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_ctor_t lf; } mpc_pdata_not_t;
-typedef struct { int n; mpc_fold_t f; mpc_parser_t *x; mpc_dtor_t dx; } mpc_pdata_repeat_t;
-typedef struct { int n; mpc_parser_t **xs; } mpc_pdata_or_t;
-typedef struct { int n; mpc_fold_t f; mpc_parser_t **xs; mpc_dtor_t *dxs;  } mpc_pdata_and_t;
-
-typedef union {
-  mpc_pdata_fail_t fail;
-  mpc_pdata_lift_t lift;
-  mpc_pdata_expect_t expect;
-  mpc_pdata_anchor_t anchor;
-  mpc_pdata_single_t single;
-  mpc_pdata_range_t range;
-  mpc_pdata_satisfy_t satisfy;
-  mpc_pdata_string_t string;
-  mpc_pdata_apply_t apply;
-  mpc_pdata_apply_to_t apply_to;
-  mpc_pdata_predict_t predict;
-  mpc_pdata_not_t not;
-  mpc_pdata_repeat_t repeat;
-  mpc_pdata_and_t and;
-  mpc_pdata_or_t or;
-} mpc_pdata_t;
-
-struct mpc_parser_t {
-  char retained;
-  char *name;
-  char type;
-  mpc_pdata_t data;
-};
-
-static mpc_val_t *mpcf_input_nth_free(mpc_input_t *i, int n, mpc_val_t **xs, int x) {
-  int j;
-  for (j = 0; j < n; j++) { if (j != x) { mpc_free(i, xs[j]); } }
-  return xs[x];
-}
- 
-static mpc_val_t *mpcf_input_fst_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 0); }
-static mpc_val_t *mpcf_input_snd_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 1); }
-static mpc_val_t *mpcf_input_trd_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 2); }
-
-static mpc_val_t *mpcf_input_strfold(mpc_input_t *i, int n, mpc_val_t **xs) {
-  int j;
-  size_t l = 0;
-  if (n == 0) { return mpc_calloc(i, 1, 1); }
-  for (j = 0; j < n; j++) { l += strlen(xs[j]); }
-  xs[0] = mpc_realloc(i, xs[0], l + 1);
-  for (j = 1; j < n; j++) { strcat(xs[0], xs[j]); mpc_free(i, xs[j]); }
-  return xs[0];
-}
-
-static mpc_val_t *mpcf_input_state_ast(mpc_input_t *i, int n, mpc_val_t **xs) {
-  mpc_state_t *s = ((mpc_state_t**)xs)[0];
-  mpc_ast_t *a = ((mpc_ast_t**)xs)[1];
-  a = mpc_ast_state(a, *s);
-  mpc_free(i, s);
-  (void) n;
-  return a;
-}
-
-static mpc_val_t *mpc_parse_fold(mpc_input_t *i, mpc_fold_t f, int n, mpc_val_t **xs) {
-  int j;
-  if (f == mpcf_null)      { return mpcf_null(n, xs); }
-  if (f == mpcf_fst)       { return mpcf_fst(n, xs); }
-  if (f == mpcf_snd)       { return mpcf_snd(n, xs); }
-  if (f == mpcf_trd)       { return mpcf_trd(n, xs); }
-  if (f == mpcf_fst_free)  { return mpcf_input_fst_free(i, n, xs); }
-  if (f == mpcf_snd_free)  { return mpcf_input_snd_free(i, n, xs); }
-  if (f == mpcf_trd_free)  { return mpcf_input_trd_free(i, n, xs); }
-  if (f == mpcf_strfold)   { return mpcf_input_strfold(i, n, xs); }
-  if (f == mpcf_state_ast) { return mpcf_input_state_ast(i, n, xs); }
-  for (j = 0; j < n; j++) { xs[j] = mpc_export(i, xs[j]); }
-  return f(j, xs);
-}
-
-static mpc_val_t *mpcf_input_free(mpc_input_t *i, mpc_val_t *x) {
-  mpc_free(i, x);
-  return NULL;
-}
-
-static mpc_val_t *mpcf_input_str_ast(mpc_input_t *i, mpc_val_t *c) {
-  mpc_ast_t *a = mpc_ast_new("", c);
-  mpc_free(i, c);
-  return a;
-}
-
-static mpc_val_t *mpc_parse_apply(mpc_input_t *i, mpc_apply_t f, mpc_val_t *x) {
-  if (f == mpcf_free)     { return mpcf_input_free(i, x); }
-  if (f == mpcf_str_ast)  { return mpcf_input_str_ast(i, x); }
-  return f(mpc_export(i, x));
-}
-
-static mpc_val_t *mpc_parse_apply_to(mpc_input_t *i, mpc_apply_to_t f, mpc_val_t *x, mpc_val_t *d) {
-  return f(mpc_export(i, x), d);
-}
-
-static void mpc_parse_dtor(mpc_input_t *i, mpc_dtor_t d, mpc_val_t *x) {
-  if (d == free) { mpc_free(i, x); return; }
-  d(mpc_export(i, x));
-}
-
-enum {
-  MPC_PARSE_STACK_MIN = 4
-};
-
-#define MPC_SUCCESS(x) r->output = x; return 1
-#define MPC_FAILURE(x) r->error = x; return 0
-#define MPC_PRIMITIVE(x) \
-  if (x) { MPC_SUCCESS(r->output); } \
-  else { MPC_FAILURE(NULL); }
-
-static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e) {
-  
-  int j = 0, k = 0;
-  mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
-  mpc_result_t *results;
-  int results_slots = MPC_PARSE_STACK_MIN;
-  
-  switch (p->type) {
-      
-    /* Basic Parsers */
-
-    case MPC_TYPE_ANY:     MPC_PRIMITIVE(mpc_input_any(i, (char**)&r->output));
-    case MPC_TYPE_SINGLE:  MPC_PRIMITIVE(mpc_input_char(i, p->data.single.x, (char**)&r->output));
-    case MPC_TYPE_RANGE:   MPC_PRIMITIVE(mpc_input_range(i, p->data.range.x, p->data.range.y, (char**)&r->output));
-    case MPC_TYPE_ONEOF:   MPC_PRIMITIVE(mpc_input_oneof(i, p->data.string.x, (char**)&r->output));
-    case MPC_TYPE_NONEOF:  MPC_PRIMITIVE(mpc_input_noneof(i, p->data.string.x, (char**)&r->output));
-    case MPC_TYPE_SATISFY: MPC_PRIMITIVE(mpc_input_satisfy(i, p->data.satisfy.f, (char**)&r->output));
-    case MPC_TYPE_STRING:  MPC_PRIMITIVE(mpc_input_string(i, p->data.string.x, (char**)&r->output));
-    case MPC_TYPE_ANCHOR:  MPC_PRIMITIVE(mpc_input_anchor(i, p->data.anchor.f, (char**)&r->output));
-    
-    /* Other parsers */
-    
-    case MPC_TYPE_UNDEFINED: MPC_FAILURE(mpc_err_fail(i, "Parser Undefined!"));
-    case MPC_TYPE_PASS:      MPC_SUCCESS(NULL);
-    case MPC_TYPE_FAIL:      MPC_FAILURE(mpc_err_fail(i, p->data.fail.m));
-    case MPC_TYPE_LIFT:      MPC_SUCCESS(p->data.lift.lf());
-    case MPC_TYPE_LIFT_VAL:  MPC_SUCCESS(p->data.lift.x);
-    case MPC_TYPE_STATE:     MPC_SUCCESS(mpc_input_state_copy(i));
-    
-    /* Application Parsers */
-    
-    case MPC_TYPE_APPLY:
-      if (mpc_parse_run(i, p->data.apply.x, r, e)) {
-        MPC_SUCCESS(mpc_parse_apply(i, p->data.apply.f, r->output));
-      } else {
-        MPC_FAILURE(r->output);
-      }
-    
-    case MPC_TYPE_APPLY_TO:
-      if (mpc_parse_run(i, p->data.apply_to.x, r, e)) {
-        MPC_SUCCESS(mpc_parse_apply_to(i, p->data.apply_to.f, r->output, p->data.apply_to.d));
-      } else {
-        MPC_FAILURE(r->error);
-      }
-    
-    case MPC_TYPE_EXPECT:
-      mpc_input_suppress_enable(i);
-      if (mpc_parse_run(i, p->data.expect.x, r, e)) {
-        mpc_input_suppress_disable(i);
-        MPC_SUCCESS(r->output);
-      } else {
-        mpc_input_suppress_disable(i);
-        MPC_FAILURE(mpc_err_new(i, p->data.expect.m));
-      }
-    
-    case MPC_TYPE_PREDICT:
-      mpc_input_backtrack_disable(i);
-      if (mpc_parse_run(i, p->data.predict.x, r, e)) {      
-        mpc_input_backtrack_enable(i);
-        MPC_SUCCESS(r->output);
-      } else {
-        mpc_input_backtrack_enable(i);
-        MPC_FAILURE(r->error);
-      }
-    
-    /* Optional Parsers */
-    
-    /* TODO: Update Not Error Message */
-    
-    case MPC_TYPE_NOT:
-      mpc_input_mark(i);
-      mpc_input_suppress_enable(i);
-      if (mpc_parse_run(i, p->data.not.x, r, e)) {
-        mpc_input_rewind(i);
-        mpc_input_suppress_disable(i);
-        mpc_parse_dtor(i, p->data.not.dx, r->output);
-        MPC_FAILURE(mpc_err_new(i, "opposite"));
-      } else {
-        mpc_input_unmark(i);
-        mpc_input_suppress_disable(i);
-        MPC_SUCCESS(p->data.not.lf());
-      }
-    
-    case MPC_TYPE_MAYBE:
-      if (mpc_parse_run(i, p->data.not.x, r, e)) {
-        MPC_SUCCESS(r->output);
-      } else {
-        *e = mpc_err_merge(i, *e, r->error);
-        MPC_SUCCESS(p->data.not.lf());
-      }
-    
-    /* Repeat Parsers */
-    
-    case MPC_TYPE_MANY:
-      
-      results = results_stk;
-      
-      while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
-        j++;
-        if (j == MPC_PARSE_STACK_MIN) {
-          results_slots = j + j / 2;
-          results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
-          memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
-        } else if (j >= results_slots) {
-          results_slots = j + j / 2;
-          results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
-        }
-      }
-      
-      *e = mpc_err_merge(i, *e, results[j].error);
-      MPC_SUCCESS(
-        mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
-        if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-    
-    case MPC_TYPE_MANY1:
-      
-      results = results_stk;
-      
-      while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
-        j++;
-        if (j == MPC_PARSE_STACK_MIN) {
-          results_slots = j + j / 2;
-          results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
-          memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
-        } else if (j >= results_slots) {
-          results_slots = j + j / 2;
-          results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
-        }
-      }
-      
-      if (j == 0) {
-        MPC_FAILURE(
-          mpc_err_many1(i, results[j].error);
-          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-      } else {
-        *e = mpc_err_merge(i, *e, results[j].error);
-        MPC_SUCCESS(
-          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
-          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-      }
-    
-    case MPC_TYPE_COUNT:
-      
-      results = p->data.repeat.n > MPC_PARSE_STACK_MIN
-        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.repeat.n)
-        : results_stk;
-      
-      while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
-        j++;
-        if (j == p->data.repeat.n) { break; }
-      }
-      
-      if (j == p->data.repeat.n) {
-        MPC_SUCCESS(
-          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
-          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-      } else {
-        for (k = 0; k < j; k++) {
-          mpc_parse_dtor(i, p->data.repeat.dx, results[k].output);
-        }
-        MPC_FAILURE(
-          mpc_err_count(i, results[j].error, p->data.repeat.n);
-          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });  
-      }
-      
-    /* Combinatory Parsers */
-    
-    case MPC_TYPE_OR:
-      
-      if (p->data.or.n == 0) { MPC_SUCCESS(NULL); }
-      
-      results = p->data.or.n > MPC_PARSE_STACK_MIN
-        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
-        : results_stk;
-      
-      for (j = 0; j < p->data.or.n; j++) {
-        if (mpc_parse_run(i, p->data.or.xs[j], &results[j], e)) {
-          MPC_SUCCESS(results[j].output;
-            if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-        } else {
-          *e = mpc_err_merge(i, *e, results[j].error);
-        } 
-      }
-      
-      MPC_FAILURE(NULL;
-        if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-    
-    case MPC_TYPE_AND:
-      
-      if (p->data.and.n == 0) { MPC_SUCCESS(NULL); }
-      
-      results = p->data.or.n > MPC_PARSE_STACK_MIN
-        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
-        : results_stk;
-      
-      mpc_input_mark(i);
-      for (j = 0; j < p->data.and.n; j++) {
-        if (!mpc_parse_run(i, p->data.and.xs[j], &results[j], e)) {
-          mpc_input_rewind(i);
-          for (k = 0; k < j; k++) {
-            mpc_parse_dtor(i, p->data.and.dxs[k], results[k].output);
-          }
-          MPC_FAILURE(results[j].error;
-            if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-        }
-      }
-      mpc_input_unmark(i); 
-      MPC_SUCCESS(
-        mpc_parse_fold(i, p->data.and.f, j, (mpc_val_t**)results);
-        if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-    
-    /* End */
-    
-    default:
-      
-      MPC_FAILURE(mpc_err_fail(i, "Unknown Parser Type Id!"));
-  }
-  
-  return 0;
-  
-}
-
-#undef MPC_SUCCESS
-#undef MPC_FAILURE
-#undef MPC_PRIMITIVE
-
-int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
-  int x;
-  mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
-  e->state = mpc_state_invalid();
-  x = mpc_parse_run(i, p, r, &e);
-  if (x) {
-    mpc_err_delete_internal(i, e);
-    r->output = mpc_export(i, r->output);
-  } else {
-    r->error = mpc_err_export(i, mpc_err_merge(i, e, r->error));
-  }
-  return x;
-}
-
-int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r) {
-  int x;
-  mpc_input_t *i = mpc_input_new_string(filename, string);
-  x = mpc_parse_input(i, p, r);
-  mpc_input_delete(i);
-  return x;
-}
-
-int mpc_nparse(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r) {
-  int x;
-  mpc_input_t *i = mpc_input_new_nstring(filename, string, length);
-  x = mpc_parse_input(i, p, r);
-  mpc_input_delete(i);
-  return x;
-}
-
-int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result_t *r) {
-  int x;
-  mpc_input_t *i = mpc_input_new_file(filename, file);
-  x = mpc_parse_input(i, p, r);
-  mpc_input_delete(i);
-  return x;
-}
-
-int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r) {
-  int x;
-  mpc_input_t *i = mpc_input_new_pipe(filename, pipe);
-  x = mpc_parse_input(i, p, r);
-  mpc_input_delete(i);
-  return x;
-}
-
-int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
-  
-  FILE *f = fopen(filename, "rb");
-  int res;
-  
-  if (f == NULL) {
-    r->output = NULL;
-    r->error = mpc_err_file(filename, "Unable to open file!");
-    return 0;
-  }
-  
-  res = mpc_parse_file(filename, f, p, r);
-  fclose(f);
-  return res;
-}
-
-/*
-** Building a Parser
-*/
-
-static void mpc_undefine_unretained(mpc_parser_t *p, int force);
-
-static void mpc_undefine_or(mpc_parser_t *p) {
-  
-  int i;
-  for (i = 0; i < p->data.or.n; i++) {
-    mpc_undefine_unretained(p->data.or.xs[i], 0);
-  }
-  free(p->data.or.xs);
-  
-}
-
-static void mpc_undefine_and(mpc_parser_t *p) {
-  
-  int i;
-  for (i = 0; i < p->data.and.n; i++) {
-    mpc_undefine_unretained(p->data.and.xs[i], 0);
-  }
-  free(p->data.and.xs);
-  free(p->data.and.dxs);
-  
-}
-
-static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
-  
-  if (p->retained && !force) { return; }
-  
-  switch (p->type) {
-    
-    case MPC_TYPE_FAIL: free(p->data.fail.m); break;
-    
-    case MPC_TYPE_ONEOF: 
-    case MPC_TYPE_NONEOF:
-    case MPC_TYPE_STRING:
-      free(p->data.string.x); 
-      break;
-    
-    case MPC_TYPE_APPLY:    mpc_undefine_unretained(p->data.apply.x, 0);    break;
-    case MPC_TYPE_APPLY_TO: mpc_undefine_unretained(p->data.apply_to.x, 0); break;
-    case MPC_TYPE_PREDICT:  mpc_undefine_unretained(p->data.predict.x, 0);  break;
-    
-    case MPC_TYPE_MAYBE:
-    case MPC_TYPE_NOT:
-      mpc_undefine_unretained(p->data.not.x, 0);
-      break;
-    
-    case MPC_TYPE_EXPECT:
-      mpc_undefine_unretained(p->data.expect.x, 0);
-      free(p->data.expect.m);
-      break;
-      
-    case MPC_TYPE_MANY:
-    case MPC_TYPE_MANY1:
-    case MPC_TYPE_COUNT:
-      mpc_undefine_unretained(p->data.repeat.x, 0);
-      break;
-    
-    case MPC_TYPE_OR:  mpc_undefine_or(p);  break;
-    case MPC_TYPE_AND: mpc_undefine_and(p); break;
-    
-    default: break;
-  }
-  
-  if (!force) {
-    free(p->name);
-    free(p);
-  }
-  
-}
-
-void mpc_delete(mpc_parser_t *p) {
-  if (p->retained) {
-
-    if (p->type != MPC_TYPE_UNDEFINED) {
-      mpc_undefine_unretained(p, 0);
-    } 
-    
-    free(p->name);
-    free(p);
-  
-  } else {
-    mpc_undefine_unretained(p, 0);  
-  }
-}
-
-static void mpc_soft_delete(mpc_val_t *x) {
-  mpc_undefine_unretained(x, 0);
-}
-
-static mpc_parser_t *mpc_undefined(void) {
-  mpc_parser_t *p = calloc(1, sizeof(mpc_parser_t));
-  p->retained = 0;
-  p->type = MPC_TYPE_UNDEFINED;
-  p->name = NULL;
-  return p;
-}
-
-mpc_parser_t *mpc_new(const char *name) {
-  mpc_parser_t *p = mpc_undefined();
-  p->retained = 1;
-  p->name = realloc(p->name, strlen(name) + 1);
-  strcpy(p->name, name);
-  return p;
-}
-
-mpc_parser_t *mpc_copy(mpc_parser_t *a) {
-  int i = 0;
-  mpc_parser_t *p;
-  
-  if (a->retained) { return a; }
-  
-  p = mpc_undefined();
-  p->retained = a->retained;
-  p->type = a->type;
-  p->data = a->data;
-  
-  if (a->name) {
-    p->name = malloc(strlen(a->name)+1);
-    strcpy(p->name, a->name);
-  }
-  
-  switch (a->type) {
-    
-    case MPC_TYPE_FAIL:
-      p->data.fail.m = malloc(strlen(a->data.fail.m)+1);
-      strcpy(p->data.fail.m, a->data.fail.m);
-    break;
-    
-    case MPC_TYPE_ONEOF: 
-    case MPC_TYPE_NONEOF:
-    case MPC_TYPE_STRING:
-      p->data.string.x = malloc(strlen(a->data.string.x)+1);
-      strcpy(p->data.string.x, a->data.string.x);
-      break;
-    
-    case MPC_TYPE_APPLY:    p->data.apply.x    = mpc_copy(a->data.apply.x);    break;
-    case MPC_TYPE_APPLY_TO: p->data.apply_to.x = mpc_copy(a->data.apply_to.x); break;
-    case MPC_TYPE_PREDICT:  p->data.predict.x  = mpc_copy(a->data.predict.x);  break;
-    
-    case MPC_TYPE_MAYBE:
-    case MPC_TYPE_NOT:
-      p->data.not.x = mpc_copy(a->data.not.x);
-      break;
-    
-    case MPC_TYPE_EXPECT:
-      p->data.expect.x = mpc_copy(a->data.expect.x);
-      p->data.expect.m = malloc(strlen(a->data.expect.m)+1);
-      strcpy(p->data.expect.m, a->data.expect.m);
-      break;
-      
-    case MPC_TYPE_MANY:
-    case MPC_TYPE_MANY1:
-    case MPC_TYPE_COUNT:
-      p->data.repeat.x = mpc_copy(a->data.repeat.x);
-      break;
-    
-    case MPC_TYPE_OR:
-      p->data.or.xs = malloc(a->data.or.n * sizeof(mpc_parser_t*));
-      for (i = 0; i < a->data.or.n; i++) {
-        p->data.or.xs[i] = mpc_copy(a->data.or.xs[i]);
-      }
-    break;
-    case MPC_TYPE_AND:
-      p->data.and.xs = malloc(a->data.and.n * sizeof(mpc_parser_t*));
-      for (i = 0; i < a->data.and.n; i++) {
-        p->data.and.xs[i] = mpc_copy(a->data.and.xs[i]);
-      }
-      p->data.and.dxs = malloc((a->data.and.n-1) * sizeof(mpc_dtor_t));
-      for (i = 0; i < a->data.and.n-1; i++) {
-        p->data.and.dxs[i] = a->data.and.dxs[i];
-      }
-    break;
-    
-    default: break;
-  }
-
-  
-  return p;
-}
-
-mpc_parser_t *mpc_undefine(mpc_parser_t *p) {
-  mpc_undefine_unretained(p, 1);
-  p->type = MPC_TYPE_UNDEFINED;
-  return p;
-}
-
-mpc_parser_t *mpc_define(mpc_parser_t *p, mpc_parser_t *a) {
-  
-  if (p->retained) {
-    p->type = a->type;
-    p->data = a->data;
-  } else {
-    mpc_parser_t *a2 = mpc_failf("Attempt to assign to Unretained Parser!");
-    p->type = a2->type;
-    p->data = a2->data;
-    free(a2);
-  }
-  
-  free(a);
-  return p;  
-}
-
-void mpc_cleanup(int n, ...) {
-  int i;
-  mpc_parser_t **list = malloc(sizeof(mpc_parser_t*) * n);
-  
-  va_list va;
-  va_start(va, n);
-  for (i = 0; i < n; i++) { list[i] = va_arg(va, mpc_parser_t*); }
-  for (i = 0; i < n; i++) { mpc_undefine(list[i]); }
-  for (i = 0; i < n; i++) { mpc_delete(list[i]); }  
-  va_end(va);  
-
-  free(list);
-}
-
-mpc_parser_t *mpc_pass(void) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_PASS;
-  return p;
-}
-
-mpc_parser_t *mpc_fail(const char *m) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_FAIL;
-  p->data.fail.m = malloc(strlen(m) + 1);
-  strcpy(p->data.fail.m, m);
-  return p;
-}
-
-/*
-** As `snprintf` is not ANSI standard this 
-** function `mpc_failf` should be considered
-** unsafe.
-**
-** You have a few options if this is going to be
-** trouble.
-**
-** - Ensure the format string does not exceed
-**   the buffer length using precision specifiers
-**   such as `%.512s`.
-**
-** - Patch this function in your code base to 
-**   use `snprintf` or whatever variant your
-**   system supports.
-**
-** - Avoid it altogether.
-**
-*/
-
-mpc_parser_t *mpc_failf(const char *fmt, ...) {
-  
-  va_list va;
-  char *buffer;
-
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_FAIL;
-  
-  va_start(va, fmt);
-  buffer = malloc(2048);
-  vsprintf(buffer, fmt, va);
-  va_end(va);
-  
-  buffer = realloc(buffer, strlen(buffer) + 1);
-  p->data.fail.m = buffer;
-  return p;
-
-}
-
-mpc_parser_t *mpc_lift_val(mpc_val_t *x) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_LIFT_VAL;
-  p->data.lift.x = x;
-  return p;
-}
-
-mpc_parser_t *mpc_lift(mpc_ctor_t lf) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_LIFT;
-  p->data.lift.lf = lf;
-  return p;
-}
-
-mpc_parser_t *mpc_anchor(int(*f)(char,char)) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_ANCHOR;
-  p->data.anchor.f = f;
-  return mpc_expect(p, "anchor");
-}
-
-mpc_parser_t *mpc_state(void) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_STATE;
-  return p;
-}
-
-mpc_parser_t *mpc_expect(mpc_parser_t *a, const char *expected) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_EXPECT;
-  p->data.expect.x = a;
-  p->data.expect.m = malloc(strlen(expected) + 1);
-  strcpy(p->data.expect.m, expected);
-  return p;
-}
-
-/*
-** As `snprintf` is not ANSI standard this 
-** function `mpc_expectf` should be considered
-** unsafe.
-**
-** You have a few options if this is going to be
-** trouble.
-**
-** - Ensure the format string does not exceed
-**   the buffer length using precision specifiers
-**   such as `%.512s`.
-**
-** - Patch this function in your code base to 
-**   use `snprintf` or whatever variant your
-**   system supports.
-**
-** - Avoid it altogether.
-**
-*/
-
-mpc_parser_t *mpc_expectf(mpc_parser_t *a, const char *fmt, ...) {
-  va_list va;
-  char *buffer;
-
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_EXPECT;
-  
-  va_start(va, fmt);
-  buffer = malloc(2048);
-  vsprintf(buffer, fmt, va);
-  va_end(va);
-  
-  buffer = realloc(buffer, strlen(buffer) + 1);
-  p->data.expect.x = a;
-  p->data.expect.m = buffer;
-  return p;
-}
-
-/*
-** Basic Parsers
-*/
-
-mpc_parser_t *mpc_any(void) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_ANY;
-  return mpc_expect(p, "any character");
-}
-
-mpc_parser_t *mpc_char(char c) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_SINGLE;
-  p->data.single.x = c;
-  return mpc_expectf(p, "'%c'", c);
-}
-
-mpc_parser_t *mpc_range(char s, char e) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_RANGE;
-  p->data.range.x = s;
-  p->data.range.y = e;
-  return mpc_expectf(p, "character between '%c' and '%c'", s, e);
-}
-
-mpc_parser_t *mpc_oneof(const char *s) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_ONEOF;
-  p->data.string.x = malloc(strlen(s) + 1);
-  strcpy(p->data.string.x, s);
-  return mpc_expectf(p, "one of '%s'", s);
-}
-
-mpc_parser_t *mpc_noneof(const char *s) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_NONEOF;
-  p->data.string.x = malloc(strlen(s) + 1);
-  strcpy(p->data.string.x, s);
-  return mpc_expectf(p, "none of '%s'", s);
-
-}
-
-mpc_parser_t *mpc_satisfy(int(*f)(char)) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_SATISFY;
-  p->data.satisfy.f = f;
-  return mpc_expectf(p, "character satisfying function %p", f);
-}
-
-mpc_parser_t *mpc_string(const char *s) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_STRING;
-  p->data.string.x = malloc(strlen(s) + 1);
-  strcpy(p->data.string.x, s);
-  return mpc_expectf(p, "\"%s\"", s);
-}
-
-/*
-** Core Parsers
-*/
-
-mpc_parser_t *mpc_apply(mpc_parser_t *a, mpc_apply_t f) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_APPLY;
-  p->data.apply.x = a;
-  p->data.apply.f = f;
-  return p;
-}
-
-mpc_parser_t *mpc_apply_to(mpc_parser_t *a, mpc_apply_to_t f, void *x) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_APPLY_TO;
-  p->data.apply_to.x = a;
-  p->data.apply_to.f = f;
-  p->data.apply_to.d = x;
-  return p;
-}
-
-mpc_parser_t *mpc_predictive(mpc_parser_t *a) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_PREDICT;
-  p->data.predict.x = a;
-  return p;
-}
-
-mpc_parser_t *mpc_not_lift(mpc_parser_t *a, mpc_dtor_t da, mpc_ctor_t lf) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_NOT;
-  p->data.not.x = a;
-  p->data.not.dx = da;
-  p->data.not.lf = lf;
-  return p;
-}
-
-mpc_parser_t *mpc_not(mpc_parser_t *a, mpc_dtor_t da) {
-  return mpc_not_lift(a, da, mpcf_ctor_null);
-}
-
-mpc_parser_t *mpc_maybe_lift(mpc_parser_t *a, mpc_ctor_t lf) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_MAYBE;
-  p->data.not.x = a;
-  p->data.not.lf = lf;
-  return p;
-}
-
-mpc_parser_t *mpc_maybe(mpc_parser_t *a) {
-  return mpc_maybe_lift(a, mpcf_ctor_null);
-}
-
-mpc_parser_t *mpc_many(mpc_fold_t f, mpc_parser_t *a) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_MANY;
-  p->data.repeat.x = a;
-  p->data.repeat.f = f;
-  return p;
-}
-
-mpc_parser_t *mpc_many1(mpc_fold_t f, mpc_parser_t *a) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_MANY1;
-  p->data.repeat.x = a;
-  p->data.repeat.f = f;
-  return p;
-}
-
-mpc_parser_t *mpc_count(int n, mpc_fold_t f, mpc_parser_t *a, mpc_dtor_t da) {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_COUNT;
-  p->data.repeat.n = n;
-  p->data.repeat.f = f;
-  p->data.repeat.x = a;
-  p->data.repeat.dx = da;
-  return p;
-}
-
-mpc_parser_t *mpc_or(int n, ...) {
-
-  int i;
-  va_list va;
-
-  mpc_parser_t *p = mpc_undefined();
-  
-  p->type = MPC_TYPE_OR;
-  p->data.or.n = n;
-  p->data.or.xs = malloc(sizeof(mpc_parser_t*) * n);
-  
-  va_start(va, n);  
-  for (i = 0; i < n; i++) {
-    p->data.or.xs[i] = va_arg(va, mpc_parser_t*);
-  }
-  va_end(va);
-  
-  return p;
-}
-
-mpc_parser_t *mpc_and(int n, mpc_fold_t f, ...) {
-
-  int i;
-  va_list va;
-
-  mpc_parser_t *p = mpc_undefined();
-  
-  p->type = MPC_TYPE_AND;
-  p->data.and.n = n;
-  p->data.and.f = f;
-  p->data.and.xs = malloc(sizeof(mpc_parser_t*) * n);
-  p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (n-1));
-
-  va_start(va, f);  
-  for (i = 0; i < n; i++) {
-    p->data.and.xs[i] = va_arg(va, mpc_parser_t*);
-  }
-  for (i = 0; i < (n-1); i++) {
-    p->data.and.dxs[i] = va_arg(va, mpc_dtor_t);
-  }  
-  va_end(va);
-  
-  return p;
-}
-
-/*
-** Common Parsers
-*/
-
-static int mpc_soi_anchor(char prev, char next) { (void) next; return (prev == '\0'); }
-static int mpc_eoi_anchor(char prev, char next) { (void) prev; return (next == '\0'); }
-
-mpc_parser_t *mpc_soi(void) { return mpc_expect(mpc_anchor(mpc_soi_anchor), "start of input"); }
-mpc_parser_t *mpc_eoi(void) { return mpc_expect(mpc_anchor(mpc_eoi_anchor), "end of input"); }
-
-static int mpc_boundary_anchor(char prev, char next) {
-  const char* word = "abcdefghijklmnopqrstuvwxyz"
-                     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                     "0123456789_";
-  if ( strchr(word, next) &&  prev == '\0') { return 1; }
-  if ( strchr(word, prev) &&  next == '\0') { return 1; }
-  if ( strchr(word, next) && !strchr(word, prev)) { return 1; }
-  if (!strchr(word, next) &&  strchr(word, prev)) { return 1; }
-  return 0;
-}
-
-mpc_parser_t *mpc_boundary(void) { return mpc_expect(mpc_anchor(mpc_boundary_anchor), "boundary"); }
-
-mpc_parser_t *mpc_whitespace(void) { return mpc_expect(mpc_oneof(" \f\n\r\t\v"), "whitespace"); }
-mpc_parser_t *mpc_whitespaces(void) { return mpc_expect(mpc_many(mpcf_strfold, mpc_whitespace()), "spaces"); }
-mpc_parser_t *mpc_blank(void) { return mpc_expect(mpc_apply(mpc_whitespaces(), mpcf_free), "whitespace"); }
-
-mpc_parser_t *mpc_newline(void) { return mpc_expect(mpc_char('\n'), "newline"); }
-mpc_parser_t *mpc_tab(void) { return mpc_expect(mpc_char('\t'), "tab"); }
-mpc_parser_t *mpc_escape(void) { return mpc_and(2, mpcf_strfold, mpc_char('\\'), mpc_any(), free); }
-
-mpc_parser_t *mpc_digit(void) { return mpc_expect(mpc_oneof("0123456789"), "digit"); }
-mpc_parser_t *mpc_hexdigit(void) { return mpc_expect(mpc_oneof("0123456789ABCDEFabcdef"), "hex digit"); }
-mpc_parser_t *mpc_octdigit(void) { return mpc_expect(mpc_oneof("01234567"), "oct digit"); }
-mpc_parser_t *mpc_digits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_digit()), "digits"); }
-mpc_parser_t *mpc_hexdigits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_hexdigit()), "hex digits"); }
-mpc_parser_t *mpc_octdigits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_octdigit()), "oct digits"); }
-
-mpc_parser_t *mpc_lower(void) { return mpc_expect(mpc_oneof("abcdefghijklmnopqrstuvwxyz"), "lowercase letter"); }
-mpc_parser_t *mpc_upper(void) { return mpc_expect(mpc_oneof("ABCDEFGHIJKLMNOPQRSTUVWXYZ"), "uppercase letter"); }
-mpc_parser_t *mpc_alpha(void) { return mpc_expect(mpc_oneof("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"), "letter"); }
-mpc_parser_t *mpc_underscore(void) { return mpc_expect(mpc_char('_'), "underscore"); }
-mpc_parser_t *mpc_alphanum(void) { return mpc_expect(mpc_or(3, mpc_alpha(), mpc_digit(), mpc_underscore()), "alphanumeric"); }
-
-mpc_parser_t *mpc_int(void) { return mpc_expect(mpc_apply(mpc_digits(), mpcf_int), "integer"); }
-mpc_parser_t *mpc_hex(void) { return mpc_expect(mpc_apply(mpc_hexdigits(), mpcf_hex), "hexadecimal"); }
-mpc_parser_t *mpc_oct(void) { return mpc_expect(mpc_apply(mpc_octdigits(), mpcf_oct), "octadecimal"); }
-mpc_parser_t *mpc_number(void) { return mpc_expect(mpc_or(3, mpc_int(), mpc_hex(), mpc_oct()), "number"); }
-
-mpc_parser_t *mpc_real(void) {
-
-  /* [+-]?\d+(\.\d+)?([eE][+-]?[0-9]+)? */
-  
-  mpc_parser_t *p0, *p1, *p2, *p30, *p31, *p32, *p3;
-  
-  p0 = mpc_maybe_lift(mpc_oneof("+-"), mpcf_ctor_str);
-  p1 = mpc_digits();
-  p2 = mpc_maybe_lift(mpc_and(2, mpcf_strfold, mpc_char('.'), mpc_digits(), free), mpcf_ctor_str);
-  p30 = mpc_oneof("eE");
-  p31 = mpc_maybe_lift(mpc_oneof("+-"), mpcf_ctor_str);
-  p32 = mpc_digits();
-  p3 = mpc_maybe_lift(mpc_and(3, mpcf_strfold, p30, p31, p32, free, free), mpcf_ctor_str);
-  
-  return mpc_expect(mpc_and(4, mpcf_strfold, p0, p1, p2, p3, free, free, free), "real");
-
-}
-
-mpc_parser_t *mpc_float(void) {
-  return mpc_expect(mpc_apply(mpc_real(), mpcf_float), "float");
-}
-
-mpc_parser_t *mpc_char_lit(void) {
-  return mpc_expect(mpc_between(mpc_or(2, mpc_escape(), mpc_any()), free, "'", "'"), "char");
-}
-
-mpc_parser_t *mpc_string_lit(void) {
-  mpc_parser_t *strchar = mpc_or(2, mpc_escape(), mpc_noneof("\""));
-  return mpc_expect(mpc_between(mpc_many(mpcf_strfold, strchar), free, "\"", "\""), "string");
-}
-
-mpc_parser_t *mpc_regex_lit(void) {  
-  mpc_parser_t *regexchar = mpc_or(2, mpc_escape(), mpc_noneof("/"));
-  return mpc_expect(mpc_between(mpc_many(mpcf_strfold, regexchar), free, "/", "/"), "regex");
-}
-
-mpc_parser_t *mpc_ident(void) {
-  mpc_parser_t *p0, *p1; 
-  p0 = mpc_or(2, mpc_alpha(), mpc_underscore());
-  p1 = mpc_many(mpcf_strfold, mpc_alphanum()); 
-  return mpc_and(2, mpcf_strfold, p0, p1, free);
-}
-
-/*
-** Useful Parsers
-*/
-
-mpc_parser_t *mpc_startwith(mpc_parser_t *a) { return mpc_and(2, mpcf_snd, mpc_soi(), a, mpcf_dtor_null); }
-mpc_parser_t *mpc_endwith(mpc_parser_t *a, mpc_dtor_t da) { return mpc_and(2, mpcf_fst, a, mpc_eoi(), da); }
-mpc_parser_t *mpc_whole(mpc_parser_t *a, mpc_dtor_t da) { return mpc_and(3, mpcf_snd, mpc_soi(), a, mpc_eoi(), mpcf_dtor_null, da); }
-
-mpc_parser_t *mpc_stripl(mpc_parser_t *a) { return mpc_and(2, mpcf_snd, mpc_blank(), a, mpcf_dtor_null); }
-mpc_parser_t *mpc_stripr(mpc_parser_t *a) { return mpc_and(2, mpcf_fst, a, mpc_blank(), mpcf_dtor_null); }
-mpc_parser_t *mpc_strip(mpc_parser_t *a) { return mpc_and(3, mpcf_snd, mpc_blank(), a, mpc_blank(), mpcf_dtor_null, mpcf_dtor_null); }
-mpc_parser_t *mpc_tok(mpc_parser_t *a) { return mpc_and(2, mpcf_fst, a, mpc_blank(), mpcf_dtor_null); }
-mpc_parser_t *mpc_sym(const char *s) { return mpc_tok(mpc_string(s)); }
-
-mpc_parser_t *mpc_total(mpc_parser_t *a, mpc_dtor_t da) { return mpc_whole(mpc_strip(a), da); }
-
-mpc_parser_t *mpc_between(mpc_parser_t *a, mpc_dtor_t ad, const char *o, const char *c) {
-  return mpc_and(3, mpcf_snd_free,
-    mpc_string(o), a, mpc_string(c),
-    free, ad);
-}
-
-mpc_parser_t *mpc_parens(mpc_parser_t *a, mpc_dtor_t ad)   { return mpc_between(a, ad, "(", ")"); }
-mpc_parser_t *mpc_braces(mpc_parser_t *a, mpc_dtor_t ad)   { return mpc_between(a, ad, "<", ">"); }
-mpc_parser_t *mpc_brackets(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "{", "}"); }
-mpc_parser_t *mpc_squares(mpc_parser_t *a, mpc_dtor_t ad)  { return mpc_between(a, ad, "[", "]"); }
-
-mpc_parser_t *mpc_tok_between(mpc_parser_t *a, mpc_dtor_t ad, const char *o, const char *c) {
-  return mpc_and(3, mpcf_snd_free,
-    mpc_sym(o), mpc_tok(a), mpc_sym(c),
-    free, ad);
-}
-
-mpc_parser_t *mpc_tok_parens(mpc_parser_t *a, mpc_dtor_t ad)   { return mpc_tok_between(a, ad, "(", ")"); }
-mpc_parser_t *mpc_tok_braces(mpc_parser_t *a, mpc_dtor_t ad)   { return mpc_tok_between(a, ad, "<", ">"); }
-mpc_parser_t *mpc_tok_brackets(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "{", "}"); }
-mpc_parser_t *mpc_tok_squares(mpc_parser_t *a, mpc_dtor_t ad)  { return mpc_tok_between(a, ad, "[", "]"); }
-
-/*
-** Regular Expression Parsers
-*/
-
-/*
-** So here is a cute bootstrapping.
-**
-** I'm using the previously defined
-** mpc constructs and functions to
-** parse the user regex string and
-** construct a parser from it.
-**
-** As it turns out lots of the standard
-** mpc functions look a lot like `fold`
-** functions and so can be used indirectly
-** by many of the parsing functions to build
-** a parser directly - as we are parsing.
-**
-** This is certainly something that
-** would be less elegant/interesting 
-** in a two-phase parser which first
-** builds an AST and then traverses it
-** to generate the object.
-**
-** This whole thing acts as a great
-** case study for how trivial it can be
-** to write a great parser in a few
-** lines of code using mpc.
-*/
-
-/*
-**
-**  ### Regular Expression Grammar
-**
-**      <regex> : <term> | (<term> "|" <regex>)
-**     
-**      <term> : <factor>*
-**
-**      <factor> : <base>
-**               | <base> "*"
-**               | <base> "+"
-**               | <base> "?"
-**               | <base> "{" <digits> "}"
-**           
-**      <base> : <char>
-**             | "\" <char>
-**             | "(" <regex> ")"
-**             | "[" <range> "]"
-*/
-
-static mpc_val_t *mpcf_re_or(int n, mpc_val_t **xs) {
-  (void) n;
-  if (xs[1] == NULL) { return xs[0]; }
-  else { return mpc_or(2, xs[0], xs[1]); }
-}
-
-static mpc_val_t *mpcf_re_and(int n, mpc_val_t **xs) {
-  int i;
-  mpc_parser_t *p = mpc_lift(mpcf_ctor_str);
-  for (i = 0; i < n; i++) {
-    p = mpc_and(2, mpcf_strfold, p, xs[i], free);
-  }
-  return p;
-}
-
-static mpc_val_t *mpcf_re_repeat(int n, mpc_val_t **xs) {
-  int num;
-  (void) n;
-  if (xs[1] == NULL) { return xs[0]; }
-  if (strcmp(xs[1], "*") == 0) { free(xs[1]); return mpc_many(mpcf_strfold, xs[0]); }
-  if (strcmp(xs[1], "+") == 0) { free(xs[1]); return mpc_many1(mpcf_strfold, xs[0]); }
-  if (strcmp(xs[1], "?") == 0) { free(xs[1]); return mpc_maybe_lift(xs[0], mpcf_ctor_str); }
-  num = *(int*)xs[1];
-  free(xs[1]);
-  
-  return mpc_count(num, mpcf_strfold, xs[0], free);
-}
-
-static mpc_parser_t *mpc_re_escape_char(char c) {
-  switch (c) {
-    case 'a': return mpc_char('\a');
-    case 'f': return mpc_char('\f');
-    case 'n': return mpc_char('\n');
-    case 'r': return mpc_char('\r');
-    case 't': return mpc_char('\t');
-    case 'v': return mpc_char('\v');
-    case 'b': return mpc_and(2, mpcf_snd, mpc_boundary(), mpc_lift(mpcf_ctor_str), free);
-    case 'B': return mpc_not_lift(mpc_boundary(), free, mpcf_ctor_str);
-    case 'A': return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
-    case 'Z': return mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free);
-    case 'd': return mpc_digit();
-    case 'D': return mpc_not_lift(mpc_digit(), free, mpcf_ctor_str);
-    case 's': return mpc_whitespace();
-    case 'S': return mpc_not_lift(mpc_whitespace(), free, mpcf_ctor_str);
-    case 'w': return mpc_alphanum();
-    case 'W': return mpc_not_lift(mpc_alphanum(), free, mpcf_ctor_str);
-    default: return NULL;
-  }
-}
-
-static mpc_val_t *mpcf_re_escape(mpc_val_t *x) {
-  
-  char *s = x;
-  mpc_parser_t *p;
-  
-  /* Regex Special Characters */
-  if (s[0] == '.') { free(s); return mpc_any(); }
-  if (s[0] == '^') { free(s); return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free); }
-  if (s[0] == '$') { free(s); return mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free); }
-  
-  /* Regex Escape */
-  if (s[0] == '\\') {
-    p = mpc_re_escape_char(s[1]);
-    p = (p == NULL) ? mpc_char(s[1]) : p;
-    free(s);
-    return p;
-  }
-  
-  /* Regex Standard */
-  p = mpc_char(s[0]);
-  free(s);
-  return p;
-}
-
-static const char *mpc_re_range_escape_char(char c) {
-  switch (c) {
-    case '-': return "-";
-    case 'a': return "\a";
-    case 'f': return "\f";
-    case 'n': return "\n";
-    case 'r': return "\r";
-    case 't': return "\t";
-    case 'v': return "\v";
-    case 'b': return "\b";
-    case 'd': return "0123456789";
-    case 's': return " \f\n\r\t\v";
-    case 'w': return "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
-    default: return NULL;
-  }
-}
-
-static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
-  
-  mpc_parser_t *out;
-  size_t i, j;
-  size_t start, end;
-  const char *tmp = NULL;
-  const char *s = x;
-  int comp = s[0] == '^' ? 1 : 0;
-  char *range = calloc(1,1);
-  
-  if (s[0] == '\0') { free(x); return mpc_fail("Invalid Regex Range Expression"); } 
-  if (s[0] == '^' && 
-      s[1] == '\0') { free(x); return mpc_fail("Invalid Regex Range Expression"); }
-  
-  for (i = comp; i < strlen(s); i++){
-    
-    /* Regex Range Escape */
-    if (s[i] == '\\') {
-      tmp = mpc_re_range_escape_char(s[i+1]);
-      if (tmp != NULL) {
-        range = realloc(range, strlen(range) + strlen(tmp) + 1);
-        strcat(range, tmp);
-      } else {
-        range = realloc(range, strlen(range) + 1 + 1);
-        range[strlen(range) + 1] = '\0';
-        range[strlen(range) + 0] = s[i+1];      
-      }
-      i++;
-    }
-    
-    /* Regex Range...Range */
-    else if (s[i] == '-') {
-      if (s[i+1] == '\0' || i == 0) {
-          range = realloc(range, strlen(range) + strlen("-") + 1);
-          strcat(range, "-");
-      } else {
-        start = s[i-1]+1;
-        end = s[i+1]-1;
-        for (j = start; j <= end; j++) {
-          range = realloc(range, strlen(range) + 1 + 1 + 1);
-          range[strlen(range) + 1] = '\0';
-          range[strlen(range) + 0] = (char)j;
-        }        
-      }
-    }
-    
-    /* Regex Range Normal */
-    else {
-      range = realloc(range, strlen(range) + 1 + 1);
-      range[strlen(range) + 1] = '\0';
-      range[strlen(range) + 0] = s[i];
-    }
-  
-  }
-  
-  out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
-  
-  free(x);
-  free(range);
-  
-  return out;
-}
-
-mpc_parser_t *mpc_re(const char *re) {
-  
-  char *err_msg;
-  mpc_parser_t *err_out;
-  mpc_result_t r;
-  mpc_parser_t *Regex, *Term, *Factor, *Base, *Range, *RegexEnclose; 
-  
-  Regex  = mpc_new("regex");
-  Term   = mpc_new("term");
-  Factor = mpc_new("factor");
-  Base   = mpc_new("base");
-  Range  = mpc_new("range");
-  
-  mpc_define(Regex, mpc_and(2, mpcf_re_or,
-    Term, 
-    mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_char('|'), Regex, free)),
-    (mpc_dtor_t)mpc_delete
-  ));
-  
-  mpc_define(Term, mpc_many(mpcf_re_and, Factor));
-  
-  mpc_define(Factor, mpc_and(2, mpcf_re_repeat,
-    Base,
-    mpc_or(5,
-      mpc_char('*'), mpc_char('+'), mpc_char('?'),
-      mpc_brackets(mpc_int(), free),
-      mpc_pass()),
-    (mpc_dtor_t)mpc_delete
-  ));
-  
-  mpc_define(Base, mpc_or(4,
-    mpc_parens(Regex, (mpc_dtor_t)mpc_delete),
-    mpc_squares(Range, (mpc_dtor_t)mpc_delete),
-    mpc_apply(mpc_escape(), mpcf_re_escape),
-    mpc_apply(mpc_noneof(")|"), mpcf_re_escape)
-  ));
-  
-  mpc_define(Range, mpc_apply(
-    mpc_many(mpcf_strfold, mpc_or(2, mpc_escape(), mpc_noneof("]"))),
-    mpcf_re_range
-  ));
-  
-  RegexEnclose = mpc_whole(mpc_predictive(Regex), (mpc_dtor_t)mpc_delete);
-  
-  mpc_optimise(RegexEnclose);
-  mpc_optimise(Regex);
-  mpc_optimise(Term);
-  mpc_optimise(Factor);
-  mpc_optimise(Base);
-  mpc_optimise(Range);
-  
-  if(!mpc_parse("<mpc_re_compiler>", re, RegexEnclose, &r)) {
-    err_msg = mpc_err_string(r.error);
-    err_out = mpc_failf("Invalid Regex: %s", err_msg);
-    mpc_err_delete(r.error);  
-    free(err_msg);
-    r.output = err_out;
-  }
-  
-  mpc_cleanup(6, RegexEnclose, Regex, Term, Factor, Base, Range);
-  
-  mpc_optimise(r.output);
-  
-  return r.output;
-  
-}
-
-/*
-** Common Fold Functions
-*/
-
-void mpcf_dtor_null(mpc_val_t *x) { (void) x; return; }
-
-mpc_val_t *mpcf_ctor_null(void) { return NULL; }
-mpc_val_t *mpcf_ctor_str(void) { return calloc(1, 1); }
-mpc_val_t *mpcf_free(mpc_val_t *x) { free(x); return NULL; }
-
-mpc_val_t *mpcf_int(mpc_val_t *x) {
-  int *y = malloc(sizeof(int));
-  *y = strtol(x, NULL, 10);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_hex(mpc_val_t *x) {
-  int *y = malloc(sizeof(int));
-  *y = strtol(x, NULL, 16);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_oct(mpc_val_t *x) {
-  int *y = malloc(sizeof(int));
-  *y = strtol(x, NULL, 8);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_float(mpc_val_t *x) {
-  float *y = malloc(sizeof(float));
-  *y = strtod(x, NULL);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_strtriml(mpc_val_t *x) {
-  char *s = x;
-  while (isspace(*s)) {
-    memmove(s, s+1, strlen(s));
-  }
-  return s;
-}
-
-mpc_val_t *mpcf_strtrimr(mpc_val_t *x) {
-  char *s = x;
-  size_t l = strlen(s);
-  while (isspace(s[l-1])) {
-    s[l-1] = '\0'; l--;
-  }
-  return s;
-}
-
-mpc_val_t *mpcf_strtrim(mpc_val_t *x) {
-  return mpcf_strtriml(mpcf_strtrimr(x));
-}
-
-static const char mpc_escape_input_c[]  = {
-  '\a', '\b', '\f', '\n', '\r',
-  '\t', '\v', '\\', '\'', '\"', '\0'};
-    
-static const char *mpc_escape_output_c[] = {
-  "\\a", "\\b", "\\f", "\\n", "\\r", "\\t", 
-  "\\v", "\\\\", "\\'", "\\\"", "\\0", NULL};
-
-static const char mpc_escape_input_raw_re[] = { '/' };
-static const char *mpc_escape_output_raw_re[] = { "\\/", NULL };
-
-static const char mpc_escape_input_raw_cstr[] = { '"' };
-static const char *mpc_escape_output_raw_cstr[] = { "\\\"", NULL };
-
-static const char mpc_escape_input_raw_cchar[] = { '\'' };
-static const char *mpc_escape_output_raw_cchar[] = { "\\'", NULL };
-
-static mpc_val_t *mpcf_escape_new(mpc_val_t *x, const char *input, const char **output) {
-  
-  int i;
-  int found;
-  char buff[2];
-  char *s = x;
-  char *y = calloc(1, 1);
-  
-  while (*s) {
-    
-    i = 0;
-    found = 0;
-
-    while (output[i]) {
-      if (*s == input[i]) {
-        y = realloc(y, strlen(y) + strlen(output[i]) + 1);
-        strcat(y, output[i]);
-        found = 1;
-        break;
-      }
-      i++;
-    }
-    
-    if (!found) {
-      y = realloc(y, strlen(y) + 2);
-      buff[0] = *s; buff[1] = '\0';
-      strcat(y, buff);
-    }
-    
-    s++;
-  }
-  
-  
-  return y;
-}
-
-static mpc_val_t *mpcf_unescape_new(mpc_val_t *x, const char *input, const char **output) {
-  
-  int i;
-  int found = 0;
-  char buff[2];
-  char *s = x;
-  char *y = calloc(1, 1);
-  
-  while (*s) {
-    
-    i = 0;
-    found = 0;
-    
-    while (output[i]) {
-      if ((*(s+0)) == output[i][0] &&
-          (*(s+1)) == output[i][1]) {
-        y = realloc(y, strlen(y) + 1 + 1);
-        buff[0] = input[i]; buff[1] = '\0';
-        strcat(y, buff);
-        found = 1;
-        s++;
-        break;
-      }
-      i++;
-    }
-    
-    if (!found) {
-      y = realloc(y, strlen(y) + 1 + 1);
-      buff[0] = *s; buff[1] = '\0';
-      strcat(y, buff);
-    }
-    
-    if (*s == '\0') { break; }
-    else { s++; }
-  }
-  
-  return y;
-  
-}
-
-mpc_val_t *mpcf_escape(mpc_val_t *x) {
-  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_c, mpc_escape_output_c);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_unescape(mpc_val_t *x) {
-  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_c, mpc_escape_output_c);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_escape_regex(mpc_val_t *x) {
-  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_re, mpc_escape_output_raw_re);
-  free(x);
-  return y;  
-}
-
-mpc_val_t *mpcf_unescape_regex(mpc_val_t *x) {
-  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_re, mpc_escape_output_raw_re);
-  free(x);
-  return y;  
-}
-
-mpc_val_t *mpcf_escape_string_raw(mpc_val_t *x) {
-  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_cstr, mpc_escape_output_raw_cstr);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_unescape_string_raw(mpc_val_t *x) {
-  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_cstr, mpc_escape_output_raw_cstr);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_escape_char_raw(mpc_val_t *x) {
-  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_cchar, mpc_escape_output_raw_cchar);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_unescape_char_raw(mpc_val_t *x) {
-  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_cchar, mpc_escape_output_raw_cchar);
-  free(x);
-  return y;
-}
-
-mpc_val_t *mpcf_null(int n, mpc_val_t** xs) { (void) n; (void) xs; return NULL; }
-mpc_val_t *mpcf_fst(int n, mpc_val_t **xs) { (void) n; return xs[0]; }
-mpc_val_t *mpcf_snd(int n, mpc_val_t **xs) { (void) n; return xs[1]; }
-mpc_val_t *mpcf_trd(int n, mpc_val_t **xs) { (void) n; return xs[2]; }
-
-static mpc_val_t *mpcf_nth_free(int n, mpc_val_t **xs, int x) {
-  int i;
-  for (i = 0; i < n; i++) {
-    if (i != x) { free(xs[i]); }
-  }
-  return xs[x];
-}
- 
-mpc_val_t *mpcf_fst_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 0); }
-mpc_val_t *mpcf_snd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 1); }
-mpc_val_t *mpcf_trd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 2); }
-
-mpc_val_t *mpcf_strfold(int n, mpc_val_t **xs) {
-  int i;
-  size_t l = 0;
-  
-  if (n == 0) { return calloc(1, 1); }
-  
-  for (i = 0; i < n; i++) { l += strlen(xs[i]); }
-  
-  xs[0] = realloc(xs[0], l + 1);
-  
-  for (i = 1; i < n; i++) {
-    strcat(xs[0], xs[i]); free(xs[i]);
-  }
-  
-  return xs[0];
-}
-
-mpc_val_t *mpcf_maths(int n, mpc_val_t **xs) {
-  int **vs = (int**)xs;
-  (void) n;
-  
-  if (strcmp(xs[1], "*") == 0) { *vs[0] *= *vs[2]; }
-  if (strcmp(xs[1], "/") == 0) { *vs[0] /= *vs[2]; }
-  if (strcmp(xs[1], "%") == 0) { *vs[0] %= *vs[2]; }
-  if (strcmp(xs[1], "+") == 0) { *vs[0] += *vs[2]; }
-  if (strcmp(xs[1], "-") == 0) { *vs[0] -= *vs[2]; }
-  
-  free(xs[1]); free(xs[2]);
-  
-  return xs[0];
-}
-
-/*
-** Printing
-*/
-
-static void mpc_print_unretained(mpc_parser_t *p, int force) {
-  
-  /* TODO: Print Everything Escaped */
-  
-  int i;
-  char *s, *e;
-  char buff[2];
-  
-  if (p->retained && !force) {;
-    if (p->name) { printf("<%s>", p->name); }
-    else { printf("<anon>"); }
-    return;
-  }
-  
-  if (p->type == MPC_TYPE_UNDEFINED) { printf("<?>"); }
-  if (p->type == MPC_TYPE_PASS)   { printf("<:>"); }
-  if (p->type == MPC_TYPE_FAIL)   { printf("<!>"); }
-  if (p->type == MPC_TYPE_LIFT)   { printf("<#>"); }
-  if (p->type == MPC_TYPE_STATE)  { printf("<S>"); }
-  if (p->type == MPC_TYPE_ANCHOR) { printf("<@>"); }
-  if (p->type == MPC_TYPE_EXPECT) {
-    printf("%s", p->data.expect.m);
-    /*mpc_print_unretained(p->data.expect.x, 0);*/
-  }
-  
-  if (p->type == MPC_TYPE_ANY) { printf("<.>"); }
-  if (p->type == MPC_TYPE_SATISFY) { printf("<f>"); }
-
-  if (p->type == MPC_TYPE_SINGLE) {
-    buff[0] = p->data.single.x; buff[1] = '\0';
-    s = mpcf_escape_new(
-      buff,
-      mpc_escape_input_c,
-      mpc_escape_output_c);
-    printf("'%s'", s);
-    free(s);
-  }
-  
-  if (p->type == MPC_TYPE_RANGE) {
-    buff[0] = p->data.range.x; buff[1] = '\0';
-    s = mpcf_escape_new(
-      buff,
-      mpc_escape_input_c,
-      mpc_escape_output_c);
-    buff[0] = p->data.range.y; buff[1] = '\0';
-    e = mpcf_escape_new(
-      buff,
-      mpc_escape_input_c,
-      mpc_escape_output_c);
-    printf("[%s-%s]", s, e);
-    free(s);
-    free(e);
-  }
-  
-  if (p->type == MPC_TYPE_ONEOF) {
-    s = mpcf_escape_new(
-      p->data.string.x,
-      mpc_escape_input_c,
-      mpc_escape_output_c);
-    printf("[%s]", s);
-    free(s);
-  }
-  
-  if (p->type == MPC_TYPE_NONEOF) {
-    s = mpcf_escape_new(
-      p->data.string.x,
-      mpc_escape_input_c,
-      mpc_escape_output_c);
-    printf("[^%s]", s);
-    free(s);
-  }
-  
-  if (p->type == MPC_TYPE_STRING) {
-    s = mpcf_escape_new(
-      p->data.string.x,
-      mpc_escape_input_c,
-      mpc_escape_output_c);
-    printf("\"%s\"", s);
-    free(s);
-  }
-  
-  if (p->type == MPC_TYPE_APPLY)    { mpc_print_unretained(p->data.apply.x, 0); }
-  if (p->type == MPC_TYPE_APPLY_TO) { mpc_print_unretained(p->data.apply_to.x, 0); }
-  if (p->type == MPC_TYPE_PREDICT)  { mpc_print_unretained(p->data.predict.x, 0); }
-
-  if (p->type == MPC_TYPE_NOT)   { mpc_print_unretained(p->data.not.x, 0); printf("!"); }
-  if (p->type == MPC_TYPE_MAYBE) { mpc_print_unretained(p->data.not.x, 0); printf("?"); }
-
-  if (p->type == MPC_TYPE_MANY)  { mpc_print_unretained(p->data.repeat.x, 0); printf("*"); }
-  if (p->type == MPC_TYPE_MANY1) { mpc_print_unretained(p->data.repeat.x, 0); printf("+"); }
-  if (p->type == MPC_TYPE_COUNT) { mpc_print_unretained(p->data.repeat.x, 0); printf("{%i}", p->data.repeat.n); }
-  
-  if (p->type == MPC_TYPE_OR) {
-    printf("(");
-    for(i = 0; i < p->data.or.n-1; i++) {
-      mpc_print_unretained(p->data.or.xs[i], 0);
-      printf(" | ");
-    }
-    mpc_print_unretained(p->data.or.xs[p->data.or.n-1], 0);
-    printf(")");
-  }
-  
-  if (p->type == MPC_TYPE_AND) {
-    printf("(");
-    for(i = 0; i < p->data.and.n-1; i++) {
-      mpc_print_unretained(p->data.and.xs[i], 0);
-      printf(" ");
-    }
-    mpc_print_unretained(p->data.and.xs[p->data.and.n-1], 0);
-    printf(")");
-  }
-  
-}
-
-void mpc_print(mpc_parser_t *p) {
-  mpc_print_unretained(p, 1);
-  printf("\n");
-}
-
-/*
-** Testing
-*/
-
-/*
-** These functions are slightly unwieldy and
-** also the whole of the testing suite for mpc
-** mpc is pretty shaky.
-**
-** It could do with a lot more tests and more
-** precision. Currently I am only really testing
-** changes off of the examples.
-**
-*/
-
-int mpc_test_fail(mpc_parser_t *p, const char *s, const void *d,
-  int(*tester)(const void*, const void*),
-  mpc_dtor_t destructor,
-  void(*printer)(const void*)) {
-  mpc_result_t r;
-  (void) printer;
-  if (mpc_parse("<test>", s, p, &r)) {
-
-    if (tester(r.output, d)) {
-      destructor(r.output);
-      return 0;
-    } else {
-      destructor(r.output);
-      return 1;
-    }
-  
-  } else {
-    mpc_err_delete(r.error);
-    return 1;
-  }
-  
-}
-
-int mpc_test_pass(mpc_parser_t *p, const char *s, const void *d,
-  int(*tester)(const void*, const void*), 
-  mpc_dtor_t destructor, 
-  void(*printer)(const void*)) {
-
-  mpc_result_t r;  
-  if (mpc_parse("<test>", s, p, &r)) {
-    
-    if (tester(r.output, d)) {
-      destructor(r.output);
-      return 1;
-    } else {
-      printf("Got "); printer(r.output); printf("\n");
-      printf("Expected "); printer(d); printf("\n");
-      destructor(r.output);
-      return 0;
-    }
-    
-  } else {    
-    mpc_err_print(r.error);
-    mpc_err_delete(r.error);
-    return 0;
-    
-  }
-  
-}
-
-
-/*
-** AST
-*/
-
-void mpc_ast_delete(mpc_ast_t *a) {
-  
-  int i;
-  
-  if (a == NULL) { return; }
-  
-  for (i = 0; i < a->children_num; i++) {
-    mpc_ast_delete(a->children[i]);
-  }
-  
-  free(a->children);
-  free(a->tag);
-  free(a->contents);
-  free(a);
-  
-}
-
-static void mpc_ast_delete_no_children(mpc_ast_t *a) {
-  free(a->children);
-  free(a->tag);
-  free(a->contents);
-  free(a);
-}
-
-mpc_ast_t *mpc_ast_new(const char *tag, const char *contents) {
-  
-  mpc_ast_t *a = malloc(sizeof(mpc_ast_t));
-  
-  a->tag = malloc(strlen(tag) + 1);
-  strcpy(a->tag, tag);
-  
-  a->contents = malloc(strlen(contents) + 1);
-  strcpy(a->contents, contents);
-  
-  a->state = mpc_state_new();
-  
-  a->children_num = 0;
-  a->children = NULL;
-  return a;
-  
-}
-
-mpc_ast_t *mpc_ast_build(int n, const char *tag, ...) {
-  
-  mpc_ast_t *a = mpc_ast_new(tag, "");
-  
-  int i;
-  va_list va;
-  va_start(va, tag);
-  
-  for (i = 0; i < n; i++) {
-    mpc_ast_add_child(a, va_arg(va, mpc_ast_t*));
-  }
-  
-  va_end(va);
-  
-  return a;
-  
-}
-
-mpc_ast_t *mpc_ast_add_root(mpc_ast_t *a) {
-
-  mpc_ast_t *r;
-
-  if (a == NULL) { return a; }
-  if (a->children_num == 0) { return a; }
-  if (a->children_num == 1) { return a; }
-
-  r = mpc_ast_new(">", "");
-  mpc_ast_add_child(r, a);
-  return r;
-}
-
-int mpc_ast_eq(mpc_ast_t *a, mpc_ast_t *b) {
-  
-  int i;
-
-  if (strcmp(a->tag, b->tag) != 0) { return 0; }
-  if (strcmp(a->contents, b->contents) != 0) { return 0; }
-  if (a->children_num != b->children_num) { return 0; }
-  
-  for (i = 0; i < a->children_num; i++) {
-    if (!mpc_ast_eq(a->children[i], b->children[i])) { return 0; }
-  }
-  
-  return 1;
-}
-
-mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a) {
-  r->children_num++;
-  r->children = realloc(r->children, sizeof(mpc_ast_t*) * r->children_num);
-  r->children[r->children_num-1] = a;
-  return r;
-}
-
-mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
-  if (a == NULL) { return a; }
-  a->tag = realloc(a->tag, strlen(t) + 1 + strlen(a->tag) + 1);
-  memmove(a->tag + strlen(t) + 1, a->tag, strlen(a->tag)+1);
-  memmove(a->tag, t, strlen(t));
-  memmove(a->tag + strlen(t), "|", 1);
-  return a;
-}
-
-mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t) {
-  if (a == NULL) { return a; }
-  a->tag = realloc(a->tag, (strlen(t)-1) + strlen(a->tag) + 1);
-  memmove(a->tag + (strlen(t)-1), a->tag, strlen(a->tag)+1);
-  memmove(a->tag, t, (strlen(t)-1));
-  return a;
-}
-
-mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t) {
-  a->tag = realloc(a->tag, strlen(t) + 1);
-  strcpy(a->tag, t);
-  return a;
-}
-
-mpc_ast_t *mpc_ast_state(mpc_ast_t *a, mpc_state_t s) {
-  if (a == NULL) { return a; }
-  a->state = s;
-  return a;
-}
-
-static void mpc_ast_print_depth(mpc_ast_t *a, int d, FILE *fp) {
-  
-  int i;
-  
-  if (a == NULL) {
-    fprintf(fp, "NULL\n");
-    return;
-  }
-  
-  for (i = 0; i < d; i++) { fprintf(fp, "  "); }
-  
-  if (strlen(a->contents)) {
-    fprintf(fp, "%s:%lu:%lu '%s'\n", a->tag, 
-      (long unsigned int)(a->state.row+1),
-      (long unsigned int)(a->state.col+1),
-      a->contents);
-  } else {
-    fprintf(fp, "%s \n", a->tag);
-  }
-  
-  for (i = 0; i < a->children_num; i++) {
-    mpc_ast_print_depth(a->children[i], d+1, fp);
-  }
-  
-}
-
-void mpc_ast_print(mpc_ast_t *a) {
-  mpc_ast_print_depth(a, 0, stdout);
-}
-
-void mpc_ast_print_to(mpc_ast_t *a, FILE *fp) {
-  mpc_ast_print_depth(a, 0, fp);
-}
-
-int mpc_ast_get_index(mpc_ast_t *ast, const char *tag) {
-  return mpc_ast_get_index_lb(ast, tag, 0);
-}
-
-int mpc_ast_get_index_lb(mpc_ast_t *ast, const char *tag, int lb) {
-  int i;
-
-  for(i=lb; i<ast->children_num; i++) {
-    if(strcmp(ast->children[i]->tag, tag) == 0) {
-      return i;
-    }
-  }
-
-  return -1;
-}
-
-mpc_ast_t *mpc_ast_get_child(mpc_ast_t *ast, const char *tag) {
-  return mpc_ast_get_child_lb(ast, tag, 0);
-}
-
-mpc_ast_t *mpc_ast_get_child_lb(mpc_ast_t *ast, const char *tag, int lb) {
-  int i;
-
-  for(i=lb; i<ast->children_num; i++) {
-    if(strcmp(ast->children[i]->tag, tag) == 0) {
-      return ast->children[i];
-    }
-  }
-
-  return NULL;
-}
-
-mpc_ast_trav_t *mpc_ast_traverse_start(mpc_ast_t *ast,
-                                       mpc_ast_trav_order_t order)
-{
-  mpc_ast_trav_t *trav, *n_trav;
-  mpc_ast_t *cnode = ast;
-
-  /* Create the traversal structure */
-  trav = malloc(sizeof(mpc_ast_trav_t));
-  trav->curr_node = cnode;
-  trav->parent = NULL;
-  trav->curr_child = 0;
-  trav->order = order;
-
-  /* Get start node */
-  switch(order) {
-    case mpc_ast_trav_order_pre:
-      /* Nothing else is needed for pre order start */
-      break;
-
-    case mpc_ast_trav_order_post:
-      while(cnode->children_num > 0) {
-        cnode = cnode->children[0];
-
-        n_trav = malloc(sizeof(mpc_ast_trav_t));
-        n_trav->curr_node = cnode;
-        n_trav->parent = trav;
-        n_trav->curr_child = 0;
-        n_trav->order = order;
-
-        trav = n_trav;
-      }
-
-      break;
-
-    default:
-      /* Unreachable, but compiler complaints */
-      break;
-  }
-
-  return trav;
-}
-
-mpc_ast_t *mpc_ast_traverse_next(mpc_ast_trav_t **trav) {
-  mpc_ast_trav_t *n_trav, *to_free;
-  mpc_ast_t *ret = NULL;
-  int cchild;
-
-  /* The end of traversal was reached */
-  if(*trav == NULL) return NULL;
-
-  switch((*trav)->order) {
-    case mpc_ast_trav_order_pre:
-      ret = (*trav)->curr_node;
-
-      /* If there aren't any more children, go up */
-      while(*trav != NULL &&
-        (*trav)->curr_child >= (*trav)->curr_node->children_num)
-      {
-        to_free = *trav;
-        *trav = (*trav)->parent;
-        free(to_free);
-      }
-
-      /* If trav is NULL, the end was reached */
-      if(*trav == NULL) {
-        break;
-      }
-
-      /* Go to next child */
-      n_trav = malloc(sizeof(mpc_ast_trav_t));
-
-      cchild = (*trav)->curr_child;
-      n_trav->curr_node = (*trav)->curr_node->children[cchild];
-      n_trav->parent = *trav;
-      n_trav->curr_child = 0;
-      n_trav->order = (*trav)->order;
-
-      (*trav)->curr_child++;
-      *trav = n_trav;
-
-      break;
-
-    case mpc_ast_trav_order_post:
-      ret = (*trav)->curr_node;
-
-      /* Move up tree to the parent If the parent doesn't have any more nodes,
-       * then this is the current node. If it does, move down to its left most
-       * child. Also, free the previous traversal node */
-      to_free = *trav;
-      *trav = (*trav)->parent;
-      free(to_free);
-
-      if(*trav == NULL)
-        break;
-
-      /* Next child */
-      (*trav)->curr_child++;
-
-      /* If there aren't any more children, this is the next node */
-      if((*trav)->curr_child >= (*trav)->curr_node->children_num) {
-        break;
-      }
-
-      /* If there are still more children, find the leftmost child from this
-       * node */
-      while((*trav)->curr_node->children_num > 0) {
-        n_trav = malloc(sizeof(mpc_ast_trav_t));
-
-        cchild = (*trav)->curr_child;
-        n_trav->curr_node = (*trav)->curr_node->children[cchild];
-        n_trav->parent = *trav;
-        n_trav->curr_child = 0;
-        n_trav->order = (*trav)->order;
-
-        *trav = n_trav;
-      }
-
-    default:
-      /* Unreachable, but compiler complaints */
-      break;
-  }
-
-  return ret;
-}
-
-void mpc_ast_traverse_free(mpc_ast_trav_t **trav) {
-  mpc_ast_trav_t *n_trav;
-
-  /* Go through parents until all are free */
-  while(*trav != NULL) {
-      n_trav = (*trav)->parent;
-      free(*trav);
-      *trav = n_trav;
-  }
-}
-
-mpc_val_t *mpcf_fold_ast(int n, mpc_val_t **xs) {
-  
-  int i, j;
-  mpc_ast_t** as = (mpc_ast_t**)xs;
-  mpc_ast_t *r;
-  
-  if (n == 0) { return NULL; }
-  if (n == 1) { return xs[0]; }
-  if (n == 2 && xs[1] == NULL) { return xs[0]; }
-  if (n == 2 && xs[0] == NULL) { return xs[1]; }
-  
-  r = mpc_ast_new(">", "");
-  
-  for (i = 0; i < n; i++) {
-    
-    if (as[i] == NULL) { continue; }
-    
-    if        (as[i] && as[i]->children_num == 0) {
-      mpc_ast_add_child(r, as[i]);
-    } else if (as[i] && as[i]->children_num == 1) {
-      mpc_ast_add_child(r, mpc_ast_add_root_tag(as[i]->children[0], as[i]->tag));
-      mpc_ast_delete_no_children(as[i]);
-    } else if (as[i] && as[i]->children_num >= 2) {
-      for (j = 0; j < as[i]->children_num; j++) {
-        mpc_ast_add_child(r, as[i]->children[j]);
-      }
-      mpc_ast_delete_no_children(as[i]);
-    }
-  
-  }
-  
-  if (r->children_num) {
-    r->state = r->children[0]->state;
-  }
-  
-  return r;
-}
-
-mpc_val_t *mpcf_str_ast(mpc_val_t *c) {
-  mpc_ast_t *a = mpc_ast_new("", c);
-  free(c);
-  return a;
-}
-
-mpc_val_t *mpcf_state_ast(int n, mpc_val_t **xs) {
-  mpc_state_t *s = ((mpc_state_t**)xs)[0];
-  mpc_ast_t *a = ((mpc_ast_t**)xs)[1];
-  (void)n;
-  a = mpc_ast_state(a, *s);
-  free(s);
-  return a;
-}
-
-mpc_parser_t *mpca_state(mpc_parser_t *a) {
-  return mpc_and(2, mpcf_state_ast, mpc_state(), a, free);
-}
-
-mpc_parser_t *mpca_tag(mpc_parser_t *a, const char *t) {
-  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_tag, (void*)t);
-}
-
-mpc_parser_t *mpca_add_tag(mpc_parser_t *a, const char *t) {
-  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_add_tag, (void*)t);
-}
-
-mpc_parser_t *mpca_root(mpc_parser_t *a) {
-  return mpc_apply(a, (mpc_apply_t)mpc_ast_add_root);
-}
-
-mpc_parser_t *mpca_not(mpc_parser_t *a) { return mpc_not(a, (mpc_dtor_t)mpc_ast_delete); }
-mpc_parser_t *mpca_maybe(mpc_parser_t *a) { return mpc_maybe(a); }
-mpc_parser_t *mpca_many(mpc_parser_t *a) { return mpc_many(mpcf_fold_ast, a); }
-mpc_parser_t *mpca_many1(mpc_parser_t *a) { return mpc_many1(mpcf_fold_ast, a); }
-mpc_parser_t *mpca_count(int n, mpc_parser_t *a) { return mpc_count(n, mpcf_fold_ast, a, (mpc_dtor_t)mpc_ast_delete); }
-
-mpc_parser_t *mpca_or(int n, ...) {
-
-  int i;
-  va_list va;
-
-  mpc_parser_t *p = mpc_undefined();
-  
-  p->type = MPC_TYPE_OR;
-  p->data.or.n = n;
-  p->data.or.xs = malloc(sizeof(mpc_parser_t*) * n);
-  
-  va_start(va, n);  
-  for (i = 0; i < n; i++) {
-    p->data.or.xs[i] = va_arg(va, mpc_parser_t*);
-  }
-  va_end(va);
-  
-  return p;
-  
-}
-
-mpc_parser_t *mpca_and(int n, ...) {
-  
-  int i;
-  va_list va;
-  
-  mpc_parser_t *p = mpc_undefined();
-  
-  p->type = MPC_TYPE_AND;
-  p->data.and.n = n;
-  p->data.and.f = mpcf_fold_ast;
-  p->data.and.xs = malloc(sizeof(mpc_parser_t*) * n);
-  p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (n-1));
-  
-  va_start(va, n);
-  for (i = 0; i < n; i++) {
-    p->data.and.xs[i] = va_arg(va, mpc_parser_t*);
-  }
-  for (i = 0; i < (n-1); i++) {
-    p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete;
-  }    
-  va_end(va);
-  
-  return p;  
-}
-
-mpc_parser_t *mpca_total(mpc_parser_t *a) { return mpc_total(a, (mpc_dtor_t)mpc_ast_delete); }
-
-/*
-** Grammar Parser
-*/
-
-/*
-** This is another interesting bootstrapping.
-**
-** Having a general purpose AST type allows
-** users to specify the grammar alone and
-** let all fold rules be automatically taken
-** care of by existing functions.
-**
-** You don't get to control the type spat
-** out but this means you can make a nice
-** parser to take in some grammar in nice
-** syntax and spit out a parser that works.
-**
-** The grammar for this looks surprisingly
-** like regex but the main difference is that
-** it is now whitespace insensitive and the
-** base type takes literals of some form.
-*/
-
-/*
-**
-**  ### Grammar Grammar
-**
-**      <grammar> : (<term> "|" <grammar>) | <term>
-**     
-**      <term> : <factor>*
-**
-**      <factor> : <base>
-**               | <base> "*"
-**               | <base> "+"
-**               | <base> "?"
-**               | <base> "{" <digits> "}"
-**           
-**      <base> : "<" (<digits> | <ident>) ">"
-**             | <string_lit>
-**             | <char_lit>
-**             | <regex_lit>
-**             | "(" <grammar> ")"
-*/
-
-typedef struct {
-  va_list *va;
-  int parsers_num;
-  mpc_parser_t **parsers;
-  int flags;
-} mpca_grammar_st_t;
-
-static mpc_val_t *mpcaf_grammar_or(int n, mpc_val_t **xs) {
-  (void) n;
-  if (xs[1] == NULL) { return xs[0]; }
-  else { return mpca_or(2, xs[0], xs[1]); }
-}
-
-static mpc_val_t *mpcaf_grammar_and(int n, mpc_val_t **xs) {
-  int i;
-  mpc_parser_t *p = mpc_pass();  
-  for (i = 0; i < n; i++) {
-    if (xs[i] != NULL) { p = mpca_and(2, p, xs[i]); }
-  }
-  return p;
-}
-
-static mpc_val_t *mpcaf_grammar_repeat(int n, mpc_val_t **xs) { 
-  int num;
-  (void) n;
-  if (xs[1] == NULL) { return xs[0]; }  
-  if (strcmp(xs[1], "*") == 0) { free(xs[1]); return mpca_many(xs[0]); }
-  if (strcmp(xs[1], "+") == 0) { free(xs[1]); return mpca_many1(xs[0]); }
-  if (strcmp(xs[1], "?") == 0) { free(xs[1]); return mpca_maybe(xs[0]); }
-  if (strcmp(xs[1], "!") == 0) { free(xs[1]); return mpca_not(xs[0]); }
-  num = *((int*)xs[1]);
-  free(xs[1]);
-  return mpca_count(num, xs[0]);
-}
-
-static mpc_val_t *mpcaf_grammar_string(mpc_val_t *x, void *s) {
-  mpca_grammar_st_t *st = s;
-  char *y = mpcf_unescape(x);
-  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_string(y) : mpc_tok(mpc_string(y));
-  free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "string"));
-}
-
-static mpc_val_t *mpcaf_grammar_char(mpc_val_t *x, void *s) {
-  mpca_grammar_st_t *st = s;
-  char *y = mpcf_unescape(x);
-  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_char(y[0]) : mpc_tok(mpc_char(y[0]));
-  free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "char"));
-}
-
-static mpc_val_t *mpcaf_grammar_regex(mpc_val_t *x, void *s) {
-  mpca_grammar_st_t *st = s;
-  char *y = mpcf_unescape_regex(x);
-  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_re(y) : mpc_tok(mpc_re(y));
-  free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "regex"));
-}
-
-/* Should this just use `isdigit` instead? */
-static int is_number(const char* s) {
-  size_t i;
-  for (i = 0; i < strlen(s); i++) { if (!strchr("0123456789", s[i])) { return 0; } }
-  return 1;
-}
-
-static mpc_parser_t *mpca_grammar_find_parser(char *x, mpca_grammar_st_t *st) {
-  
-  int i;
-  mpc_parser_t *p;
-  
-  /* Case of Number */
-  if (is_number(x)) {
-
-    i = strtol(x, NULL, 10);
-    
-    while (st->parsers_num <= i) {
-      st->parsers_num++;
-      st->parsers = realloc(st->parsers, sizeof(mpc_parser_t*) * st->parsers_num);
-      st->parsers[st->parsers_num-1] = va_arg(*st->va, mpc_parser_t*);
-      if (st->parsers[st->parsers_num-1] == NULL) {
-        return mpc_failf("No Parser in position %i! Only supplied %i Parsers!", i, st->parsers_num);
-      }
-    }
-    
-    return st->parsers[st->parsers_num-1];
-  
-  /* Case of Identifier */
-  } else {
-    
-    /* Search Existing Parsers */
-    for (i = 0; i < st->parsers_num; i++) {
-      mpc_parser_t *q = st->parsers[i];
-      if (q == NULL) { return mpc_failf("Unknown Parser '%s'!", x); }
-      if (q->name && strcmp(q->name, x) == 0) { return q; }
-    }
-    
-    /* Search New Parsers */
-    while (1) {
-    
-      p = va_arg(*st->va, mpc_parser_t*);
-      
-      st->parsers_num++;
-      st->parsers = realloc(st->parsers, sizeof(mpc_parser_t*) * st->parsers_num);
-      st->parsers[st->parsers_num-1] = p;
-      
-      if (p == NULL || p->name == NULL) { return mpc_failf("Unknown Parser '%s'!", x); }
-      if (p->name && strcmp(p->name, x) == 0) { return p; }
-      
-    }
-  
-  }  
-  
-}
-
-static mpc_val_t *mpcaf_grammar_id(mpc_val_t *x, void *s) {
-  
-  mpca_grammar_st_t *st = s;
-  mpc_parser_t *p = mpca_grammar_find_parser(x, st);
-  free(x);
-
-  if (p->name) {
-    return mpca_state(mpca_root(mpca_add_tag(p, p->name)));
-  } else {
-    return mpca_state(mpca_root(p));
-  }
-}
-
-mpc_parser_t *mpca_grammar_st(const char *grammar, mpca_grammar_st_t *st) {
-  
-  char *err_msg;
-  mpc_parser_t *err_out;
-  mpc_result_t r;
-  mpc_parser_t *GrammarTotal, *Grammar, *Term, *Factor, *Base;
-  
-  GrammarTotal = mpc_new("grammar_total");
-  Grammar = mpc_new("grammar");
-  Term = mpc_new("term");
-  Factor = mpc_new("factor");
-  Base = mpc_new("base");
-  
-  mpc_define(GrammarTotal,
-    mpc_predictive(mpc_total(Grammar, mpc_soft_delete))
-  );
-  
-  mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
-    Term,
-    mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_sym("|"), Grammar, free)),
-    mpc_soft_delete
-  ));
-  
-  mpc_define(Term, mpc_many1(mpcaf_grammar_and, Factor));
-  
-  mpc_define(Factor, mpc_and(2, mpcaf_grammar_repeat,
-    Base,
-      mpc_or(6,
-        mpc_sym("*"),
-        mpc_sym("+"),
-        mpc_sym("?"),
-        mpc_sym("!"),
-        mpc_tok_brackets(mpc_int(), free),
-        mpc_pass()),
-    mpc_soft_delete
-  ));
-  
-  mpc_define(Base, mpc_or(5,
-    mpc_apply_to(mpc_tok(mpc_string_lit()), mpcaf_grammar_string, st),
-    mpc_apply_to(mpc_tok(mpc_char_lit()),   mpcaf_grammar_char, st),
-    mpc_apply_to(mpc_tok(mpc_regex_lit()),  mpcaf_grammar_regex, st),
-    mpc_apply_to(mpc_tok_braces(mpc_or(2, mpc_digits(), mpc_ident()), free), mpcaf_grammar_id, st),
-    mpc_tok_parens(Grammar, mpc_soft_delete)
-  ));
-  
-  mpc_optimise(GrammarTotal);
-  mpc_optimise(Grammar);
-  mpc_optimise(Factor);
-  mpc_optimise(Term);
-  mpc_optimise(Base);
-  
-  if(!mpc_parse("<mpc_grammar_compiler>", grammar, GrammarTotal, &r)) {
-    err_msg = mpc_err_string(r.error);
-    err_out = mpc_failf("Invalid Grammar: %s", err_msg);
-    mpc_err_delete(r.error);
-    free(err_msg);
-    r.output = err_out;
-  }
-  
-  mpc_cleanup(5, GrammarTotal, Grammar, Term, Factor, Base);
-  
-  mpc_optimise(r.output);
-  
-  return (st->flags & MPCA_LANG_PREDICTIVE) ? mpc_predictive(r.output) : r.output;
-  
-}
-
-mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...) {
-  mpca_grammar_st_t st;
-  mpc_parser_t *res;
-  va_list va;
-  va_start(va, grammar);
-  
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
-  
-  res = mpca_grammar_st(grammar, &st);  
-  free(st.parsers);
-  va_end(va);
-  return res;
-}
-
-typedef struct {
-  char *ident;
-  char *name;
-  mpc_parser_t *grammar;
-} mpca_stmt_t;
-
-static mpc_val_t *mpca_stmt_afold(int n, mpc_val_t **xs) {
-  mpca_stmt_t *stmt = malloc(sizeof(mpca_stmt_t));
-  stmt->ident = ((char**)xs)[0];
-  stmt->name = ((char**)xs)[1];
-  stmt->grammar = ((mpc_parser_t**)xs)[3];
-  (void) n;
-  free(((char**)xs)[2]);
-  free(((char**)xs)[4]);
-  
-  return stmt;
-}
-
-static mpc_val_t *mpca_stmt_fold(int n, mpc_val_t **xs) {
-  
-  int i;
-  mpca_stmt_t **stmts = malloc(sizeof(mpca_stmt_t*) * (n+1));
-  
-  for (i = 0; i < n; i++) {
-    stmts[i] = xs[i];
-  }
-  stmts[n] = NULL;  
-  
-  return stmts;
-}
-
-static void mpca_stmt_list_delete(mpc_val_t *x) {
-
-  mpca_stmt_t **stmts = x;
-
-  while(*stmts) {
-    mpca_stmt_t *stmt = *stmts; 
-    free(stmt->ident);
-    free(stmt->name);
-    mpc_soft_delete(stmt->grammar);
-    free(stmt);  
-    stmts++;
-  }
-  free(x);
-
-}
-
-static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
-
-  mpca_grammar_st_t *st = s;
-  mpca_stmt_t *stmt;
-  mpca_stmt_t **stmts = x;
-  mpc_parser_t *left;
-
-  while(*stmts) {
-    stmt = *stmts;
-    left = mpca_grammar_find_parser(stmt->ident, st);
-    if (st->flags & MPCA_LANG_PREDICTIVE) { stmt->grammar = mpc_predictive(stmt->grammar); }
-    if (stmt->name) { stmt->grammar = mpc_expect(stmt->grammar, stmt->name); }
-    mpc_optimise(stmt->grammar);
-    mpc_define(left, stmt->grammar);
-    free(stmt->ident);
-    free(stmt->name);
-    free(stmt);
-    stmts++;
-  }
-  
-  free(x);
-  
-  return NULL;
-}
-
-static mpc_err_t *mpca_lang_st(mpc_input_t *i, mpca_grammar_st_t *st) {
-  
-  mpc_result_t r;
-  mpc_err_t *e;
-  mpc_parser_t *Lang, *Stmt, *Grammar, *Term, *Factor, *Base; 
-  
-  Lang    = mpc_new("lang");
-  Stmt    = mpc_new("stmt");
-  Grammar = mpc_new("grammar");
-  Term    = mpc_new("term");
-  Factor  = mpc_new("factor");
-  Base    = mpc_new("base");
-  
-  mpc_define(Lang, mpc_apply_to(
-    mpc_total(mpc_predictive(mpc_many(mpca_stmt_fold, Stmt)), mpca_stmt_list_delete),
-    mpca_stmt_list_apply_to, st
-  ));
-  
-  mpc_define(Stmt, mpc_and(5, mpca_stmt_afold,
-    mpc_tok(mpc_ident()), mpc_maybe(mpc_tok(mpc_string_lit())), mpc_sym(":"), Grammar, mpc_sym(";"),
-    free, free, free, mpc_soft_delete
-  ));
-  
-  mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
-      Term,
-      mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_sym("|"), Grammar, free)),
-      mpc_soft_delete
-  ));
-  
-  mpc_define(Term, mpc_many1(mpcaf_grammar_and, Factor));
-  
-  mpc_define(Factor, mpc_and(2, mpcaf_grammar_repeat,
-    Base,
-      mpc_or(6,
-        mpc_sym("*"),
-        mpc_sym("+"),
-        mpc_sym("?"),
-        mpc_sym("!"),
-        mpc_tok_brackets(mpc_int(), free),
-        mpc_pass()),
-    mpc_soft_delete
-  ));
-  
-  mpc_define(Base, mpc_or(5,
-    mpc_apply_to(mpc_tok(mpc_string_lit()), mpcaf_grammar_string, st),
-    mpc_apply_to(mpc_tok(mpc_char_lit()),   mpcaf_grammar_char, st),
-    mpc_apply_to(mpc_tok(mpc_regex_lit()),  mpcaf_grammar_regex, st),
-    mpc_apply_to(mpc_tok_braces(mpc_or(2, mpc_digits(), mpc_ident()), free), mpcaf_grammar_id, st),
-    mpc_tok_parens(Grammar, mpc_soft_delete)
-  ));
-  
-  mpc_optimise(Lang);
-  mpc_optimise(Stmt);
-  mpc_optimise(Grammar);
-  mpc_optimise(Term);
-  mpc_optimise(Factor);
-  mpc_optimise(Base);
-  
-  if (!mpc_parse_input(i, Lang, &r)) {
-    e = r.error;
-  } else {
-    e = NULL;
-  }
-  
-  mpc_cleanup(6, Lang, Stmt, Grammar, Term, Factor, Base);
-  
-  return e;
-}
-
-mpc_err_t *mpca_lang_file(int flags, FILE *f, ...) {
-  mpca_grammar_st_t st;
-  mpc_input_t *i;
-  mpc_err_t *err;
-
-  va_list va;  
-  va_start(va, f);
-  
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
-  
-  i = mpc_input_new_file("<mpca_lang_file>", f);
-  err = mpca_lang_st(i, &st);
-  mpc_input_delete(i);
-  
-  free(st.parsers);
-  va_end(va);
-  return err;
-}
-
-mpc_err_t *mpca_lang_pipe(int flags, FILE *p, ...) {
-  mpca_grammar_st_t st;
-  mpc_input_t *i;
-  mpc_err_t *err;
-
-  va_list va;  
-  va_start(va, p);
-  
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
-  
-  i = mpc_input_new_pipe("<mpca_lang_pipe>", p);
-  err = mpca_lang_st(i, &st);
-  mpc_input_delete(i);
-  
-  free(st.parsers);
-  va_end(va);
-  return err;
-}
-
-mpc_err_t *mpca_lang(int flags, const char *language, ...) {
-  
-  mpca_grammar_st_t st;
-  mpc_input_t *i;
-  mpc_err_t *err;
-  
-  va_list va;  
-  va_start(va, language);
-  
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
-  
-  i = mpc_input_new_string("<mpca_lang>", language);
-  err = mpca_lang_st(i, &st);
-  mpc_input_delete(i);
-  
-  free(st.parsers);
-  va_end(va);
-  return err;
-}
-
-mpc_err_t *mpca_lang_contents(int flags, const char *filename, ...) {
-  
-  mpca_grammar_st_t st;
-  mpc_input_t *i;
-  mpc_err_t *err;
-  
-  va_list va;
-
-  FILE *f = fopen(filename, "rb");
-  
-  if (f == NULL) {
-    err = mpc_err_file(filename, "Unable to open file!");
-    return err;
-  }
-  
-  va_start(va, filename);
-  
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
-  
-  i = mpc_input_new_file(filename, f);
-  err = mpca_lang_st(i, &st);
-  mpc_input_delete(i);
-  
-  free(st.parsers);
-  va_end(va);  
-  
-  fclose(f);
-  
-  return err;
-}
-
-static int mpc_nodecount_unretained(mpc_parser_t* p, int force) {
-
-  int i, total;
-
-  if (p->retained && !force) { return 0; }
-
-  if (p->type == MPC_TYPE_EXPECT) { return 1 + mpc_nodecount_unretained(p->data.expect.x, 0); }
-
-  if (p->type == MPC_TYPE_APPLY)    { return 1 + mpc_nodecount_unretained(p->data.apply.x, 0); }
-  if (p->type == MPC_TYPE_APPLY_TO) { return 1 + mpc_nodecount_unretained(p->data.apply_to.x, 0); }
-  if (p->type == MPC_TYPE_PREDICT)  { return 1 + mpc_nodecount_unretained(p->data.predict.x, 0); }
-
-  if (p->type == MPC_TYPE_NOT)   { return 1 + mpc_nodecount_unretained(p->data.not.x, 0); }
-  if (p->type == MPC_TYPE_MAYBE) { return 1 + mpc_nodecount_unretained(p->data.not.x, 0); }
-
-  if (p->type == MPC_TYPE_MANY)  { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
-  if (p->type == MPC_TYPE_MANY1) { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
-  if (p->type == MPC_TYPE_COUNT) { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
-
-  if (p->type == MPC_TYPE_OR) { 
-    total = 0;
-    for(i = 0; i < p->data.or.n; i++) {
-      total += mpc_nodecount_unretained(p->data.or.xs[i], 0);
-    }
-    return total;
-  }
-  
-  if (p->type == MPC_TYPE_AND) {
-    total = 0;
-    for(i = 0; i < p->data.and.n; i++) {
-      total += mpc_nodecount_unretained(p->data.and.xs[i], 0);
-    }
-    return total;
-  }
-
-  return 1;
-  
-}
-
-void mpc_stats(mpc_parser_t* p) {
-  printf("Stats\n");
-  printf("=====\n");
-  printf("Node Count: %i\n", mpc_nodecount_unretained(p, 1));
-}
-
-static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
-  
-  int i, n, m;
-  mpc_parser_t *t;
-  
-  if (p->retained && !force) { return; }
-  
-  /* Optimise Subexpressions */
-  
-  if (p->type == MPC_TYPE_EXPECT)   { mpc_optimise_unretained(p->data.expect.x, 0); }
-  if (p->type == MPC_TYPE_APPLY)    { mpc_optimise_unretained(p->data.apply.x, 0); }
-  if (p->type == MPC_TYPE_APPLY_TO) { mpc_optimise_unretained(p->data.apply_to.x, 0); }
-  if (p->type == MPC_TYPE_PREDICT)  { mpc_optimise_unretained(p->data.predict.x, 0); }
-  if (p->type == MPC_TYPE_NOT)      { mpc_optimise_unretained(p->data.not.x, 0); }
-  if (p->type == MPC_TYPE_MAYBE)    { mpc_optimise_unretained(p->data.not.x, 0); }
-  if (p->type == MPC_TYPE_MANY)     { mpc_optimise_unretained(p->data.repeat.x, 0); }
-  if (p->type == MPC_TYPE_MANY1)    { mpc_optimise_unretained(p->data.repeat.x, 0); }
-  if (p->type == MPC_TYPE_COUNT)    { mpc_optimise_unretained(p->data.repeat.x, 0); }
-  
-  if (p->type == MPC_TYPE_OR) { 
-    for(i = 0; i < p->data.or.n; i++) {
-      mpc_optimise_unretained(p->data.or.xs[i], 0);
-    }
-  }
-  
-  if (p->type == MPC_TYPE_AND) {
-    for(i = 0; i < p->data.and.n; i++) {
-      mpc_optimise_unretained(p->data.and.xs[i], 0);
-    }
-  }  
-  
-  /* Perform optimisations */
-  
-  while (1) {
-    
-    /* Merge rhs `or` */
-    if (p->type == MPC_TYPE_OR
-    &&  p->data.or.xs[p->data.or.n-1]->type == MPC_TYPE_OR
-    && !p->data.or.xs[p->data.or.n-1]->retained) {
-      t = p->data.or.xs[p->data.or.n-1];
-      n = p->data.or.n; m = t->data.or.n;
-      p->data.or.n = n + m - 1;
-      p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
-      memmove(p->data.or.xs + n - 1, t->data.or.xs, m * sizeof(mpc_parser_t*));
-      free(t->data.or.xs); free(t->name); free(t);
-      continue;
-    }
-
-    /* Merge lhs `or` */
-    if (p->type == MPC_TYPE_OR
-    &&  p->data.or.xs[0]->type == MPC_TYPE_OR
-    && !p->data.or.xs[0]->retained) {
-      t = p->data.or.xs[0];
-      n = p->data.or.n; m = t->data.or.n;
-      p->data.or.n = n + m - 1;
-      p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
-      memmove(p->data.or.xs + m, t->data.or.xs + 1, n * sizeof(mpc_parser_t*));
-      memmove(p->data.or.xs, t->data.or.xs, m * sizeof(mpc_parser_t*));
-      free(t->data.or.xs); free(t->name); free(t);
-      continue;
-    }
-    
-    /* Remove ast `pass` */
-    if (p->type == MPC_TYPE_AND
-    &&  p->data.and.n == 2
-    &&  p->data.and.xs[0]->type == MPC_TYPE_PASS
-    && !p->data.and.xs[0]->retained
-    &&  p->data.and.f == mpcf_fold_ast) {
-      t = p->data.and.xs[1];
-      mpc_delete(p->data.and.xs[0]);
-      free(p->data.and.xs); free(p->data.and.dxs); free(p->name);
-      memcpy(p, t, sizeof(mpc_parser_t));
-      free(t);
-      continue;
-    }
-    
-    /* Merge ast lhs `and` */
-    if (p->type == MPC_TYPE_AND
-    &&  p->data.and.f == mpcf_fold_ast
-    &&  p->data.and.xs[0]->type == MPC_TYPE_AND
-    && !p->data.and.xs[0]->retained
-    &&  p->data.and.xs[0]->data.and.f == mpcf_fold_ast) {
-      t = p->data.and.xs[0];
-      n = p->data.and.n; m = t->data.and.n;
-      p->data.and.n = n + m - 1;
-      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t*) * (n + m - 1));
-      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
-      memmove(p->data.and.xs + m, p->data.and.xs + 1, (n - 1) * sizeof(mpc_parser_t*));
-      memmove(p->data.and.xs, t->data.and.xs, m * sizeof(mpc_parser_t*));
-      for (i = 0; i < p->data.and.n-1; i++) { p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete; }
-      free(t->data.and.xs); free(t->data.and.dxs); free(t->name); free(t); 
-      continue;
-    }
-    
-    /* Merge ast rhs `and` */
-    if (p->type == MPC_TYPE_AND
-    &&  p->data.and.f == mpcf_fold_ast
-    &&  p->data.and.xs[p->data.and.n-1]->type == MPC_TYPE_AND
-    && !p->data.and.xs[p->data.and.n-1]->retained
-    &&  p->data.and.xs[p->data.and.n-1]->data.and.f == mpcf_fold_ast) {
-      t = p->data.and.xs[p->data.and.n-1];
-      n = p->data.and.n; m = t->data.and.n;
-      p->data.and.n = n + m - 1;
-      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t*) * (n + m -1));
-      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
-      memmove(p->data.and.xs + n - 1, t->data.and.xs, m * sizeof(mpc_parser_t*));
-      for (i = 0; i < p->data.and.n-1; i++) { p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete; }
-      free(t->data.and.xs); free(t->data.and.dxs); free(t->name); free(t); 
-      continue;
-    }
-
-    /* Remove re `lift` */
-    if (p->type == MPC_TYPE_AND
-    &&  p->data.and.n == 2
-    &&  p->data.and.xs[0]->type == MPC_TYPE_LIFT
-    &&  p->data.and.xs[0]->data.lift.lf == mpcf_ctor_str
-    && !p->data.and.xs[0]->retained
-    &&  p->data.and.f == mpcf_strfold) {
-      t = p->data.and.xs[1];
-      mpc_delete(p->data.and.xs[0]);
-      free(p->data.and.xs); free(p->data.and.dxs); free(p->name);
-      memcpy(p, t, sizeof(mpc_parser_t));
-      free(t);
-      continue;
-    }
-
-    /* Merge re lhs `and` */
-    if (p->type == MPC_TYPE_AND
-    &&  p->data.and.f == mpcf_strfold
-    &&  p->data.and.xs[0]->type == MPC_TYPE_AND
-    && !p->data.and.xs[0]->retained
-    &&  p->data.and.xs[0]->data.and.f == mpcf_strfold) {
-      t = p->data.and.xs[0];
-      n = p->data.and.n; m = t->data.and.n;
-      p->data.and.n = n + m - 1;
-      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t*) * (n + m - 1));
-      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
-      memmove(p->data.and.xs + m, p->data.and.xs + 1, (n - 1) * sizeof(mpc_parser_t*));
-      memmove(p->data.and.xs, t->data.and.xs, m * sizeof(mpc_parser_t*));
-      for (i = 0; i < p->data.and.n-1; i++) { p->data.and.dxs[i] = free; }
-      free(t->data.and.xs); free(t->data.and.dxs); free(t->name); free(t); 
-      continue;
-    }
-    
-    /* Merge re rhs `and` */
-    if (p->type == MPC_TYPE_AND
-    &&  p->data.and.f == mpcf_strfold
-    &&  p->data.and.xs[p->data.and.n-1]->type == MPC_TYPE_AND
-    && !p->data.and.xs[p->data.and.n-1]->retained
-    &&  p->data.and.xs[p->data.and.n-1]->data.and.f == mpcf_strfold) {
-      t = p->data.and.xs[p->data.and.n-1];
-      n = p->data.and.n; m = t->data.and.n;
-      p->data.and.n = n + m - 1;
-      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t*) * (n + m -1));
-      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
-      memmove(p->data.and.xs + n - 1, t->data.and.xs, m * sizeof(mpc_parser_t*));
-      for (i = 0; i < p->data.and.n-1; i++) { p->data.and.dxs[i] = free; }
-      free(t->data.and.xs); free(t->data.and.dxs); free(t->name); free(t); 
-      continue;
-    }
-    
-    return;
-    
-  }
-  
-}
-
-void mpc_optimise(mpc_parser_t *p) {
-  mpc_optimise_unretained(p, 1);
-}
-
+/*
+** Regular files are memory mapped where the
+** platform supports it. Define `MPC_NO_MMAP`
+** to always read files through stdio instead.
+*/
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(MPC_NO_MMAP)
+#define MPC_USE_MMAP
+#if !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+#endif
+
+/*
+** Runs of a character class are scanned sixteen
+** bytes at a time where SSE2 is available. Define
+** `MPC_NO_SIMD` to always scan one byte at a time.
+*/
+
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(MPC_NO_SIMD)
+#define MPC_USE_SSE2
+#endif
+
+#include "mpc.h"
+
+#ifdef MPC_USE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef MPC_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/*
+** State Type
+*/
+
+static mpc_state_t mpc_state_invalid(void) {
+  mpc_state_t s;
+  s.pos = -1;
+  s.row = -1;
+  s.col = -1;
+  return s;
+}
+
+static mpc_state_t mpc_state_new(void) {
+  mpc_state_t s;
+  s.pos = 0;
+  s.row = 0;
+  s.col = 0;
+  return s;
+}
+
+/*
+** Input Type
+*/
+
+/*
+** In mpc the input type has three modes of 
+** operation: String, File and Pipe.
+**
+** String is easy. The caller's buffer is
+** borrowed for the duration of the parse and
+** scanned through in place, with its length
+** cached so the end of input is found in
+** constant time. The cursor can jump around
+** at will making backtracking easy.
+**
+** The second is a File which is also somewhat
+** easy. Where possible regular files are memory
+** mapped and then treated exactly like a String.
+** Otherwise the contents are never loaded into 
+** memory but backtracking can still be achieved
+** by seeking in the file at different positions.
+**
+** The final mode is Pipe. This is the difficult
+** one. As we assume pipes cannot be seeked, every
+** character read is appended to a buffer made of
+** fixed size chunks and all reading is done from
+** that buffer.
+**
+** This means that if we are requested to seek
+** back we can simply start reading from the
+** buffer again. Chunks which lie entirely before
+** both the oldest outstanding mark and the cursor
+** can never be read again and so are discarded,
+** keeping memory use bounded by how far back the
+** parser may still need to backtrack.
+**
+** Of course using `mpc_predictive` will disable
+** backtracking and make LL(1) grammars easy
+** to parse for all input methods.
+**
+*/
+
+enum {
+  MPC_INPUT_STRING = 0,
+  MPC_INPUT_FILE   = 1,
+  MPC_INPUT_PIPE   = 2
+};
+
+enum {
+  MPC_INPUT_MARKS_MIN = 32
+};
+
+enum {
+  MPC_INPUT_MEMO_SLOTS = 4096
+};
+
+enum {
+  MPC_INPUT_MEM_CLASSES  = 5,
+  MPC_INPUT_MEM_SMALLEST = 16,
+  MPC_INPUT_MEM_INLINE   = 1024,
+  MPC_INPUT_MEM_PAGE     = 8192,
+  MPC_INPUT_MEM_PAGE_MAX = 1048576
+};
+
+enum {
+  MPC_INPUT_CHUNK_SIZE = 4096
+};
+
+enum {
+  MPC_INPUT_SPAN_RANGES = 4
+};
+
+typedef struct mpc_mem_t {
+  struct mpc_mem_t *next;
+} mpc_mem_t;
+
+typedef struct {
+  char *start;
+  char *end;
+  int size_class;
+  int used;
+} mpc_mem_page_t;
+
+typedef struct {
+  struct mpc_parser_t *parser;
+  long pos;
+  long end;
+  char result;
+  char suppress;
+  char last;
+  void *output;
+  char errored;
+  mpc_err_t error;
+  char *expected;
+} mpc_memo_t;
+
+typedef struct {
+  struct mpc_parser_t *parser;
+  char *expected;
+  char *failure;
+  long pos;
+  long bound;
+  char last;
+} mpc_fail_t;
+
+typedef struct {
+  long pos;
+  char recieved;
+  int num;
+  int floor;
+} mpc_fail_mark_t;
+
+/*
+** A scanner is a single DFA for all the terminals of
+** a language, built by `mpc_scanner_build`. For each
+** of its states `ends` has a row of `width` bytes,
+** with a bit for every kind of token ending there.
+*/
+
+struct mpc_re_dfa_t;
+
+typedef struct {
+  int refs;
+  int skip;
+  int states;
+  int *trans;
+  char *accept;
+  unsigned char *ends;
+  int width;
+  int kinds_num;
+  char **kinds;
+  int *roots;
+  struct mpc_re_dfa_t *re;
+} mpc_scanner_t;
+
+typedef struct {
+  long start;
+  long end;
+  long next;
+  long stop;
+  int state;
+} mpc_token_t;
+
+typedef struct {
+
+  int type;
+  char *filename;  
+  long pos;
+  mpc_state_t origin;
+  
+  const char *string;
+  size_t length;
+  FILE *file;
+  
+  char **chunks;
+  char *chunk_spare;
+  int chunks_num;
+  int chunks_slots;
+  long chunks_pos;
+  long buffered;
+  
+  void *map;
+  size_t map_length;
+  long file_offset;
+  
+  int suppress;
+  int backtrack;
+  int checked;
+  int dirty;
+  int capture;
+  int partial;
+  int starved;
+  int marks_slots;
+  int marks_num;
+  long *marks;
+  
+  char *lasts;
+  char last;
+  
+  long *lines;
+  int lines_num;
+  int lines_slots;
+  long lines_end;
+  long lines_row;
+  long lines_last;
+  
+  mpc_mem_t *mem_free[MPC_INPUT_MEM_CLASSES];
+  char *mem_next[MPC_INPUT_MEM_CLASSES];
+  char *mem_end[MPC_INPUT_MEM_CLASSES];
+  size_t mem_grow[MPC_INPUT_MEM_CLASSES];
+  int mem_pages_num;
+  int mem_pages_slots;
+  mpc_mem_page_t *mem_pages;
+  char *mem_lo;
+  char *mem_hi;
+  unsigned long mem_hits;
+  unsigned long mem_misses;
+  mpc_mem_t mem[MPC_INPUT_MEM_CLASSES * MPC_INPUT_MEM_INLINE / sizeof(mpc_mem_t)];
+  
+  mpc_memo_t *memo;
+  int *memo_used;
+  int memo_used_num;
+  unsigned long memo_hits;
+  unsigned long memo_stores;
+  unsigned long memo_evictions;
+  
+  mpc_err_t err;
+  char *err_expected;
+  
+  long fail_pos;
+  char fail_recieved;
+  mpc_fail_t *fails;
+  int fails_num;
+  int fails_slots;
+  int fails_floor;
+  int replay;
+  
+  char **labels;
+  int labels_num;
+  int labels_slots;
+  
+  int depth;
+  int depth_max;
+  int depth_stop;
+  
+  mpc_scanner_t *scanner;
+  mpc_token_t *tokens;
+  int tokens_num;
+  int tokens_slots;
+  int tokens_at;
+  int tokens_stop;
+  long tokens_end;
+  
+  struct mpc_ast_arena_t *arena;
+  struct mpc_vm_t *vm;
+  
+} mpc_input_t;
+
+static unsigned long mpc_mem_hits = 0;
+static unsigned long mpc_mem_misses = 0;
+
+static unsigned long mpc_memo_hits = 0;
+static unsigned long mpc_memo_stores = 0;
+static unsigned long mpc_memo_evictions = 0;
+
+enum {
+  MPC_OPTIMISE_PASSES = 10
+};
+
+static unsigned long mpc_optimise_rewrites[MPC_OPTIMISE_PASSES];
+static long mpc_optimise_nodes[MPC_OPTIMISE_PASSES];
+
+static void mpc_optimise_note(int pass, long nodes) {
+  int k = 0;
+  while ((1 << k) != pass) { k++; }
+  mpc_optimise_rewrites[k]++;
+  mpc_optimise_nodes[k] += nodes;
+}
+
+static void mpc_input_memo_clear(mpc_input_t *i);
+static void mpc_vm_delete(struct mpc_vm_t *m);
+
+/*
+** Puts an input back into its initial state, ready to
+** be pointed at something new. Buffers which only
+** depend on how much was parsed (marks, the newline
+** index and the memory pools) are kept for reuse,
+** which lets a session parse many short inputs
+** without allocating new ones each time. So is any
+** depth limit it was given.
+*/
+
+static void mpc_input_reset(mpc_input_t *i, int type) {
+  
+  int j;
+  
+  mpc_input_memo_clear(i);
+  
+  i->type = type;
+  
+  i->pos = 0;
+  i->origin = mpc_state_new();
+  
+  i->string = NULL;
+  i->length = 0;
+  i->file = NULL;
+  
+  for (j = 0; j < i->chunks_num; j++) { free(i->chunks[j]); }
+  i->chunks_num = 0;
+  i->chunks_pos = 0;
+  i->buffered = 0;
+  
+  i->map = NULL;
+  i->map_length = 0;
+  i->file_offset = 0;
+  
+  i->suppress = 0;
+  i->backtrack = 1;
+  i->checked = 0;
+  i->dirty = 0;
+  i->capture = 0;
+  i->partial = 0;
+  i->starved = 0;
+  i->marks_num = 0;
+  i->last = '\0';
+  
+  i->lines_num = 0;
+  i->lines_end = 0;
+  i->lines_row = 0;
+  i->lines_last = -1;
+  
+  for (j = 0; j < i->mem_pages_num; j++) { i->mem_pages[j].used = 0; }
+  for (j = 0; j < MPC_INPUT_MEM_CLASSES; j++) {
+    i->mem_free[j] = NULL;
+    i->mem_next[j] = (char*)i->mem + (size_t)j * MPC_INPUT_MEM_INLINE;
+    i->mem_end[j] = i->mem_next[j] + MPC_INPUT_MEM_INLINE;
+  }
+  
+  mpc_mem_hits += i->mem_hits;
+  mpc_mem_misses += i->mem_misses;
+  i->mem_hits = 0;
+  i->mem_misses = 0;
+  
+  mpc_memo_hits += i->memo_hits;
+  mpc_memo_stores += i->memo_stores;
+  mpc_memo_evictions += i->memo_evictions;
+  i->memo_hits = 0;
+  i->memo_stores = 0;
+  i->memo_evictions = 0;
+  
+  i->fail_pos = -1;
+  i->fails_num = 0;
+  i->fails_floor = 0;
+  i->replay = 0;
+  for (j = 0; j < i->labels_num; j++) { free(i->labels[j]); }
+  i->labels_num = 0;
+  
+  i->depth = 0;
+  
+  i->scanner = NULL;
+  i->tokens_num = 0;
+  i->tokens_at = 0;
+  i->tokens_stop = 0;
+  i->tokens_end = 0;
+  
+  i->arena = NULL;
+}
+
+static mpc_input_t *mpc_input_new(const char *filename, int type) {
+
+  mpc_input_t *i = malloc(sizeof(mpc_input_t));
+  int j;
+  
+  i->filename = malloc(strlen(filename) + 1);
+  strcpy(i->filename, filename);
+  
+  i->chunks = NULL;
+  i->chunk_spare = NULL;
+  i->chunks_num = 0;
+  i->chunks_slots = 0;
+  
+  i->marks_slots = MPC_INPUT_MARKS_MIN;
+  i->marks = malloc(sizeof(long) * i->marks_slots);
+  i->lasts = malloc(sizeof(char) * i->marks_slots);
+  
+  i->lines = NULL;
+  i->lines_slots = 0;
+  
+  i->mem_pages_num = 0;
+  i->mem_pages_slots = 0;
+  i->mem_pages = NULL;
+  i->mem_lo = NULL;
+  i->mem_hi = NULL;
+  for (j = 0; j < MPC_INPUT_MEM_CLASSES; j++) { i->mem_grow[j] = MPC_INPUT_MEM_PAGE; }
+  i->mem_hits = 0;
+  i->mem_misses = 0;
+  
+  i->memo = NULL;
+  i->memo_used = NULL;
+  i->memo_used_num = 0;
+  i->memo_hits = 0;
+  i->memo_stores = 0;
+  i->memo_evictions = 0;
+  
+  i->err.filename = i->filename;
+  i->err.expected = &i->err_expected;
+  i->err.state = mpc_state_new();
+  
+  i->fails = NULL;
+  i->fails_slots = 0;
+  i->labels = NULL;
+  i->labels_num = 0;
+  i->labels_slots = 0;
+  
+  i->tokens = NULL;
+  i->tokens_slots = 0;
+  
+  i->depth_max = 0;
+  i->depth_stop = 0;
+  i->vm = NULL;
+  
+  mpc_input_reset(i, type);
+  return i;
+}
+
+static mpc_input_t *mpc_input_new_string(const char *filename, const char *string, size_t length) {
+  mpc_input_t *i = mpc_input_new(filename, MPC_INPUT_STRING);
+  i->string = string;
+  i->length = length;
+  return i;
+}
+
+static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
+  mpc_input_t *i = mpc_input_new(filename, MPC_INPUT_PIPE);
+  i->file = pipe;
+  return i;
+}
+
+#ifdef MPC_USE_MMAP
+
+/*
+** Map the remainder of a regular file into memory
+** and present it as a String input. The parse
+** starts from the current file position, which is
+** restored to just past the consumed input when
+** the input is deleted. Returns NULL if the file
+** cannot be mapped, in which case the caller falls
+** back to reading it through stdio.
+**
+** The stream is flushed first so that anything the
+** caller wrote to it is in the file being mapped, and
+** so that its position is that of the descriptor.
+** Only whole pages can be mapped, so the mapping
+** starts at the page holding that position.
+*/
+
+static mpc_input_t *mpc_input_new_mmap(const char *filename, FILE *file) {
+  
+  mpc_input_t *i;
+  struct stat st;
+  long offset, page;
+  void *map;
+  
+  if (fflush(file) != 0) { return NULL; }
+  if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode)) { return NULL; }
+  
+  offset = ftell(file);
+  if (offset < 0) { return NULL; }
+  
+  if ((off_t)offset >= st.st_size) {
+    i = mpc_input_new_string(filename, "", 0);
+    i->file = file;
+    i->file_offset = offset;
+    return i;
+  }
+  
+  page = sysconf(_SC_PAGESIZE);
+  if (page <= 0) { return NULL; }
+  page = offset - offset % page;
+  
+  map = mmap(NULL, (size_t)(st.st_size - page), PROT_READ, MAP_PRIVATE, fileno(file), (off_t)page);
+  if (map == MAP_FAILED) { return NULL; }
+  
+  i = mpc_input_new_string(filename, (const char*)map + (offset - page), (size_t)(st.st_size - offset));
+  i->file = file;
+  i->map = map;
+  i->map_length = (size_t)(st.st_size - page);
+  i->file_offset = offset;
+  return i;
+}
+
+#endif
+
+static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
+  mpc_input_t *i;
+#ifdef MPC_USE_MMAP
+  i = mpc_input_new_mmap(filename, file);
+  if (i) { return i; }
+#endif
+  i = mpc_input_new(filename, MPC_INPUT_FILE);
+  i->file = file;
+  i->file_offset = ftell(file);
+  if (i->file_offset < 0) { i->file_offset = 0; }
+  return i;
+}
+
+static void mpc_input_delete(mpc_input_t *i) {
+  
+  int j;
+  
+  free(i->filename);
+  
+  if (i->type == MPC_INPUT_STRING && i->file) {
+#ifdef MPC_USE_MMAP
+    if (i->map) { munmap(i->map, i->map_length); }
+#endif
+    fseek(i->file, i->file_offset + i->pos, SEEK_SET);
+  }
+  
+  mpc_input_reset(i, i->type);
+  free(i->chunks);
+  free(i->chunk_spare);
+  for (j = 0; j < i->mem_pages_num; j++) { free(i->mem_pages[j].start); }
+  free(i->mem_pages);
+  
+  free(i->marks);
+  free(i->lasts);
+  free(i->lines);
+  free(i->memo);
+  free(i->memo_used);
+  free(i->fails);
+  free(i->labels);
+  free(i->tokens);
+  if (i->vm) { mpc_vm_delete(i->vm); }
+  free(i);
+}
+
+/*
+** Small allocations made while parsing are served
+** from pools kept by the input, one for each of a few
+** size classes. Free blocks are linked through their
+** own first word, so allocating and freeing are a
+** single list operation.
+**
+** Each class starts with a small page held inside the
+** input itself which is handed out in order whenever
+** the free list is empty. Once that is used up further
+** pages are allocated, each twice the size of the
+** last up to a limit. Anything larger than the
+** biggest class goes to `malloc`. Allocated pages are
+** kept when the input is reset and are handed out in
+** the same way again by the next parse.
+**
+** Values may also be allocated outside of the input,
+** for example by user folds, so freeing first checks
+** which page a pointer lies in. For the inline pages
+** this is a range check and the extra pages are kept
+** sorted by address so can be binary searched.
+*/
+
+static int mpc_mem_class(size_t n) {
+  static const char classes[] = {
+    0, 0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+  size_t k = (n + MPC_INPUT_MEM_SMALLEST - 1) / MPC_INPUT_MEM_SMALLEST;
+  return k < sizeof(classes) ? classes[k] : -1;
+}
+
+static size_t mpc_mem_size(int c) {
+  return (size_t)MPC_INPUT_MEM_SMALLEST << c;
+}
+
+static int mpc_mem_page_new(mpc_input_t *i, int c) {
+  
+  int j;
+  size_t bytes = i->mem_grow[c];
+  char *page = malloc(bytes);
+  
+  if (bytes < MPC_INPUT_MEM_PAGE_MAX) { i->mem_grow[c] = bytes * 2; }
+  
+  if (i->mem_pages_num == i->mem_pages_slots) {
+    i->mem_pages_slots = i->mem_pages_slots ? i->mem_pages_slots * 2 : 8;
+    i->mem_pages = realloc(i->mem_pages, sizeof(mpc_mem_page_t) * i->mem_pages_slots);
+  }
+  
+  for (j = i->mem_pages_num; j > 0 && i->mem_pages[j-1].start > page; j--) {
+    i->mem_pages[j] = i->mem_pages[j-1];
+  }
+  
+  i->mem_pages[j].start = page;
+  i->mem_pages[j].end = page + bytes;
+  i->mem_pages[j].size_class = c;
+  i->mem_pages[j].used = 0;
+  i->mem_pages_num++;
+  
+  if (i->mem_lo == NULL || page < i->mem_lo) { i->mem_lo = page; }
+  if (i->mem_hi == NULL || page + bytes > i->mem_hi) { i->mem_hi = page + bytes; }
+  
+  return j;
+}
+
+static mpc_mem_t *mpc_mem_grow(mpc_input_t *i, int c) {
+  
+  int j;
+  size_t size = mpc_mem_size(c);
+  mpc_mem_t *b;
+  
+  if (i->mem_next[c] + size > i->mem_end[c]) {
+    
+    for (j = 0; j < i->mem_pages_num; j++) {
+      if (i->mem_pages[j].size_class == c && !i->mem_pages[j].used) { break; }
+    }
+    if (j == i->mem_pages_num) { j = mpc_mem_page_new(i, c); }
+    
+    i->mem_pages[j].used = 1;
+    i->mem_next[c] = i->mem_pages[j].start;
+    i->mem_end[c] = i->mem_pages[j].end;
+  }
+  
+  b = (mpc_mem_t*)i->mem_next[c];
+  i->mem_next[c] += size;
+  return b;
+}
+
+static int mpc_mem_search(mpc_input_t *i, void *p) {
+  
+  int lo = 0, hi = i->mem_pages_num, mid;
+  
+  if ((char*)p < i->mem_lo || (char*)p >= i->mem_hi) { return -1; }
+  
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if ((char*)p < i->mem_pages[mid].start) { hi = mid; }
+    else if ((char*)p >= i->mem_pages[mid].end) { lo = mid + 1; }
+    else { return i->mem_pages[mid].size_class; }
+  }
+  
+  return -1;
+}
+
+/*
+** Returns the class of block `p` belongs to,
+** or -1 if it was not allocated from the pools.
+*/
+
+static int mpc_mem_find(mpc_input_t *i, void *p) {
+  if ((char*)p >= (char*)i->mem && (char*)p < (char*)i->mem + sizeof(i->mem)) {
+    return (int)(((char*)p - (char*)i->mem) / MPC_INPUT_MEM_INLINE);
+  }
+  return i->mem_pages_num > 0 ? mpc_mem_search(i, p) : -1;
+}
+
+static void *mpc_malloc(mpc_input_t *i, size_t n) {
+  
+  mpc_mem_t *b;
+  int c = mpc_mem_class(n);
+  
+  if (c < 0) {
+    i->mem_misses++;
+    return malloc(n);
+  }
+  
+  i->mem_hits++;
+  
+  b = i->mem_free[c];
+  if (b == NULL) { return mpc_mem_grow(i, c); }
+  i->mem_free[c] = b->next;
+  return b;
+}
+
+static void *mpc_calloc(mpc_input_t *i, size_t n, size_t m) {
+  char *x = mpc_malloc(i, n * m);
+  memset(x, 0, n * m);
+  return x;
+}
+
+static void mpc_mem_release(mpc_input_t *i, int c, void *p) {
+  mpc_mem_t *b = p;
+  b->next = i->mem_free[c];
+  i->mem_free[c] = b;
+}
+
+static void mpc_free(mpc_input_t *i, void *p) {
+  int c = mpc_mem_find(i, p);
+  if (c < 0) { free(p); return; }
+  mpc_mem_release(i, c, p);
+}
+
+static void *mpc_realloc(mpc_input_t *i, void *p, size_t n) {
+  
+  char *q = NULL;
+  int c = mpc_mem_find(i, p);
+  
+  if (c < 0) { return realloc(p, n); }
+  
+  if (n > mpc_mem_size(c)) {
+    q = mpc_malloc(i, n);
+    memcpy(q, p, mpc_mem_size(c));
+    mpc_mem_release(i, c, p);
+    return q;
+  }
+  
+  return p;
+}
+
+static void *mpc_export(mpc_input_t *i, void *p) {
+  char *q = NULL;
+  int c = mpc_mem_find(i, p);
+  if (c < 0) { return p; }
+  q = malloc(mpc_mem_size(c));
+  memcpy(q, p, mpc_mem_size(c));
+  mpc_mem_release(i, c, p);
+  return q; 
+}
+
+static void mpc_input_backtrack_disable(mpc_input_t *i) { i->backtrack--; }
+static void mpc_input_backtrack_enable(mpc_input_t *i) { i->backtrack++; }
+
+/*
+** Without backtracking a parser which fails part way
+** through can't be undone, so anything which carries
+** on after such a failure marks the input as dirty.
+*/
+
+static void mpc_input_recover(mpc_input_t *i, long start) {
+  if (i->backtrack < 1 && i->pos != start) { i->dirty = 1; }
+}
+
+static void mpc_input_suppress_disable(mpc_input_t *i) { i->suppress--; }
+static void mpc_input_suppress_enable(mpc_input_t *i) { i->suppress++; }
+
+static void mpc_input_mark(mpc_input_t *i) {
+  
+  if (i->backtrack < 1) { return; }
+  
+  i->marks_num++;
+  
+  if (i->marks_num > i->marks_slots) {
+    i->marks_slots = i->marks_num + i->marks_num / 2;
+    i->marks = realloc(i->marks, sizeof(long) * i->marks_slots);
+    i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);
+  }
+
+  i->marks[i->marks_num-1] = i->pos;
+  i->lasts[i->marks_num-1] = i->last;
+  
+}
+
+static void mpc_input_chunks_discard(mpc_input_t *i) {
+  
+  int j, n;
+  long keep = i->marks_num > 0 && i->marks[0] < i->pos
+    ? i->marks[0] : i->pos;
+  
+  n = (int)((keep - i->chunks_pos) / MPC_INPUT_CHUNK_SIZE);
+  if (n <= 0) { return; }
+  
+  for (j = 0; j < n; j++) {
+    if (i->chunk_spare == NULL) { i->chunk_spare = i->chunks[j]; }
+    else { free(i->chunks[j]); }
+  }
+  
+  i->chunks_num -= n;
+  i->chunks_pos += (long)n * MPC_INPUT_CHUNK_SIZE;
+  memmove(i->chunks, i->chunks + n, sizeof(char*) * i->chunks_num);
+}
+
+static void mpc_input_unmark(mpc_input_t *i) {
+  
+  if (i->backtrack < 1) { return; }
+  
+  i->marks_num--;
+  
+  if (i->marks_slots > i->marks_num + i->marks_num / 2
+  &&  i->marks_slots > MPC_INPUT_MARKS_MIN) {
+    i->marks_slots = 
+      i->marks_num > MPC_INPUT_MARKS_MIN ?
+      i->marks_num : MPC_INPUT_MARKS_MIN;
+    i->marks = realloc(i->marks, sizeof(long) * i->marks_slots);
+    i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);      
+  }
+  
+  if (i->type == MPC_INPUT_PIPE && i->marks_num == 0) {
+    mpc_input_chunks_discard(i);
+  }
+  
+}
+
+static void mpc_input_rewind(mpc_input_t *i) {
+  
+  if (i->backtrack < 1) { return; }
+  
+  i->pos = i->marks[i->marks_num-1];
+  i->last  = i->lasts[i->marks_num-1];
+  
+  if (i->type == MPC_INPUT_FILE) {
+    fseek(i->file, i->file_offset + i->pos, SEEK_SET);
+  }
+  
+  mpc_input_unmark(i);
+}
+
+static int mpc_input_chunks_fill(mpc_input_t *i) {
+  
+  int c;
+  long offset;
+  
+  if (i->pos < i->buffered) { return 1; }
+  
+  c = getc(i->file);
+  if (c == EOF) { return 0; }
+  
+  offset = i->buffered - i->chunks_pos;
+  
+  if (offset == (long)i->chunks_num * MPC_INPUT_CHUNK_SIZE) {
+    if (i->chunks_num == i->chunks_slots) {
+      i->chunks_slots = i->chunks_slots ? i->chunks_slots * 2 : 4;
+      i->chunks = realloc(i->chunks, sizeof(char*) * i->chunks_slots);
+    }
+    if (i->chunk_spare) {
+      i->chunks[i->chunks_num] = i->chunk_spare;
+      i->chunk_spare = NULL;
+    } else {
+      i->chunks[i->chunks_num] = malloc(MPC_INPUT_CHUNK_SIZE);
+    }
+    i->chunks_num++;
+  }
+  
+  i->chunks[offset / MPC_INPUT_CHUNK_SIZE][offset % MPC_INPUT_CHUNK_SIZE] = (char)c;
+  i->buffered++;
+  return 1;
+}
+
+static char mpc_input_chunks_get(mpc_input_t *i) {
+  long offset;
+  if (!mpc_input_chunks_fill(i)) { return '\0'; }
+  offset = i->pos - i->chunks_pos;
+  return i->chunks[offset / MPC_INPUT_CHUNK_SIZE][offset % MPC_INPUT_CHUNK_SIZE];
+}
+
+/*
+** A push parse runs over a view of its input which is
+** `partial` when more of it could still arrive. Reading
+** up to the end of such a view marks the input as
+** `starved`, as whatever was found there might change
+** once the rest is known.
+*/
+
+static int mpc_input_ends(mpc_input_t *i, long j) {
+  if (j < (long)i->length) { return 0; }
+  if (i->partial) { i->starved = 1; }
+  return 1;
+}
+
+static int mpc_input_terminated(mpc_input_t *i) {
+  if (i->type == MPC_INPUT_STRING) { return mpc_input_ends(i, i->pos); }
+  if (i->type == MPC_INPUT_FILE && feof(i->file)) { return 1; }
+  if (i->type == MPC_INPUT_PIPE && !mpc_input_chunks_fill(i)) { return 1; }
+  return 0;
+}
+
+static char mpc_input_getc(mpc_input_t *i) {
+  
+  char c = '\0';
+  
+  switch (i->type) {
+    
+    case MPC_INPUT_STRING:
+      return i->pos < (long)i->length ? i->string[i->pos] : '\0';
+    case MPC_INPUT_FILE: c = fgetc(i->file); return c;
+    case MPC_INPUT_PIPE: return mpc_input_chunks_get(i);
+    default: return c;
+  }
+}
+
+static char mpc_input_peekc(mpc_input_t *i) {
+  
+  char c = '\0';
+  
+  switch (i->type) {
+    case MPC_INPUT_STRING:
+      return i->pos < (long)i->length ? i->string[i->pos] : '\0';
+    case MPC_INPUT_FILE: 
+      
+      c = fgetc(i->file);
+      if (feof(i->file)) { return '\0'; }
+      
+      fseek(i->file, -1, SEEK_CUR);
+      return c;
+    
+    case MPC_INPUT_PIPE: return mpc_input_chunks_get(i);
+    default: return c;
+  }
+  
+}
+
+static int mpc_input_failure(mpc_input_t *i, char c) {
+  (void) c;
+  if (i->type == MPC_INPUT_FILE) { fseek(i->file, -1, SEEK_CUR); }
+  return 0;
+}
+
+/*
+** Only the byte offset is tracked while parsing. Row
+** and column are worked out on demand from an index
+** of newline positions. For String inputs this is
+** built lazily with `memchr` as positions are asked
+** about, while for Files and Pipes newlines are noted
+** the first time the parser moves past them.
+*/
+
+static void mpc_input_newline(mpc_input_t *i, long pos) {
+  
+  if (i->lines_num > 0 && i->lines[i->lines_num-1] >= pos) { return; }
+  
+  if (i->lines_num == i->lines_slots) {
+    i->lines_slots = i->lines_slots ? i->lines_slots * 2 : 64;
+    i->lines = realloc(i->lines, sizeof(long) * i->lines_slots);
+  }
+  
+  i->lines[i->lines_num++] = pos;
+}
+
+static void mpc_input_lines_scan(mpc_input_t *i, long pos) {
+  
+  const char *s, *e, *n;
+  
+  if (pos <= i->lines_end) { return; }
+  
+  if (pos < i->lines_end + MPC_INPUT_CHUNK_SIZE) { pos = i->lines_end + MPC_INPUT_CHUNK_SIZE; }
+  if (pos > (long)i->length) { pos = (long)i->length; }
+  
+  s = i->string + i->lines_end;
+  e = i->string + pos;
+  while (s < e && (n = memchr(s, '\n', (size_t)(e - s))) != NULL) {
+    mpc_input_newline(i, (long)(n - i->string));
+    s = n + 1;
+  }
+  
+  i->lines_end = pos;
+}
+
+/*
+** Forgets newlines before `pos`, which no position
+** still to be reported can lie before.
+*/
+
+static void mpc_input_lines_discard(mpc_input_t *i, long pos) {
+  
+  int n = 0;
+  
+  while (n < i->lines_num && i->lines[n] < pos) { n++; }
+  if (n == 0) { return; }
+  
+  i->lines_row += n;
+  i->lines_last = i->lines[n-1];
+  i->lines_num -= n;
+  memmove(i->lines, i->lines + n, sizeof(long) * i->lines_num);
+}
+
+static mpc_state_t mpc_input_state_at(mpc_input_t *i, long pos) {
+  
+  mpc_state_t s;
+  int lo = 0, hi = i->lines_num, mid;
+  
+  if (i->type == MPC_INPUT_STRING) {
+    mpc_input_lines_scan(i, pos);
+    hi = i->lines_num;
+  }
+  
+  if (hi > 0 && i->lines[hi-1] < pos) {
+    lo = hi;
+  } else {
+    while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if (i->lines[mid] < pos) { lo = mid + 1; } else { hi = mid; }
+    }
+  }
+  
+  s.pos = pos + i->origin.pos;
+  s.row = i->lines_row + lo;
+  s.col = pos - (lo > 0 ? i->lines[lo-1] : i->lines_last) - 1;
+  if (s.row == 0) { s.col += i->origin.col; }
+  s.row += i->origin.row;
+  return s;
+}
+
+static int mpc_input_success(mpc_input_t *i, char c, char **o) {
+  
+  if (c == '\n' && i->type != MPC_INPUT_STRING) {
+    mpc_input_newline(i, i->pos);
+  }
+  
+  i->last = c;
+  i->pos++;
+  
+  if (i->type == MPC_INPUT_PIPE
+  &&  i->pos - i->chunks_pos >= 2 * MPC_INPUT_CHUNK_SIZE) {
+    mpc_input_chunks_discard(i);
+  }
+  
+  if (o && i->capture) {
+    (*o) = NULL;
+  } else if (o) {
+    (*o) = mpc_malloc(i, 2);
+    (*o)[0] = c;
+    (*o)[1] = '\0';
+  }
+  
+  return 1;
+}
+
+static int mpc_input_any(mpc_input_t *i, char **o) {
+  char x = mpc_input_getc(i);
+  if (mpc_input_terminated(i)) { return 0; }
+  return mpc_input_success(i, x, o);
+}
+
+static int mpc_input_char(mpc_input_t *i, char c, char **o) {
+  char x = mpc_input_getc(i);
+  if (mpc_input_terminated(i)) { return 0; }
+  return x == c ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);
+}
+
+static int mpc_input_range(mpc_input_t *i, char c, char d, char **o) {
+  char x = mpc_input_getc(i);
+  if (mpc_input_terminated(i)) { return 0; }
+  return x >= c && x <= d ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
+}
+
+static int mpc_input_class(mpc_input_t *i, const unsigned char *set, char **o) {
+  char x = mpc_input_getc(i);
+  unsigned char c = (unsigned char)x;
+  if (mpc_input_terminated(i)) { return 0; }
+  return set[c / 8] & (1 << (c % 8)) ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);
+}
+
+static int mpc_input_satisfy(mpc_input_t *i, int(*cond)(char), char **o) {
+  char x = mpc_input_getc(i);
+  if (mpc_input_terminated(i)) { return 0; }
+  return cond(x) ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
+}
+
+/*
+** String inputs are compared against a literal all at
+** once, leaving the position where it was on failure.
+** Other inputs are still read a character at a time.
+** Without backtracking a failed literal keeps what it
+** matched, as the character loop would.
+*/
+
+static int mpc_input_string_prefix(mpc_input_t *i, const char *c) {
+  while (*c && !mpc_input_ends(i, i->pos) && i->string[i->pos] == *c) {
+    i->last = *c++;
+    i->pos++;
+  }
+  return 0;
+}
+
+/* A literal cut off by the end of a partial view may still match */
+static int mpc_input_literal(mpc_input_t *i, const char *c, size_t n) {
+  size_t left = i->length - (size_t)i->pos;
+  if (left >= n) { return memcmp(i->string + i->pos, c, n) == 0; }
+  if (i->partial && memcmp(i->string + i->pos, c, left) == 0) { i->starved = 1; }
+  return 0;
+}
+
+static int mpc_input_string(mpc_input_t *i, const char *c, char **o) {
+  
+  const char *x = c;
+  size_t n = strlen(c);
+  
+  if (i->type == MPC_INPUT_STRING) {
+    if (!mpc_input_literal(i, c, n)) {
+      return i->backtrack < 1 ? mpc_input_string_prefix(i, c) : 0;
+    }
+    if (n > 0) { i->last = c[n-1]; }
+    i->pos += (long)n;
+  } else {
+    mpc_input_mark(i);
+    while (*x) {
+      if (!mpc_input_char(i, *x, NULL)) {
+        mpc_input_rewind(i);
+        return 0;
+      }
+      x++;
+    }
+    mpc_input_unmark(i);
+  }
+  
+  if (i->capture) { *o = NULL; return 1; }
+  
+  *o = mpc_malloc(i, n + 1);
+  memcpy(*o, c, n + 1);
+  return 1;
+}
+
+static int mpc_input_anchor(mpc_input_t* i, int(*f)(char,char), char **o) {
+  *o = NULL;
+  if (i->type == MPC_INPUT_STRING) { mpc_input_ends(i, i->pos); }
+  return f(i->last, mpc_input_peekc(i));
+}
+
+/*
+** The input between `start` and the current position
+** as a string. Nul characters are dropped from it just
+** as folding the characters one by one would. While
+** capturing nothing is made, as the enclosing capture
+** takes its own slice of the input instead.
+*/
+
+static char *mpc_input_slice(mpc_input_t *i, long start) {
+  
+  long j;
+  int n = (int)(i->pos - start);
+  char *o;
+  
+  if (i->capture) { return NULL; }
+  
+  o = mpc_malloc(i, n + 1);
+  memcpy(o, i->string + start, n);
+  o[n] = '\0';
+  if ((long)strlen(o) < n) {
+    for (n = 0, j = start; j < i->pos; j++) { if (i->string[j]) { o[n++] = i->string[j]; } }
+    o[n] = '\0';
+  }
+  return o;
+}
+
+/*
+** Consumes the longest run of characters in a class
+** from a String input, given as a 256 bit set. When
+** some of the class is also given as a few ranges of
+** bytes these are compared against sixteen bytes at
+** once, and the set only decides where they stop.
+*/
+
+static long mpc_input_span_end(mpc_input_t *i, const unsigned char *set, const unsigned char *ranges, int ranges_num) {
+  
+  const unsigned char *s = (const unsigned char*)i->string;
+  long j = i->pos, length = (long)i->length;
+  
+#ifdef MPC_USE_SSE2
+  int k, mask;
+  __m128i x, d, out;
+#else
+  (void) ranges; (void) ranges_num;
+#endif
+  
+  while (1) {
+    
+#ifdef MPC_USE_SSE2
+    while (ranges_num > 0 && j + 16 <= length) {
+      x = _mm_loadu_si128((const __m128i*)(s + j));
+      out = _mm_set1_epi8(-1);
+      for (k = 0; k < ranges_num; k++) {
+        /* Unsigned x - lo > hi - lo, as a signed compare */
+        d = _mm_xor_si128(_mm_sub_epi8(x, _mm_set1_epi8((char)ranges[k*2])), _mm_set1_epi8((char)0x80));
+        out = _mm_and_si128(out, _mm_cmpgt_epi8(d, _mm_set1_epi8((char)((ranges[k*2+1] - ranges[k*2]) ^ 0x80))));
+      }
+      mask = _mm_movemask_epi8(out);
+      if (mask) { j += __builtin_ctz((unsigned)mask); break; }
+      j += 16;
+    }
+#endif
+    
+    if (mpc_input_ends(i, j) || !(set[s[j] / 8] & (1 << (s[j] % 8)))) { return j; }
+    j++;
+  }
+}
+
+static int mpc_input_span(mpc_input_t *i, const unsigned char *set, const unsigned char *ranges, int ranges_num, int min, char **o) {
+  
+  long start = i->pos, end = mpc_input_span_end(i, set, ranges, ranges_num);
+  
+  if (end - start < min) { return 0; }
+  
+  if (end > start) { i->last = i->string[end-1]; }
+  i->pos = end;
+  *o = mpc_input_slice(i, start);
+  return 1;
+}
+
+/*
+** Runs a regex DFA over a String input, stopping at
+** the first character it has no transition for and
+** matching up to the last accepting state it passed
+** through. The tables never cover nul, so if a nul
+** in the input is where it stopped the result can't
+** be trusted and -1 asks for the regex to be run.
+** Where it stopped is given back as `stop`, as no
+** error the regex could give is past it.
+*/
+
+static int mpc_input_dfa(mpc_input_t *i, const int *trans, const char *accept, char **o, long *stop) {
+  
+  const char *s = i->string;
+  long start = i->pos, j = i->pos, end = accept[0] ? i->pos : -1, length = (long)i->length;
+  int q = 0;
+  
+  while (j < length && (q = trans[q * 256 + (unsigned char)s[j]]) >= 0) {
+    j++;
+    if (accept[q]) { end = j; }
+  }
+  
+  mpc_input_ends(i, j);
+  *stop = j;
+  if (j < length && s[j] == '\0') { return -1; }
+  if (end < 0) { return 0; }
+  
+  if (end > start) { i->last = s[end-1]; }
+  i->pos = end;
+  *o = mpc_input_slice(i, start);
+  return 1;
+}
+
+/*
+** Tokens are scanned from a String input when they
+** are first asked for, each the longest match of the
+** scanner followed by any whitespace after it. They
+** are kept in order, so coming back to one after a
+** rewind is just a lookup. Asking at a position no
+** token starts at drops the tokens after it and scans
+** again from there, and if still nothing starts there
+** the terminal's own parser is used instead.
+*/
+
+static long mpc_input_blank_end(mpc_input_t *i, long j) {
+  while (!mpc_input_ends(i, j) && i->string[j] && strchr(" \f\n\r\t\v", i->string[j])) { j++; }
+  return j;
+}
+
+static void mpc_input_tokens_scan(mpc_input_t *i) {
+  
+  mpc_scanner_t *s = i->scanner;
+  const char *str = i->string;
+  long j = i->tokens_end, end = -1, length = (long)i->length;
+  int q = 0, state = -1;
+  mpc_token_t *t;
+  
+  while (j < length && (q = s->trans[q * 256 + (unsigned char)str[j]]) >= 0) {
+    j++;
+    if (s->accept[q]) { end = j; state = q; }
+  }
+  
+  mpc_input_ends(i, j);
+  
+  if (end < 0) {
+    i->tokens_stop = 1;
+    return;
+  }
+  
+  if (i->tokens_num == i->tokens_slots) {
+    i->tokens_slots = i->tokens_slots ? i->tokens_slots * 2 : 64;
+    i->tokens = realloc(i->tokens, sizeof(mpc_token_t) * i->tokens_slots);
+  }
+  
+  t = &i->tokens[i->tokens_num++];
+  t->start = i->tokens_end;
+  t->end = end;
+  t->next = s->skip ? mpc_input_blank_end(i, end) : end;
+  t->stop = j > t->next ? j : t->next;
+  t->state = state;
+  i->tokens_end = t->next;
+}
+
+static void mpc_input_tokens_fill(mpc_input_t *i, long pos) {
+  while (!i->tokens_stop && (i->tokens_num == 0 || i->tokens[i->tokens_num-1].start < pos)) {
+    mpc_input_tokens_scan(i);
+  }
+}
+
+static int mpc_input_token_find(mpc_input_t *i, mpc_scanner_t *s) {
+  
+  int lo, hi, k;
+  long pos = i->pos;
+  
+  if (i->scanner != s) {
+    i->scanner = s;
+    i->tokens_num = 0;
+    i->tokens_stop = 1;
+  }
+  
+  k = i->tokens_at;
+  if (k < i->tokens_num && i->tokens[k].start == pos) { return k; }
+  
+  mpc_input_tokens_fill(i, pos);
+  
+  lo = 0; hi = i->tokens_num;
+  while (lo < hi) {
+    k = (lo + hi) / 2;
+    if (i->tokens[k].start < pos) { lo = k + 1; } else { hi = k; }
+  }
+  
+  if (lo < i->tokens_num && i->tokens[lo].start == pos) {
+    i->tokens_at = lo;
+    return lo;
+  }
+  
+  /* Other parsers may have matched the text differently, so scan again from here */
+  i->tokens_num = lo;
+  i->tokens_at = lo;
+  i->tokens_stop = 0;
+  i->tokens_end = s->skip ? mpc_input_blank_end(i, pos) : pos;
+  mpc_input_tokens_fill(i, pos);
+  
+  return lo < i->tokens_num && i->tokens[lo].start == pos ? lo : -1;
+}
+
+/*
+** Returns -1 if no token starts here, otherwise whether it
+** is of this kind, with `stop` as far as the scanner looked.
+*/
+static int mpc_input_token(mpc_input_t *i, mpc_scanner_t *s, int kind, char **o, long *stop) {
+  
+  int k = mpc_input_token_find(i, s);
+  mpc_token_t *t;
+  
+  if (k < 0) { return -1; }
+  
+  t = &i->tokens[k];
+  *stop = t->stop;
+  if (!(s->ends[t->state * s->width + kind / 8] & (1 << (kind % 8)))) { return 0; }
+  
+  i->tokens_at = k + 1;
+  i->pos = t->end;
+  *o = mpc_input_slice(i, t->start);
+  i->pos = t->next;
+  i->last = i->string[t->next-1];
+  return 1;
+}
+
+/*
+** The state as seen from outside the input. Inputs
+** which continue an earlier stream (such as those
+** created by the push parser) start counting from
+** `origin` so that reported positions are relative
+** to the whole stream rather than the current view.
+*/
+
+static mpc_state_t mpc_input_state(mpc_input_t *i) {
+  return mpc_input_state_at(i, i->pos);
+}
+
+static mpc_state_t *mpc_input_state_copy(mpc_input_t *i) {
+  mpc_state_t *r = mpc_malloc(i, sizeof(mpc_state_t));
+  *r = mpc_input_state(i);
+  return r;
+}
+
+/*
+** Error Type
+*/
+
+void mpc_err_delete(mpc_err_t *x) {
+  int i;
+  for (i = 0; i < x->expected_num; i++) { free(x->expected[i]); }
+  free(x->expected);
+  free(x->filename);
+  free(x->failure);
+  free(x);
+}
+
+void mpc_err_print(mpc_err_t *x) {
+  mpc_err_print_to(x, stdout);
+}
+
+void mpc_err_print_to(mpc_err_t *x, FILE *f) {
+  char *str = mpc_err_string(x);
+  fprintf(f, "%s", str);
+  free(str);
+}
+
+static void mpc_err_string_cat(char *buffer, int *pos, int *max, char const *fmt, ...) {
+  /* TODO: Error Checking on Length */
+  int left = ((*max) - (*pos));
+  va_list va;
+  va_start(va, fmt);
+  if (left < 0) { left = 0;}
+  (*pos) += vsprintf(buffer + (*pos), fmt, va);
+  va_end(va);
+}
+
+static char char_unescape_buffer[4];
+
+static const char *mpc_err_char_unescape(char c) {
+  
+  char_unescape_buffer[0] = '\'';
+  char_unescape_buffer[1] = ' ';
+  char_unescape_buffer[2] = '\'';
+  char_unescape_buffer[3] = '\0';
+  
+  switch (c) {
+    case '\a': return "bell";
+    case '\b': return "backspace";
+    case '\f': return "formfeed";
+    case '\r': return "carriage return";
+    case '\v': return "vertical tab";
+    case '\0': return "end of input";
+    case '\n': return "newline";
+    case '\t': return "tab";
+    case ' ' : return "space";
+    default:
+      char_unescape_buffer[1] = c;
+      return char_unescape_buffer;
+  }
+  
+}
+
+char *mpc_err_string(mpc_err_t *x) {
+
+  int i;  
+  int pos = 0; 
+  int max = 1023;
+  char *buffer = calloc(1, 1024);
+  
+  if (x->failure) {
+    mpc_err_string_cat(buffer, &pos, &max,
+    "%s: error: %s\n", x->filename, x->failure);
+    return buffer;
+  }
+  
+  mpc_err_string_cat(buffer, &pos, &max, 
+    "%s:%i:%i: error: expected ", x->filename, x->state.row+1, x->state.col+1);
+  
+  if (x->expected_num == 0) { mpc_err_string_cat(buffer, &pos, &max, "ERROR: NOTHING EXPECTED"); }
+  if (x->expected_num == 1) { mpc_err_string_cat(buffer, &pos, &max, "%s", x->expected[0]); }
+  if (x->expected_num >= 2) {
+  
+    for (i = 0; i < x->expected_num-2; i++) {
+      mpc_err_string_cat(buffer, &pos, &max, "%s, ", x->expected[i]);
+    } 
+    
+    mpc_err_string_cat(buffer, &pos, &max, "%s or %s", 
+      x->expected[x->expected_num-2], 
+      x->expected[x->expected_num-1]);
+  }
+  
+  mpc_err_string_cat(buffer, &pos, &max, " at ");
+  mpc_err_string_cat(buffer, &pos, &max, mpc_err_char_unescape(x->recieved));
+  mpc_err_string_cat(buffer, &pos, &max, "\n");
+  
+  return realloc(buffer, strlen(buffer) + 1);
+}
+
+/*
+** A failing parser returns at most one error, which
+** is kept in the input and only lives until whatever
+** called it has looked at it. Its label belongs to the
+** parser which made it. None are made while errors
+** are suppressed.
+*/
+
+static mpc_err_t *mpc_err_new(mpc_input_t *i, const char *expected) {
+  if (i->suppress) { return NULL; }
+  i->err.state.pos = i->origin.pos + i->pos;
+  i->err.expected_num = 1;
+  i->err_expected = (char*)expected;
+  i->err.failure = NULL;
+  i->err.recieved = mpc_input_peekc(i);
+  return &i->err;
+}
+
+static mpc_err_t *mpc_err_fail(mpc_input_t *i, const char *failure) {
+  if (i->suppress) { return NULL; }
+  i->err.state.pos = i->origin.pos + i->pos;
+  i->err.expected_num = 0;
+  i->err.failure = (char*)failure;
+  i->err.recieved = ' ';
+  return &i->err;
+}
+
+static mpc_err_t *mpc_err_file(const char *filename, const char *failure) {
+  mpc_err_t *x;
+  x = malloc(sizeof(mpc_err_t));
+  x->filename = malloc(strlen(filename) + 1);
+  strcpy(x->filename, filename);
+  x->state = mpc_state_new();
+  x->expected_num = 0;
+  x->expected = NULL;
+  x->failure = malloc(strlen(failure) + 1);
+  strcpy(x->failure, failure);
+  x->recieved = ' ';
+  return x;
+}
+
+/*
+** Errors which reach an `or`, `maybe` or loop are
+** added to the farthest failure of the input, which
+** keeps every label seen at the farthest position
+** reached so far, in order, and drops the others as
+** soon as it moves on. Being the only record, the
+** error message is built from it once the parse has
+** failed, without running anything a second time.
+**
+** Parsers skipped by a dispatch table, and regexes or
+** tokens matched by a DFA, never run the parsers
+** which would have given their labels. They are added
+** as they are, along with the farthest position any
+** of their labels could be at, and only run to find
+** those labels if they could still be reported once
+** the parse has failed, or if too many pile up.
+*/
+
+enum {
+  MPC_INPUT_FAILS_MAX = 256
+};
+
+static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r);
+static int mpc_depth_stop(mpc_input_t *i, int depth);
+static void mpc_fail_settle(mpc_input_t *i);
+
+static void mpc_fail_push(mpc_input_t *i, mpc_parser_t *p, char *expected, char *failure, long pos, long bound, char last) {
+  mpc_fail_t *f;
+  if (i->fails_num == i->fails_slots) {
+    i->fails_slots = i->fails_slots ? i->fails_slots * 2 : 16;
+    i->fails = realloc(i->fails, sizeof(mpc_fail_t) * i->fails_slots);
+  }
+  f = &i->fails[i->fails_num++];
+  f->parser = p;
+  f->expected = expected;
+  f->failure = failure;
+  f->pos = pos;
+  f->bound = bound;
+  f->last = last;
+}
+
+static void mpc_fail_reset(mpc_input_t *i) {
+  int j;
+  for (j = 0; j < i->labels_num; j++) { free(i->labels[j]); }
+  i->labels_num = 0;
+  i->fail_pos = -1;
+  i->fails_num = 0;
+  i->fails_floor = 0;
+}
+
+/* Moves the farthest failure on to `pos`, keeping only what could still reach it */
+static void mpc_fail_advance(mpc_input_t *i, long pos, char recieved) {
+  int j, k = i->fails_floor;
+  for (j = i->fails_floor; j < i->fails_num; j++) {
+    if (i->fails[j].bound >= pos) { i->fails[k++] = i->fails[j]; }
+  }
+  i->fails_num = k;
+  i->fail_pos = pos;
+  i->fail_recieved = recieved;
+}
+
+static void mpc_err_merge(mpc_input_t *i, mpc_err_t *x) {
+  
+  int j;
+  long pos;
+  
+  if (x == NULL || x->state.pos < i->fail_pos) { return; }
+  
+  pos = x->state.pos;
+  if (pos > i->fail_pos) { mpc_fail_advance(i, pos, x->recieved); }
+  
+  if (x->failure) {
+    mpc_fail_push(i, NULL, NULL, x->failure, pos, pos, '\0');
+    return;
+  }
+  
+  for (j = i->fails_floor; j < i->fails_num; j++) {
+    if (i->fails[j].parser || i->fails[j].pos != pos || i->fails[j].expected == NULL) { continue; }
+    if (i->fails[j].expected == x->expected[0]
+    ||  strcmp(i->fails[j].expected, x->expected[0]) == 0) { return; }
+  }
+  
+  mpc_fail_push(i, NULL, x->expected[0], NULL, pos, pos, '\0');
+}
+
+/* A parser not run at `start`, none of whose labels can be past `bound` */
+static void mpc_err_defer(mpc_input_t *i, mpc_parser_t *p, long start, char last, long bound) {
+  
+  mpc_fail_t *f;
+  
+  start += i->origin.pos;
+  bound += i->origin.pos;
+  if (i->suppress || bound < i->fail_pos) { return; }
+  if (i->fails_num > i->fails_floor) {
+    f = i->fails + i->fails_num - 1;
+    if (f->parser == p && f->pos == start) { return; }
+  }
+  
+  if (i->fails_num - i->fails_floor >= MPC_INPUT_FAILS_MAX) {
+    mpc_fail_settle(i);
+    if (bound < i->fail_pos) { return; }
+  }
+  
+  mpc_fail_push(i, p, NULL, NULL, start, bound, last);
+}
+
+/*
+** Checked regions of a predictive rule add to the
+** farthest failure as usual, but in a way which can be
+** undone if the rule has to be run again.
+*/
+
+static void mpc_fail_mark(mpc_input_t *i, mpc_fail_mark_t *m) {
+  m->pos = i->fail_pos;
+  m->recieved = i->fail_recieved;
+  m->num = i->fails_num;
+  m->floor = i->fails_floor;
+  i->fails_floor = i->fails_num;
+}
+
+static void mpc_fail_unmark(mpc_input_t *i, mpc_fail_mark_t *m) {
+  i->fails_floor = m->floor;
+}
+
+static void mpc_fail_rewind(mpc_input_t *i, mpc_fail_mark_t *m) {
+  i->fail_pos = m->pos;
+  i->fail_recieved = m->recieved;
+  i->fails_num = m->num;
+  i->fails_floor = m->floor;
+}
+
+/*
+** Runs a deferred parser where it was skipped, only
+** recognising, with nothing dispatched or memoized,
+** so that every label it has is seen. What it finds
+** goes into a farthest failure of its own, above
+** everything else.
+*/
+
+static void mpc_fail_replay(mpc_input_t *i, mpc_fail_t f) {
+  
+  mpc_result_t r;
+  mpc_err_t err = i->err;
+  char *err_expected = i->err_expected;
+  long pos = i->pos, fail_pos = i->fail_pos;
+  char last = i->last, recieved = i->fail_recieved;
+  int suppress = i->suppress, backtrack = i->backtrack;
+  int checked = i->checked, dirty = i->dirty;
+  int floor = i->fails_floor, stop = i->depth_stop;
+  
+  i->pos = f.pos - i->origin.pos;
+  i->last = f.last;
+  i->suppress = 0;
+  i->backtrack = 1;
+  i->checked = 0;
+  i->capture++;
+  i->replay++;
+  i->fails_floor = i->fails_num;
+  i->fail_pos = -1;
+  i->depth_stop = mpc_depth_stop(i, i->depth);
+  
+  if (!mpc_parse_run(i, f.parser, &r)) { mpc_err_merge(i, r.error); }
+  
+  i->replay--;
+  i->capture--;
+  i->pos = pos;
+  i->last = last;
+  i->suppress = suppress;
+  i->backtrack = backtrack;
+  i->checked = checked;
+  i->dirty = dirty;
+  i->fails_floor = floor;
+  i->depth_stop = stop;
+  i->fail_pos = fail_pos;
+  i->fail_recieved = recieved;
+  i->err = err;
+  i->err_expected = err_expected;
+}
+
+/*
+** Replaces every deferred parser which could still be
+** reported by what it expected. The newest are run
+** first just to see how far they get, which usually
+** rules out most of the others without running them.
+*/
+static void mpc_fail_settle(mpc_input_t *i) {
+  
+  int j, k, n = i->fails_num, floor = i->fails_floor;
+  long pos = i->fail_pos, sub;
+  mpc_fail_t f;
+  
+  for (j = n-1; j >= floor; j--) {
+    f = i->fails[j];
+    if (f.parser == NULL || f.bound < pos) { continue; }
+    mpc_fail_replay(i, f);
+    for (k = n; k < i->fails_num; k++) {
+      if (i->fails[k].pos > pos) { pos = i->fails[k].pos; }
+    }
+    i->fails_num = n;
+  }
+  
+  for (j = floor; j < n; j++) {
+    f = i->fails[j];
+    if (f.parser == NULL) { mpc_fail_push(i, NULL, f.expected, f.failure, f.pos, f.pos, '\0'); continue; }
+    if (f.bound < pos) { continue; }
+    sub = i->fails_num;
+    mpc_fail_replay(i, f);
+    for (k = (int)sub; k < i->fails_num; k++) {
+      if (i->fails[k].pos > pos) { pos = i->fails[k].pos; }
+    }
+  }
+  
+  k = floor;
+  for (j = n; j < i->fails_num; j++) {
+    if (i->fails[j].pos == pos) { i->fails[k++] = i->fails[j]; }
+  }
+  i->fails_num = k;
+  
+  if (pos != i->fail_pos) {
+    i->fail_pos = pos;
+    sub = pos - i->origin.pos;
+    i->fail_recieved = sub < (long)i->length ? i->string[sub] : '\0';
+  }
+}
+
+/*
+** `many1` and `count` put a prefix on the label of any
+** error they return. Only those which could still be
+** reported get one, and each label made this way is
+** kept by the input until its next parse.
+*/
+
+static char *mpc_err_label(mpc_input_t *i, const char *prefix, const char *expected) {
+  
+  int j;
+  char *x = malloc(strlen(prefix) + strlen(expected) + 1);
+  strcpy(x, prefix);
+  strcat(x, expected);
+  
+  for (j = 0; j < i->labels_num; j++) {
+    if (strcmp(i->labels[j], x) == 0) { free(x); return i->labels[j]; }
+  }
+  
+  if (i->labels_num == i->labels_slots) {
+    i->labels_slots = i->labels_slots ? i->labels_slots * 2 : 8;
+    i->labels = realloc(i->labels, sizeof(char*) * i->labels_slots);
+  }
+  i->labels[i->labels_num++] = x;
+  return x;
+}
+
+static mpc_err_t *mpc_err_many1(mpc_input_t *i, mpc_err_t *x) {
+  if (x == NULL || x->failure || x->state.pos < i->fail_pos) { return x; }
+  x->expected[0] = mpc_err_label(i, "one or more of ", x->expected[0]);
+  return x;
+}
+
+static mpc_err_t *mpc_err_count(mpc_input_t *i, mpc_err_t *x, int n) {
+  char prefix[32];
+  if (x == NULL || x->failure || x->state.pos < i->fail_pos) { return x; }
+  sprintf(prefix, "%i of ", n);
+  x->expected[0] = mpc_err_label(i, prefix, x->expected[0]);
+  return x;
+}
+
+/* Going too deep is reported with where it happened */
+static const char mpc_depth_failure[] = "Maximum Depth Exceeded!";
+
+/* The error of a failed parse, from its farthest failure */
+static mpc_err_t *mpc_err_build(mpc_input_t *i) {
+  
+  int j, k;
+  mpc_err_t *x = malloc(sizeof(mpc_err_t));
+  
+  mpc_fail_settle(i);
+  
+  x->filename = malloc(strlen(i->filename) + 1);
+  strcpy(x->filename, i->filename);
+  x->expected_num = 0;
+  x->expected = NULL;
+  x->failure = NULL;
+  x->recieved = i->fail_recieved;
+  
+  if (i->fails_num == 0) {
+    x->state = mpc_state_invalid();
+    x->failure = malloc(strlen("Unknown Error") + 1);
+    strcpy(x->failure, "Unknown Error");
+    return x;
+  }
+  
+  x->state = mpc_state_new();
+  x->state.pos = i->fail_pos;
+  if (i->fail_pos >= i->origin.pos) {
+    x->state = mpc_input_state_at(i, i->fail_pos - i->origin.pos);
+  }
+  
+  for (j = 0; j < i->fails_num; j++) {
+    
+    if (i->fails[j].failure == mpc_depth_failure) {
+      x->failure = malloc(80);
+      sprintf(x->failure, "Maximum Depth Exceeded at %li:%li!", x->state.row+1, x->state.col+1);
+      break;
+    }
+    
+    if (i->fails[j].failure) {
+      x->failure = malloc(strlen(i->fails[j].failure) + 1);
+      strcpy(x->failure, i->fails[j].failure);
+      break;
+    }
+    
+    for (k = 0; k < x->expected_num; k++) {
+      if (strcmp(x->expected[k], i->fails[j].expected) == 0) { break; }
+    }
+    if (k < x->expected_num) { continue; }
+    
+    x->expected_num++;
+    x->expected = realloc(x->expected, sizeof(char*) * x->expected_num);
+    x->expected[k] = malloc(strlen(i->fails[j].expected) + 1);
+    strcpy(x->expected[k], i->fails[j].expected);
+  }
+  
+  return x;
+}
+
+/*
+** Parser Type
+*/
+
+enum {
+  MPC_TYPE_UNDEFINED = 0,
+  MPC_TYPE_PASS      = 1,
+  MPC_TYPE_FAIL      = 2,
+  MPC_TYPE_LIFT      = 3,
+  MPC_TYPE_LIFT_VAL  = 4,
+  MPC_TYPE_EXPECT    = 5,
+  MPC_TYPE_ANCHOR    = 6,
+  MPC_TYPE_STATE     = 7,
+  
+  MPC_TYPE_ANY       = 8,
+  MPC_TYPE_SINGLE    = 9,
+  MPC_TYPE_ONEOF     = 10,
+  MPC_TYPE_NONEOF    = 11,
+  MPC_TYPE_RANGE     = 12,
+  MPC_TYPE_SATISFY   = 13,
+  MPC_TYPE_STRING    = 14,
+  
+  MPC_TYPE_APPLY     = 15,
+  MPC_TYPE_APPLY_TO  = 16,
+  MPC_TYPE_PREDICT   = 17,
+  MPC_TYPE_NOT       = 18,
+  MPC_TYPE_MAYBE     = 19,
+  MPC_TYPE_MANY      = 20,
+  MPC_TYPE_MANY1     = 21,
+  MPC_TYPE_COUNT     = 22,
+  
+  MPC_TYPE_OR        = 23,
+  MPC_TYPE_AND       = 24,
+  
+  MPC_TYPE_MEMO      = 25,
+  MPC_TYPE_DFA       = 26,
+  MPC_TYPE_SPAN      = 27,
+  MPC_TYPE_CAPTURE   = 28,
+  MPC_TYPE_SKIP      = 29,
+  MPC_TYPE_TOKEN     = 30
+};
+
+typedef struct { char *m; } mpc_pdata_fail_t;
+typedef struct { mpc_ctor_t lf; void *x; } mpc_pdata_lift_t;
+typedef struct { mpc_parser_t *x; char *m; } mpc_pdata_expect_t;
+typedef struct { int(*f)(char,char); } mpc_pdata_anchor_t;
+typedef struct { char x; } mpc_pdata_single_t;
+typedef struct { char x; char y; } mpc_pdata_range_t;
+typedef struct { int(*f)(char); } mpc_pdata_satisfy_t;
+typedef struct { char *x; unsigned char *set; } mpc_pdata_string_t;
+typedef struct { mpc_parser_t *x; mpc_apply_t f; } mpc_pdata_apply_t;
+typedef struct { mpc_parser_t *x; mpc_apply_to_t f; void *d; } mpc_pdata_apply_to_t;
+typedef struct { mpc_parser_t *x; mpc_dtor_t dx; } mpc_pdata_predict_t;
+typedef struct { mpc_parser_t *x; } mpc_pdata_memo_t;
+typedef struct { mpc_parser_t *x; int n; int *trans; char *accept; } mpc_pdata_dfa_t;
+/* Also used by `skip`, which runs a capture's parser and drops the text */
+typedef struct { mpc_parser_t *x; } mpc_pdata_capture_t;
+typedef struct { mpc_parser_t *x; mpc_scanner_t *s; int kind; } mpc_pdata_token_t;
+typedef struct { mpc_parser_t *x; int min; unsigned char *set; unsigned char ranges[MPC_INPUT_SPAN_RANGES * 2]; int ranges_num; } mpc_pdata_span_t;
+typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_ctor_t lf; unsigned char *lookahead; int gen; } mpc_pdata_not_t;
+typedef struct { int n; mpc_fold_t f; mpc_parser_t *x; mpc_dtor_t dx; unsigned char *lookahead; int gen; } mpc_pdata_repeat_t;
+typedef struct { int n; mpc_parser_t **xs; unsigned char *dispatch; int gen; } mpc_pdata_or_t;
+typedef struct { int n; mpc_fold_t f; mpc_parser_t **xs; mpc_dtor_t *dxs;  } mpc_pdata_and_t;
+
+typedef union {
+  mpc_pdata_fail_t fail;
+  mpc_pdata_lift_t lift;
+  mpc_pdata_expect_t expect;
+  mpc_pdata_anchor_t anchor;
+  mpc_pdata_single_t single;
+  mpc_pdata_range_t range;
+  mpc_pdata_satisfy_t satisfy;
+  mpc_pdata_string_t string;
+  mpc_pdata_apply_t apply;
+  mpc_pdata_apply_to_t apply_to;
+  mpc_pdata_predict_t predict;
+  mpc_pdata_memo_t memo;
+  mpc_pdata_dfa_t dfa;
+  mpc_pdata_span_t span;
+  mpc_pdata_capture_t capture;
+  mpc_pdata_token_t token;
+  mpc_pdata_not_t not;
+  mpc_pdata_repeat_t repeat;
+  mpc_pdata_and_t and;
+  mpc_pdata_or_t or;
+} mpc_pdata_t;
+
+struct mpc_parser_t {
+  char retained;
+  char *name;
+  char type;
+  char first;
+  mpc_pdata_t data;
+};
+
+static mpc_val_t *mpcf_input_nth_free(mpc_input_t *i, int n, mpc_val_t **xs, int x) {
+  int j;
+  for (j = 0; j < n; j++) { if (j != x) { mpc_free(i, xs[j]); } }
+  return xs[x];
+}
+ 
+static mpc_val_t *mpcf_input_fst_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 0); }
+static mpc_val_t *mpcf_input_snd_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 1); }
+static mpc_val_t *mpcf_input_trd_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 2); }
+
+static mpc_val_t *mpcf_input_strfold(mpc_input_t *i, int n, mpc_val_t **xs) {
+  int j;
+  size_t l = 0;
+  if (n == 0) { return mpc_calloc(i, 1, 1); }
+  for (j = 0; j < n; j++) { l += strlen(xs[j]); }
+  xs[0] = mpc_realloc(i, xs[0], l + 1);
+  for (j = 1; j < n; j++) { strcat(xs[0], xs[j]); mpc_free(i, xs[j]); }
+  return xs[0];
+}
+
+static mpc_val_t *mpcf_input_state_ast(mpc_input_t *i, int n, mpc_val_t **xs) {
+  mpc_state_t *s = ((mpc_state_t**)xs)[0];
+  mpc_ast_t *a = ((mpc_ast_t**)xs)[1];
+  a = mpc_ast_state(a, *s);
+  mpc_free(i, s);
+  (void) n;
+  return a;
+}
+
+/*
+** While capturing (or only recognising) the values
+** of parsers are never looked at, so none are made
+** and no callbacks are run.
+*/
+
+static mpc_val_t *mpc_ast_fold(struct mpc_ast_arena_t *arena, int n, mpc_val_t **xs);
+
+static mpc_val_t *mpc_parse_fold(mpc_input_t *i, mpc_fold_t f, int n, mpc_val_t **xs) {
+  int j;
+  if (i->capture)          { return NULL; }
+  if (f == mpcf_null)      { return mpcf_null(n, xs); }
+  if (f == mpcf_fst)       { return mpcf_fst(n, xs); }
+  if (f == mpcf_snd)       { return mpcf_snd(n, xs); }
+  if (f == mpcf_trd)       { return mpcf_trd(n, xs); }
+  if (f == mpcf_fst_free)  { return mpcf_input_fst_free(i, n, xs); }
+  if (f == mpcf_snd_free)  { return mpcf_input_snd_free(i, n, xs); }
+  if (f == mpcf_trd_free)  { return mpcf_input_trd_free(i, n, xs); }
+  if (f == mpcf_strfold)   { return mpcf_input_strfold(i, n, xs); }
+  if (f == mpcf_state_ast) { return mpcf_input_state_ast(i, n, xs); }
+  if (f == mpcf_fold_ast)  { return mpc_ast_fold(i->arena, n, xs); }
+  for (j = 0; j < n; j++) { xs[j] = mpc_export(i, xs[j]); }
+  return f(j, xs);
+}
+
+static mpc_val_t *mpcf_input_free(mpc_input_t *i, mpc_val_t *x) {
+  mpc_free(i, x);
+  return NULL;
+}
+
+static long mpc_ast_slice_find(struct mpc_ast_arena_t *a, mpc_input_t *i, const char *c, long n);
+static mpc_ast_t *mpc_ast_new_slice(struct mpc_ast_arena_t *arena, const char *tag, const char *contents, long offset, long length);
+static mpc_ast_t *mpc_ast_root_in(struct mpc_ast_arena_t *arena, mpc_ast_t *a);
+
+static mpc_val_t *mpcf_input_str_ast(mpc_input_t *i, mpc_val_t *c) {
+  long n = (long)strlen(c);
+  mpc_ast_t *a = mpc_ast_new_slice(i->arena, "", c, mpc_ast_slice_find(i->arena, i, c, n), n);
+  mpc_free(i, c);
+  return a;
+}
+
+static mpc_val_t *mpc_parse_apply(mpc_input_t *i, mpc_apply_t f, mpc_val_t *x) {
+  if (i->capture)         { return NULL; }
+  if (f == mpcf_free)     { return mpcf_input_free(i, x); }
+  if (f == mpcf_str_ast)  { return mpcf_input_str_ast(i, x); }
+  if (f == (mpc_apply_t)mpc_ast_add_root) { return mpc_ast_root_in(i->arena, x); }
+  return f(mpc_export(i, x));
+}
+
+static mpc_val_t *mpc_parse_apply_to(mpc_input_t *i, mpc_apply_to_t f, mpc_val_t *x, mpc_val_t *d) {
+  if (i->capture) { return NULL; }
+  return f(mpc_export(i, x), d);
+}
+
+static void mpc_parse_dtor(mpc_input_t *i, mpc_dtor_t d, mpc_val_t *x) {
+  if (i->capture) { return; }
+  if (d == free) { mpc_free(i, x); return; }
+  d(mpc_export(i, x));
+}
+
+enum {
+  MPC_PARSE_STACK_MIN = 4
+};
+
+/*
+** Nesting Depth
+**
+** The interpreter recurses on the C stack, a few
+** frames for every rule it enters, so input nested
+** deeply enough would overflow it and crash. Unless
+** given a limit it stops at a depth that is safe on
+** a typical 8MB stack, and going past it is then an
+** ordinary parse failure reported where the rule was
+** entered. Sessions and push sessions can be given a
+** limit of their own, which callers on a smaller or
+** larger stack should do.
+**
+** Compiled parsers keep their stack on the heap, so
+** unless given a limit they stop only at a very high
+** one. Parts of them which run on the interpreter
+** may nest no further than the interpreter would from
+** where they were entered.
+*/
+
+enum {
+  MPC_DEPTH_INTERPRETED = 4096,
+  MPC_DEPTH_COMPILED    = 1 << 20
+};
+
+static int mpc_depth_stop(mpc_input_t *i, int depth) {
+  if (i->depth_max) { return i->depth_max; }
+  return depth < MPC_DEPTH_COMPILED - MPC_DEPTH_INTERPRETED
+    ? depth + MPC_DEPTH_INTERPRETED : MPC_DEPTH_COMPILED;
+}
+
+/*
+** Packrat Memoization
+**
+** Rules wrapped with `mpca_memo` remember how they
+** went at each position so that when backtracking
+** brings the parser back to the same place the work
+** isn't repeated. The table is direct-mapped, so it
+** never grows and a new entry simply evicts whatever
+** was in its slot. Its memory is therefore bounded
+** and parsing stays linear as long as backtracking
+** doesn't reach further back than the table holds.
+**
+** Most rules are only tried once at any position, so
+** the first visit just records that it happened and
+** only on a second visit is the result stored. As
+** values are consumed by whoever receives them the
+** table keeps a copy of the AST, and each hit is
+** handed a copy of its own. Whatever the rule added
+** to the farthest failure is still there when it is
+** found again, so only the error it returned is kept
+** and messages are the same as without memoization.
+**
+** Only String inputs are memoized and only while
+** backtracking is enabled and deferred parsers are
+** not being run. Everything is dropped at
+** the end of each parse.
+*/
+
+enum {
+  MPC_MEMO_SEEN    = 0,
+  MPC_MEMO_FAILURE = 1,
+  MPC_MEMO_SUCCESS = 2
+};
+
+static mpc_ast_t *mpc_ast_copy(struct mpc_ast_arena_t *arena, mpc_ast_t *a);
+static struct mpc_ast_arena_t *mpc_ast_arena(mpc_ast_t *a);
+static void mpc_input_memo_release(mpc_input_t *i, mpc_memo_t *m) {
+  (void)i;
+  if (m->result == MPC_MEMO_SUCCESS) { mpc_ast_delete(m->output); }
+  m->result = MPC_MEMO_SEEN;
+  m->output = NULL;
+  m->errored = 0;
+}
+
+static void mpc_input_memo_clear(mpc_input_t *i) {
+  int j;
+  for (j = 0; j < i->memo_used_num; j++) {
+    mpc_input_memo_release(i, &i->memo[i->memo_used[j]]);
+    i->memo[i->memo_used[j]].parser = NULL;
+  }
+  i->memo_used_num = 0;
+}
+
+static mpc_memo_t *mpc_input_memo_slot(mpc_input_t *i, mpc_parser_t *p, long pos) {
+  
+  int j;
+  unsigned long h = ((unsigned long)(size_t)p >> 4) ^ ((unsigned long)pos * 2654435761UL);
+  
+  if (i->memo == NULL) {
+    i->memo = calloc(MPC_INPUT_MEMO_SLOTS, sizeof(mpc_memo_t));
+    i->memo_used = malloc(sizeof(int) * MPC_INPUT_MEMO_SLOTS);
+  }
+  
+  j = (int)(h & (MPC_INPUT_MEMO_SLOTS - 1));
+  
+  if (i->memo[j].parser == NULL) {
+    i->memo_used[i->memo_used_num++] = j;
+  } else if (i->memo[j].result != MPC_MEMO_SEEN
+  && (i->memo[j].parser != p || i->memo[j].pos != pos)) {
+    i->memo_evictions++;
+  }
+  
+  return &i->memo[j];
+}
+
+static int mpc_parse_memo(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+  
+  int x;
+  long start = i->pos;
+  char suppress = i->suppress > 0;
+  mpc_memo_t *m;
+  
+  if (i->type != MPC_INPUT_STRING || i->backtrack < 1 || i->replay) {
+    return mpc_parse_run(i, p->data.memo.x, r);
+  }
+  
+  m = mpc_input_memo_slot(i, p, start);
+  
+  if (m->parser == p && m->pos == start && m->suppress == suppress) {
+    
+    if (m->result != MPC_MEMO_SEEN) {
+      i->memo_hits++;
+      i->pos = m->end;
+      i->last = m->last;
+      if (m->result == MPC_MEMO_SUCCESS) {
+        r->output = mpc_ast_copy(i->arena, m->output);
+        return 1;
+      }
+      r->error = NULL;
+      if (m->errored) {
+        i->err = m->error;
+        i->err.expected = &i->err_expected;
+        i->err_expected = m->expected;
+        r->error = &i->err;
+      }
+      return 0;
+    }
+    
+    /* Second visit so store the result this time */
+    x = mpc_parse_run(i, p->data.memo.x, r);
+    
+    m = mpc_input_memo_slot(i, p, start);
+    mpc_input_memo_release(i, m);
+    m->parser = p;
+    m->pos = start;
+    m->suppress = suppress;
+    m->end = i->pos;
+    m->last = i->last;
+    m->result = x ? MPC_MEMO_SUCCESS : MPC_MEMO_FAILURE;
+    m->output = x ? mpc_ast_copy(i->arena, r->output) : NULL;
+    if (!x && r->error) {
+      m->errored = 1;
+      m->error = *r->error;
+      m->expected = r->error->expected_num ? r->error->expected[0] : NULL;
+    }
+    i->memo_stores++;
+    return x;
+  }
+  
+  mpc_input_memo_release(i, m);
+  m->parser = p;
+  m->pos = start;
+  m->suppress = suppress;
+  return mpc_parse_run(i, p->data.memo.x, r);
+}
+
+/*
+** Dispatch Tables
+**
+** `mpc_optimise` works out which characters each
+** parser can start with and stores the result on
+** `or` and `many` nodes. For an `or` it is a table
+** with a row per character (and one for the end of
+** input) marking which alternatives could match,
+** and for `maybe`, `many` and `many1` it is the set
+** of characters the inner parser can begin with.
+** The engine peeks one byte and jumps past any
+** alternative, or out of any loop, that would
+** only fail there.
+**
+** Tables refer to other rules, so redefining a
+** parser which some table looked at bumps a global
+** generation and any table built before that is
+** ignored. Rules not defined yet are assumed to
+** match anything, which only makes a table less
+** precise, and undefined rules can never match so
+** skipping them changes nothing.
+**
+** Skipped parsers are deferred to the farthest
+** failure, which runs them if what they expected
+** could still be reported, so messages are exactly
+** the same as without tables. Only String inputs use
+** them.
+*/
+
+enum {
+  MPC_DISPATCH_EOI = 256,
+  MPC_DISPATCH_ROWS = 257
+};
+
+static int mpc_generation = 0;
+
+static void mpc_dispatch_invalidate(mpc_parser_t *p) {
+  if (p->first) { mpc_generation++; p->first = 0; }
+}
+
+static int mpc_dispatch_peek(mpc_input_t *i) {
+  return mpc_input_ends(i, i->pos) ? MPC_DISPATCH_EOI : (unsigned char)i->string[i->pos];
+}
+
+static const unsigned char *mpc_dispatch_row(mpc_input_t *i, mpc_parser_t *p) {
+  if (i->type != MPC_INPUT_STRING || i->replay
+  ||  p->data.or.dispatch == NULL || p->data.or.gen != mpc_generation) { return NULL; }
+  return p->data.or.dispatch + mpc_dispatch_peek(i) * ((p->data.or.n + 7) / 8);
+}
+
+static int mpc_dispatch_viable(mpc_input_t *i, const unsigned char *row, int j, mpc_parser_t *x) {
+  if (row == NULL || row[j / 8] & (1 << (j % 8))) { return 1; }
+  mpc_err_defer(i, x, i->pos, i->last, i->pos);
+  return 0;
+}
+
+/* A `many1` with nothing yet returns the error of what it would skip, so runs it if that matters */
+static int mpc_dispatch_next(mpc_input_t *i, const unsigned char *lookahead, int gen, mpc_parser_t *x, int required, mpc_result_t *r) {
+  
+  int c;
+  
+  if (i->type != MPC_INPUT_STRING || i->replay
+  ||  lookahead == NULL || gen != mpc_generation) { return 1; }
+  
+  c = mpc_dispatch_peek(i);
+  if (c != MPC_DISPATCH_EOI && lookahead[c / 8] & (1 << (c % 8))) { return 1; }
+  
+  if (required && !i->suppress && i->origin.pos + i->pos >= i->fail_pos) { return 1; }
+  
+  mpc_err_defer(i, x, i->pos, i->last, i->pos);
+  r->error = NULL;
+  return 0;
+}
+
+/*
+** A run of characters stops at the first one the
+** `many` doesn't match, where its element, run once,
+** gives the error the loop would have.
+*/
+
+static mpc_err_t *mpc_span_error(mpc_input_t *i, mpc_parser_t *p, int ok) {
+  
+  mpc_result_t r;
+  long pos = i->pos;
+  char last = i->last;
+  
+  if (i->suppress || i->origin.pos + i->pos < i->fail_pos) { return NULL; }
+  
+  i->capture++;
+  if (mpc_parse_run(i, p->data.repeat.x, &r)) { r.error = NULL; }
+  i->capture--;
+  i->pos = pos;
+  i->last = last;
+  
+  if (ok) { mpc_err_merge(i, r.error); return NULL; }
+  return mpc_err_many1(i, r.error);
+}
+
+#define MPC_SUCCESS(x) r->output = x; return 1
+#define MPC_FAILURE(x) r->error = x; return 0
+#define MPC_PRIMITIVE(x) \
+  if (x) { MPC_SUCCESS(r->output); } \
+  else { MPC_FAILURE(NULL); }
+
+static int mpc_parse_node(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r);
+
+static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+  
+  int x;
+  
+  if (!p->retained) { return mpc_parse_node(i, p, r); }
+  
+  if (i->depth >= i->depth_stop) {
+    r->error = mpc_err_fail(i, mpc_depth_failure);
+    return 0;
+  }
+  
+  i->depth++;
+  x = mpc_parse_node(i, p, r);
+  i->depth--;
+  return x;
+}
+
+static int mpc_parse_node(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+  
+  int j = 0, k = 0;
+  long start, stop;
+  char last;
+  mpc_fail_mark_t f;
+  mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
+  mpc_result_t *results;
+  int results_slots = MPC_PARSE_STACK_MIN;
+  const unsigned char *row;
+  
+  switch (p->type) {
+      
+    /* Basic Parsers */
+
+    case MPC_TYPE_ANY:     MPC_PRIMITIVE(mpc_input_any(i, (char**)&r->output));
+    case MPC_TYPE_SINGLE:  MPC_PRIMITIVE(mpc_input_char(i, p->data.single.x, (char**)&r->output));
+    case MPC_TYPE_RANGE:   MPC_PRIMITIVE(mpc_input_range(i, p->data.range.x, p->data.range.y, (char**)&r->output));
+    case MPC_TYPE_ONEOF:   MPC_PRIMITIVE(mpc_input_class(i, p->data.string.set, (char**)&r->output));
+    case MPC_TYPE_NONEOF:  MPC_PRIMITIVE(mpc_input_class(i, p->data.string.set, (char**)&r->output));
+    case MPC_TYPE_SATISFY: MPC_PRIMITIVE(mpc_input_satisfy(i, p->data.satisfy.f, (char**)&r->output));
+    case MPC_TYPE_STRING:  MPC_PRIMITIVE(mpc_input_string(i, p->data.string.x, (char**)&r->output));
+    case MPC_TYPE_ANCHOR:  MPC_PRIMITIVE(mpc_input_anchor(i, p->data.anchor.f, (char**)&r->output));
+    
+    /* Other parsers */
+    
+    case MPC_TYPE_UNDEFINED: MPC_FAILURE(mpc_err_fail(i, "Parser Undefined!"));
+    case MPC_TYPE_PASS:      MPC_SUCCESS(NULL);
+    case MPC_TYPE_FAIL:      MPC_FAILURE(mpc_err_fail(i, p->data.fail.m));
+    case MPC_TYPE_LIFT:      MPC_SUCCESS(i->capture ? NULL : p->data.lift.lf());
+    case MPC_TYPE_LIFT_VAL:  MPC_SUCCESS(p->data.lift.x);
+    case MPC_TYPE_STATE:     MPC_SUCCESS(i->capture ? NULL : mpc_input_state_copy(i));
+    
+    /* Application Parsers */
+    
+    case MPC_TYPE_APPLY:
+      if (mpc_parse_run(i, p->data.apply.x, r)) {
+        MPC_SUCCESS(mpc_parse_apply(i, p->data.apply.f, r->output));
+      } else {
+        MPC_FAILURE(r->output);
+      }
+    
+    case MPC_TYPE_APPLY_TO:
+      if (mpc_parse_run(i, p->data.apply_to.x, r)) {
+        MPC_SUCCESS(mpc_parse_apply_to(i, p->data.apply_to.f, r->output, p->data.apply_to.d));
+      } else {
+        MPC_FAILURE(r->error);
+      }
+    
+    case MPC_TYPE_EXPECT:
+      start = i->pos;
+      mpc_input_suppress_enable(i);
+      if (mpc_parse_run(i, p->data.expect.x, r)) {
+        mpc_input_suppress_disable(i);
+        MPC_SUCCESS(r->output);
+      } else {
+        mpc_input_suppress_disable(i);
+        mpc_input_recover(i, start);
+        MPC_FAILURE(mpc_err_new(i, p->data.expect.m));
+      }
+    
+    case MPC_TYPE_PREDICT:
+      if (p->data.predict.dx == NULL) {
+        k = i->checked;
+        i->checked = 0;
+        mpc_input_backtrack_disable(i);
+        j = mpc_parse_run(i, p->data.predict.x, r);
+        mpc_input_backtrack_enable(i);
+        i->checked = k;
+        if (j) { MPC_SUCCESS(r->output); }
+        MPC_FAILURE(r->error);
+      }
+      
+      /*
+      ** A rule `mpca_lang` found to be LL(1) is marked
+      ** once, and fails if anything inside it carried on
+      ** past a failure, or failed somewhere other than
+      ** where it would have with backtracking. Then it
+      ** is run again with backtracking, and what it
+      ** added to the farthest failure is taken back.
+      ** Rules inside one already running need nothing.
+      */
+      if (i->backtrack < 1) { return mpc_parse_run(i, p->data.predict.x, r); }
+      
+      mpc_input_mark(i);
+      mpc_fail_mark(i, &f);
+      mpc_input_backtrack_disable(i);
+      i->checked++;
+      i->dirty = 0;
+      j = mpc_parse_run(i, p->data.predict.x, r);
+      i->checked--;
+      mpc_input_backtrack_enable(i);
+      if (!i->dirty) {
+        mpc_fail_unmark(i, &f);
+        if (j) { mpc_input_unmark(i); MPC_SUCCESS(r->output); }
+        mpc_input_rewind(i);
+        MPC_FAILURE(r->error);
+      }
+      if (j) { mpc_parse_dtor(i, p->data.predict.dx, r->output); }
+      mpc_fail_rewind(i, &f);
+      mpc_input_rewind(i);
+      return mpc_parse_run(i, p->data.predict.x, r);
+    
+    /* Optional Parsers */
+    
+    /* TODO: Update Not Error Message */
+    
+    case MPC_TYPE_NOT:
+      start = i->pos;
+      mpc_input_mark(i);
+      mpc_input_suppress_enable(i);
+      if (mpc_parse_run(i, p->data.not.x, r)) {
+        mpc_input_rewind(i);
+        mpc_input_recover(i, start);
+        mpc_input_suppress_disable(i);
+        mpc_parse_dtor(i, p->data.not.dx, r->output);
+        MPC_FAILURE(mpc_err_new(i, "opposite"));
+      } else {
+        mpc_input_unmark(i);
+        mpc_input_suppress_disable(i);
+        MPC_SUCCESS(i->capture ? NULL : p->data.not.lf());
+      }
+    
+    case MPC_TYPE_MAYBE:
+      start = i->pos;
+      if (mpc_dispatch_next(i, p->data.not.lookahead, p->data.not.gen, p->data.not.x, 0, r)
+      &&  mpc_parse_run(i, p->data.not.x, r)) {
+        MPC_SUCCESS(r->output);
+      } else {
+        mpc_input_recover(i, start);
+        mpc_err_merge(i, r->error);
+        MPC_SUCCESS(i->capture ? NULL : p->data.not.lf());
+      }
+    
+    /* Repeat Parsers */
+    
+    case MPC_TYPE_MANY:
+      
+      results = results_stk;
+      start = i->pos;
+      
+      while (mpc_dispatch_next(i, p->data.repeat.lookahead, p->data.repeat.gen, p->data.repeat.x, 0, &results[j])
+      &&     mpc_parse_run(i, p->data.repeat.x, &results[j])) {
+        start = i->pos;
+        j++;
+        if (j == MPC_PARSE_STACK_MIN) {
+          results_slots = j + j / 2;
+          results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
+          memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
+        } else if (j >= results_slots) {
+          results_slots = j + j / 2;
+          results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
+        }
+      }
+      
+      mpc_input_recover(i, start);
+      mpc_err_merge(i, results[j].error);
+      MPC_SUCCESS(
+        mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
+        if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+    
+    case MPC_TYPE_MANY1:
+      
+      results = results_stk;
+      start = i->pos;
+      
+      while (mpc_dispatch_next(i, p->data.repeat.lookahead, p->data.repeat.gen, p->data.repeat.x, j == 0, &results[j])
+      &&     mpc_parse_run(i, p->data.repeat.x, &results[j])) {
+        start = i->pos;
+        j++;
+        if (j == MPC_PARSE_STACK_MIN) {
+          results_slots = j + j / 2;
+          results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
+          memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
+        } else if (j >= results_slots) {
+          results_slots = j + j / 2;
+          results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
+        }
+      }
+      
+      mpc_input_recover(i, start);
+      if (j == 0) {
+        MPC_FAILURE(
+          mpc_err_many1(i, results[j].error);
+          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+      } else {
+        mpc_err_merge(i, results[j].error);
+        MPC_SUCCESS(
+          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
+          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+      }
+    
+    case MPC_TYPE_COUNT:
+      
+      results = p->data.repeat.n > MPC_PARSE_STACK_MIN
+        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.repeat.n)
+        : results_stk;
+      
+      mpc_input_mark(i);
+      while (mpc_parse_run(i, p->data.repeat.x, &results[j])) {
+        j++;
+        if (j == p->data.repeat.n) { break; }
+      }
+      
+      if (j == p->data.repeat.n) {
+        mpc_input_unmark(i);
+        MPC_SUCCESS(
+          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
+          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+      } else {
+        mpc_input_rewind(i);
+        for (k = 0; k < j; k++) {
+          mpc_parse_dtor(i, p->data.repeat.dx, results[k].output);
+        }
+        MPC_FAILURE(
+          mpc_err_count(i, results[j].error, p->data.repeat.n);
+          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });  
+      }
+      
+    /* Combinatory Parsers */
+    
+    case MPC_TYPE_OR:
+      
+      if (p->data.or.n == 0) { MPC_SUCCESS(NULL); }
+      
+      results = p->data.or.n > MPC_PARSE_STACK_MIN
+        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
+        : results_stk;
+      
+      row = mpc_dispatch_row(i, p);
+      start = i->pos;
+      
+      for (j = 0; j < p->data.or.n; j++) {
+        if (!mpc_dispatch_viable(i, row, j, p->data.or.xs[j])) { continue; }
+        if (mpc_parse_run(i, p->data.or.xs[j], &results[j])) {
+          MPC_SUCCESS(results[j].output;
+            if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+        } else {
+          mpc_input_recover(i, start);
+          mpc_err_merge(i, results[j].error);
+          /* Without backtracking the next alternative starts where this one stopped */
+          if (i->pos != start) { row = mpc_dispatch_row(i, p); }
+        } 
+      }
+      
+      MPC_FAILURE(NULL;
+        if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+    
+    case MPC_TYPE_AND:
+      
+      if (p->data.and.n == 0) { MPC_SUCCESS(NULL); }
+      
+      results = p->data.or.n > MPC_PARSE_STACK_MIN
+        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
+        : results_stk;
+      
+      mpc_input_mark(i);
+      for (j = 0; j < p->data.and.n; j++) {
+        if (!mpc_parse_run(i, p->data.and.xs[j], &results[j])) {
+          mpc_input_rewind(i);
+          for (k = 0; k < j; k++) {
+            mpc_parse_dtor(i, p->data.and.dxs[k], results[k].output);
+          }
+          MPC_FAILURE(results[j].error;
+            if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+        }
+      }
+      mpc_input_unmark(i); 
+      MPC_SUCCESS(
+        mpc_parse_fold(i, p->data.and.f, j, (mpc_val_t**)results);
+        if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+    
+    /* Memoized Parsers */
+    
+    case MPC_TYPE_MEMO: return mpc_parse_memo(i, p, r);
+    
+    /* Regex Automata */
+    
+    case MPC_TYPE_DFA:
+      if (i->type != MPC_INPUT_STRING || i->replay || i->backtrack + i->checked < 1) {
+        return mpc_parse_run(i, p->data.dfa.x, r);
+      }
+      start = i->pos;
+      last = i->last;
+      switch (mpc_input_dfa(i, p->data.dfa.trans, p->data.dfa.accept, (char**)&r->output, &stop)) {
+        case 1:
+          mpc_err_defer(i, p->data.dfa.x, start, last, stop);
+          MPC_SUCCESS(r->output);
+        case 0:
+          /* The regex itself says what it expected, if that could still be reported */
+          if (i->suppress || i->origin.pos + stop < i->fail_pos) { MPC_FAILURE(NULL); }
+      }
+      return mpc_parse_run(i, p->data.dfa.x, r);
+    
+    /* Character Runs */
+    
+    case MPC_TYPE_SPAN:
+      if (i->type != MPC_INPUT_STRING) {
+        return mpc_parse_run(i, p->data.span.x, r);
+      }
+      j = mpc_input_span(i, p->data.span.set, p->data.span.ranges, p->data.span.ranges_num,
+        p->data.span.min, (char**)&r->output);
+      if (j) { mpc_span_error(i, p->data.span.x, 1); MPC_SUCCESS(r->output); }
+      MPC_FAILURE(mpc_span_error(i, p->data.span.x, 0));
+    
+    /* Text Captures */
+    
+    case MPC_TYPE_CAPTURE:
+      if (i->type != MPC_INPUT_STRING || i->backtrack + i->checked < 1 || i->capture) {
+        return mpc_parse_run(i, p->data.capture.x, r);
+      }
+      start = i->pos;
+      i->capture++;
+      j = mpc_parse_run(i, p->data.capture.x, r);
+      i->capture--;
+      if (j) { MPC_SUCCESS(mpc_input_slice(i, start)); }
+      MPC_FAILURE(r->error);
+    
+    case MPC_TYPE_SKIP:
+      i->capture++;
+      j = mpc_parse_run(i, p->data.capture.x, r);
+      i->capture--;
+      if (j) { MPC_SUCCESS(NULL); }
+      MPC_FAILURE(r->error);
+    
+    /* Scanned Tokens */
+    
+    case MPC_TYPE_TOKEN:
+      if (i->type != MPC_INPUT_STRING || i->replay || p->data.token.s->trans == NULL) {
+        return mpc_parse_run(i, p->data.token.x, r);
+      }
+      start = i->pos;
+      last = i->last;
+      switch (mpc_input_token(i, p->data.token.s, p->data.token.kind, (char**)&r->output, &stop)) {
+        case 1:
+          mpc_err_defer(i, p->data.token.x, start, last, stop);
+          MPC_SUCCESS(r->output);
+        case 0:
+          if (i->suppress || i->origin.pos + stop < i->fail_pos) { MPC_FAILURE(NULL); }
+          /* Only the error of the terminal is wanted, as the longer token still wins */
+          i->capture++;
+          j = mpc_parse_run(i, p->data.token.x, r);
+          i->capture--;
+          i->pos = start;
+          i->last = last;
+          MPC_FAILURE(j ? mpc_err_new(i, p->data.token.s->kinds[p->data.token.kind]) : r->error);
+      }
+      return mpc_parse_run(i, p->data.token.x, r);
+    
+    /* End */
+    
+    default:
+      
+      MPC_FAILURE(mpc_err_fail(i, "Unknown Parser Type Id!"));
+  }
+  
+  return 0;
+  
+}
+
+#undef MPC_SUCCESS
+#undef MPC_FAILURE
+#undef MPC_PRIMITIVE
+
+/*
+** A parse which fails has its error built from the
+** farthest failure, once, at the end.
+*/
+
+static int mpc_parse_finish(mpc_input_t *i, int x, mpc_result_t *r) {
+  
+  mpc_input_memo_clear(i);
+  
+  if (x) {
+    r->output = mpc_export(i, r->output);
+    return 1;
+  }
+  
+  mpc_err_merge(i, r->error);
+  r->error = mpc_err_build(i);
+  return 0;
+}
+
+int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+  mpc_fail_reset(i);
+  i->depth_stop = mpc_depth_stop(i, 0);
+  return mpc_parse_finish(i, mpc_parse_run(i, p, r), r);
+}
+
+int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r) {
+  return mpc_parse_view(filename, string, strlen(string), p, r);
+}
+
+int mpc_nparse(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r) {
+  const char *end = memchr(string, '\0', length);
+  if (end) { length = (size_t)(end - string); }
+  return mpc_parse_view(filename, string, length, p, r);
+}
+
+int mpc_parse_view(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r) {
+  int x;
+  mpc_input_t *i = mpc_input_new_string(filename, string, length);
+  x = mpc_parse_input(i, p, r);
+  mpc_input_delete(i);
+  return x;
+}
+
+int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result_t *r) {
+  int x;
+  mpc_input_t *i = mpc_input_new_file(filename, file);
+  x = mpc_parse_input(i, p, r);
+  mpc_input_delete(i);
+  return x;
+}
+
+int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r) {
+  int x;
+  mpc_input_t *i = mpc_input_new_pipe(filename, pipe);
+  x = mpc_parse_input(i, p, r);
+  mpc_input_delete(i);
+  return x;
+}
+
+int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
+  
+  FILE *f = fopen(filename, "rb");
+  int res;
+  
+  if (f == NULL) {
+    r->output = NULL;
+    r->error = mpc_err_file(filename, "Unable to open file!");
+    return 0;
+  }
+  
+  res = mpc_parse_file(filename, f, p, r);
+  fclose(f);
+  return res;
+}
+
+/*
+** Sessions
+**
+** Each call to `mpc_parse` creates a fresh input,
+** which means allocating its memory pools, mark stack
+** and a copy of the filename. A session keeps a single
+** input and resets it between parses instead, which
+** matters when many short inputs are parsed, such as
+** the lines typed at a REPL.
+**
+** With `MPC_SESSION_ARENA` the AST built by each parse
+** is placed in a region of its own. Deleting the root
+** of the result releases the whole region at once.
+**
+** `MPC_SESSION_SLICES` also leaves the contents of
+** leaves where they are in the source, so it must
+** outlive the AST. Their `contents` is `NULL` until
+** asked for with `mpc_ast_contents`.
+**
+** `MPC_SESSION_FLAT` builds the AST in an arena as
+** above, then outputs it as an `mpc_ast_flat_t` and
+** drops the arena.
+**
+** `MPC_SESSION_COMPILED` runs the parser as a compiled
+** program, which is kept until a different parser is
+** passed in. It can be combined with the flags above
+** and lets input nest far deeper than the C stack
+** allows. Parsers must not be redefined while their
+** program is kept.
+**
+** `mpc_session_depth_limit` bounds how deeply rules
+** may nest in the session's parses.
+*/
+
+struct mpc_session_t {
+  mpc_input_t *input;
+  int flags;
+  mpc_program_t *program;
+};
+
+static struct mpc_ast_arena_t *mpc_ast_arena_new(mpc_input_t *i, const char *source);
+static void mpc_ast_arena_delete(struct mpc_ast_arena_t *a);
+static void mpc_ast_arena_finish(struct mpc_ast_arena_t *a, mpc_ast_t *root);
+
+static mpc_program_t *mpc_program_for(mpc_program_t *c, mpc_parser_t *p);
+static int mpc_parse_input_compiled(mpc_input_t *i, mpc_program_t *c, mpc_result_t *r);
+
+static int mpc_session_input(mpc_input_t *i, int flags, mpc_program_t **c, mpc_parser_t *p, mpc_result_t *r) {
+  if (!(flags & MPC_SESSION_COMPILED)) { return mpc_parse_input(i, p, r); }
+  *c = mpc_program_for(*c, p);
+  return mpc_parse_input_compiled(i, *c, r);
+}
+
+/* The arena a parse with `flags` builds its AST in, if any */
+static struct mpc_ast_arena_t *mpc_session_arena(mpc_input_t *i, int flags, const char *source) {
+  if (!(flags & (MPC_SESSION_ARENA | MPC_SESSION_SLICES | MPC_SESSION_FLAT))) { return NULL; }
+  i->arena = mpc_ast_arena_new((flags & MPC_SESSION_SLICES) ? i : NULL, source);
+  return i->arena;
+}
+
+/* Hands over the output of a parse made in arena `a` */
+static int mpc_session_finish(mpc_input_t *i, int flags, struct mpc_ast_arena_t *a, int x, mpc_result_t *r) {
+  
+  mpc_ast_t *t;
+  
+  if (a == NULL) { return x; }
+  
+  mpc_input_memo_clear(i);
+  i->arena = NULL;
+  
+  if (x && (flags & MPC_SESSION_FLAT)) {
+    t = r->output;
+    r->output = mpc_ast_flatten(t);
+    if (t && mpc_ast_arena(t) != a) { mpc_ast_delete(t); }
+    mpc_ast_arena_finish(a, NULL);
+    return x;
+  }
+  
+  mpc_ast_arena_finish(a, x ? r->output : NULL);
+  return x;
+}
+
+static int mpc_session_run(mpc_input_t *i, int flags, mpc_program_t **c, const char *source, mpc_parser_t *p, mpc_result_t *r) {
+  struct mpc_ast_arena_t *a = mpc_session_arena(i, flags, source);
+  return mpc_session_finish(i, flags, a, mpc_session_input(i, flags, c, p, r), r);
+}
+
+mpc_session_t *mpc_session_new(const char *filename, int flags) {
+  mpc_session_t *s = malloc(sizeof(mpc_session_t));
+  s->input = mpc_input_new(filename, MPC_INPUT_STRING);
+  s->flags = flags;
+  s->program = NULL;
+  return s;
+}
+
+int mpc_session_parse(mpc_session_t *s, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r) {
+  mpc_input_t *i = s->input;
+  mpc_input_reset(i, MPC_INPUT_STRING);
+  i->string = string;
+  i->length = length;
+  return mpc_session_run(i, s->flags, &s->program, string, p, r);
+}
+
+void mpc_session_delete(mpc_session_t *s) {
+  if (s->program) { mpc_program_delete(s->program); }
+  mpc_input_delete(s->input);
+  free(s);
+}
+
+/* Limits how many rules a parse may be inside at once, with zero for the default */
+void mpc_session_depth_limit(mpc_session_t *s, int n) {
+  s->input->depth_max = n > 0 ? n : 0;
+}
+
+/*
+** Push Parsing
+**
+** A push session lets input arrive in pieces. Each
+** chunk is appended to a buffer and the parser is
+** run over the part of the buffer not yet consumed
+** by a complete form, always as a compiled program.
+**
+** Until the session ends the view of the buffer is
+** partial, and the program stops at the first thing
+** it would read at the end of the view, such as a
+** token which might go on in the next chunk or the
+** whitespace after a form. The caller is then told to
+** feed more, and the run carries on from where it
+** stopped once more is in view, so no input is ever
+** parsed twice. A form is reported as soon as its
+** end is known, and a failure the input to come can't
+** change is reported straight away.
+**
+** Input which arrives in lines, such as a REPL's, can
+** instead be flushed after each one. That tries the
+** stopped run out as if the buffer held the whole
+** input, and if that would fail at its end because a
+** form is left open asks for more, with the run left
+** as it was. Otherwise the run is finished as if the
+** input ended there.
+**
+** The flags are the same as those of a session.
+*/
+
+struct mpc_push_t {
+  mpc_input_t *input;
+  mpc_parser_t *parser;
+  int flags;
+  mpc_program_t *program;
+  struct mpc_ast_arena_t *arena;
+  char *buffer;
+  size_t length;
+  size_t slots;
+  size_t consumed;
+  mpc_state_t state;
+};
+
+mpc_push_t *mpc_push_begin(const char *filename, mpc_parser_t *p, int flags) {
+  mpc_push_t *s = malloc(sizeof(mpc_push_t));
+  s->input = mpc_input_new(filename, MPC_INPUT_STRING);
+  s->parser = p;
+  s->flags = flags;
+  s->program = NULL;
+  s->arena = NULL;
+  s->buffer = NULL;
+  s->length = 0;
+  s->slots = 0;
+  s->consumed = 0;
+  s->state = mpc_state_new();
+  return s;
+}
+
+size_t mpc_push_pending(mpc_push_t *s) {
+  return s->length - s->consumed;
+}
+
+void mpc_push_depth_limit(mpc_push_t *s, int n) {
+  s->input->depth_max = n > 0 ? n : 0;
+}
+
+static void mpc_push_skip(mpc_push_t *s) {
+  
+  size_t j;
+  
+  for (j = s->consumed; j < s->length; j++) {
+    s->state.pos++;
+    if (s->buffer[j] == '\n') {
+      s->state.col = 0;
+      s->state.row++;
+    } else {
+      s->state.col++;
+    }
+  }
+  
+  s->consumed = s->length;
+}
+
+static int mpc_vm_running(mpc_input_t *i);
+static int mpc_vm_trial(mpc_input_t *i, mpc_program_t *c);
+
+/* Flushes the buffer if `whole`, and when `ended` no more is coming */
+static int mpc_push_run(mpc_push_t *s, int whole, int ended, mpc_result_t *r) {
+  
+  mpc_input_t *i = s->input;
+  size_t pending = s->length - s->consumed;
+  int x;
+  
+  if (!mpc_vm_running(i)) {
+    if (pending == 0) {
+      r->output = NULL;
+      return ended ? MPC_PUSH_DONE : MPC_PUSH_MORE;
+    }
+    mpc_input_reset(i, MPC_INPUT_STRING);
+    i->origin = s->state;
+    s->program = mpc_program_for(s->program, s->parser);
+    s->arena = mpc_session_arena(i, s->flags, NULL);
+  }
+  
+  i->string = s->buffer + s->consumed;
+  i->length = pending;
+  i->partial = !ended;
+  x = mpc_parse_input_compiled(i, s->program, r);
+  i->partial = 0;
+  
+  if (x < 0 && whole && !ended) {
+    x = mpc_vm_trial(i, s->program);
+    if (x >= 0) { x = mpc_parse_input_compiled(i, s->program, r); }
+  }
+  
+  if (x < 0) {
+    r->output = NULL;
+    return MPC_PUSH_MORE;
+  }
+  
+  x = mpc_session_finish(i, s->flags, s->arena, x, r);
+  s->arena = NULL;
+  
+  if (x) {
+    s->consumed += (size_t)i->pos;
+    s->state = mpc_input_state(i);
+    return MPC_PUSH_OK;
+  }
+  
+  mpc_push_skip(s);
+  return MPC_PUSH_ERROR;
+}
+
+/*
+** Feeding an empty chunk parses any further forms
+** already buffered, so after `MPC_PUSH_OK` the caller
+** should keep feeding empty chunks until it gets back
+** `MPC_PUSH_MORE`. On `MPC_PUSH_ERROR` all buffered
+** input is discarded and the session carries on from
+** whatever is fed next.
+*/
+
+int mpc_push_feed(mpc_push_t *s, const char *chunk, size_t length, mpc_result_t *r) {
+  
+  if (length > 0) {
+    
+    if (s->consumed > 0) {
+      memmove(s->buffer, s->buffer + s->consumed, s->length - s->consumed);
+      s->length -= s->consumed;
+      s->consumed = 0;
+    }
+    
+    if (s->length + length > s->slots) {
+      s->slots = s->length + length > s->slots * 2 ? s->length + length : s->slots * 2;
+      s->buffer = realloc(s->buffer, s->slots);
+    }
+    
+    memcpy(s->buffer + s->length, chunk, length);
+    s->length += length;
+  }
+  
+  return mpc_push_run(s, 0, 0, r);
+}
+
+/*
+** Parses the buffered input as if it were complete,
+** without ending the session. A form still open at
+** the end gives `MPC_PUSH_MORE`. Like feeding, this
+** is repeated until it no longer gives `MPC_PUSH_OK`.
+*/
+
+int mpc_push_flush(mpc_push_t *s, mpc_result_t *r) {
+  return mpc_push_run(s, 1, 0, r);
+}
+
+/*
+** Ends the session, parsing whatever remains of the
+** input with no more to come. Returns `MPC_PUSH_DONE`
+** if nothing was left over.
+*/
+
+int mpc_push_end(mpc_push_t *s, mpc_result_t *r) {
+  int x = mpc_push_run(s, 1, 1, r);
+  if (s->program) { mpc_program_delete(s->program); }
+  mpc_input_delete(s->input);
+  free(s->buffer);
+  free(s);
+  return x;
+}
+
+/*
+** Streaming
+**
+** A stream reads a file or pipe one form at a time,
+** running the parser again from wherever the last
+** form ended. The input is always read as a Pipe so
+** that buffered chunks are released as soon as the
+** parser has moved past them, keeping memory use in
+** proportion to the largest form rather than the
+** whole file. Whitespace between forms is skipped.
+**
+** After an error there is no sensible place to carry
+** on from, so the stream reports that it is done.
+*/
+
+struct mpc_stream_t {
+  mpc_input_t *input;
+  mpc_parser_t *parser;
+  int failed;
+};
+
+mpc_stream_t *mpc_stream_begin(const char *filename, FILE *file, mpc_parser_t *p) {
+  mpc_stream_t *s = malloc(sizeof(mpc_stream_t));
+  s->input = mpc_input_new_pipe(filename, file);
+  s->parser = p;
+  s->failed = 0;
+  return s;
+}
+
+int mpc_stream_next(mpc_stream_t *s, mpc_result_t *r) {
+  
+  mpc_input_t *i = s->input;
+  
+  if (s->failed) {
+    r->output = NULL;
+    return MPC_STREAM_DONE;
+  }
+  
+  while (isspace((unsigned char)mpc_input_peekc(i))) { mpc_input_any(i, NULL); }
+  
+  if (mpc_input_terminated(i)) {
+    r->output = NULL;
+    return MPC_STREAM_DONE;
+  }
+  
+  if (mpc_parse_input(i, s->parser, r)) {
+    mpc_input_chunks_discard(i);
+    mpc_input_lines_discard(i, i->pos);
+    return MPC_STREAM_OK;
+  }
+  
+  s->failed = 1;
+  return MPC_STREAM_ERROR;
+}
+
+void mpc_stream_end(mpc_stream_t *s) {
+  mpc_input_delete(s->input);
+  free(s);
+}
+
+/*
+** Building a Parser
+*/
+
+/*
+** Parsers are counted so that the tag table can be
+** freed along with the last of them.
+*/
+
+static long mpc_parsers_live = 0;
+
+static void mpc_tags_clear(void);
+
+static void mpc_parser_free(mpc_parser_t *p) {
+  free(p);
+  if (--mpc_parsers_live == 0) { mpc_tags_clear(); }
+}
+
+static void mpc_undefine_unretained(mpc_parser_t *p, int force);
+static void mpc_scanner_delete(mpc_scanner_t *s);
+
+static void mpc_undefine_or(mpc_parser_t *p) {
+  
+  int i;
+  for (i = 0; i < p->data.or.n; i++) {
+    mpc_undefine_unretained(p->data.or.xs[i], 0);
+  }
+  free(p->data.or.xs);
+  free(p->data.or.dispatch);
+  
+}
+
+static void mpc_undefine_and(mpc_parser_t *p) {
+  
+  int i;
+  for (i = 0; i < p->data.and.n; i++) {
+    mpc_undefine_unretained(p->data.and.xs[i], 0);
+  }
+  free(p->data.and.xs);
+  free(p->data.and.dxs);
+  
+}
+
+static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
+  
+  if (p->retained && !force) { return; }
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_FAIL: free(p->data.fail.m); break;
+    
+    case MPC_TYPE_ONEOF: 
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_STRING:
+      free(p->data.string.x); 
+      free(p->data.string.set);
+      break;
+    
+    case MPC_TYPE_APPLY:    mpc_undefine_unretained(p->data.apply.x, 0);    break;
+    case MPC_TYPE_APPLY_TO: mpc_undefine_unretained(p->data.apply_to.x, 0); break;
+    case MPC_TYPE_PREDICT:  mpc_undefine_unretained(p->data.predict.x, 0);  break;
+    case MPC_TYPE_MEMO:     mpc_undefine_unretained(p->data.memo.x, 0);     break;
+    
+    case MPC_TYPE_DFA:
+      mpc_undefine_unretained(p->data.dfa.x, 0);
+      free(p->data.dfa.trans);
+      free(p->data.dfa.accept);
+      break;
+    
+    case MPC_TYPE_SPAN:
+      mpc_undefine_unretained(p->data.span.x, 0);
+      free(p->data.span.set);
+      break;
+    
+    case MPC_TYPE_CAPTURE:
+    case MPC_TYPE_SKIP:
+      mpc_undefine_unretained(p->data.capture.x, 0);
+      break;
+    
+    case MPC_TYPE_TOKEN:
+      mpc_undefine_unretained(p->data.token.x, 0);
+      mpc_scanner_delete(p->data.token.s);
+      break;
+    
+    case MPC_TYPE_MAYBE:
+    case MPC_TYPE_NOT:
+      mpc_undefine_unretained(p->data.not.x, 0);
+      free(p->data.not.lookahead);
+      break;
+    
+    case MPC_TYPE_EXPECT:
+      mpc_undefine_unretained(p->data.expect.x, 0);
+      free(p->data.expect.m);
+      break;
+      
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      mpc_undefine_unretained(p->data.repeat.x, 0);
+      free(p->data.repeat.lookahead);
+      break;
+    
+    case MPC_TYPE_OR:  mpc_undefine_or(p);  break;
+    case MPC_TYPE_AND: mpc_undefine_and(p); break;
+    
+    default: break;
+  }
+  
+  if (!force) {
+    free(p->name);
+    mpc_parser_free(p);
+  }
+  
+}
+
+void mpc_delete(mpc_parser_t *p) {
+  if (p->retained) {
+
+    if (p->type != MPC_TYPE_UNDEFINED) {
+      mpc_undefine_unretained(p, 0);
+    } 
+    
+    free(p->name);
+    mpc_parser_free(p);
+  
+  } else {
+    mpc_undefine_unretained(p, 0);  
+  }
+}
+
+static void mpc_soft_delete(mpc_val_t *x) {
+  mpc_undefine_unretained(x, 0);
+}
+
+static mpc_parser_t *mpc_undefined(void) {
+  mpc_parser_t *p = calloc(1, sizeof(mpc_parser_t));
+  mpc_parsers_live++;
+  p->retained = 0;
+  p->type = MPC_TYPE_UNDEFINED;
+  p->name = NULL;
+  return p;
+}
+
+mpc_parser_t *mpc_new(const char *name) {
+  mpc_parser_t *p = mpc_undefined();
+  p->retained = 1;
+  p->name = realloc(p->name, strlen(name) + 1);
+  strcpy(p->name, name);
+  return p;
+}
+
+mpc_parser_t *mpc_copy(mpc_parser_t *a) {
+  int i = 0;
+  mpc_parser_t *p;
+  
+  if (a->retained) { return a; }
+  
+  p = mpc_undefined();
+  p->retained = a->retained;
+  p->type = a->type;
+  p->data = a->data;
+  
+  if (a->name) {
+    p->name = malloc(strlen(a->name)+1);
+    strcpy(p->name, a->name);
+  }
+  
+  switch (a->type) {
+    
+    case MPC_TYPE_FAIL:
+      p->data.fail.m = malloc(strlen(a->data.fail.m)+1);
+      strcpy(p->data.fail.m, a->data.fail.m);
+    break;
+    
+    case MPC_TYPE_ONEOF: 
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_STRING:
+      p->data.string.x = malloc(strlen(a->data.string.x)+1);
+      strcpy(p->data.string.x, a->data.string.x);
+      if (a->data.string.set) {
+        p->data.string.set = malloc(32);
+        memcpy(p->data.string.set, a->data.string.set, 32);
+      }
+      break;
+    
+    case MPC_TYPE_APPLY:    p->data.apply.x    = mpc_copy(a->data.apply.x);    break;
+    case MPC_TYPE_APPLY_TO: p->data.apply_to.x = mpc_copy(a->data.apply_to.x); break;
+    case MPC_TYPE_PREDICT:  p->data.predict.x  = mpc_copy(a->data.predict.x);  break;
+    case MPC_TYPE_MEMO:     p->data.memo.x     = mpc_copy(a->data.memo.x);     break;
+    
+    case MPC_TYPE_DFA:
+      p->data.dfa.x = mpc_copy(a->data.dfa.x);
+      p->data.dfa.trans = malloc(sizeof(int) * 256 * a->data.dfa.n);
+      p->data.dfa.accept = malloc(a->data.dfa.n);
+      memcpy(p->data.dfa.trans, a->data.dfa.trans, sizeof(int) * 256 * a->data.dfa.n);
+      memcpy(p->data.dfa.accept, a->data.dfa.accept, a->data.dfa.n);
+      break;
+    
+    case MPC_TYPE_SPAN:
+      p->data.span.x = mpc_copy(a->data.span.x);
+      p->data.span.set = malloc(32);
+      memcpy(p->data.span.set, a->data.span.set, 32);
+      break;
+    
+    case MPC_TYPE_CAPTURE:
+    case MPC_TYPE_SKIP:
+      p->data.capture.x = mpc_copy(a->data.capture.x);
+      break;
+    
+    case MPC_TYPE_TOKEN:
+      p->data.token.x = mpc_copy(a->data.token.x);
+      p->data.token.s->refs++;
+      break;
+    
+    case MPC_TYPE_MAYBE:
+    case MPC_TYPE_NOT:
+      p->data.not.x = mpc_copy(a->data.not.x);
+      p->data.not.lookahead = NULL;
+      break;
+    
+    case MPC_TYPE_EXPECT:
+      p->data.expect.x = mpc_copy(a->data.expect.x);
+      p->data.expect.m = malloc(strlen(a->data.expect.m)+1);
+      strcpy(p->data.expect.m, a->data.expect.m);
+      break;
+      
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      p->data.repeat.x = mpc_copy(a->data.repeat.x);
+      p->data.repeat.lookahead = NULL;
+      break;
+    
+    case MPC_TYPE_OR:
+      p->data.or.dispatch = NULL;
+      p->data.or.xs = malloc(a->data.or.n * sizeof(mpc_parser_t*));
+      for (i = 0; i < a->data.or.n; i++) {
+        p->data.or.xs[i] = mpc_copy(a->data.or.xs[i]);
+      }
+    break;
+    case MPC_TYPE_AND:
+      p->data.and.xs = malloc(a->data.and.n * sizeof(mpc_parser_t*));
+      for (i = 0; i < a->data.and.n; i++) {
+        p->data.and.xs[i] = mpc_copy(a->data.and.xs[i]);
+      }
+      p->data.and.dxs = malloc((a->data.and.n-1) * sizeof(mpc_dtor_t));
+      for (i = 0; i < a->data.and.n-1; i++) {
+        p->data.and.dxs[i] = a->data.and.dxs[i];
+      }
+    break;
+    
+    default: break;
+  }
+
+  
+  return p;
+}
+
+mpc_parser_t *mpc_undefine(mpc_parser_t *p) {
+  mpc_undefine_unretained(p, 1);
+  p->type = MPC_TYPE_UNDEFINED;
+  return p;
+}
+
+mpc_parser_t *mpc_define(mpc_parser_t *p, mpc_parser_t *a) {
+  
+  mpc_dispatch_invalidate(p);
+  
+  if (p->retained) {
+    p->type = a->type;
+    p->data = a->data;
+  } else {
+    mpc_parser_t *a2 = mpc_failf("Attempt to assign to Unretained Parser!");
+    p->type = a2->type;
+    p->data = a2->data;
+    mpc_parser_free(a2);
+  }
+  
+  mpc_parser_free(a);
+  return p;  
+}
+
+void mpc_cleanup(int n, ...) {
+  int i;
+  mpc_parser_t **list = malloc(sizeof(mpc_parser_t*) * n);
+  
+  va_list va;
+  va_start(va, n);
+  for (i = 0; i < n; i++) { list[i] = va_arg(va, mpc_parser_t*); }
+  for (i = 0; i < n; i++) { mpc_undefine(list[i]); }
+  for (i = 0; i < n; i++) { mpc_delete(list[i]); }  
+  va_end(va);  
+
+  free(list);
+}
+
+mpc_parser_t *mpc_pass(void) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_PASS;
+  return p;
+}
+
+mpc_parser_t *mpc_fail(const char *m) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_FAIL;
+  p->data.fail.m = malloc(strlen(m) + 1);
+  strcpy(p->data.fail.m, m);
+  return p;
+}
+
+/*
+** As `snprintf` is not ANSI standard this 
+** function `mpc_failf` should be considered
+** unsafe.
+**
+** You have a few options if this is going to be
+** trouble.
+**
+** - Ensure the format string does not exceed
+**   the buffer length using precision specifiers
+**   such as `%.512s`.
+**
+** - Patch this function in your code base to 
+**   use `snprintf` or whatever variant your
+**   system supports.
+**
+** - Avoid it altogether.
+**
+*/
+
+mpc_parser_t *mpc_failf(const char *fmt, ...) {
+  
+  va_list va;
+  char *buffer;
+
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_FAIL;
+  
+  va_start(va, fmt);
+  buffer = malloc(2048);
+  vsprintf(buffer, fmt, va);
+  va_end(va);
+  
+  buffer = realloc(buffer, strlen(buffer) + 1);
+  p->data.fail.m = buffer;
+  return p;
+
+}
+
+mpc_parser_t *mpc_lift_val(mpc_val_t *x) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_LIFT_VAL;
+  p->data.lift.x = x;
+  return p;
+}
+
+mpc_parser_t *mpc_lift(mpc_ctor_t lf) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_LIFT;
+  p->data.lift.lf = lf;
+  return p;
+}
+
+mpc_parser_t *mpc_anchor(int(*f)(char,char)) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_ANCHOR;
+  p->data.anchor.f = f;
+  return mpc_expect(p, "anchor");
+}
+
+mpc_parser_t *mpc_state(void) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_STATE;
+  return p;
+}
+
+mpc_parser_t *mpc_expect(mpc_parser_t *a, const char *expected) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_EXPECT;
+  p->data.expect.x = a;
+  p->data.expect.m = malloc(strlen(expected) + 1);
+  strcpy(p->data.expect.m, expected);
+  return p;
+}
+
+/*
+** As `snprintf` is not ANSI standard this 
+** function `mpc_expectf` should be considered
+** unsafe.
+**
+** You have a few options if this is going to be
+** trouble.
+**
+** - Ensure the format string does not exceed
+**   the buffer length using precision specifiers
+**   such as `%.512s`.
+**
+** - Patch this function in your code base to 
+**   use `snprintf` or whatever variant your
+**   system supports.
+**
+** - Avoid it altogether.
+**
+*/
+
+mpc_parser_t *mpc_expectf(mpc_parser_t *a, const char *fmt, ...) {
+  va_list va;
+  char *buffer;
+
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_EXPECT;
+  
+  va_start(va, fmt);
+  buffer = malloc(2048);
+  vsprintf(buffer, fmt, va);
+  va_end(va);
+  
+  buffer = realloc(buffer, strlen(buffer) + 1);
+  p->data.expect.x = a;
+  p->data.expect.m = buffer;
+  return p;
+}
+
+/*
+** Basic Parsers
+*/
+
+mpc_parser_t *mpc_any(void) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_ANY;
+  return mpc_expect(p, "any character");
+}
+
+mpc_parser_t *mpc_char(char c) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_SINGLE;
+  p->data.single.x = c;
+  return mpc_expectf(p, "'%c'", c);
+}
+
+mpc_parser_t *mpc_range(char s, char e) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_RANGE;
+  p->data.range.x = s;
+  p->data.range.y = e;
+  return mpc_expectf(p, "character between '%c' and '%c'", s, e);
+}
+
+/*
+** Character classes are tested against a 256 bit
+** set worked out when they are built rather than
+** searching the string of characters each time. As
+** with `strchr` the terminating nul is in the string.
+*/
+
+static unsigned char *mpc_class_set(const char *s, int none) {
+  int c;
+  unsigned char *set = calloc(1, 32);
+  for (c = 0; c < 256; c++) {
+    if ((strchr(s, (char)c) == 0) == none) { set[c / 8] |= 1 << (c % 8); }
+  }
+  return set;
+}
+
+mpc_parser_t *mpc_oneof(const char *s) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_ONEOF;
+  p->data.string.x = malloc(strlen(s) + 1);
+  strcpy(p->data.string.x, s);
+  p->data.string.set = mpc_class_set(s, 0);
+  return mpc_expectf(p, "one of '%s'", s);
+}
+
+mpc_parser_t *mpc_noneof(const char *s) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_NONEOF;
+  p->data.string.x = malloc(strlen(s) + 1);
+  strcpy(p->data.string.x, s);
+  p->data.string.set = mpc_class_set(s, 1);
+  return mpc_expectf(p, "none of '%s'", s);
+
+}
+
+mpc_parser_t *mpc_satisfy(int(*f)(char)) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_SATISFY;
+  p->data.satisfy.f = f;
+  return mpc_expectf(p, "character satisfying function %p", f);
+}
+
+mpc_parser_t *mpc_string(const char *s) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_STRING;
+  p->data.string.x = malloc(strlen(s) + 1);
+  strcpy(p->data.string.x, s);
+  return mpc_expectf(p, "\"%s\"", s);
+}
+
+/*
+** Core Parsers
+*/
+
+mpc_parser_t *mpc_apply(mpc_parser_t *a, mpc_apply_t f) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_APPLY;
+  p->data.apply.x = a;
+  p->data.apply.f = f;
+  return p;
+}
+
+mpc_parser_t *mpc_apply_to(mpc_parser_t *a, mpc_apply_to_t f, void *x) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_APPLY_TO;
+  p->data.apply_to.x = a;
+  p->data.apply_to.f = f;
+  p->data.apply_to.d = x;
+  return p;
+}
+
+mpc_parser_t *mpc_predictive(mpc_parser_t *a) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_PREDICT;
+  p->data.predict.x = a;
+  return p;
+}
+
+mpc_parser_t *mpc_not_lift(mpc_parser_t *a, mpc_dtor_t da, mpc_ctor_t lf) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_NOT;
+  p->data.not.x = a;
+  p->data.not.dx = da;
+  p->data.not.lf = lf;
+  return p;
+}
+
+mpc_parser_t *mpc_not(mpc_parser_t *a, mpc_dtor_t da) {
+  return mpc_not_lift(a, da, mpcf_ctor_null);
+}
+
+mpc_parser_t *mpc_maybe_lift(mpc_parser_t *a, mpc_ctor_t lf) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_MAYBE;
+  p->data.not.x = a;
+  p->data.not.lf = lf;
+  return p;
+}
+
+mpc_parser_t *mpc_maybe(mpc_parser_t *a) {
+  return mpc_maybe_lift(a, mpcf_ctor_null);
+}
+
+mpc_parser_t *mpc_many(mpc_fold_t f, mpc_parser_t *a) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_MANY;
+  p->data.repeat.x = a;
+  p->data.repeat.f = f;
+  return p;
+}
+
+mpc_parser_t *mpc_many1(mpc_fold_t f, mpc_parser_t *a) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_MANY1;
+  p->data.repeat.x = a;
+  p->data.repeat.f = f;
+  return p;
+}
+
+mpc_parser_t *mpc_count(int n, mpc_fold_t f, mpc_parser_t *a, mpc_dtor_t da) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_COUNT;
+  p->data.repeat.n = n;
+  p->data.repeat.f = f;
+  p->data.repeat.x = a;
+  p->data.repeat.dx = da;
+  return p;
+}
+
+mpc_parser_t *mpc_or(int n, ...) {
+
+  int i;
+  va_list va;
+
+  mpc_parser_t *p = mpc_undefined();
+  
+  p->type = MPC_TYPE_OR;
+  p->data.or.n = n;
+  p->data.or.xs = malloc(sizeof(mpc_parser_t*) * n);
+  
+  va_start(va, n);  
+  for (i = 0; i < n; i++) {
+    p->data.or.xs[i] = va_arg(va, mpc_parser_t*);
+  }
+  va_end(va);
+  
+  return p;
+}
+
+mpc_parser_t *mpc_and(int n, mpc_fold_t f, ...) {
+
+  int i;
+  va_list va;
+
+  mpc_parser_t *p = mpc_undefined();
+  
+  p->type = MPC_TYPE_AND;
+  p->data.and.n = n;
+  p->data.and.f = f;
+  p->data.and.xs = malloc(sizeof(mpc_parser_t*) * n);
+  p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (n-1));
+
+  va_start(va, f);  
+  for (i = 0; i < n; i++) {
+    p->data.and.xs[i] = va_arg(va, mpc_parser_t*);
+  }
+  for (i = 0; i < (n-1); i++) {
+    p->data.and.dxs[i] = va_arg(va, mpc_dtor_t);
+  }  
+  va_end(va);
+  
+  return p;
+}
+
+/*
+** Common Parsers
+*/
+
+static int mpc_soi_anchor(char prev, char next) { (void) next; return (prev == '\0'); }
+static int mpc_eoi_anchor(char prev, char next) { (void) prev; return (next == '\0'); }
+
+mpc_parser_t *mpc_soi(void) { return mpc_expect(mpc_anchor(mpc_soi_anchor), "start of input"); }
+mpc_parser_t *mpc_eoi(void) { return mpc_expect(mpc_anchor(mpc_eoi_anchor), "end of input"); }
+
+static int mpc_boundary_anchor(char prev, char next) {
+  const char* word = "abcdefghijklmnopqrstuvwxyz"
+                     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                     "0123456789_";
+  if ( strchr(word, next) &&  prev == '\0') { return 1; }
+  if ( strchr(word, prev) &&  next == '\0') { return 1; }
+  if ( strchr(word, next) && !strchr(word, prev)) { return 1; }
+  if (!strchr(word, next) &&  strchr(word, prev)) { return 1; }
+  return 0;
+}
+
+mpc_parser_t *mpc_boundary(void) { return mpc_expect(mpc_anchor(mpc_boundary_anchor), "boundary"); }
+
+mpc_parser_t *mpc_whitespace(void) { return mpc_expect(mpc_oneof(" \f\n\r\t\v"), "whitespace"); }
+mpc_parser_t *mpc_whitespaces(void) { return mpc_expect(mpc_many(mpcf_strfold, mpc_whitespace()), "spaces"); }
+mpc_parser_t *mpc_blank(void) { return mpc_expect(mpc_apply(mpc_whitespaces(), mpcf_free), "whitespace"); }
+
+mpc_parser_t *mpc_newline(void) { return mpc_expect(mpc_char('\n'), "newline"); }
+mpc_parser_t *mpc_tab(void) { return mpc_expect(mpc_char('\t'), "tab"); }
+mpc_parser_t *mpc_escape(void) { return mpc_and(2, mpcf_strfold, mpc_char('\\'), mpc_any(), free); }
+
+mpc_parser_t *mpc_digit(void) { return mpc_expect(mpc_oneof("0123456789"), "digit"); }
+mpc_parser_t *mpc_hexdigit(void) { return mpc_expect(mpc_oneof("0123456789ABCDEFabcdef"), "hex digit"); }
+mpc_parser_t *mpc_octdigit(void) { return mpc_expect(mpc_oneof("01234567"), "oct digit"); }
+mpc_parser_t *mpc_digits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_digit()), "digits"); }
+mpc_parser_t *mpc_hexdigits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_hexdigit()), "hex digits"); }
+mpc_parser_t *mpc_octdigits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_octdigit()), "oct digits"); }
+
+mpc_parser_t *mpc_lower(void) { return mpc_expect(mpc_oneof("abcdefghijklmnopqrstuvwxyz"), "lowercase letter"); }
+mpc_parser_t *mpc_upper(void) { return mpc_expect(mpc_oneof("ABCDEFGHIJKLMNOPQRSTUVWXYZ"), "uppercase letter"); }
+mpc_parser_t *mpc_alpha(void) { return mpc_expect(mpc_oneof("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"), "letter"); }
+mpc_parser_t *mpc_underscore(void) { return mpc_expect(mpc_char('_'), "underscore"); }
+mpc_parser_t *mpc_alphanum(void) { return mpc_expect(mpc_or(3, mpc_alpha(), mpc_digit(), mpc_underscore()), "alphanumeric"); }
+
+mpc_parser_t *mpc_int(void) { return mpc_expect(mpc_apply(mpc_digits(), mpcf_int), "integer"); }
+mpc_parser_t *mpc_hex(void) { return mpc_expect(mpc_apply(mpc_hexdigits(), mpcf_hex), "hexadecimal"); }
+mpc_parser_t *mpc_oct(void) { return mpc_expect(mpc_apply(mpc_octdigits(), mpcf_oct), "octadecimal"); }
+mpc_parser_t *mpc_number(void) { return mpc_expect(mpc_or(3, mpc_int(), mpc_hex(), mpc_oct()), "number"); }
+
+mpc_parser_t *mpc_real(void) {
+
+  /* [+-]?\d+(\.\d+)?([eE][+-]?[0-9]+)? */
+  
+  mpc_parser_t *p0, *p1, *p2, *p30, *p31, *p32, *p3;
+  
+  p0 = mpc_maybe_lift(mpc_oneof("+-"), mpcf_ctor_str);
+  p1 = mpc_digits();
+  p2 = mpc_maybe_lift(mpc_and(2, mpcf_strfold, mpc_char('.'), mpc_digits(), free), mpcf_ctor_str);
+  p30 = mpc_oneof("eE");
+  p31 = mpc_maybe_lift(mpc_oneof("+-"), mpcf_ctor_str);
+  p32 = mpc_digits();
+  p3 = mpc_maybe_lift(mpc_and(3, mpcf_strfold, p30, p31, p32, free, free), mpcf_ctor_str);
+  
+  return mpc_expect(mpc_and(4, mpcf_strfold, p0, p1, p2, p3, free, free, free), "real");
+
+}
+
+mpc_parser_t *mpc_float(void) {
+  return mpc_expect(mpc_apply(mpc_real(), mpcf_float), "float");
+}
+
+mpc_parser_t *mpc_char_lit(void) {
+  return mpc_expect(mpc_between(mpc_or(2, mpc_escape(), mpc_any()), free, "'", "'"), "char");
+}
+
+mpc_parser_t *mpc_string_lit(void) {
+  mpc_parser_t *strchar = mpc_or(2, mpc_escape(), mpc_noneof("\""));
+  return mpc_expect(mpc_between(mpc_many(mpcf_strfold, strchar), free, "\"", "\""), "string");
+}
+
+mpc_parser_t *mpc_regex_lit(void) {  
+  mpc_parser_t *regexchar = mpc_or(2, mpc_escape(), mpc_noneof("/"));
+  return mpc_expect(mpc_between(mpc_many(mpcf_strfold, regexchar), free, "/", "/"), "regex");
+}
+
+mpc_parser_t *mpc_ident(void) {
+  mpc_parser_t *p0, *p1; 
+  p0 = mpc_or(2, mpc_alpha(), mpc_underscore());
+  p1 = mpc_many(mpcf_strfold, mpc_alphanum()); 
+  return mpc_and(2, mpcf_strfold, p0, p1, free);
+}
+
+/*
+** Useful Parsers
+*/
+
+mpc_parser_t *mpc_startwith(mpc_parser_t *a) { return mpc_and(2, mpcf_snd, mpc_soi(), a, mpcf_dtor_null); }
+mpc_parser_t *mpc_endwith(mpc_parser_t *a, mpc_dtor_t da) { return mpc_and(2, mpcf_fst, a, mpc_eoi(), da); }
+mpc_parser_t *mpc_whole(mpc_parser_t *a, mpc_dtor_t da) { return mpc_and(3, mpcf_snd, mpc_soi(), a, mpc_eoi(), mpcf_dtor_null, da); }
+
+mpc_parser_t *mpc_stripl(mpc_parser_t *a) { return mpc_and(2, mpcf_snd, mpc_blank(), a, mpcf_dtor_null); }
+mpc_parser_t *mpc_stripr(mpc_parser_t *a) { return mpc_and(2, mpcf_fst, a, mpc_blank(), mpcf_dtor_null); }
+mpc_parser_t *mpc_strip(mpc_parser_t *a) { return mpc_and(3, mpcf_snd, mpc_blank(), a, mpc_blank(), mpcf_dtor_null, mpcf_dtor_null); }
+mpc_parser_t *mpc_tok(mpc_parser_t *a) { return mpc_and(2, mpcf_fst, a, mpc_blank(), mpcf_dtor_null); }
+mpc_parser_t *mpc_sym(const char *s) { return mpc_tok(mpc_string(s)); }
+
+mpc_parser_t *mpc_total(mpc_parser_t *a, mpc_dtor_t da) { return mpc_whole(mpc_strip(a), da); }
+
+mpc_parser_t *mpc_between(mpc_parser_t *a, mpc_dtor_t ad, const char *o, const char *c) {
+  return mpc_and(3, mpcf_snd_free,
+    mpc_string(o), a, mpc_string(c),
+    free, ad);
+}
+
+mpc_parser_t *mpc_parens(mpc_parser_t *a, mpc_dtor_t ad)   { return mpc_between(a, ad, "(", ")"); }
+mpc_parser_t *mpc_braces(mpc_parser_t *a, mpc_dtor_t ad)   { return mpc_between(a, ad, "<", ">"); }
+mpc_parser_t *mpc_brackets(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "{", "}"); }
+mpc_parser_t *mpc_squares(mpc_parser_t *a, mpc_dtor_t ad)  { return mpc_between(a, ad, "[", "]"); }
+
+mpc_parser_t *mpc_tok_between(mpc_parser_t *a, mpc_dtor_t ad, const char *o, const char *c) {
+  return mpc_and(3, mpcf_snd_free,
+    mpc_sym(o), mpc_tok(a), mpc_sym(c),
+    free, ad);
+}
+
+mpc_parser_t *mpc_tok_parens(mpc_parser_t *a, mpc_dtor_t ad)   { return mpc_tok_between(a, ad, "(", ")"); }
+mpc_parser_t *mpc_tok_braces(mpc_parser_t *a, mpc_dtor_t ad)   { return mpc_tok_between(a, ad, "<", ">"); }
+mpc_parser_t *mpc_tok_brackets(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "{", "}"); }
+mpc_parser_t *mpc_tok_squares(mpc_parser_t *a, mpc_dtor_t ad)  { return mpc_tok_between(a, ad, "[", "]"); }
+
+/*
+** Regular Expression Parsers
+*/
+
+/*
+** So here is a cute bootstrapping.
+**
+** I'm using the previously defined
+** mpc constructs and functions to
+** parse the user regex string and
+** construct a parser from it.
+**
+** As it turns out lots of the standard
+** mpc functions look a lot like `fold`
+** functions and so can be used indirectly
+** by many of the parsing functions to build
+** a parser directly - as we are parsing.
+**
+** This is certainly something that
+** would be less elegant/interesting 
+** in a two-phase parser which first
+** builds an AST and then traverses it
+** to generate the object.
+**
+** This whole thing acts as a great
+** case study for how trivial it can be
+** to write a great parser in a few
+** lines of code using mpc.
+*/
+
+/*
+**
+**  ### Regular Expression Grammar
+**
+**      <regex> : <term> | (<term> "|" <regex>)
+**     
+**      <term> : <factor>*
+**
+**      <factor> : <base>
+**               | <base> "*"
+**               | <base> "+"
+**               | <base> "?"
+**               | <base> "{" <digits> "}"
+**           
+**      <base> : <char>
+**             | "\" <char>
+**             | "(" <regex> ")"
+**             | "[" <range> "]"
+*/
+
+static mpc_val_t *mpcf_re_or(int n, mpc_val_t **xs) {
+  (void) n;
+  if (xs[1] == NULL) { return xs[0]; }
+  else { return mpc_or(2, xs[0], xs[1]); }
+}
+
+static mpc_val_t *mpcf_re_and(int n, mpc_val_t **xs) {
+  int i;
+  mpc_parser_t *p = mpc_lift(mpcf_ctor_str);
+  for (i = 0; i < n; i++) {
+    p = mpc_and(2, mpcf_strfold, p, xs[i], free);
+  }
+  return p;
+}
+
+static mpc_val_t *mpcf_re_repeat(int n, mpc_val_t **xs) {
+  int num;
+  (void) n;
+  if (xs[1] == NULL) { return xs[0]; }
+  if (strcmp(xs[1], "*") == 0) { free(xs[1]); return mpc_many(mpcf_strfold, xs[0]); }
+  if (strcmp(xs[1], "+") == 0) { free(xs[1]); return mpc_many1(mpcf_strfold, xs[0]); }
+  if (strcmp(xs[1], "?") == 0) { free(xs[1]); return mpc_maybe_lift(xs[0], mpcf_ctor_str); }
+  num = *(int*)xs[1];
+  free(xs[1]);
+  
+  return mpc_count(num, mpcf_strfold, xs[0], free);
+}
+
+static mpc_parser_t *mpc_re_escape_char(char c) {
+  switch (c) {
+    case 'a': return mpc_char('\a');
+    case 'f': return mpc_char('\f');
+    case 'n': return mpc_char('\n');
+    case 'r': return mpc_char('\r');
+    case 't': return mpc_char('\t');
+    case 'v': return mpc_char('\v');
+    case 'b': return mpc_and(2, mpcf_snd, mpc_boundary(), mpc_lift(mpcf_ctor_str), free);
+    case 'B': return mpc_not_lift(mpc_boundary(), free, mpcf_ctor_str);
+    case 'A': return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
+    case 'Z': return mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free);
+    case 'd': return mpc_digit();
+    case 'D': return mpc_not_lift(mpc_digit(), free, mpcf_ctor_str);
+    case 's': return mpc_whitespace();
+    case 'S': return mpc_not_lift(mpc_whitespace(), free, mpcf_ctor_str);
+    case 'w': return mpc_alphanum();
+    case 'W': return mpc_not_lift(mpc_alphanum(), free, mpcf_ctor_str);
+    default: return NULL;
+  }
+}
+
+static mpc_val_t *mpcf_re_escape(mpc_val_t *x) {
+  
+  char *s = x;
+  mpc_parser_t *p;
+  
+  /* Regex Special Characters */
+  if (s[0] == '.') { free(s); return mpc_any(); }
+  if (s[0] == '^') { free(s); return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free); }
+  if (s[0] == '$') { free(s); return mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free); }
+  
+  /* Regex Escape */
+  if (s[0] == '\\') {
+    p = mpc_re_escape_char(s[1]);
+    p = (p == NULL) ? mpc_char(s[1]) : p;
+    free(s);
+    return p;
+  }
+  
+  /* Regex Standard */
+  p = mpc_char(s[0]);
+  free(s);
+  return p;
+}
+
+static const char *mpc_re_range_escape_char(char c) {
+  switch (c) {
+    case '-': return "-";
+    case 'a': return "\a";
+    case 'f': return "\f";
+    case 'n': return "\n";
+    case 'r': return "\r";
+    case 't': return "\t";
+    case 'v': return "\v";
+    case 'b': return "\b";
+    case 'd': return "0123456789";
+    case 's': return " \f\n\r\t\v";
+    case 'w': return "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+    default: return NULL;
+  }
+}
+
+static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
+  
+  mpc_parser_t *out;
+  size_t i, j;
+  size_t start, end;
+  const char *tmp = NULL;
+  const char *s = x;
+  int comp = s[0] == '^' ? 1 : 0;
+  char *range = calloc(1,1);
+  
+  if (s[0] == '\0') { free(x); return mpc_fail("Invalid Regex Range Expression"); } 
+  if (s[0] == '^' && 
+      s[1] == '\0') { free(x); return mpc_fail("Invalid Regex Range Expression"); }
+  
+  for (i = comp; i < strlen(s); i++){
+    
+    /* Regex Range Escape */
+    if (s[i] == '\\') {
+      tmp = mpc_re_range_escape_char(s[i+1]);
+      if (tmp != NULL) {
+        range = realloc(range, strlen(range) + strlen(tmp) + 1);
+        strcat(range, tmp);
+      } else {
+        range = realloc(range, strlen(range) + 1 + 1);
+        range[strlen(range) + 1] = '\0';
+        range[strlen(range) + 0] = s[i+1];      
+      }
+      i++;
+    }
+    
+    /* Regex Range...Range */
+    else if (s[i] == '-') {
+      if (s[i+1] == '\0' || i == 0) {
+          range = realloc(range, strlen(range) + strlen("-") + 1);
+          strcat(range, "-");
+      } else {
+        start = s[i-1]+1;
+        end = s[i+1]-1;
+        for (j = start; j <= end; j++) {
+          range = realloc(range, strlen(range) + 1 + 1 + 1);
+          range[strlen(range) + 1] = '\0';
+          range[strlen(range) + 0] = (char)j;
+        }        
+      }
+    }
+    
+    /* Regex Range Normal */
+    else {
+      range = realloc(range, strlen(range) + 1 + 1);
+      range[strlen(range) + 1] = '\0';
+      range[strlen(range) + 0] = s[i];
+    }
+  
+  }
+  
+  out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
+  
+  free(x);
+  free(range);
+  
+  return out;
+}
+
+/*
+** Regex Automata
+**
+** The parser built from a regex backtracks through
+** it one character at a time. Where the regex allows
+** it that parser is also turned into a DFA which can
+** match the same text in a single table driven loop.
+**
+** The combinators are a PEG, so `*`, `+` and `?` are
+** greedy and `|` takes the first alternative which
+** matches, while a DFA finds the longest match. The
+** two agree when every choice can be decided by the
+** next character: the alternatives of an `|` start
+** differently and only the last may match nothing,
+** and a repeated or optional part can neither match
+** nothing nor start with anything that may follow
+** it. Other regexes, and those using anchors or
+** negated classes, are left as they are.
+**
+** The DFA is found from the positions of the regex,
+** one for each character class in it, by following
+** which position may come after which. The original
+** parser is kept with it and is run instead for
+** anything other than String input, and wherever the
+** DFA failed no earlier than the farthest failure,
+** to say what was expected there.
+*/
+
+enum {
+  MPC_RE_POSITIONS = 256,
+  MPC_RE_STATES = 128,
+  MPC_RE_SCANNER_STATES = 4096
+};
+
+enum {
+  MPC_RE_EMPTY,
+  MPC_RE_SET,
+  MPC_RE_CAT,
+  MPC_RE_ALT,
+  MPC_RE_OPT,
+  MPC_RE_STAR
+};
+
+typedef struct {
+  int type;
+  int x;
+  int y;
+  char nullable;
+  unsigned char first[32];
+  unsigned char follow[32];
+  unsigned char firsts[MPC_RE_POSITIONS / 8];
+  unsigned char lasts[MPC_RE_POSITIONS / 8];
+} mpc_re_node_t;
+
+typedef struct mpc_re_dfa_t {
+  mpc_re_node_t *nodes;
+  int num;
+  int slots;
+  unsigned char sets[MPC_RE_POSITIONS][32];
+  unsigned char follows[MPC_RE_POSITIONS][MPC_RE_POSITIONS / 8];
+  int positions;
+} mpc_re_dfa_t;
+
+static int mpc_first_char(mpc_parser_t *p, char c);
+
+static int mpc_re_has(const unsigned char *set, int j) {
+  return set[j / 8] & (1 << (j % 8));
+}
+
+static int mpc_re_meets(const unsigned char *x, const unsigned char *y, int n) {
+  int j;
+  for (j = 0; j < n; j++) { if (x[j] & y[j]) { return 1; } }
+  return 0;
+}
+
+static int mpc_re_none(const unsigned char *x, int n) {
+  int j;
+  for (j = 0; j < n; j++) { if (x[j]) { return 0; } }
+  return 1;
+}
+
+static void mpc_re_union(unsigned char *x, const unsigned char *y, int n) {
+  int j;
+  for (j = 0; j < n; j++) { x[j] |= y[j]; }
+}
+
+static unsigned long mpc_re_hash(const unsigned char *x, int n) {
+  int j;
+  unsigned long h = 2166136261UL;
+  for (j = 0; j < n; j++) { h = (h ^ x[j]) * 16777619UL; }
+  return h;
+}
+
+static int mpc_re_node(mpc_re_dfa_t *d, int type, int x, int y) {
+  
+  mpc_re_node_t *n, *a, *b;
+  
+  if (d->num == d->slots) {
+    d->slots = d->slots ? d->slots * 2 : 16;
+    d->nodes = realloc(d->nodes, sizeof(mpc_re_node_t) * d->slots);
+  }
+  
+  n = &d->nodes[d->num];
+  memset(n, 0, sizeof(mpc_re_node_t));
+  n->type = type;
+  n->x = x;
+  n->y = y;
+  
+  a = x >= 0 ? &d->nodes[x] : NULL;
+  b = y >= 0 ? &d->nodes[y] : NULL;
+  
+  switch (type) {
+    case MPC_RE_EMPTY:
+      n->nullable = 1;
+      break;
+    case MPC_RE_CAT:
+      n->nullable = a->nullable && b->nullable;
+      memcpy(n->first, a->first, 32);
+      memcpy(n->firsts, a->firsts, sizeof(n->firsts));
+      if (a->nullable) {
+        mpc_re_union(n->first, b->first, 32);
+        mpc_re_union(n->firsts, b->firsts, sizeof(n->firsts));
+      }
+      memcpy(n->lasts, b->lasts, sizeof(n->lasts));
+      if (b->nullable) { mpc_re_union(n->lasts, a->lasts, sizeof(n->lasts)); }
+      break;
+    case MPC_RE_ALT:
+      n->nullable = a->nullable || b->nullable;
+      memcpy(n->first, a->first, 32);
+      mpc_re_union(n->first, b->first, 32);
+      memcpy(n->firsts, a->firsts, sizeof(n->firsts));
+      mpc_re_union(n->firsts, b->firsts, sizeof(n->firsts));
+      memcpy(n->lasts, a->lasts, sizeof(n->lasts));
+      mpc_re_union(n->lasts, b->lasts, sizeof(n->lasts));
+      break;
+    case MPC_RE_OPT:
+    case MPC_RE_STAR:
+      n->nullable = 1;
+      memcpy(n->first, a->first, 32);
+      memcpy(n->firsts, a->firsts, sizeof(n->firsts));
+      memcpy(n->lasts, a->lasts, sizeof(n->lasts));
+      break;
+  }
+  
+  return d->num++;
+}
+
+static int mpc_re_position(mpc_re_dfa_t *d, const unsigned char *set) {
+  
+  int j, k;
+  
+  if (d->positions == MPC_RE_POSITIONS) { return -1; }
+  
+  j = d->positions++;
+  memcpy(d->sets[j], set, 32);
+  
+  k = mpc_re_node(d, MPC_RE_SET, -1, -1);
+  memcpy(d->nodes[k].first, set, 32);
+  d->nodes[k].firsts[j / 8] |= 1 << (j % 8);
+  d->nodes[k].lasts[j / 8] |= 1 << (j % 8);
+  return k;
+}
+
+static int mpc_re_set(mpc_re_dfa_t *d, mpc_parser_t *p) {
+  
+  int c;
+  unsigned char set[32];
+  
+  /* Nul is left out and handed back to the regex itself */
+  memset(set, 0, 32);
+  for (c = 1; c < 256; c++) {
+    if (p->type == MPC_TYPE_ANY || mpc_first_char(p, (char)c)) {
+      set[c / 8] |= 1 << (c % 8);
+    }
+  }
+  
+  return mpc_re_position(d, set);
+}
+
+static int mpc_re_string(mpc_re_dfa_t *d, const char *s, size_t n) {
+  
+  int x, y;
+  unsigned char set[32];
+  
+  x = mpc_re_node(d, MPC_RE_EMPTY, -1, -1);
+  for (; n > 0; s++, n--) {
+    memset(set, 0, 32);
+    set[(unsigned char)*s / 8] |= 1 << ((unsigned char)*s % 8);
+    if ((y = mpc_re_position(d, set)) < 0) { return -1; }
+    x = mpc_re_node(d, MPC_RE_CAT, x, y);
+  }
+  return x;
+}
+
+/*
+** A `count` which fails part way through doesn't go
+** back to where it started, so unless an `and` around
+** it does that the position it leaves matters and it
+** can't be part of a DFA.
+*/
+
+static int mpc_re_build(mpc_re_dfa_t *d, mpc_parser_t *p, int guarded) {
+  
+  int j, x, y;
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_EXPECT: return mpc_re_build(d, p->data.expect.x, guarded);
+    case MPC_TYPE_SPAN:   return mpc_re_build(d, p->data.span.x, guarded);
+    case MPC_TYPE_CAPTURE: return mpc_re_build(d, p->data.capture.x, guarded);
+    case MPC_TYPE_DFA:    return mpc_re_build(d, p->data.dfa.x, guarded);
+    
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      return mpc_re_set(d, p);
+    
+    case MPC_TYPE_LIFT:
+      if (p->data.lift.lf != mpcf_ctor_str) { return -1; }
+      return mpc_re_node(d, MPC_RE_EMPTY, -1, -1);
+    
+    case MPC_TYPE_AND:
+      if (p->data.and.f != mpcf_strfold) { return -1; }
+      x = mpc_re_node(d, MPC_RE_EMPTY, -1, -1);
+      for (j = 0; j < p->data.and.n; j++) {
+        if ((y = mpc_re_build(d, p->data.and.xs[j], 1)) < 0) { return -1; }
+        x = mpc_re_node(d, MPC_RE_CAT, x, y);
+      }
+      return x;
+    
+    case MPC_TYPE_OR:
+      if (p->data.or.n == 0) { return -1; }
+      if ((y = mpc_re_build(d, p->data.or.xs[p->data.or.n-1], 0)) < 0) { return -1; }
+      for (j = p->data.or.n-2; j >= 0; j--) {
+        if ((x = mpc_re_build(d, p->data.or.xs[j], 0)) < 0) { return -1; }
+        y = mpc_re_node(d, MPC_RE_ALT, x, y);
+      }
+      return y;
+    
+    case MPC_TYPE_MAYBE:
+      if (p->data.not.lf != mpcf_ctor_str) { return -1; }
+      if ((x = mpc_re_build(d, p->data.not.x, 0)) < 0) { return -1; }
+      return mpc_re_node(d, MPC_RE_OPT, x, -1);
+    
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+      if (p->data.repeat.f != mpcf_strfold) { return -1; }
+      if ((x = mpc_re_build(d, p->data.repeat.x, 0)) < 0) { return -1; }
+      x = mpc_re_node(d, MPC_RE_STAR, x, -1);
+      if (p->type == MPC_TYPE_MANY) { return x; }
+      if ((y = mpc_re_build(d, p->data.repeat.x, 0)) < 0) { return -1; }
+      return mpc_re_node(d, MPC_RE_CAT, y, x);
+    
+    case MPC_TYPE_COUNT:
+      if (p->data.repeat.f != mpcf_strfold) { return -1; }
+      if (p->data.repeat.n > 1 && !guarded) { return -1; }
+      x = mpc_re_node(d, MPC_RE_EMPTY, -1, -1);
+      for (j = 0; j < p->data.repeat.n; j++) {
+        if ((y = mpc_re_build(d, p->data.repeat.x, 0)) < 0) { return -1; }
+        x = mpc_re_node(d, MPC_RE_CAT, x, y);
+      }
+      return x;
+    
+    default: return -1;
+  }
+  
+}
+
+/*
+** Children always come before their parents, so going
+** backwards gives each node what may follow it before
+** its children are visited. This is also where the
+** choices are checked. Only the nodes from `from` on
+** are looked at, so that regexes built one after the
+** other into the same positions can be checked alone.
+*/
+
+static int mpc_re_check(mpc_re_dfa_t *d, int from) {
+  
+  int k, j;
+  mpc_re_node_t *n, *a, *b;
+  
+  for (k = d->num-1; k >= from; k--) {
+    
+    n = &d->nodes[k];
+    a = n->x >= 0 ? &d->nodes[n->x] : NULL;
+    b = n->y >= 0 ? &d->nodes[n->y] : NULL;
+    
+    switch (n->type) {
+      
+      case MPC_RE_CAT:
+        memcpy(b->follow, n->follow, 32);
+        memcpy(a->follow, b->first, 32);
+        if (b->nullable) { mpc_re_union(a->follow, n->follow, 32); }
+        for (j = 0; j < d->positions; j++) {
+          if (mpc_re_has(a->lasts, j)) { mpc_re_union(d->follows[j], b->firsts, sizeof(b->firsts)); }
+        }
+        break;
+      
+      case MPC_RE_ALT:
+        if (a->nullable || mpc_re_meets(a->first, b->first, 32)) { return 0; }
+        if (b->nullable && mpc_re_meets(a->first, n->follow, 32)) { return 0; }
+        memcpy(a->follow, n->follow, 32);
+        memcpy(b->follow, n->follow, 32);
+        break;
+      
+      case MPC_RE_OPT:
+      case MPC_RE_STAR:
+        if (a->nullable || mpc_re_meets(a->first, n->follow, 32)) { return 0; }
+        memcpy(a->follow, n->follow, 32);
+        if (n->type == MPC_RE_OPT) { break; }
+        mpc_re_union(a->follow, a->first, 32);
+        for (j = 0; j < d->positions; j++) {
+          if (mpc_re_has(a->lasts, j)) { mpc_re_union(d->follows[j], a->firsts, sizeof(a->firsts)); }
+        }
+        break;
+    }
+  }
+  
+  return 1;
+}
+
+/*
+** Each state of a DFA is a set of positions which the
+** input so far may have ended on. The start state is
+** the only one before any position, so the empty set
+** stands for it and `firsts` are what come after it.
+** Several regexes can be matched at once by giving
+** their roots, and for each state `ends` has a row of
+** bits saying which of them it is the end of. Returns
+** the number of states, or zero if there were more
+** than `max`.
+*/
+
+static int mpc_re_states(mpc_re_dfa_t *d, const unsigned char *firsts, const int *roots, int roots_num,
+  int max, int **trans_out, unsigned char **ends_out) {
+  
+  int w = d->positions > 0 ? (d->positions + 7) / 8 : 1, v = (roots_num + 7) / 8;
+  int num = 1, slots = 16, index_slots = 64;
+  int k, j, c, q, h;
+  unsigned char *states, *ends, *masks, *follow, *next;
+  int *trans, *index;
+  
+  /* The positions each character can move on to */
+  masks = calloc(256, w);
+  for (j = 0; j < d->positions; j++) {
+    for (c = 0; c < 256; c++) {
+      if (mpc_re_has(d->sets[j], c)) { masks[c * w + j / 8] |= 1 << (j % 8); }
+    }
+  }
+  
+  states = calloc(slots, w);
+  ends = calloc(slots, v);
+  trans = malloc(sizeof(int) * 256 * slots);
+  index = calloc(index_slots, sizeof(int));
+  follow = malloc(w);
+  next = malloc(w);
+  
+  for (k = 0; k < num; k++) {
+    
+    if (k == 0) {
+      memcpy(follow, firsts, w);
+    } else {
+      memset(follow, 0, w);
+      for (j = 0; j < d->positions; j++) {
+        if (mpc_re_has(states + k * w, j)) { mpc_re_union(follow, d->follows[j], w); }
+      }
+    }
+    
+    for (c = 0; c < 256; c++) {
+      
+      for (j = 0; j < w; j++) { next[j] = follow[j] & masks[c * w + j]; }
+      
+      if (mpc_re_none(next, w)) {
+        trans[k * 256 + c] = -1;
+        continue;
+      }
+      
+      h = (int)(mpc_re_hash(next, w) & (unsigned long)(index_slots - 1));
+      while (index[h] && memcmp(states + index[h] * w, next, w) != 0) {
+        h = (h + 1) & (index_slots - 1);
+      }
+      
+      if (index[h]) {
+        trans[k * 256 + c] = index[h];
+        continue;
+      }
+      
+      if (num == max) {
+        free(masks); free(states); free(ends); free(trans); free(index); free(follow); free(next);
+        return 0;
+      }
+      
+      if (num == slots) {
+        slots *= 2;
+        states = realloc(states, (size_t)slots * w);
+        ends = realloc(ends, (size_t)slots * v);
+        trans = realloc(trans, sizeof(int) * 256 * slots);
+      }
+      
+      memcpy(states + num * w, next, w);
+      memset(ends + num * v, 0, v);
+      for (j = 0; j < roots_num; j++) {
+        if (mpc_re_meets(next, d->nodes[roots[j]].lasts, w)) { ends[num * v + j / 8] |= 1 << (j % 8); }
+      }
+      
+      trans[k * 256 + c] = num;
+      index[h] = num++;
+      
+      if (num * 2 > index_slots) {
+        free(index);
+        index_slots *= 2;
+        index = calloc(index_slots, sizeof(int));
+        for (q = 1; q < num; q++) {
+          h = (int)(mpc_re_hash(states + q * w, w) & (unsigned long)(index_slots - 1));
+          while (index[h]) { h = (h + 1) & (index_slots - 1); }
+          index[h] = q;
+        }
+      }
+    }
+  }
+  
+  free(masks); free(states); free(index); free(follow); free(next);
+  *trans_out = realloc(trans, sizeof(int) * 256 * num);
+  *ends_out = realloc(ends, (size_t)num * v);
+  return num;
+}
+
+static mpc_parser_t *mpc_re_dfa(mpc_parser_t *x) {
+  
+  int root, num, k;
+  int *trans;
+  unsigned char *ends;
+  char *accept;
+  mpc_re_dfa_t d;
+  mpc_parser_t *p;
+  
+  memset(&d, 0, sizeof(mpc_re_dfa_t));
+  root = mpc_re_build(&d, x, 0);
+  
+  if (root < 0 || !mpc_re_check(&d, 0)) {
+    free(d.nodes);
+    return x;
+  }
+  
+  num = mpc_re_states(&d, d.nodes[root].firsts, &root, 1, MPC_RE_STATES, &trans, &ends);
+  if (num == 0) {
+    free(d.nodes);
+    return x;
+  }
+  
+  accept = malloc(num);
+  for (k = 0; k < num; k++) { accept[k] = ends[k] & 1; }
+  accept[0] = d.nodes[root].nullable;
+  
+  p = mpc_undefined();
+  p->type = MPC_TYPE_DFA;
+  p->data.dfa.x = x;
+  p->data.dfa.n = num;
+  p->data.dfa.trans = trans;
+  p->data.dfa.accept = accept;
+  
+  free(ends);
+  free(d.nodes);
+  mpc_optimise_note(MPC_OPTIMISE_DFA, 1);
+  return p;
+}
+
+mpc_parser_t *mpc_re_with(const char *re, int passes) {
+  
+  char *err_msg;
+  mpc_parser_t *err_out;
+  mpc_result_t r;
+  mpc_parser_t *Regex, *Term, *Factor, *Base, *Range, *RegexEnclose; 
+  
+  Regex  = mpc_new("regex");
+  Term   = mpc_new("term");
+  Factor = mpc_new("factor");
+  Base   = mpc_new("base");
+  Range  = mpc_new("range");
+  
+  mpc_define(Regex, mpc_and(2, mpcf_re_or,
+    Term, 
+    mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_char('|'), Regex, free)),
+    (mpc_dtor_t)mpc_delete
+  ));
+  
+  mpc_define(Term, mpc_many(mpcf_re_and, Factor));
+  
+  mpc_define(Factor, mpc_and(2, mpcf_re_repeat,
+    Base,
+    mpc_or(5,
+      mpc_char('*'), mpc_char('+'), mpc_char('?'),
+      mpc_brackets(mpc_int(), free),
+      mpc_pass()),
+    (mpc_dtor_t)mpc_delete
+  ));
+  
+  mpc_define(Base, mpc_or(4,
+    mpc_parens(Regex, (mpc_dtor_t)mpc_delete),
+    mpc_squares(Range, (mpc_dtor_t)mpc_delete),
+    mpc_apply(mpc_escape(), mpcf_re_escape),
+    mpc_apply(mpc_noneof(")|"), mpcf_re_escape)
+  ));
+  
+  mpc_define(Range, mpc_apply(
+    mpc_many(mpcf_strfold, mpc_or(2, mpc_escape(), mpc_noneof("]"))),
+    mpcf_re_range
+  ));
+  
+  RegexEnclose = mpc_whole(mpc_predictive(Regex), (mpc_dtor_t)mpc_delete);
+  
+  mpc_optimise(RegexEnclose);
+  mpc_optimise(Regex);
+  mpc_optimise(Term);
+  mpc_optimise(Factor);
+  mpc_optimise(Base);
+  mpc_optimise(Range);
+  
+  if(!mpc_parse("<mpc_re_compiler>", re, RegexEnclose, &r)) {
+    err_msg = mpc_err_string(r.error);
+    err_out = mpc_failf("Invalid Regex: %s", err_msg);
+    mpc_err_delete(r.error);  
+    free(err_msg);
+    r.output = err_out;
+  }
+  
+  mpc_cleanup(6, RegexEnclose, Regex, Term, Factor, Base, Range);
+  
+  mpc_optimise_with(r.output, passes);
+  
+  return (passes & MPC_OPTIMISE_DFA) ? mpc_re_dfa(r.output) : r.output;
+  
+}
+
+mpc_parser_t *mpc_re(const char *re) {
+  return mpc_re_with(re, MPC_OPTIMISE_ALL);
+}
+
+/*
+** Scanners
+**
+** A language read with `MPCA_LANG_TOKENS` adds its
+** terminals to a scanner as it goes. Every string or
+** char literal, and every regex which can be a DFA
+** and never matches nothing, becomes a kind of token,
+** and once the whole language is read they are made
+** into one DFA which finds the longest token at each
+** position. A terminal is then matched by looking at
+** the kind of the token scanned where it starts, so
+** each is only scanned once however often the parser
+** comes back to it.
+**
+** Where no token was scanned, and for other than
+** String inputs, the terminal's own parser is run
+** instead. So it is where a token of another kind
+** stopped the scanner no earlier than the farthest
+** failure, to find what it expected there.
+*/
+
+static mpc_scanner_t *mpc_scanner_new(int skip) {
+  mpc_scanner_t *s = calloc(1, sizeof(mpc_scanner_t));
+  s->refs = 1;
+  s->skip = skip;
+  s->re = calloc(1, sizeof(mpc_re_dfa_t));
+  return s;
+}
+
+static void mpc_scanner_delete(mpc_scanner_t *s) {
+  
+  int j;
+  
+  if (s == NULL || --s->refs > 0) { return; }
+  
+  for (j = 0; j < s->kinds_num; j++) { free(s->kinds[j]); }
+  free(s->kinds);
+  free(s->roots);
+  if (s->re) { free(s->re->nodes); }
+  free(s->re);
+  free(s->trans);
+  free(s->accept);
+  free(s->ends);
+  free(s);
+}
+
+/*
+** Kinds are told apart by their text, the literal or
+** the regex between its quotes or slashes, so that a
+** terminal used many times is only added once, and it
+** is also what a terminal which matches only part of
+** a longer token is reported to have expected. The
+** regex is built from its parser `re`, and if it
+** can't be a token it is taken back out again.
+*/
+
+static int mpc_scanner_kind(mpc_scanner_t *s, const char *kind, mpc_parser_t *re) {
+  
+  int j, root, num, positions;
+  mpc_re_dfa_t *d = s->re;
+  
+  for (j = 0; j < s->kinds_num; j++) {
+    if (strcmp(s->kinds[j], kind) == 0) { return j; }
+  }
+  
+  if (d == NULL) { return -1; }
+  
+  num = d->num;
+  positions = d->positions;
+  root = re ? mpc_re_build(d, re, 0) : mpc_re_string(d, kind + 1, strlen(kind) - 2);
+  
+  if (root < 0 || d->nodes[root].nullable || !mpc_re_check(d, num)) {
+    memset(d->sets[positions], 0, sizeof(d->sets[0]) * (d->positions - positions));
+    memset(d->follows[positions], 0, sizeof(d->follows[0]) * (d->positions - positions));
+    d->positions = positions;
+    d->num = num;
+    return -1;
+  }
+  
+  s->kinds = realloc(s->kinds, sizeof(char*) * (s->kinds_num + 1));
+  s->roots = realloc(s->roots, sizeof(int) * (s->kinds_num + 1));
+  s->kinds[s->kinds_num] = malloc(strlen(kind) + 1);
+  strcpy(s->kinds[s->kinds_num], kind);
+  s->roots[s->kinds_num] = root;
+  return s->kinds_num++;
+}
+
+static mpc_parser_t *mpc_scanner_token(mpc_scanner_t *s, const char *kind, mpc_parser_t *re, mpc_parser_t *x) {
+  
+  int k = mpc_scanner_kind(s, kind, re);
+  mpc_parser_t *p;
+  
+  if (k < 0) { return x; }
+  
+  p = mpc_undefined();
+  p->type = MPC_TYPE_TOKEN;
+  p->data.token.x = x;
+  p->data.token.s = s;
+  p->data.token.kind = k;
+  s->refs++;
+  return p;
+}
+
+/* If there are too many states the tokens are never used */
+static void mpc_scanner_build(mpc_scanner_t *s) {
+  
+  int j, k, num = 0;
+  unsigned char firsts[MPC_RE_POSITIONS / 8];
+  mpc_re_dfa_t *d = s->re;
+  
+  if (d == NULL) { return; }
+  
+  memset(firsts, 0, sizeof(firsts));
+  for (j = 0; j < s->kinds_num; j++) {
+    mpc_re_union(firsts, d->nodes[s->roots[j]].firsts, sizeof(firsts));
+  }
+  
+  if (s->kinds_num > 0) {
+    num = mpc_re_states(d, firsts, s->roots, s->kinds_num, MPC_RE_SCANNER_STATES, &s->trans, &s->ends);
+  }
+  
+  if (num > 0) {
+    s->states = num;
+    s->width = (s->kinds_num + 7) / 8;
+    s->accept = malloc(num);
+    for (k = 0; k < num; k++) { s->accept[k] = !mpc_re_none(s->ends + k * s->width, s->width); }
+  }
+  
+  free(d->nodes);
+  free(d);
+  s->re = NULL;
+}
+
+/*
+** Common Fold Functions
+*/
+
+void mpcf_dtor_null(mpc_val_t *x) { (void) x; return; }
+
+mpc_val_t *mpcf_ctor_null(void) { return NULL; }
+mpc_val_t *mpcf_ctor_str(void) { return calloc(1, 1); }
+mpc_val_t *mpcf_free(mpc_val_t *x) { free(x); return NULL; }
+
+mpc_val_t *mpcf_int(mpc_val_t *x) {
+  int *y = malloc(sizeof(int));
+  *y = strtol(x, NULL, 10);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_hex(mpc_val_t *x) {
+  int *y = malloc(sizeof(int));
+  *y = strtol(x, NULL, 16);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_oct(mpc_val_t *x) {
+  int *y = malloc(sizeof(int));
+  *y = strtol(x, NULL, 8);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_float(mpc_val_t *x) {
+  float *y = malloc(sizeof(float));
+  *y = strtod(x, NULL);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_strtriml(mpc_val_t *x) {
+  char *s = x;
+  while (isspace(*s)) {
+    memmove(s, s+1, strlen(s));
+  }
+  return s;
+}
+
+mpc_val_t *mpcf_strtrimr(mpc_val_t *x) {
+  char *s = x;
+  size_t l = strlen(s);
+  while (isspace(s[l-1])) {
+    s[l-1] = '\0'; l--;
+  }
+  return s;
+}
+
+mpc_val_t *mpcf_strtrim(mpc_val_t *x) {
+  return mpcf_strtriml(mpcf_strtrimr(x));
+}
+
+static const char mpc_escape_input_c[]  = {
+  '\a', '\b', '\f', '\n', '\r',
+  '\t', '\v', '\\', '\'', '\"', '\0'};
+    
+static const char *mpc_escape_output_c[] = {
+  "\\a", "\\b", "\\f", "\\n", "\\r", "\\t", 
+  "\\v", "\\\\", "\\'", "\\\"", "\\0", NULL};
+
+static const char mpc_escape_input_raw_re[] = { '/' };
+static const char *mpc_escape_output_raw_re[] = { "\\/", NULL };
+
+static const char mpc_escape_input_raw_cstr[] = { '"' };
+static const char *mpc_escape_output_raw_cstr[] = { "\\\"", NULL };
+
+static const char mpc_escape_input_raw_cchar[] = { '\'' };
+static const char *mpc_escape_output_raw_cchar[] = { "\\'", NULL };
+
+static mpc_val_t *mpcf_escape_new(mpc_val_t *x, const char *input, const char **output) {
+  
+  int i;
+  int found;
+  char buff[2];
+  char *s = x;
+  char *y = calloc(1, 1);
+  
+  while (*s) {
+    
+    i = 0;
+    found = 0;
+
+    while (output[i]) {
+      if (*s == input[i]) {
+        y = realloc(y, strlen(y) + strlen(output[i]) + 1);
+        strcat(y, output[i]);
+        found = 1;
+        break;
+      }
+      i++;
+    }
+    
+    if (!found) {
+      y = realloc(y, strlen(y) + 2);
+      buff[0] = *s; buff[1] = '\0';
+      strcat(y, buff);
+    }
+    
+    s++;
+  }
+  
+  
+  return y;
+}
+
+static mpc_val_t *mpcf_unescape_new(mpc_val_t *x, const char *input, const char **output) {
+  
+  int i;
+  int found = 0;
+  char buff[2];
+  char *s = x;
+  char *y = calloc(1, 1);
+  
+  while (*s) {
+    
+    i = 0;
+    found = 0;
+    
+    while (output[i]) {
+      if ((*(s+0)) == output[i][0] &&
+          (*(s+1)) == output[i][1]) {
+        y = realloc(y, strlen(y) + 1 + 1);
+        buff[0] = input[i]; buff[1] = '\0';
+        strcat(y, buff);
+        found = 1;
+        s++;
+        break;
+      }
+      i++;
+    }
+    
+    if (!found) {
+      y = realloc(y, strlen(y) + 1 + 1);
+      buff[0] = *s; buff[1] = '\0';
+      strcat(y, buff);
+    }
+    
+    if (*s == '\0') { break; }
+    else { s++; }
+  }
+  
+  return y;
+  
+}
+
+mpc_val_t *mpcf_escape(mpc_val_t *x) {
+  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_c, mpc_escape_output_c);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_unescape(mpc_val_t *x) {
+  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_c, mpc_escape_output_c);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_escape_regex(mpc_val_t *x) {
+  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_re, mpc_escape_output_raw_re);
+  free(x);
+  return y;  
+}
+
+mpc_val_t *mpcf_unescape_regex(mpc_val_t *x) {
+  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_re, mpc_escape_output_raw_re);
+  free(x);
+  return y;  
+}
+
+mpc_val_t *mpcf_escape_string_raw(mpc_val_t *x) {
+  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_cstr, mpc_escape_output_raw_cstr);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_unescape_string_raw(mpc_val_t *x) {
+  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_cstr, mpc_escape_output_raw_cstr);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_escape_char_raw(mpc_val_t *x) {
+  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_cchar, mpc_escape_output_raw_cchar);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_unescape_char_raw(mpc_val_t *x) {
+  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_cchar, mpc_escape_output_raw_cchar);
+  free(x);
+  return y;
+}
+
+mpc_val_t *mpcf_null(int n, mpc_val_t** xs) { (void) n; (void) xs; return NULL; }
+mpc_val_t *mpcf_fst(int n, mpc_val_t **xs) { (void) n; return xs[0]; }
+mpc_val_t *mpcf_snd(int n, mpc_val_t **xs) { (void) n; return xs[1]; }
+mpc_val_t *mpcf_trd(int n, mpc_val_t **xs) { (void) n; return xs[2]; }
+
+static mpc_val_t *mpcf_nth_free(int n, mpc_val_t **xs, int x) {
+  int i;
+  for (i = 0; i < n; i++) {
+    if (i != x) { free(xs[i]); }
+  }
+  return xs[x];
+}
+ 
+mpc_val_t *mpcf_fst_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 0); }
+mpc_val_t *mpcf_snd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 1); }
+mpc_val_t *mpcf_trd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 2); }
+
+mpc_val_t *mpcf_strfold(int n, mpc_val_t **xs) {
+  int i;
+  size_t l = 0;
+  
+  if (n == 0) { return calloc(1, 1); }
+  
+  for (i = 0; i < n; i++) { l += strlen(xs[i]); }
+  
+  xs[0] = realloc(xs[0], l + 1);
+  
+  for (i = 1; i < n; i++) {
+    strcat(xs[0], xs[i]); free(xs[i]);
+  }
+  
+  return xs[0];
+}
+
+mpc_val_t *mpcf_maths(int n, mpc_val_t **xs) {
+  int **vs = (int**)xs;
+  (void) n;
+  
+  if (strcmp(xs[1], "*") == 0) { *vs[0] *= *vs[2]; }
+  if (strcmp(xs[1], "/") == 0) { *vs[0] /= *vs[2]; }
+  if (strcmp(xs[1], "%") == 0) { *vs[0] %= *vs[2]; }
+  if (strcmp(xs[1], "+") == 0) { *vs[0] += *vs[2]; }
+  if (strcmp(xs[1], "-") == 0) { *vs[0] -= *vs[2]; }
+  
+  free(xs[1]); free(xs[2]);
+  
+  return xs[0];
+}
+
+/*
+** Printing
+*/
+
+static void mpc_print_unretained(mpc_parser_t *p, int force) {
+  
+  /* TODO: Print Everything Escaped */
+  
+  int i;
+  char *s, *e;
+  char buff[2];
+  
+  if (p->retained && !force) {;
+    if (p->name) { printf("<%s>", p->name); }
+    else { printf("<anon>"); }
+    return;
+  }
+  
+  if (p->type == MPC_TYPE_UNDEFINED) { printf("<?>"); }
+  if (p->type == MPC_TYPE_PASS)   { printf("<:>"); }
+  if (p->type == MPC_TYPE_FAIL)   { printf("<!>"); }
+  if (p->type == MPC_TYPE_LIFT)   { printf("<#>"); }
+  if (p->type == MPC_TYPE_STATE)  { printf("<S>"); }
+  if (p->type == MPC_TYPE_ANCHOR) { printf("<@>"); }
+  if (p->type == MPC_TYPE_EXPECT) {
+    printf("%s", p->data.expect.m);
+    /*mpc_print_unretained(p->data.expect.x, 0);*/
+  }
+  
+  if (p->type == MPC_TYPE_ANY) { printf("<.>"); }
+  if (p->type == MPC_TYPE_SATISFY) { printf("<f>"); }
+
+  if (p->type == MPC_TYPE_SINGLE) {
+    buff[0] = p->data.single.x; buff[1] = '\0';
+    s = mpcf_escape_new(
+      buff,
+      mpc_escape_input_c,
+      mpc_escape_output_c);
+    printf("'%s'", s);
+    free(s);
+  }
+  
+  if (p->type == MPC_TYPE_RANGE) {
+    buff[0] = p->data.range.x; buff[1] = '\0';
+    s = mpcf_escape_new(
+      buff,
+      mpc_escape_input_c,
+      mpc_escape_output_c);
+    buff[0] = p->data.range.y; buff[1] = '\0';
+    e = mpcf_escape_new(
+      buff,
+      mpc_escape_input_c,
+      mpc_escape_output_c);
+    printf("[%s-%s]", s, e);
+    free(s);
+    free(e);
+  }
+  
+  if (p->type == MPC_TYPE_ONEOF) {
+    s = mpcf_escape_new(
+      p->data.string.x,
+      mpc_escape_input_c,
+      mpc_escape_output_c);
+    printf("[%s]", s);
+    free(s);
+  }
+  
+  if (p->type == MPC_TYPE_NONEOF) {
+    s = mpcf_escape_new(
+      p->data.string.x,
+      mpc_escape_input_c,
+      mpc_escape_output_c);
+    printf("[^%s]", s);
+    free(s);
+  }
+  
+  if (p->type == MPC_TYPE_STRING) {
+    s = mpcf_escape_new(
+      p->data.string.x,
+      mpc_escape_input_c,
+      mpc_escape_output_c);
+    printf("\"%s\"", s);
+    free(s);
+  }
+  
+  if (p->type == MPC_TYPE_APPLY)    { mpc_print_unretained(p->data.apply.x, 0); }
+  if (p->type == MPC_TYPE_APPLY_TO) { mpc_print_unretained(p->data.apply_to.x, 0); }
+  if (p->type == MPC_TYPE_PREDICT)  { mpc_print_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_MEMO)     { mpc_print_unretained(p->data.memo.x, 0); }
+  if (p->type == MPC_TYPE_DFA)      { mpc_print_unretained(p->data.dfa.x, 0); }
+  if (p->type == MPC_TYPE_SPAN)     { mpc_print_unretained(p->data.span.x, 0); }
+  if (p->type == MPC_TYPE_CAPTURE)  { mpc_print_unretained(p->data.capture.x, 0); }
+  if (p->type == MPC_TYPE_SKIP)     { mpc_print_unretained(p->data.capture.x, 0); }
+  if (p->type == MPC_TYPE_TOKEN)    { mpc_print_unretained(p->data.token.x, 0); }
+
+  if (p->type == MPC_TYPE_NOT)   { mpc_print_unretained(p->data.not.x, 0); printf("!"); }
+  if (p->type == MPC_TYPE_MAYBE) { mpc_print_unretained(p->data.not.x, 0); printf("?"); }
+
+  if (p->type == MPC_TYPE_MANY)  { mpc_print_unretained(p->data.repeat.x, 0); printf("*"); }
+  if (p->type == MPC_TYPE_MANY1) { mpc_print_unretained(p->data.repeat.x, 0); printf("+"); }
+  if (p->type == MPC_TYPE_COUNT) { mpc_print_unretained(p->data.repeat.x, 0); printf("{%i}", p->data.repeat.n); }
+  
+  if (p->type == MPC_TYPE_OR) {
+    printf("(");
+    for(i = 0; i < p->data.or.n-1; i++) {
+      mpc_print_unretained(p->data.or.xs[i], 0);
+      printf(" | ");
+    }
+    mpc_print_unretained(p->data.or.xs[p->data.or.n-1], 0);
+    printf(")");
+  }
+  
+  if (p->type == MPC_TYPE_AND) {
+    printf("(");
+    for(i = 0; i < p->data.and.n-1; i++) {
+      mpc_print_unretained(p->data.and.xs[i], 0);
+      printf(" ");
+    }
+    mpc_print_unretained(p->data.and.xs[p->data.and.n-1], 0);
+    printf(")");
+  }
+  
+}
+
+void mpc_print(mpc_parser_t *p) {
+  mpc_print_unretained(p, 1);
+  printf("\n");
+}
+
+/*
+** Testing
+*/
+
+/*
+** These functions are slightly unwieldy and
+** also the whole of the testing suite for mpc
+** mpc is pretty shaky.
+**
+** It could do with a lot more tests and more
+** precision. Currently I am only really testing
+** changes off of the examples.
+**
+*/
+
+int mpc_test_fail(mpc_parser_t *p, const char *s, const void *d,
+  int(*tester)(const void*, const void*),
+  mpc_dtor_t destructor,
+  void(*printer)(const void*)) {
+  mpc_result_t r;
+  (void) printer;
+  if (mpc_parse("<test>", s, p, &r)) {
+
+    if (tester(r.output, d)) {
+      destructor(r.output);
+      return 0;
+    } else {
+      destructor(r.output);
+      return 1;
+    }
+  
+  } else {
+    mpc_err_delete(r.error);
+    return 1;
+  }
+  
+}
+
+int mpc_test_pass(mpc_parser_t *p, const char *s, const void *d,
+  int(*tester)(const void*, const void*), 
+  mpc_dtor_t destructor, 
+  void(*printer)(const void*)) {
+
+  mpc_result_t r;  
+  if (mpc_parse("<test>", s, p, &r)) {
+    
+    if (tester(r.output, d)) {
+      destructor(r.output);
+      return 1;
+    } else {
+      printf("Got "); printer(r.output); printf("\n");
+      printf("Expected "); printer(d); printf("\n");
+      destructor(r.output);
+      return 0;
+    }
+    
+  } else {    
+    mpc_err_print(r.error);
+    mpc_err_delete(r.error);
+    return 0;
+    
+  }
+  
+}
+
+
+/*
+** AST
+*/
+
+/*
+** AST Arenas
+**
+** An arena hands out the nodes, strings and child
+** arrays of one tree from a list of blocks, each
+** twice the size of the last. Nothing is freed on
+** its own: deleting a node in the arena does nothing
+** unless it is the root, in which case every block
+** goes at once. Subtrees thrown away while the parse
+** backtracks simply stay in the arena until then.
+**
+** While a session parses with `MPC_SESSION_ARENA` the
+** arena is held by its input, and the folds and
+** applies of `mpca_*` build their nodes in it. Nodes
+** made by the user's own callbacks come from `malloc`
+** as usual. A node added as the child of one that
+** lives elsewhere is copied across, so every tree is
+** either wholly in one arena or wholly outside.
+**
+** An arena made for slices also knows the input being
+** parsed. Leaves are given an offset and length into
+** `source`, which is either the caller's string or,
+** where the input buffer won't last, such as in a push
+** session, a copy of it made on the first slice.
+*/
+
+enum {
+  MPC_AST_ARENA_BLOCK     = 4096,
+  MPC_AST_ARENA_BLOCK_MAX = 1048576,
+  MPC_AST_CHILDREN_MIN    = 4
+};
+
+typedef union {
+  void *p;
+  long l;
+  double d;
+} mpc_ast_align_t;
+
+typedef struct mpc_ast_block_t {
+  struct mpc_ast_block_t *next;
+  mpc_ast_align_t data[1];
+} mpc_ast_block_t;
+
+struct mpc_ast_arena_t {
+  mpc_ast_t *root;
+  mpc_ast_block_t *blocks;
+  char *top, *end;
+  size_t grow;
+  mpc_input_t *input;
+  const char *source;
+  size_t copied, room;
+};
+
+/*
+** A node in an arena comes just after a header giving
+** the arena and, for a slice, where its text lies in
+** the source. Its tag says whether it has one, see
+** `mpc_tag_set`, so nodes outside of any arena are no
+** bigger than they ever were.
+*/
+
+typedef struct {
+  struct mpc_ast_arena_t *arena;
+  long offset;
+  long length;
+} mpc_ast_in_t;
+
+static mpc_ast_in_t *mpc_ast_in(mpc_ast_t *a) {
+  return (mpc_ast_in_t*)a - 1;
+}
+
+static struct mpc_ast_arena_t *mpc_ast_arena_new(mpc_input_t *i, const char *source) {
+  struct mpc_ast_arena_t *a = malloc(sizeof(struct mpc_ast_arena_t));
+  a->root = NULL;
+  a->blocks = NULL;
+  a->top = NULL;
+  a->end = NULL;
+  a->grow = MPC_AST_ARENA_BLOCK;
+  a->input = i;
+  a->source = source;
+  a->copied = 0;
+  a->room = source ? 0 : 1;
+  return a;
+}
+
+static void mpc_ast_arena_delete(struct mpc_ast_arena_t *a) {
+  mpc_ast_block_t *b;
+  while (a->blocks) {
+    b = a->blocks;
+    a->blocks = b->next;
+    free(b);
+  }
+  free(a);
+}
+
+/*
+** Once parsing is over the arena belongs to the tree
+** it returned. If there isn't one, such as when the
+** parse failed, nothing in the arena is reachable.
+*/
+
+static void mpc_ast_arena_finish(struct mpc_ast_arena_t *a, mpc_ast_t *root) {
+  if (root == NULL || mpc_ast_arena(root) != a) { mpc_ast_arena_delete(a); return; }
+  a->root = root;
+}
+
+static void *mpc_ast_arena_alloc(struct mpc_ast_arena_t *a, size_t n) {
+  
+  mpc_ast_block_t *b;
+  size_t size;
+  char *x;
+  
+  n = (n + sizeof(mpc_ast_align_t) - 1) & ~(sizeof(mpc_ast_align_t) - 1);
+  
+  if (n > (size_t)(a->end - a->top)) {
+    size = n > a->grow ? n : a->grow;
+    b = malloc(sizeof(mpc_ast_block_t) + size);
+    b->next = a->blocks;
+    a->blocks = b;
+    a->top = (char*)b->data;
+    a->end = a->top + size;
+    if (a->grow < MPC_AST_ARENA_BLOCK_MAX) { a->grow *= 2; }
+  }
+  
+  x = a->top;
+  a->top += n;
+  return x;
+}
+
+static char *mpc_ast_strdup(struct mpc_ast_arena_t *a, const char *s) {
+  size_t n = strlen(s) + 1;
+  char *x = a ? mpc_ast_arena_alloc(a, n) : malloc(n);
+  memcpy(x, s, n);
+  return x;
+}
+
+/*
+** A token's text is usually the bytes just before the
+** input position, perhaps followed by whitespace which
+** `mpc_tok` consumed. Any match will do as the bytes
+** are the same, but if none is found nearby the text
+** must have been built some other way and is copied.
+**
+** Without a source of its own the arena keeps a copy
+** of the input, grown as a push parse sees more of it.
+*/
+
+static long mpc_ast_slice_find(struct mpc_ast_arena_t *a, mpc_input_t *i, const char *c, long n) {
+  
+  long end = i->pos;
+  char *copy;
+  
+  if (a == NULL || a->input != i || i->type != MPC_INPUT_STRING) { return -1; }
+  
+  while (end >= n) {
+    if (memcmp(i->string + end - n, c, (size_t)n) == 0) { break; }
+    if (end == 0 || !isspace((unsigned char)i->string[end-1])) { return -1; }
+    end--;
+  }
+  
+  if (end < n) { return -1; }
+  
+  if (a->room && a->copied < i->length) {
+    if (a->source == NULL || a->room < i->length) {
+      while (a->room < i->length) { a->room *= 2; }
+      copy = mpc_ast_arena_alloc(a, a->room);
+      memcpy(copy, i->string, a->copied);
+      a->source = copy;
+    }
+    memcpy((char*)a->source + a->copied, i->string + a->copied, i->length - a->copied);
+    a->copied = i->length;
+  }
+  
+  return end - n;
+}
+
+/*
+** Tag IDs
+**
+** Every distinct tag string is interned and given a
+** small integer ID, starting from one. A tag such as
+** `expr|number|regex` is interned as a whole, and its
+** entry also lists the IDs of the names it is made
+** of, so nodes only need to carry the single ID of
+** their full tag to be tested for any one rule.
+**
+** Tags are only interned as grammars are built, by
+** `mpca_tag` and `mpca_add_tag`, or by `mpc_tag_id`.
+** Parsing only looks names up, so it never writes to
+** the table and separate threads can parse at once.
+** `>` is always interned, as ID one.
+**
+** Each node carries the set of IDs of the names in its
+** tag, stored just after the terminator of the tag
+** string in the same allocation. When a name is added
+** to a tag only that name is looked up and the rest of
+** the set is copied across, so a joined tag such as
+** `expr|number|regex` is tested for any one rule by
+** scanning a few integers. Names which were never
+** interned have no ID and are left out of the set.
+**
+** The table lasts as long as any parser does, so it
+** is freed when the last one is deleted, usually by
+** `mpc_cleanup`.
+*/
+
+typedef struct {
+  char *name;
+  unsigned long hash;
+  int *parts;
+  int parts_num;
+} mpc_tag_t;
+
+static mpc_tag_t *mpc_tags = NULL;
+static int mpc_tags_num = 0;
+static int mpc_tags_slots = 0;
+static int *mpc_tags_index = NULL;
+static int mpc_tags_index_slots = 0;
+
+static unsigned long mpc_tag_hash(const char *s, size_t n) {
+  unsigned long h = 5381;
+  size_t j;
+  for (j = 0; j < n; j++) { h = h * 33 + (unsigned char)s[j]; }
+  return h;
+}
+
+static void mpc_tags_index_grow(void) {
+  
+  int j, k;
+  int slots = mpc_tags_index_slots ? mpc_tags_index_slots * 2 : 64;
+  
+  free(mpc_tags_index);
+  mpc_tags_index = calloc(slots, sizeof(int));
+  mpc_tags_index_slots = slots;
+  
+  for (j = 1; j < mpc_tags_num; j++) {
+    k = (int)(mpc_tags[j].hash & (unsigned long)(slots - 1));
+    while (mpc_tags_index[k]) { k = (k + 1) & (slots - 1); }
+    mpc_tags_index[k] = j;
+  }
+}
+
+/* The slot `s` is in, or the empty one it would go in */
+static int mpc_tag_slot(const char *s, size_t n, unsigned long h) {
+  
+  int id, k = (int)(h & (unsigned long)(mpc_tags_index_slots - 1));
+  
+  while (mpc_tags_index[k]) {
+    id = mpc_tags_index[k];
+    if (mpc_tags[id].hash == h && strncmp(mpc_tags[id].name, s, n) == 0
+    &&  mpc_tags[id].name[n] == '\0') { return k; }
+    k = (k + 1) & (mpc_tags_index_slots - 1);
+  }
+  
+  return k;
+}
+
+static int mpc_tag_intern(const char *s, size_t n) {
+  
+  int id, k;
+  size_t j, start;
+  unsigned long h = mpc_tag_hash(s, n);
+  
+  /* ID zero is never handed out */
+  if (mpc_tags_index_slots == 0) {
+    mpc_tags_index_grow();
+    mpc_tags_num = 1;
+    mpc_tag_intern(">", 1);
+  }
+  
+  k = mpc_tag_slot(s, n, h);
+  if (mpc_tags_index[k]) { return mpc_tags_index[k]; }
+  
+  if (mpc_tags_num >= mpc_tags_slots) {
+    mpc_tags_slots = mpc_tags_slots ? mpc_tags_slots * 2 : 64;
+    mpc_tags = realloc(mpc_tags, sizeof(mpc_tag_t) * mpc_tags_slots);
+  }
+  
+  id = mpc_tags_num++;
+  mpc_tags[id].name = malloc(n + 1);
+  memcpy(mpc_tags[id].name, s, n);
+  mpc_tags[id].name[n] = '\0';
+  mpc_tags[id].hash = h;
+  mpc_tags[id].parts = NULL;
+  mpc_tags[id].parts_num = 0;
+  mpc_tags_index[k] = id;
+  
+  if (mpc_tags_num * 2 > mpc_tags_index_slots) { mpc_tags_index_grow(); }
+  
+  if (memchr(s, '|', n) == NULL) {
+    mpc_tags[id].parts = malloc(sizeof(int));
+    mpc_tags[id].parts[0] = id;
+    mpc_tags[id].parts_num = 1;
+    return id;
+  }
+  
+  /* Interning the parts can move `mpc_tags` so index it each time */
+  for (j = 0, start = 0; j <= n; j++) {
+    if (j < n && s[j] != '|') { continue; }
+    k = mpc_tag_intern(s + start, j - start);
+    mpc_tags[id].parts = realloc(mpc_tags[id].parts, sizeof(int) * (mpc_tags[id].parts_num + 1));
+    mpc_tags[id].parts[mpc_tags[id].parts_num++] = k;
+    start = j + 1;
+  }
+  
+  return id;
+}
+
+/* The ID of a tag already interned, or zero, without changing the table */
+static int mpc_tag_find(const char *tag, size_t n) {
+  if (mpc_tags_index_slots == 0) { return 0; }
+  return mpc_tags_index[mpc_tag_slot(tag, n, mpc_tag_hash(tag, n))];
+}
+
+static void mpc_tags_clear(void) {
+  int j;
+  for (j = 1; j < mpc_tags_num; j++) {
+    free(mpc_tags[j].name);
+    free(mpc_tags[j].parts);
+  }
+  free(mpc_tags);
+  free(mpc_tags_index);
+  mpc_tags = NULL;
+  mpc_tags_num = 0;
+  mpc_tags_slots = 0;
+  mpc_tags_index = NULL;
+  mpc_tags_index_slots = 0;
+}
+
+int mpc_tag_id(const char *tag) {
+  return mpc_tag_intern(tag, strlen(tag));
+}
+
+const char *mpc_tag_name(int id) {
+  if (id <= 0 || id >= mpc_tags_num) { return NULL; }
+  return mpc_tags[id].name;
+}
+
+int mpc_tag_has_id(int tag, int id) {
+  
+  int j;
+  mpc_tag_t *t;
+  
+  if (tag <= 0 || tag >= mpc_tags_num) { return 0; }
+  if (tag == id) { return 1; }
+  
+  t = &mpc_tags[tag];
+  for (j = 0; j < t->parts_num; j++) {
+    if (t->parts[j] == id) { return 1; }
+  }
+  return 0;
+}
+
+/*
+** A tag of `n` characters has its ID set at the first
+** `int` boundary past its terminator. The set is its
+** size followed by the IDs, outermost name first. The
+** tag of a node in an arena has the size inverted.
+*/
+
+static size_t mpc_tag_set_at(size_t n) {
+  return (n + sizeof(int)) / sizeof(int) * sizeof(int);
+}
+
+static const int *mpc_tag_set(const char *tag) {
+  return (const int*)(tag + mpc_tag_set_at(strlen(tag)));
+}
+
+static int mpc_tag_set_num(const int *set) {
+  return set[0] < 0 ? ~set[0] : set[0];
+}
+
+/* The whole size of a tag along with its set */
+static size_t mpc_tag_size(const char *tag) {
+  return mpc_tag_set_at(strlen(tag)) + sizeof(int) * (size_t)(mpc_tag_set_num(mpc_tag_set(tag)) + 1);
+}
+
+/*
+** Writes the first `n` characters of `head` then, if
+** given, `tail` into `x`, followed by their ID set. If
+** `join` is set a `|` goes between the two. The names
+** in `head` are looked up while the IDs of `tail`,
+** itself a tag with a set, are copied.
+*/
+
+static size_t mpc_tag_set_size(const char *head, size_t n, const char *tail, int join) {
+  
+  size_t parts = 1, j;
+  
+  for (j = 0; j < n; j++) { parts += head[j] == '|'; }
+  if (tail) {
+    parts += (size_t)mpc_tag_set_num(mpc_tag_set(tail));
+    n += strlen(tail) + (join ? 1 : 0);
+  }
+  return mpc_tag_set_at(n) + sizeof(int) * (parts + 1);
+}
+
+static void mpc_tag_set_write(char *x, const char *head, size_t n, const char *tail, int join) {
+  
+  size_t j, start, m = tail ? strlen(tail) + (join ? 1 : 0) : 0;
+  int *set = (int*)(x + mpc_tag_set_at(n + m));
+  int id;
+  
+  memcpy(x, head, n);
+  if (tail && join) { x[n] = '|'; }
+  if (tail) { memcpy(x + n + (join ? 1 : 0), tail, m - (join ? 1 : 0)); }
+  x[n + m] = '\0';
+  
+  set[0] = 0;
+  for (j = 0, start = 0; j <= n; j++) {
+    if (j < n && head[j] != '|') { continue; }
+    id = j > start ? mpc_tag_find(head + start, j - start) : 0;
+    if (id) { set[++set[0]] = id; }
+    start = j + 1;
+  }
+  
+  if (tail) {
+    memcpy(set + set[0] + 1, mpc_tag_set(tail) + 1, sizeof(int) * (size_t)mpc_tag_set_num(mpc_tag_set(tail)));
+    set[0] += mpc_tag_set_num(mpc_tag_set(tail));
+  }
+}
+
+/*
+** A tag is allocated along with its ID set, so giving
+** a node a new one builds it afresh, in the arena if
+** the node is in one, and frees the old one if not.
+*/
+
+static char *mpc_ast_tag_new(struct mpc_ast_arena_t *a, const char *head, size_t n, const char *tail, int join) {
+  size_t size = mpc_tag_set_size(head, n, tail, join);
+  char *x = a ? mpc_ast_arena_alloc(a, size) : malloc(size);
+  int *set;
+  mpc_tag_set_write(x, head, n, tail, join);
+  if (a) {
+    set = (int*)mpc_tag_set(x);
+    set[0] = ~set[0];
+  }
+  return x;
+}
+
+static struct mpc_ast_arena_t *mpc_ast_arena(mpc_ast_t *a) {
+  return mpc_tag_set(a->tag)[0] < 0 ? mpc_ast_in(a)->arena : NULL;
+}
+
+static void mpc_ast_tag_set(mpc_ast_t *a, const char *head, size_t n, const char *tail, int join) {
+  struct mpc_ast_arena_t *arena = mpc_ast_arena(a);
+  char *x = mpc_ast_tag_new(arena, head, n, tail, join);
+  if (arena == NULL) { free(a->tag); }
+  a->tag = x;
+}
+
+static int mpc_tag_set_has(const char *tag, int id) {
+  const int *set = mpc_tag_set(tag);
+  int j, n = mpc_tag_set_num(set);
+  for (j = 1; j <= n; j++) {
+    if (set[j] == id) { return 1; }
+  }
+  return 0;
+}
+
+int mpc_ast_has_tag_id(mpc_ast_t *a, int id) {
+  return mpc_tag_set_has(a->tag, id);
+}
+
+int mpc_ast_tag_id(mpc_ast_t *a) {
+  const int *set = mpc_tag_set(a->tag);
+  return mpc_tag_set_num(set) ? set[1] : 0;
+}
+
+/*
+** Compiled parsers build trees deeper than the C stack
+** could recurse through, so they are walked using a
+** stack of their own. Children are pushed last first
+** so that they are popped in order.
+*/
+
+static mpc_ast_t **mpc_ast_stack_push(mpc_ast_t **stack, int *n, int *slots, mpc_ast_t *a) {
+  int i;
+  if (*n + a->children_num > *slots) {
+    while (*n + a->children_num > *slots) { *slots *= 2; }
+    stack = realloc(stack, sizeof(mpc_ast_t*) * *slots);
+  }
+  for (i = a->children_num - 1; i >= 0; i--) {
+    stack[(*n)++] = a->children[i];
+  }
+  return stack;
+}
+
+void mpc_ast_delete(mpc_ast_t *a) {
+  
+  mpc_ast_t **stack;
+  struct mpc_ast_arena_t *arena;
+  int n = 0, slots = MPC_AST_CHILDREN_MIN;
+  
+  if (a == NULL) { return; }
+  
+  stack = malloc(sizeof(mpc_ast_t*) * slots);
+  stack[n++] = a;
+  
+  while (n > 0) {
+    a = stack[--n];
+    
+    arena = mpc_ast_arena(a);
+    if (arena) {
+      if (arena->root == a) { mpc_ast_arena_delete(arena); }
+      continue;
+    }
+    
+    stack = mpc_ast_stack_push(stack, &n, &slots, a);
+    
+    free(a->children);
+    free(a->tag);
+    free(a->contents);
+    free(a);
+  }
+  
+  free(stack);
+  
+}
+
+static void mpc_ast_delete_no_children(mpc_ast_t *a) {
+  if (mpc_ast_arena(a)) { return; }
+  free(a->children);
+  free(a->tag);
+  free(a->contents);
+  free(a);
+}
+
+/* A slice, with `offset` not negative, must be in an arena */
+static mpc_ast_t *mpc_ast_new_slice(struct mpc_ast_arena_t *arena, const char *tag, const char *contents, long offset, long length) {
+  
+  mpc_ast_in_t *x;
+  mpc_ast_t *a;
+  
+  if (arena) {
+    x = mpc_ast_arena_alloc(arena, sizeof(mpc_ast_in_t) + sizeof(mpc_ast_t));
+    x->arena = arena;
+    x->offset = offset;
+    x->length = length;
+    a = (mpc_ast_t*)(x + 1);
+  } else {
+    a = malloc(sizeof(mpc_ast_t));
+  }
+  
+  a->tag = mpc_ast_tag_new(arena, tag, strlen(tag), NULL, 0);
+  a->contents = offset < 0 ? mpc_ast_strdup(arena, contents) : NULL;
+  
+  a->state = mpc_state_new();
+  
+  a->children_num = 0;
+  a->children = NULL;
+  return a;
+  
+}
+
+static mpc_ast_t *mpc_ast_new_in(struct mpc_ast_arena_t *arena, const char *tag, const char *contents) {
+  if (arena && arena->input && contents[0] == '\0') {
+    return mpc_ast_new_slice(arena, tag, contents, 0, 0);
+  }
+  return mpc_ast_new_slice(arena, tag, contents, -1, (long)strlen(contents));
+}
+
+mpc_ast_t *mpc_ast_new(const char *tag, const char *contents) {
+  return mpc_ast_new_in(NULL, tag, contents);
+}
+
+char *mpc_ast_contents(mpc_ast_t *a) {
+  mpc_ast_in_t *x;
+  if (a->contents == NULL) {
+    x = mpc_ast_in(a);
+    a->contents = mpc_ast_arena_alloc(x->arena, (size_t)x->length + 1);
+    if (x->length) {
+      memcpy(a->contents, x->arena->source + x->offset, (size_t)x->length);
+    }
+    a->contents[x->length] = '\0';
+  }
+  return a->contents;
+}
+
+mpc_ast_t *mpc_ast_build(int n, const char *tag, ...) {
+  
+  mpc_ast_t *a = mpc_ast_new(tag, "");
+  
+  int i;
+  va_list va;
+  va_start(va, tag);
+  
+  for (i = 0; i < n; i++) {
+    mpc_ast_add_child(a, va_arg(va, mpc_ast_t*));
+  }
+  
+  va_end(va);
+  
+  return a;
+  
+}
+
+static mpc_ast_t *mpc_ast_root_in(struct mpc_ast_arena_t *arena, mpc_ast_t *a) {
+
+  mpc_ast_t *r;
+
+  if (a == NULL) { return a; }
+  if (a->children_num == 0) { return a; }
+  if (a->children_num == 1) { return a; }
+
+  r = mpc_ast_new_in(arena, ">", "");
+  mpc_ast_add_child(r, a);
+  return r;
+}
+
+mpc_ast_t *mpc_ast_add_root(mpc_ast_t *a) {
+  return mpc_ast_root_in(NULL, a);
+}
+
+int mpc_ast_eq(mpc_ast_t *a, mpc_ast_t *b) {
+  
+  int i;
+
+  if (strcmp(a->tag, b->tag) != 0) { return 0; }
+  if (strcmp(mpc_ast_contents(a), mpc_ast_contents(b)) != 0) { return 0; }
+  if (a->children_num != b->children_num) { return 0; }
+  
+  for (i = 0; i < a->children_num; i++) {
+    if (!mpc_ast_eq(a->children[i], b->children[i])) { return 0; }
+  }
+  
+  return 1;
+}
+
+/* Copies `a` into `arena`, or outside of any if it is `NULL` */
+static mpc_ast_t *mpc_ast_copy(struct mpc_ast_arena_t *arena, mpc_ast_t *a) {
+  
+  int j;
+  mpc_ast_t *b;
+  
+  if (a == NULL) { return NULL; }
+  
+  if (a->contents) {
+    b = mpc_ast_new_slice(arena, a->tag, a->contents, -1, 0);
+  } else if (arena == NULL || arena->source != mpc_ast_in(a)->arena->source) {
+    b = mpc_ast_new_slice(arena, a->tag, mpc_ast_contents(a), -1, 0);
+  } else {
+    b = mpc_ast_new_slice(arena, a->tag, NULL, mpc_ast_in(a)->offset, mpc_ast_in(a)->length);
+  }
+  b->state = a->state;
+  for (j = 0; j < a->children_num; j++) {
+    mpc_ast_add_child(b, mpc_ast_copy(arena, a->children[j]));
+  }
+  return b;
+}
+
+/*
+** Child arrays in an arena start with a few slots and
+** double whenever the count reaches a power of two,
+** so the capacity never needs to be stored.
+*/
+
+mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a) {
+  
+  mpc_ast_t **children;
+  mpc_ast_t *b;
+  struct mpc_ast_arena_t *arena = mpc_ast_arena(r);
+  int n = r->children_num;
+  
+  if (a && mpc_ast_arena(a) != arena) {
+    b = mpc_ast_copy(arena, a);
+    if (mpc_ast_arena(a) == NULL) { mpc_ast_delete(a); }
+    a = b;
+  }
+  
+  if (arena == NULL) {
+    r->children = realloc(r->children, sizeof(mpc_ast_t*) * (n + 1));
+  } else if (n == 0 || (n >= MPC_AST_CHILDREN_MIN && (n & (n - 1)) == 0)) {
+    children = mpc_ast_arena_alloc(arena,
+      sizeof(mpc_ast_t*) * (n == 0 ? MPC_AST_CHILDREN_MIN : n * 2));
+    if (n > 0) { memcpy(children, r->children, sizeof(mpc_ast_t*) * n); }
+    r->children = children;
+  }
+  
+  r->children[n] = a;
+  r->children_num++;
+  return r;
+}
+
+mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
+  if (a == NULL) { return a; }
+  mpc_ast_tag_set(a, t, strlen(t), a->tag, 1);
+  return a;
+}
+
+mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t) {
+  if (a == NULL) { return a; }
+  mpc_ast_tag_set(a, t, strlen(t)-1, a->tag, 0);
+  return a;
+}
+
+mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t) {
+  mpc_ast_tag_set(a, t, strlen(t), NULL, 0);
+  return a;
+}
+
+mpc_ast_t *mpc_ast_state(mpc_ast_t *a, mpc_state_t s) {
+  if (a == NULL) { return a; }
+  a->state = s;
+  return a;
+}
+
+static void mpc_ast_print_depth(mpc_ast_t *a, int d, FILE *fp) {
+  
+  int i;
+  
+  if (a == NULL) {
+    fprintf(fp, "NULL\n");
+    return;
+  }
+  
+  for (i = 0; i < d; i++) { fprintf(fp, "  "); }
+  
+  if (strlen(mpc_ast_contents(a))) {
+    fprintf(fp, "%s:%lu:%lu '%s'\n", a->tag, 
+      (long unsigned int)(a->state.row+1),
+      (long unsigned int)(a->state.col+1),
+      mpc_ast_contents(a));
+  } else {
+    fprintf(fp, "%s \n", a->tag);
+  }
+  
+  for (i = 0; i < a->children_num; i++) {
+    mpc_ast_print_depth(a->children[i], d+1, fp);
+  }
+  
+}
+
+void mpc_ast_print(mpc_ast_t *a) {
+  mpc_ast_print_depth(a, 0, stdout);
+}
+
+void mpc_ast_print_to(mpc_ast_t *a, FILE *fp) {
+  mpc_ast_print_depth(a, 0, fp);
+}
+
+int mpc_ast_get_index(mpc_ast_t *ast, const char *tag) {
+  return mpc_ast_get_index_lb(ast, tag, 0);
+}
+
+int mpc_ast_get_index_lb(mpc_ast_t *ast, const char *tag, int lb) {
+  int i;
+
+  for(i=lb; i<ast->children_num; i++) {
+    if(strcmp(ast->children[i]->tag, tag) == 0) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+mpc_ast_t *mpc_ast_get_child(mpc_ast_t *ast, const char *tag) {
+  return mpc_ast_get_child_lb(ast, tag, 0);
+}
+
+mpc_ast_t *mpc_ast_get_child_lb(mpc_ast_t *ast, const char *tag, int lb) {
+  int i;
+
+  for(i=lb; i<ast->children_num; i++) {
+    if(strcmp(ast->children[i]->tag, tag) == 0) {
+      return ast->children[i];
+    }
+  }
+
+  return NULL;
+}
+
+mpc_ast_trav_t *mpc_ast_traverse_start(mpc_ast_t *ast,
+                                       mpc_ast_trav_order_t order)
+{
+  mpc_ast_trav_t *trav, *n_trav;
+  mpc_ast_t *cnode = ast;
+
+  /* Create the traversal structure */
+  trav = malloc(sizeof(mpc_ast_trav_t));
+  trav->curr_node = cnode;
+  trav->parent = NULL;
+  trav->curr_child = 0;
+  trav->order = order;
+
+  /* Get start node */
+  switch(order) {
+    case mpc_ast_trav_order_pre:
+      /* Nothing else is needed for pre order start */
+      break;
+
+    case mpc_ast_trav_order_post:
+      while(cnode->children_num > 0) {
+        cnode = cnode->children[0];
+
+        n_trav = malloc(sizeof(mpc_ast_trav_t));
+        n_trav->curr_node = cnode;
+        n_trav->parent = trav;
+        n_trav->curr_child = 0;
+        n_trav->order = order;
+
+        trav = n_trav;
+      }
+
+      break;
+
+    default:
+      /* Unreachable, but compiler complaints */
+      break;
+  }
+
+  return trav;
+}
+
+mpc_ast_t *mpc_ast_traverse_next(mpc_ast_trav_t **trav) {
+  mpc_ast_trav_t *n_trav, *to_free;
+  mpc_ast_t *ret = NULL;
+  int cchild;
+
+  /* The end of traversal was reached */
+  if(*trav == NULL) return NULL;
+
+  switch((*trav)->order) {
+    case mpc_ast_trav_order_pre:
+      ret = (*trav)->curr_node;
+
+      /* If there aren't any more children, go up */
+      while(*trav != NULL &&
+        (*trav)->curr_child >= (*trav)->curr_node->children_num)
+      {
+        to_free = *trav;
+        *trav = (*trav)->parent;
+        free(to_free);
+      }
+
+      /* If trav is NULL, the end was reached */
+      if(*trav == NULL) {
+        break;
+      }
+
+      /* Go to next child */
+      n_trav = malloc(sizeof(mpc_ast_trav_t));
+
+      cchild = (*trav)->curr_child;
+      n_trav->curr_node = (*trav)->curr_node->children[cchild];
+      n_trav->parent = *trav;
+      n_trav->curr_child = 0;
+      n_trav->order = (*trav)->order;
+
+      (*trav)->curr_child++;
+      *trav = n_trav;
+
+      break;
+
+    case mpc_ast_trav_order_post:
+      ret = (*trav)->curr_node;
+
+      /* Move up tree to the parent If the parent doesn't have any more nodes,
+       * then this is the current node. If it does, move down to its left most
+       * child. Also, free the previous traversal node */
+      to_free = *trav;
+      *trav = (*trav)->parent;
+      free(to_free);
+
+      if(*trav == NULL)
+        break;
+
+      /* Next child */
+      (*trav)->curr_child++;
+
+      /* If there aren't any more children, this is the next node */
+      if((*trav)->curr_child >= (*trav)->curr_node->children_num) {
+        break;
+      }
+
+      /* If there are still more children, find the leftmost child from this
+       * node */
+      while((*trav)->curr_node->children_num > 0) {
+        n_trav = malloc(sizeof(mpc_ast_trav_t));
+
+        cchild = (*trav)->curr_child;
+        n_trav->curr_node = (*trav)->curr_node->children[cchild];
+        n_trav->parent = *trav;
+        n_trav->curr_child = 0;
+        n_trav->order = (*trav)->order;
+
+        *trav = n_trav;
+      }
+
+    default:
+      /* Unreachable, but compiler complaints */
+      break;
+  }
+
+  return ret;
+}
+
+void mpc_ast_traverse_free(mpc_ast_trav_t **trav) {
+  mpc_ast_trav_t *n_trav;
+
+  /* Go through parents until all are free */
+  while(*trav != NULL) {
+      n_trav = (*trav)->parent;
+      free(*trav);
+      *trav = n_trav;
+  }
+}
+
+/*
+** Flat ASTs
+**
+** A flat AST stores its nodes in pre-order in a set of
+** parallel arrays, so the first child of node `i` is
+** `i + 1` and the sibling following it is found by
+** skipping its `size`, the number of nodes in its
+** subtree. The children of `i` are walked with
+**
+**   c = mpc_ast_flat_first(f, i);
+**   for (j = 0; j < f->children_num[i]; j++) {
+**     ...
+**     c = mpc_ast_flat_next(f, c);
+**   }
+**
+** while a scan over every node is simply a loop from
+** zero to `num`. The tags and contents of all nodes
+** share one buffer, `text`, each terminated so it can
+** be used as a string directly. Tags keep their ID
+** sets as they do in a tree, and `tag_id` holds the
+** ID of the outermost name of each, or zero.
+*/
+
+static void mpc_ast_flat_count(mpc_ast_t *a, int *num, long *text) {
+  
+  mpc_ast_t **stack;
+  int n = 0, slots = MPC_AST_CHILDREN_MIN;
+  
+  stack = malloc(sizeof(mpc_ast_t*) * slots);
+  stack[n++] = a;
+  
+  while (n > 0) {
+    a = stack[--n];
+    (*num)++;
+    *text = (*text + (long)sizeof(int) - 1) / (long)sizeof(int) * (long)sizeof(int);
+    *text += (long)mpc_tag_size(a->tag);
+    *text += (a->contents ? (long)strlen(a->contents) : mpc_ast_in(a)->length) + 1;
+    stack = mpc_ast_stack_push(stack, &n, &slots, a);
+  }
+  
+  free(stack);
+}
+
+static void mpc_ast_flat_node(mpc_ast_flat_t *f, mpc_ast_t *a, int i, long *text) {
+  
+  long n = a->contents ? (long)strlen(a->contents) : mpc_ast_in(a)->length;
+  
+  *text = (*text + (long)sizeof(int) - 1) / (long)sizeof(int) * (long)sizeof(int);
+  f->tag_id[i] = mpc_ast_tag_id(a);
+  f->tag_offset[i] = *text;
+  memcpy(f->text + *text, a->tag, mpc_tag_size(a->tag));
+  *text += (long)mpc_tag_size(a->tag);
+  
+  f->children_num[i] = a->children_num;
+  f->state[i] = a->state;
+  f->contents_offset[i] = *text;
+  f->contents_length[i] = n;
+  
+  if (a->contents) {
+    memcpy(f->text + *text, a->contents, (size_t)n);
+  } else if (n) {
+    memcpy(f->text + *text, mpc_ast_in(a)->arena->source + mpc_ast_in(a)->offset, (size_t)n);
+  }
+  f->text[*text + n] = '\0';
+  *text += n + 1;
+}
+
+/*
+** Nodes are filled in pre-order, which leaves every
+** subtree after its root, so going backwards the size
+** of each node can be summed from its children's.
+*/
+
+static void mpc_ast_flat_fill(mpc_ast_flat_t *f, mpc_ast_t *a) {
+  
+  mpc_ast_t **stack;
+  int i = 0, j, c, n = 0, slots = MPC_AST_CHILDREN_MIN;
+  long text = 0;
+  
+  stack = malloc(sizeof(mpc_ast_t*) * slots);
+  stack[n++] = a;
+  
+  while (n > 0) {
+    a = stack[--n];
+    mpc_ast_flat_node(f, a, i++, &text);
+    stack = mpc_ast_stack_push(stack, &n, &slots, a);
+  }
+  
+  free(stack);
+  
+  for (i = f->num - 1; i >= 0; i--) {
+    f->size[i] = 1;
+    for (j = 0, c = i + 1; j < f->children_num[i]; j++, c += f->size[c]) {
+      f->size[i] += f->size[c];
+    }
+  }
+}
+
+mpc_ast_flat_t *mpc_ast_flatten(mpc_ast_t *a) {
+  
+  mpc_ast_flat_t *f;
+  int num = 0;
+  long text = 0;
+  
+  if (a == NULL) { return NULL; }
+  
+  mpc_ast_flat_count(a, &num, &text);
+  
+  f = malloc(sizeof(mpc_ast_flat_t));
+  f->num = num;
+  f->tag_id = malloc(sizeof(int) * num);
+  f->tag_offset = malloc(sizeof(long) * num);
+  f->children_num = malloc(sizeof(int) * num);
+  f->size = malloc(sizeof(int) * num);
+  f->contents_offset = malloc(sizeof(long) * num);
+  f->contents_length = malloc(sizeof(long) * num);
+  f->state = malloc(sizeof(mpc_state_t) * num);
+  f->text = malloc((size_t)text);
+  
+  mpc_ast_flat_fill(f, a);
+  return f;
+}
+
+/*
+** As when printing, the subtree is rebuilt in order
+** with a stack of its open nodes and how many of their
+** children are still to come.
+*/
+
+mpc_ast_t *mpc_ast_unflatten(mpc_ast_flat_t *f, int i) {
+  
+  int k, d = 0;
+  mpc_ast_t *a, *root = NULL;
+  mpc_ast_t **open = malloc(sizeof(mpc_ast_t*) * f->size[i]);
+  int *left = malloc(sizeof(int) * f->size[i]);
+  
+  for (k = i; k < i + f->size[i]; k++) {
+    
+    a = mpc_ast_new(mpc_ast_flat_tag(f, k), mpc_ast_flat_contents(f, k));
+    a->state = f->state[k];
+    
+    while (d > 0 && left[d-1] == 0) { d--; }
+    
+    if (d > 0) {
+      mpc_ast_add_child(open[d-1], a);
+      left[d-1]--;
+    } else {
+      root = a;
+    }
+    
+    open[d] = a;
+    left[d++] = f->children_num[k];
+  }
+  
+  free(open);
+  free(left);
+  return root;
+}
+
+void mpc_ast_flat_delete(mpc_ast_flat_t *f) {
+  if (f == NULL) { return; }
+  free(f->tag_id);
+  free(f->tag_offset);
+  free(f->children_num);
+  free(f->size);
+  free(f->contents_offset);
+  free(f->contents_length);
+  free(f->state);
+  free(f->text);
+  free(f);
+}
+
+int mpc_ast_flat_first(mpc_ast_flat_t *f, int i) {
+  (void) f;
+  return i + 1;
+}
+
+int mpc_ast_flat_next(mpc_ast_flat_t *f, int i) {
+  return i + f->size[i];
+}
+
+const char *mpc_ast_flat_tag(mpc_ast_flat_t *f, int i) {
+  return f->text + f->tag_offset[i];
+}
+
+int mpc_ast_flat_has_tag_id(mpc_ast_flat_t *f, int i, int id) {
+  return mpc_tag_set_has(mpc_ast_flat_tag(f, i), id);
+}
+
+const char *mpc_ast_flat_contents(mpc_ast_flat_t *f, int i) {
+  return f->text + f->contents_offset[i];
+}
+
+/*
+** Nodes are in the order they are printed, so the
+** depth is tracked with a stack of how many nodes
+** remain in each open subtree.
+*/
+
+void mpc_ast_flat_print_to(mpc_ast_flat_t *f, FILE *fp) {
+  
+  int i, d;
+  int *left;
+  
+  if (f == NULL) {
+    fprintf(fp, "NULL\n");
+    return;
+  }
+  
+  left = malloc(sizeof(int) * f->num);
+  
+  for (i = 0, d = 0; i < f->num; i++) {
+    
+    while (d > 0 && left[d-1] == 0) { d--; }
+    
+    fprintf(fp, "%*s", d * 2, "");
+    
+    if (f->contents_length[i]) {
+      fprintf(fp, "%s:%lu:%lu '%s'\n", mpc_ast_flat_tag(f, i),
+        (long unsigned int)(f->state[i].row+1),
+        (long unsigned int)(f->state[i].col+1),
+        mpc_ast_flat_contents(f, i));
+    } else {
+      fprintf(fp, "%s \n", mpc_ast_flat_tag(f, i));
+    }
+    
+    if (d > 0) { left[d-1] -= f->size[i]; }
+    left[d++] = f->size[i] - 1;
+  }
+  
+  free(left);
+}
+
+void mpc_ast_flat_print(mpc_ast_flat_t *f) {
+  mpc_ast_flat_print_to(f, stdout);
+}
+
+static mpc_val_t *mpc_ast_fold(struct mpc_ast_arena_t *arena, int n, mpc_val_t **xs) {
+  
+  int i, j;
+  mpc_ast_t** as = (mpc_ast_t**)xs;
+  mpc_ast_t *r;
+  
+  if (n == 0) { return NULL; }
+  if (n == 1) { return xs[0]; }
+  if (n == 2 && xs[1] == NULL) { return xs[0]; }
+  if (n == 2 && xs[0] == NULL) { return xs[1]; }
+  
+  r = mpc_ast_new_in(arena, ">", "");
+  
+  for (i = 0; i < n; i++) {
+    
+    if (as[i] == NULL) { continue; }
+    
+    if        (as[i] && as[i]->children_num == 0) {
+      mpc_ast_add_child(r, as[i]);
+    } else if (as[i] && as[i]->children_num == 1) {
+      mpc_ast_add_child(r, mpc_ast_add_root_tag(as[i]->children[0], as[i]->tag));
+      mpc_ast_delete_no_children(as[i]);
+    } else if (as[i] && as[i]->children_num >= 2) {
+      for (j = 0; j < as[i]->children_num; j++) {
+        mpc_ast_add_child(r, as[i]->children[j]);
+      }
+      mpc_ast_delete_no_children(as[i]);
+    }
+  
+  }
+  
+  if (r->children_num) {
+    r->state = r->children[0]->state;
+  }
+  
+  return r;
+}
+
+mpc_val_t *mpcf_fold_ast(int n, mpc_val_t **xs) {
+  return mpc_ast_fold(NULL, n, xs);
+}
+
+mpc_val_t *mpcf_str_ast(mpc_val_t *c) {
+  mpc_ast_t *a = mpc_ast_new("", c);
+  free(c);
+  return a;
+}
+
+mpc_val_t *mpcf_state_ast(int n, mpc_val_t **xs) {
+  mpc_state_t *s = ((mpc_state_t**)xs)[0];
+  mpc_ast_t *a = ((mpc_ast_t**)xs)[1];
+  (void)n;
+  a = mpc_ast_state(a, *s);
+  free(s);
+  return a;
+}
+
+mpc_parser_t *mpca_state(mpc_parser_t *a) {
+  return mpc_and(2, mpcf_state_ast, mpc_state(), a, free);
+}
+
+mpc_parser_t *mpca_tag(mpc_parser_t *a, const char *t) {
+  mpc_tag_id(t);
+  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_tag, (void*)t);
+}
+
+mpc_parser_t *mpca_add_tag(mpc_parser_t *a, const char *t) {
+  mpc_tag_id(t);
+  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_add_tag, (void*)t);
+}
+
+mpc_parser_t *mpca_root(mpc_parser_t *a) {
+  return mpc_apply(a, (mpc_apply_t)mpc_ast_add_root);
+}
+
+mpc_parser_t *mpca_not(mpc_parser_t *a) { return mpc_not(a, (mpc_dtor_t)mpc_ast_delete); }
+mpc_parser_t *mpca_maybe(mpc_parser_t *a) { return mpc_maybe(a); }
+mpc_parser_t *mpca_many(mpc_parser_t *a) { return mpc_many(mpcf_fold_ast, a); }
+mpc_parser_t *mpca_many1(mpc_parser_t *a) { return mpc_many1(mpcf_fold_ast, a); }
+mpc_parser_t *mpca_count(int n, mpc_parser_t *a) { return mpc_count(n, mpcf_fold_ast, a, (mpc_dtor_t)mpc_ast_delete); }
+
+mpc_parser_t *mpca_or(int n, ...) {
+
+  int i;
+  va_list va;
+
+  mpc_parser_t *p = mpc_undefined();
+  
+  p->type = MPC_TYPE_OR;
+  p->data.or.n = n;
+  p->data.or.xs = malloc(sizeof(mpc_parser_t*) * n);
+  
+  va_start(va, n);  
+  for (i = 0; i < n; i++) {
+    p->data.or.xs[i] = va_arg(va, mpc_parser_t*);
+  }
+  va_end(va);
+  
+  return p;
+  
+}
+
+mpc_parser_t *mpca_and(int n, ...) {
+  
+  int i;
+  va_list va;
+  
+  mpc_parser_t *p = mpc_undefined();
+  
+  p->type = MPC_TYPE_AND;
+  p->data.and.n = n;
+  p->data.and.f = mpcf_fold_ast;
+  p->data.and.xs = malloc(sizeof(mpc_parser_t*) * n);
+  p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (n-1));
+  
+  va_start(va, n);
+  for (i = 0; i < n; i++) {
+    p->data.and.xs[i] = va_arg(va, mpc_parser_t*);
+  }
+  for (i = 0; i < (n-1); i++) {
+    p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete;
+  }    
+  va_end(va);
+  
+  return p;  
+}
+
+mpc_parser_t *mpca_total(mpc_parser_t *a) { return mpc_total(a, (mpc_dtor_t)mpc_ast_delete); }
+
+mpc_parser_t *mpca_memo(mpc_parser_t *a) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_MEMO;
+  p->data.memo.x = a;
+  return p;
+}
+
+/*
+** Grammar Parser
+*/
+
+/*
+** This is another interesting bootstrapping.
+**
+** Having a general purpose AST type allows
+** users to specify the grammar alone and
+** let all fold rules be automatically taken
+** care of by existing functions.
+**
+** You don't get to control the type spat
+** out but this means you can make a nice
+** parser to take in some grammar in nice
+** syntax and spit out a parser that works.
+**
+** The grammar for this looks surprisingly
+** like regex but the main difference is that
+** it is now whitespace insensitive and the
+** base type takes literals of some form.
+*/
+
+/*
+**
+**  ### Grammar Grammar
+**
+**      <grammar> : (<term> "|" <grammar>) | <term>
+**     
+**      <term> : <factor>*
+**
+**      <factor> : <base>
+**               | <base> "*"
+**               | <base> "+"
+**               | <base> "?"
+**               | <base> "{" <digits> "}"
+**           
+**      <base> : "<" (<digits> | <ident>) ">"
+**             | <string_lit>
+**             | <char_lit>
+**             | <regex_lit>
+**             | "(" <grammar> ")"
+*/
+
+typedef struct {
+  va_list *va;
+  int parsers_num;
+  mpc_parser_t **parsers;
+  int flags;
+  mpc_scanner_t *scanner;
+} mpca_grammar_st_t;
+
+static int mpca_passes(mpca_grammar_st_t *st) {
+  return (st->flags & MPCA_LANG_NO_OPTIMISE) ? MPC_OPTIMISE_NONE : MPC_OPTIMISE_ALL;
+}
+
+static mpc_val_t *mpcaf_grammar_or(int n, mpc_val_t **xs) {
+  (void) n;
+  if (xs[1] == NULL) { return xs[0]; }
+  else { return mpca_or(2, xs[0], xs[1]); }
+}
+
+static mpc_val_t *mpcaf_grammar_and(int n, mpc_val_t **xs) {
+  int i;
+  mpc_parser_t *p = mpc_pass();  
+  for (i = 0; i < n; i++) {
+    if (xs[i] != NULL) { p = mpca_and(2, p, xs[i]); }
+  }
+  return p;
+}
+
+static mpc_val_t *mpcaf_grammar_repeat(int n, mpc_val_t **xs) { 
+  int num;
+  (void) n;
+  if (xs[1] == NULL) { return xs[0]; }  
+  if (strcmp(xs[1], "*") == 0) { free(xs[1]); return mpca_many(xs[0]); }
+  if (strcmp(xs[1], "+") == 0) { free(xs[1]); return mpca_many1(xs[0]); }
+  if (strcmp(xs[1], "?") == 0) { free(xs[1]); return mpca_maybe(xs[0]); }
+  if (strcmp(xs[1], "!") == 0) { free(xs[1]); return mpca_not(xs[0]); }
+  num = *((int*)xs[1]);
+  free(xs[1]);
+  return mpca_count(num, xs[0]);
+}
+
+/* With `MPCA_LANG_TOKENS` a terminal is also added to the scanner, see `mpc_scanner_kind` */
+static mpc_parser_t *mpca_grammar_token(mpca_grammar_st_t *st, char type, const char *y, mpc_parser_t *re, mpc_parser_t *p) {
+  
+  char *kind;
+  
+  if (!(st->flags & MPCA_LANG_TOKENS)) { return p; }
+  
+  if (st->scanner == NULL) {
+    st->scanner = mpc_scanner_new(!(st->flags & MPCA_LANG_WHITESPACE_SENSITIVE));
+  }
+  
+  kind = malloc(strlen(y) + 3);
+  sprintf(kind, "%c%s%c", type, y, type);
+  p = mpc_scanner_token(st->scanner, kind, re, p);
+  free(kind);
+  return p;
+}
+
+static mpc_val_t *mpcaf_grammar_string(mpc_val_t *x, void *s) {
+  mpca_grammar_st_t *st = s;
+  char *y = mpcf_unescape(x);
+  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_string(y) : mpc_tok(mpc_string(y));
+  p = mpca_grammar_token(st, '"', y, NULL, p);
+  free(y);
+  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "string"));
+}
+
+static mpc_val_t *mpcaf_grammar_char(mpc_val_t *x, void *s) {
+  mpca_grammar_st_t *st = s;
+  char *y = mpcf_unescape(x);
+  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_char(y[0]) : mpc_tok(mpc_char(y[0]));
+  if (y[0]) { y[1] = '\0'; }
+  p = mpca_grammar_token(st, '"', y, NULL, p);
+  free(y);
+  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "char"));
+}
+
+static mpc_val_t *mpcaf_grammar_regex(mpc_val_t *x, void *s) {
+  mpca_grammar_st_t *st = s;
+  char *y = mpcf_unescape_regex(x);
+  mpc_parser_t *r = mpc_re_with(y, mpca_passes(st));
+  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? r : mpc_tok(r);
+  p = mpca_grammar_token(st, '/', y, r, p);
+  free(y);
+  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "regex"));
+}
+
+/* Should this just use `isdigit` instead? */
+static int is_number(const char* s) {
+  size_t i;
+  for (i = 0; i < strlen(s); i++) { if (!strchr("0123456789", s[i])) { return 0; } }
+  return 1;
+}
+
+/*
+** Without a list of parsers, as when generating code
+** for a grammar, each rule is made the first time its
+** name comes up.
+*/
+
+static mpc_parser_t *mpca_grammar_find_parser(char *x, mpca_grammar_st_t *st) {
+  
+  int i;
+  mpc_parser_t *p;
+  
+  /* Case of Number */
+  if (is_number(x)) {
+
+    i = strtol(x, NULL, 10);
+    
+    if (st->va == NULL) { return mpc_failf("No Parser in position %i!", i); }
+    
+    while (st->parsers_num <= i) {
+      st->parsers_num++;
+      st->parsers = realloc(st->parsers, sizeof(mpc_parser_t*) * st->parsers_num);
+      st->parsers[st->parsers_num-1] = va_arg(*st->va, mpc_parser_t*);
+      if (st->parsers[st->parsers_num-1] == NULL) {
+        return mpc_failf("No Parser in position %i! Only supplied %i Parsers!", i, st->parsers_num);
+      }
+    }
+    
+    return st->parsers[st->parsers_num-1];
+  
+  /* Case of Identifier */
+  } else {
+    
+    /* Search Existing Parsers */
+    for (i = 0; i < st->parsers_num; i++) {
+      mpc_parser_t *q = st->parsers[i];
+      if (q == NULL) { return mpc_failf("Unknown Parser '%s'!", x); }
+      if (q->name && strcmp(q->name, x) == 0) { return q; }
+    }
+    
+    /* Search New Parsers */
+    while (1) {
+    
+      p = st->va ? va_arg(*st->va, mpc_parser_t*) : mpc_new(x);
+      
+      st->parsers_num++;
+      st->parsers = realloc(st->parsers, sizeof(mpc_parser_t*) * st->parsers_num);
+      st->parsers[st->parsers_num-1] = p;
+      
+      if (p == NULL || p->name == NULL) { return mpc_failf("Unknown Parser '%s'!", x); }
+      if (p->name && strcmp(p->name, x) == 0) { return p; }
+      
+    }
+  
+  }  
+  
+}
+
+static mpc_val_t *mpcaf_grammar_id(mpc_val_t *x, void *s) {
+  
+  mpca_grammar_st_t *st = s;
+  mpc_parser_t *p = mpca_grammar_find_parser(x, st);
+  free(x);
+
+  if (p->name) {
+    return mpca_state(mpca_root(mpca_add_tag(p, p->name)));
+  } else {
+    return mpca_state(mpca_root(p));
+  }
+}
+
+mpc_parser_t *mpca_grammar_st(const char *grammar, mpca_grammar_st_t *st) {
+  
+  char *err_msg;
+  mpc_parser_t *err_out;
+  mpc_result_t r;
+  mpc_parser_t *GrammarTotal, *Grammar, *Term, *Factor, *Base;
+  
+  GrammarTotal = mpc_new("grammar_total");
+  Grammar = mpc_new("grammar");
+  Term = mpc_new("term");
+  Factor = mpc_new("factor");
+  Base = mpc_new("base");
+  
+  mpc_define(GrammarTotal,
+    mpc_predictive(mpc_total(Grammar, mpc_soft_delete))
+  );
+  
+  mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
+    Term,
+    mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_sym("|"), Grammar, free)),
+    mpc_soft_delete
+  ));
+  
+  mpc_define(Term, mpc_many1(mpcaf_grammar_and, Factor));
+  
+  mpc_define(Factor, mpc_and(2, mpcaf_grammar_repeat,
+    Base,
+      mpc_or(6,
+        mpc_sym("*"),
+        mpc_sym("+"),
+        mpc_sym("?"),
+        mpc_sym("!"),
+        mpc_tok_brackets(mpc_int(), free),
+        mpc_pass()),
+    mpc_soft_delete
+  ));
+  
+  mpc_define(Base, mpc_or(5,
+    mpc_apply_to(mpc_tok(mpc_string_lit()), mpcaf_grammar_string, st),
+    mpc_apply_to(mpc_tok(mpc_char_lit()),   mpcaf_grammar_char, st),
+    mpc_apply_to(mpc_tok(mpc_regex_lit()),  mpcaf_grammar_regex, st),
+    mpc_apply_to(mpc_tok_braces(mpc_or(2, mpc_digits(), mpc_ident()), free), mpcaf_grammar_id, st),
+    mpc_tok_parens(Grammar, mpc_soft_delete)
+  ));
+  
+  mpc_optimise(GrammarTotal);
+  mpc_optimise(Grammar);
+  mpc_optimise(Factor);
+  mpc_optimise(Term);
+  mpc_optimise(Base);
+  
+  if(!mpc_parse("<mpc_grammar_compiler>", grammar, GrammarTotal, &r)) {
+    err_msg = mpc_err_string(r.error);
+    err_out = mpc_failf("Invalid Grammar: %s", err_msg);
+    mpc_err_delete(r.error);
+    free(err_msg);
+    r.output = err_out;
+  }
+  
+  mpc_cleanup(5, GrammarTotal, Grammar, Term, Factor, Base);
+  
+  if (st->scanner) { mpc_scanner_build(st->scanner); }
+  mpc_optimise_with(r.output, mpca_passes(st));
+  
+  return (st->flags & MPCA_LANG_PREDICTIVE) ? mpc_predictive(r.output) : r.output;
+  
+}
+
+mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...) {
+  mpca_grammar_st_t st;
+  mpc_parser_t *res;
+  va_list va;
+  va_start(va, grammar);
+  
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+  st.scanner = NULL;
+  
+  res = mpca_grammar_st(grammar, &st);  
+  mpc_scanner_delete(st.scanner);
+  free(st.parsers);
+  va_end(va);
+  return res;
+}
+
+typedef struct {
+  char *ident;
+  char *name;
+  mpc_parser_t *grammar;
+} mpca_stmt_t;
+
+static mpc_val_t *mpca_stmt_afold(int n, mpc_val_t **xs) {
+  mpca_stmt_t *stmt = malloc(sizeof(mpca_stmt_t));
+  stmt->ident = ((char**)xs)[0];
+  stmt->name = ((char**)xs)[1];
+  stmt->grammar = ((mpc_parser_t**)xs)[3];
+  (void) n;
+  free(((char**)xs)[2]);
+  free(((char**)xs)[4]);
+  
+  return stmt;
+}
+
+static mpc_val_t *mpca_stmt_fold(int n, mpc_val_t **xs) {
+  
+  int i;
+  mpca_stmt_t **stmts = malloc(sizeof(mpca_stmt_t*) * (n+1));
+  
+  for (i = 0; i < n; i++) {
+    stmts[i] = xs[i];
+  }
+  stmts[n] = NULL;  
+  
+  return stmts;
+}
+
+static void mpca_stmt_list_delete(mpc_val_t *x) {
+
+  mpca_stmt_t **stmts = x;
+
+  while(*stmts) {
+    mpca_stmt_t *stmt = *stmts; 
+    free(stmt->ident);
+    free(stmt->name);
+    mpc_soft_delete(stmt->grammar);
+    free(stmt);  
+    stmts++;
+  }
+  free(x);
+
+}
+
+static void mpc_optimise_unretained(mpc_parser_t *p, int force, int flags);
+static void mpc_dispatch_update(mpc_parser_t *p, int flags);
+static void mpc_capture_update(mpc_parser_t *p, int force, int flags);
+static char **mpc_predict_check(mpc_parser_t **ps, int n);
+
+/*
+** Rules found to be LL(1) are wrapped in a predictive
+** parser in place. What they can start with doesn't
+** change, so no dispatch table needs invalidating.
+*/
+
+static void mpca_stmt_list_predict(mpc_parser_t **lefts, int n, int flags) {
+  
+  int i;
+  mpc_parser_t *x;
+  char **conflicts = mpc_predict_check(lefts, n);
+  
+  if (flags & MPCA_LANG_PREDICTIVE_REPORT) {
+    printf("Predictive Rules\n");
+    printf("================\n");
+  }
+  
+  for (i = 0; i < n; i++) {
+    
+    if (flags & MPCA_LANG_PREDICTIVE_REPORT) {
+      if (conflicts[i]) { printf("<%s>: backtracking, %s\n", lefts[i]->name, conflicts[i]); }
+      else { printf("<%s>: predictive\n", lefts[i]->name); }
+    }
+    
+    if (conflicts[i] == NULL && (flags & MPCA_LANG_AUTO_PREDICTIVE)) {
+      x = mpc_undefined();
+      x->type = lefts[i]->type;
+      x->data = lefts[i]->data;
+      lefts[i]->type = MPC_TYPE_PREDICT;
+      lefts[i]->data.predict.x = x;
+      lefts[i]->data.predict.dx = (mpc_dtor_t)mpc_ast_delete;
+    }
+    
+    free(conflicts[i]);
+  }
+  
+  free(conflicts);
+}
+
+static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
+
+  mpca_grammar_st_t *st = s;
+  mpca_stmt_t *stmt;
+  mpca_stmt_t **stmts = x;
+  mpc_parser_t *left;
+  mpc_parser_t **lefts;
+  int i, n = 0;
+  
+  while (stmts[n]) { n++; }
+  lefts = malloc(sizeof(mpc_parser_t*) * (n + 1));
+  n = 0;
+  
+  /* Every terminal has been read, so the scanner can be built */
+  if (st->scanner) { mpc_scanner_build(st->scanner); }
+
+  while(*stmts) {
+    stmt = *stmts;
+    left = mpca_grammar_find_parser(stmt->ident, st);
+    lefts[n++] = left;
+    if (left->name) { mpc_tag_id(left->name); }
+    if (st->flags & MPCA_LANG_PREDICTIVE) { stmt->grammar = mpc_predictive(stmt->grammar); }
+    if (st->flags & MPCA_LANG_PACKRAT) { stmt->grammar = mpca_memo(stmt->grammar); }
+    if (stmt->name) { stmt->grammar = mpc_expect(stmt->grammar, stmt->name); }
+    mpc_optimise_unretained(stmt->grammar, 1, mpca_passes(st));
+    mpc_capture_update(stmt->grammar, 1, mpca_passes(st));
+    mpc_define(left, stmt->grammar);
+    free(stmt->ident);
+    free(stmt->name);
+    free(stmt);
+    stmts++;
+  }
+  
+  if (!(st->flags & MPCA_LANG_PREDICTIVE)
+  &&   (st->flags & (MPCA_LANG_AUTO_PREDICTIVE | MPCA_LANG_PREDICTIVE_REPORT))) {
+    mpca_stmt_list_predict(lefts, n, st->flags);
+  }
+  
+  /* Dispatch tables are only built once every rule is defined */
+  for (i = 0; i < n; i++) { mpc_dispatch_update(lefts[i], mpca_passes(st)); }
+  
+  free(lefts);
+  free(x);
+  
+  return NULL;
+}
+
+static mpc_err_t *mpca_lang_st(mpc_input_t *i, mpca_grammar_st_t *st) {
+  
+  mpc_result_t r;
+  mpc_err_t *e;
+  mpc_parser_t *Lang, *Stmt, *Grammar, *Term, *Factor, *Base; 
+  
+  Lang    = mpc_new("lang");
+  Stmt    = mpc_new("stmt");
+  Grammar = mpc_new("grammar");
+  Term    = mpc_new("term");
+  Factor  = mpc_new("factor");
+  Base    = mpc_new("base");
+  
+  mpc_define(Lang, mpc_apply_to(
+    mpc_total(mpc_predictive(mpc_many(mpca_stmt_fold, Stmt)), mpca_stmt_list_delete),
+    mpca_stmt_list_apply_to, st
+  ));
+  
+  mpc_define(Stmt, mpc_and(5, mpca_stmt_afold,
+    mpc_tok(mpc_ident()), mpc_maybe(mpc_tok(mpc_string_lit())), mpc_sym(":"), Grammar, mpc_sym(";"),
+    free, free, free, mpc_soft_delete
+  ));
+  
+  mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
+      Term,
+      mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_sym("|"), Grammar, free)),
+      mpc_soft_delete
+  ));
+  
+  mpc_define(Term, mpc_many1(mpcaf_grammar_and, Factor));
+  
+  mpc_define(Factor, mpc_and(2, mpcaf_grammar_repeat,
+    Base,
+      mpc_or(6,
+        mpc_sym("*"),
+        mpc_sym("+"),
+        mpc_sym("?"),
+        mpc_sym("!"),
+        mpc_tok_brackets(mpc_int(), free),
+        mpc_pass()),
+    mpc_soft_delete
+  ));
+  
+  mpc_define(Base, mpc_or(5,
+    mpc_apply_to(mpc_tok(mpc_string_lit()), mpcaf_grammar_string, st),
+    mpc_apply_to(mpc_tok(mpc_char_lit()),   mpcaf_grammar_char, st),
+    mpc_apply_to(mpc_tok(mpc_regex_lit()),  mpcaf_grammar_regex, st),
+    mpc_apply_to(mpc_tok_braces(mpc_or(2, mpc_digits(), mpc_ident()), free), mpcaf_grammar_id, st),
+    mpc_tok_parens(Grammar, mpc_soft_delete)
+  ));
+  
+  mpc_optimise(Lang);
+  mpc_optimise(Stmt);
+  mpc_optimise(Grammar);
+  mpc_optimise(Term);
+  mpc_optimise(Factor);
+  mpc_optimise(Base);
+  
+  if (!mpc_parse_input(i, Lang, &r)) {
+    e = r.error;
+  } else {
+    e = NULL;
+  }
+  
+  mpc_cleanup(6, Lang, Stmt, Grammar, Term, Factor, Base);
+  mpc_scanner_delete(st->scanner);
+  st->scanner = NULL;
+  
+  return e;
+}
+
+mpc_err_t *mpca_lang_file(int flags, FILE *f, ...) {
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+
+  va_list va;  
+  va_start(va, f);
+  
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+  st.scanner = NULL;
+  
+  i = mpc_input_new_file("<mpca_lang_file>", f);
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+  
+  free(st.parsers);
+  va_end(va);
+  return err;
+}
+
+mpc_err_t *mpca_lang_pipe(int flags, FILE *p, ...) {
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+
+  va_list va;  
+  va_start(va, p);
+  
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+  st.scanner = NULL;
+  
+  i = mpc_input_new_pipe("<mpca_lang_pipe>", p);
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+  
+  free(st.parsers);
+  va_end(va);
+  return err;
+}
+
+mpc_err_t *mpca_lang(int flags, const char *language, ...) {
+  
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+  
+  va_list va;  
+  va_start(va, language);
+  
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+  st.scanner = NULL;
+  
+  i = mpc_input_new_string("<mpca_lang>", language, strlen(language));
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+  
+  free(st.parsers);
+  va_end(va);
+  return err;
+}
+
+mpc_err_t *mpca_lang_contents(int flags, const char *filename, ...) {
+  
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+  
+  va_list va;
+
+  FILE *f = fopen(filename, "rb");
+  
+  if (f == NULL) {
+    err = mpc_err_file(filename, "Unable to open file!");
+    return err;
+  }
+  
+  va_start(va, filename);
+  
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+  st.scanner = NULL;
+  
+  i = mpc_input_new_file(filename, f);
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+  
+  free(st.parsers);
+  va_end(va);  
+  
+  fclose(f);
+  
+  return err;
+}
+
+static int mpc_nodecount_unretained(mpc_parser_t* p, int force) {
+
+  int i, total;
+
+  if (p->retained && !force) { return 0; }
+
+  if (p->type == MPC_TYPE_EXPECT) { return 1 + mpc_nodecount_unretained(p->data.expect.x, 0); }
+
+  if (p->type == MPC_TYPE_APPLY)    { return 1 + mpc_nodecount_unretained(p->data.apply.x, 0); }
+  if (p->type == MPC_TYPE_APPLY_TO) { return 1 + mpc_nodecount_unretained(p->data.apply_to.x, 0); }
+  if (p->type == MPC_TYPE_PREDICT)  { return 1 + mpc_nodecount_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_MEMO)     { return 1 + mpc_nodecount_unretained(p->data.memo.x, 0); }
+  if (p->type == MPC_TYPE_DFA)      { return 1 + mpc_nodecount_unretained(p->data.dfa.x, 0); }
+  if (p->type == MPC_TYPE_SPAN)     { return 1 + mpc_nodecount_unretained(p->data.span.x, 0); }
+  if (p->type == MPC_TYPE_CAPTURE)  { return 1 + mpc_nodecount_unretained(p->data.capture.x, 0); }
+  if (p->type == MPC_TYPE_SKIP)     { return 1 + mpc_nodecount_unretained(p->data.capture.x, 0); }
+  if (p->type == MPC_TYPE_TOKEN)    { return 1 + mpc_nodecount_unretained(p->data.token.x, 0); }
+
+  if (p->type == MPC_TYPE_NOT)   { return 1 + mpc_nodecount_unretained(p->data.not.x, 0); }
+  if (p->type == MPC_TYPE_MAYBE) { return 1 + mpc_nodecount_unretained(p->data.not.x, 0); }
+
+  if (p->type == MPC_TYPE_MANY)  { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
+  if (p->type == MPC_TYPE_MANY1) { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
+  if (p->type == MPC_TYPE_COUNT) { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
+
+  if (p->type == MPC_TYPE_OR) { 
+    total = 1;
+    for(i = 0; i < p->data.or.n; i++) {
+      total += mpc_nodecount_unretained(p->data.or.xs[i], 0);
+    }
+    return total;
+  }
+  
+  if (p->type == MPC_TYPE_AND) {
+    total = 1;
+    for(i = 0; i < p->data.and.n; i++) {
+      total += mpc_nodecount_unretained(p->data.and.xs[i], 0);
+    }
+    return total;
+  }
+
+  return 1;
+  
+}
+
+void mpc_stats(mpc_parser_t* p) {
+  
+  int k;
+  static const char *names[] = {
+    "Expect", "Lift", "Inline", "Merge", "Factor",
+    "Span", "Skip", "Capture", "DFA", "Dispatch"
+  };
+  
+  printf("Stats\n");
+  printf("=====\n");
+  printf("Node Count: %i\n", mpc_nodecount_unretained(p, 1));
+  printf("Pool Allocations: %lu\n", mpc_mem_hits);
+  printf("Fallback Allocations: %lu\n", mpc_mem_misses);
+  printf("Memo Stores: %lu\n", mpc_memo_stores);
+  printf("Memo Hits: %lu\n", mpc_memo_hits);
+  printf("Memo Evictions: %lu\n", mpc_memo_evictions);
+  for (k = 0; k < MPC_OPTIMISE_PASSES; k++) {
+    printf("Optimise %s: %lu rewrites, %+ld nodes\n", names[k],
+      mpc_optimise_rewrites[k], mpc_optimise_nodes[k]);
+  }
+}
+
+/*
+** A `many` of a character class, or a choice between
+** several, folded into a string is turned into a span
+** which scans the run against a 256 bit set and makes
+** its output with one allocation. Functions given to
+** `mpc_satisfy` are assumed to give the same answer
+** for the same character every time. Classes of only
+** a few ranges of bytes also keep those ranges so that
+** they can be scanned with SIMD. `mpc_span` builds
+** one directly from the class it is given.
+*/
+
+static int mpc_span_class(mpc_parser_t *p, unsigned char *set) {
+  
+  int c, j;
+  
+  while (p->type == MPC_TYPE_EXPECT && !p->data.expect.x->retained) { p = p->data.expect.x; }
+  if (p->retained) { return 0; }
+  
+  switch (p->type) {
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_SATISFY:
+      for (c = 0; c < 256; c++) {
+        if (p->type == MPC_TYPE_ANY
+        || (p->type == MPC_TYPE_SATISFY ? p->data.satisfy.f((char)c) : mpc_first_char(p, (char)c))) {
+          set[c / 8] |= 1 << (c % 8);
+        }
+      }
+      return 1;
+    case MPC_TYPE_OR:
+      for (j = 0; j < p->data.or.n; j++) {
+        if (!mpc_span_class(p->data.or.xs[j], set)) { return 0; }
+      }
+      return p->data.or.n > 0;
+    default: return 0;
+  }
+}
+
+/* Moves a parser into a new anonymous one so that it can be wrapped in place */
+static mpc_parser_t *mpc_optimise_inner(mpc_parser_t *p) {
+  mpc_parser_t *t = mpc_undefined();
+  memcpy(t, p, sizeof(mpc_parser_t));
+  t->retained = 0;
+  t->name = NULL;
+  return t;
+}
+
+static void mpc_span_new(mpc_parser_t *p, const unsigned char *set) {
+  
+  int c, e, n = 0;
+  mpc_parser_t *t = mpc_optimise_inner(p);
+  
+  p->type = MPC_TYPE_SPAN;
+  p->data.span.x = t;
+  p->data.span.min = t->type == MPC_TYPE_MANY1;
+  p->data.span.set = malloc(32);
+  memcpy(p->data.span.set, set, 32);
+  
+  /* Nul is in most sets but not worth a range of its own */
+  for (c = 1; c < 256 && n >= 0; c = e) {
+    for (e = c; e < 256 && (set[e / 8] & (1 << (e % 8))); e++);
+    if (e == c) { e++; continue; }
+    if (n == MPC_INPUT_SPAN_RANGES) { n = -1; break; }
+    p->data.span.ranges[n*2+0] = (unsigned char)c;
+    p->data.span.ranges[n*2+1] = (unsigned char)(e - 1);
+    n++;
+  }
+  p->data.span.ranges_num = n < 0 ? 0 : n;
+}
+
+/* Anything other than a class is left as the `many` it would be */
+static mpc_parser_t *mpc_span_of(mpc_parser_t *p) {
+  unsigned char set[32];
+  if (mpc_span_class(p->data.repeat.x, memset(set, 0, 32))) { mpc_span_new(p, set); }
+  return p;
+}
+
+mpc_parser_t *mpc_span(mpc_parser_t *a) {
+  return mpc_span_of(mpc_many(mpcf_strfold, a));
+}
+
+mpc_parser_t *mpc_span1(mpc_parser_t *a) {
+  return mpc_span_of(mpc_many1(mpcf_strfold, a));
+}
+
+/*
+** The optimiser is a pipeline of rewrites, each applied
+** bottom up to the parsers below a rule until none of
+** them match. Which ones run is given with each call,
+** to `mpc_optimise_with`, `mpc_re_with`, or for all of
+** the rules of a language with `MPCA_LANG_NO_OPTIMISE`,
+** and `mpc_stats` reports how often each one fired and
+** how many nodes it added or took away.
+*/
+
+static int mpc_capture_text(mpc_parser_t *p, int force, int guarded);
+
+/* Moves the contents of `t` into `p`, which keeps its name and whether it is retained */
+static void mpc_optimise_replace(mpc_parser_t *p, mpc_parser_t *t) {
+  char retained = p->retained;
+  char *name = p->name;
+  memcpy(p, t, sizeof(mpc_parser_t));
+  p->retained = retained;
+  p->name = name;
+  mpc_parser_free(t);
+}
+
+/*
+** Whether two parsers always match the same input in
+** the same way. Rules are only the same as themselves
+** and functions are compared by address.
+*/
+
+static int mpc_optimise_same(mpc_parser_t *a, mpc_parser_t *b) {
+  
+  int j;
+  
+  if (a == b) { return 1; }
+  if (a->retained || b->retained || a->type != b->type) { return 0; }
+  
+  switch (a->type) {
+    case MPC_TYPE_PASS:
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_STATE:    return 1;
+    case MPC_TYPE_FAIL:     return strcmp(a->data.fail.m, b->data.fail.m) == 0;
+    case MPC_TYPE_LIFT:     return a->data.lift.lf == b->data.lift.lf;
+    case MPC_TYPE_LIFT_VAL: return a->data.lift.x == b->data.lift.x;
+    case MPC_TYPE_ANCHOR:   return a->data.anchor.f == b->data.anchor.f;
+    case MPC_TYPE_SINGLE:   return a->data.single.x == b->data.single.x;
+    case MPC_TYPE_RANGE:    return a->data.range.x == b->data.range.x && a->data.range.y == b->data.range.y;
+    case MPC_TYPE_SATISFY:  return a->data.satisfy.f == b->data.satisfy.f;
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_STRING:   return strcmp(a->data.string.x, b->data.string.x) == 0;
+    
+    case MPC_TYPE_EXPECT:
+      return strcmp(a->data.expect.m, b->data.expect.m) == 0
+        && mpc_optimise_same(a->data.expect.x, b->data.expect.x);
+    case MPC_TYPE_APPLY:
+      return a->data.apply.f == b->data.apply.f
+        && mpc_optimise_same(a->data.apply.x, b->data.apply.x);
+    case MPC_TYPE_APPLY_TO:
+      return a->data.apply_to.f == b->data.apply_to.f && a->data.apply_to.d == b->data.apply_to.d
+        && mpc_optimise_same(a->data.apply_to.x, b->data.apply_to.x);
+    
+    case MPC_TYPE_PREDICT:
+      return a->data.predict.dx == b->data.predict.dx
+        && mpc_optimise_same(a->data.predict.x, b->data.predict.x);
+    case MPC_TYPE_DFA:     return mpc_optimise_same(a->data.dfa.x, b->data.dfa.x);
+    case MPC_TYPE_SPAN:    return mpc_optimise_same(a->data.span.x, b->data.span.x);
+    case MPC_TYPE_CAPTURE:
+    case MPC_TYPE_SKIP:    return mpc_optimise_same(a->data.capture.x, b->data.capture.x);
+    case MPC_TYPE_TOKEN:
+      return a->data.token.s == b->data.token.s && a->data.token.kind == b->data.token.kind
+        && mpc_optimise_same(a->data.token.x, b->data.token.x);
+    
+    case MPC_TYPE_NOT:
+    case MPC_TYPE_MAYBE:
+      return a->data.not.dx == b->data.not.dx && a->data.not.lf == b->data.not.lf
+        && mpc_optimise_same(a->data.not.x, b->data.not.x);
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      return a->data.repeat.n == b->data.repeat.n && a->data.repeat.f == b->data.repeat.f
+        && a->data.repeat.dx == b->data.repeat.dx
+        && mpc_optimise_same(a->data.repeat.x, b->data.repeat.x);
+    
+    case MPC_TYPE_OR:
+      if (a->data.or.n != b->data.or.n) { return 0; }
+      for (j = 0; j < a->data.or.n; j++) {
+        if (!mpc_optimise_same(a->data.or.xs[j], b->data.or.xs[j])) { return 0; }
+      }
+      return 1;
+    
+    case MPC_TYPE_AND:
+      if (a->data.and.n != b->data.and.n || a->data.and.f != b->data.and.f) { return 0; }
+      for (j = 0; j < a->data.and.n; j++) {
+        if (!mpc_optimise_same(a->data.and.xs[j], b->data.and.xs[j])) { return 0; }
+        if (j < a->data.and.n-1 && a->data.and.dxs[j] != b->data.and.dxs[j]) { return 0; }
+      }
+      return 1;
+    
+    default: return 0;
+  }
+}
+
+/*
+** Neighbouring alternatives which begin by matching
+** the same thing are factored into that followed by
+** a choice between their rests, so it is only matched
+** once. The fold must take each rest as one value,
+** which is true of strings but of ASTs only when the
+** rest is a single parser. Without backtracking the
+** next alternative would start where a failed one
+** stopped, so nothing below `mpc_predictive` is
+** factored. The choice stays an `or` even when only
+** the factored alternative is left, because an `or`
+** reports what its alternatives expected itself and
+** the labels a `many1` or `count` adds would change.
+*/
+
+static int mpc_optimise_shares(mpc_parser_t *a, mpc_parser_t *b) {
+  
+  if (a->type != MPC_TYPE_AND || b->type != MPC_TYPE_AND) { return 0; }
+  if (a->retained || b->retained || a->data.and.f != b->data.and.f) { return 0; }
+  if (a->data.and.n < 2 || b->data.and.n < 2) { return 0; }
+  if (a->data.and.dxs[0] != b->data.and.dxs[0]) { return 0; }
+  
+  if (a->data.and.f == mpcf_fold_ast && (a->data.and.n != 2 || b->data.and.n != 2)) { return 0; }
+  if (a->data.and.f != mpcf_fold_ast && a->data.and.f != mpcf_strfold) { return 0; }
+  
+  return mpc_optimise_same(a->data.and.xs[0], b->data.and.xs[0]);
+}
+
+static int mpc_optimise_rewrite(mpc_parser_t *p, int flags);
+
+static void mpc_optimise_factor(mpc_parser_t *p, int j, int k, int flags) {
+  
+  int l, m;
+  mpc_parser_t *a = p->data.or.xs[j], *b, *t, *rest;
+  
+  rest = mpc_undefined();
+  rest->type = MPC_TYPE_OR;
+  rest->data.or.n = k - j;
+  rest->data.or.xs = malloc(sizeof(mpc_parser_t*) * (k - j));
+  
+  for (l = j; l < k; l++) {
+    
+    b = p->data.or.xs[l];
+    m = b->data.and.n - 1;
+    
+    if (m == 1) {
+      t = b->data.and.xs[1];
+    } else {
+      t = mpc_undefined();
+      t->type = MPC_TYPE_AND;
+      t->data.and.n = m;
+      t->data.and.f = b->data.and.f;
+      t->data.and.xs = malloc(sizeof(mpc_parser_t*) * m);
+      t->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (m-1));
+      memcpy(t->data.and.xs, b->data.and.xs + 1, sizeof(mpc_parser_t*) * m);
+      memcpy(t->data.and.dxs, b->data.and.dxs + 1, sizeof(mpc_dtor_t) * (m-1));
+    }
+    rest->data.or.xs[l - j] = t;
+    
+    if (l > j) {
+      mpc_soft_delete(b->data.and.xs[0]);
+      free(b->data.and.xs); free(b->data.and.dxs); free(b->name); mpc_parser_free(b);
+    }
+  }
+  
+  a->data.and.n = 2;
+  a->data.and.xs[1] = rest;
+  
+  memmove(p->data.or.xs + j + 1, p->data.or.xs + k, (p->data.or.n - k) * sizeof(mpc_parser_t*));
+  p->data.or.n -= k - j - 1;
+  
+  /* The rests may share a beginning of their own */
+  while (mpc_optimise_rewrite(rest, flags)) {}
+}
+
+/* Applies the first rewrite which matches `p` and returns its pass, or zero */
+static int mpc_optimise_rewrite(mpc_parser_t *p, int flags) {
+  
+  int i, j, k, n, m;
+  mpc_parser_t *t;
+  
+  /* Collapse nested `expect` */
+  if ((flags & MPC_OPTIMISE_EXPECT)
+  &&  p->type == MPC_TYPE_EXPECT
+  &&  p->data.expect.x->type == MPC_TYPE_EXPECT
+  && !p->data.expect.x->retained) {
+    t = p->data.expect.x;
+    p->data.expect.x = t->data.expect.x;
+    free(t->data.expect.m); free(t->name); mpc_parser_free(t);
+    return MPC_OPTIMISE_EXPECT;
+  }
+  
+  /* Hoist constant `lift` */
+  if ((flags & MPC_OPTIMISE_LIFT)
+  &&  p->type == MPC_TYPE_LIFT
+  &&  p->data.lift.lf == mpcf_ctor_null) {
+    p->type = MPC_TYPE_PASS;
+    return MPC_OPTIMISE_LIFT;
+  }
+  
+  /* Inline `or` of one `or` */
+  if ((flags & MPC_OPTIMISE_INLINE)
+  &&  p->type == MPC_TYPE_OR
+  &&  p->data.or.n == 1
+  &&  p->data.or.xs[0]->type == MPC_TYPE_OR
+  && !p->data.or.xs[0]->retained) {
+    t = p->data.or.xs[0];
+    free(p->data.or.xs); free(p->data.or.dispatch);
+    mpc_optimise_replace(p, t);
+    return MPC_OPTIMISE_INLINE;
+  }
+  
+  /* Inline `and` of one */
+  if ((flags & MPC_OPTIMISE_INLINE)
+  &&  p->type == MPC_TYPE_AND
+  &&  p->data.and.n == 1
+  && !p->data.and.xs[0]->retained
+  && (p->data.and.f == mpcf_strfold || p->data.and.f == mpcf_fold_ast
+  ||  p->data.and.f == mpcf_fst     || p->data.and.f == mpcf_fst_free)) {
+    t = p->data.and.xs[0];
+    free(p->data.and.xs); free(p->data.and.dxs);
+    mpc_optimise_replace(p, t);
+    return MPC_OPTIMISE_INLINE;
+  }
+  
+  if (flags & MPC_OPTIMISE_MERGE) {
+    
+    /* Merge rhs `or` */
+    if (p->type == MPC_TYPE_OR
+    &&  p->data.or.xs[p->data.or.n-1]->type == MPC_TYPE_OR
+    && !p->data.or.xs[p->data.or.n-1]->retained) {
+      t = p->data.or.xs[p->data.or.n-1];
+      n = p->data.or.n; m = t->data.or.n;
+      p->data.or.n = n + m - 1;
+      p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
+      memmove(p->data.or.xs + n - 1, t->data.or.xs, m * sizeof(mpc_parser_t*));
+      free(t->data.or.xs); free(t->data.or.dispatch); free(t->name); mpc_parser_free(t);
+      return MPC_OPTIMISE_MERGE;
+    }
+
+    /* Merge lhs `or` */
+    if (p->type == MPC_TYPE_OR
+    &&  p->data.or.xs[0]->type == MPC_TYPE_OR
+    && !p->data.or.xs[0]->retained) {
+      t = p->data.or.xs[0];
+      n = p->data.or.n; m = t->data.or.n;
+      p->data.or.n = n + m - 1;
+      p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
+      memmove(p->data.or.xs + m, p->data.or.xs + 1, (n - 1) * sizeof(mpc_parser_t*));
+      memmove(p->data.or.xs, t->data.or.xs, m * sizeof(mpc_parser_t*));
+      free(t->data.or.xs); free(t->data.or.dispatch); free(t->name); mpc_parser_free(t);
+      return MPC_OPTIMISE_MERGE;
+    }
+    
+    /* Remove ast `pass` */
+    if (p->type == MPC_TYPE_AND
+    &&  p->data.and.n == 2
+    &&  p->data.and.xs[0]->type == MPC_TYPE_PASS
+    && !p->data.and.xs[0]->retained
+    && !p->data.and.xs[1]->retained
+    &&  p->data.and.f == mpcf_fold_ast) {
+      t = p->data.and.xs[1];
+      mpc_delete(p->data.and.xs[0]);
+      free(p->data.and.xs); free(p->data.and.dxs);
+      mpc_optimise_replace(p, t);
+      return MPC_OPTIMISE_MERGE;
+    }
+    
+    /* Merge ast lhs `and` */
+    if (p->type == MPC_TYPE_AND
+    &&  p->data.and.f == mpcf_fold_ast
+    &&  p->data.and.xs[0]->type == MPC_TYPE_AND
+    && !p->data.and.xs[0]->retained
+    &&  p->data.and.xs[0]->data.and.f == mpcf_fold_ast) {
+      t = p->data.and.xs[0];
+      n = p->data.and.n; m = t->data.and.n;
+      p->data.and.n = n + m - 1;
+      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t*) * (n + m - 1));
+      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
+      memmove(p->data.and.xs + m, p->data.and.xs + 1, (n - 1) * sizeof(mpc_parser_t*));
+      memmove(p->data.and.xs, t->data.and.xs, m * sizeof(mpc_parser_t*));
+      for (i = 0; i < p->data.and.n-1; i++) { p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete; }
+      free(t->data.and.xs); free(t->data.and.dxs); free(t->name); mpc_parser_free(t); 
+      return MPC_OPTIMISE_MERGE;
+    }
+    
+    /* Merge ast rhs `and` */
+    if (p->type == MPC_TYPE_AND
+    &&  p->data.and.f == mpcf_fold_ast
+    &&  p->data.and.xs[p->data.and.n-1]->type == MPC_TYPE_AND
+    && !p->data.and.xs[p->data.and.n-1]->retained
+    &&  p->data.and.xs[p->data.and.n-1]->data.and.f == mpcf_fold_ast) {
+      t = p->data.and.xs[p->data.and.n-1];
+      n = p->data.and.n; m = t->data.and.n;
+      p->data.and.n = n + m - 1;
+      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t*) * (n + m -1));
+      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
+      memmove(p->data.and.xs + n - 1, t->data.and.xs, m * sizeof(mpc_parser_t*));
+      for (i = 0; i < p->data.and.n-1; i++) { p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete; }
+      free(t->data.and.xs); free(t->data.and.dxs); free(t->name); mpc_parser_free(t); 
+      return MPC_OPTIMISE_MERGE;
+    }
+
+    /* Remove re `lift` */
+    if (p->type == MPC_TYPE_AND
+    &&  p->data.and.n == 2
+    &&  p->data.and.xs[0]->type == MPC_TYPE_LIFT
+    &&  p->data.and.xs[0]->data.lift.lf == mpcf_ctor_str
+    && !p->data.and.xs[0]->retained
+    && !p->data.and.xs[1]->retained
+    &&  p->data.and.f == mpcf_strfold) {
+      t = p->data.and.xs[1];
+      mpc_delete(p->data.and.xs[0]);
+      free(p->data.and.xs); free(p->data.and.dxs);
+      mpc_optimise_replace(p, t);
+      return MPC_OPTIMISE_MERGE;
+    }
+
+    /* Merge re lhs `and` */
+    if (p->type == MPC_TYPE_AND
+    &&  p->data.and.f == mpcf_strfold
+    &&  p->data.and.xs[0]->type == MPC_TYPE_AND
+    && !p->data.and.xs[0]->retained
+    &&  p->data.and.xs[0]->data.and.f == mpcf_strfold) {
+      t = p->data.and.xs[0];
+      n = p->data.and.n; m = t->data.and.n;
+      p->data.and.n = n + m - 1;
+      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t*) * (n + m - 1));
+      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
+      memmove(p->data.and.xs + m, p->data.and.xs + 1, (n - 1) * sizeof(mpc_parser_t*));
+      memmove(p->data.and.xs, t->data.and.xs, m * sizeof(mpc_parser_t*));
+      for (i = 0; i < p->data.and.n-1; i++) { p->data.and.dxs[i] = free; }
+      free(t->data.and.xs); free(t->data.and.dxs); free(t->name); mpc_parser_free(t); 
+      return MPC_OPTIMISE_MERGE;
+    }
+    
+    /* Merge re rhs `and` */
+    if (p->type == MPC_TYPE_AND
+    &&  p->data.and.f == mpcf_strfold
+    &&  p->data.and.xs[p->data.and.n-1]->type == MPC_TYPE_AND
+    && !p->data.and.xs[p->data.and.n-1]->retained
+    &&  p->data.and.xs[p->data.and.n-1]->data.and.f == mpcf_strfold) {
+      t = p->data.and.xs[p->data.and.n-1];
+      n = p->data.and.n; m = t->data.and.n;
+      p->data.and.n = n + m - 1;
+      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t*) * (n + m -1));
+      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
+      memmove(p->data.and.xs + n - 1, t->data.and.xs, m * sizeof(mpc_parser_t*));
+      for (i = 0; i < p->data.and.n-1; i++) { p->data.and.dxs[i] = free; }
+      free(t->data.and.xs); free(t->data.and.dxs); free(t->name); mpc_parser_free(t); 
+      return MPC_OPTIMISE_MERGE;
+    }
+    
+  }
+  
+  /* Factor out shared beginnings */
+  if ((flags & MPC_OPTIMISE_FACTOR) && p->type == MPC_TYPE_OR) {
+    for (j = 0; j < p->data.or.n - 1; j++) {
+      for (k = j + 1; k < p->data.or.n && mpc_optimise_shares(p->data.or.xs[j], p->data.or.xs[k]); k++);
+      if (k - j > 1) {
+        mpc_optimise_factor(p, j, k, flags);
+        return MPC_OPTIMISE_FACTOR;
+      }
+    }
+  }
+  
+  /* Scan re `many` of a class as a span */
+  if ((flags & MPC_OPTIMISE_SPAN)
+  &&  (p->type == MPC_TYPE_MANY || p->type == MPC_TYPE_MANY1)
+  &&  p->data.repeat.f == mpcf_strfold
+  &&  mpc_span_of(p)->type == MPC_TYPE_SPAN) {
+    return MPC_OPTIMISE_SPAN;
+  }
+  
+  /* Match freed text without building it */
+  if ((flags & MPC_OPTIMISE_SKIP)
+  &&  p->type == MPC_TYPE_APPLY
+  &&  p->data.apply.f == mpcf_free
+  &&  mpc_capture_text(p->data.apply.x, 0, 1)) {
+    t = p->data.apply.x;
+    p->type = MPC_TYPE_SKIP;
+    p->data.capture.x = t;
+    return MPC_OPTIMISE_SKIP;
+  }
+  
+  return 0;
+}
+
+static void mpc_optimise_unretained(mpc_parser_t *p, int force, int flags) {
+  
+  int i, pass;
+  long n, m;
+  
+  if (p->retained && !force) { return; }
+  
+  /* Optimise Subexpressions */
+  
+  if (p->type == MPC_TYPE_EXPECT)   { mpc_optimise_unretained(p->data.expect.x, 0, flags); }
+  if (p->type == MPC_TYPE_APPLY)    { mpc_optimise_unretained(p->data.apply.x, 0, flags); }
+  if (p->type == MPC_TYPE_APPLY_TO) { mpc_optimise_unretained(p->data.apply_to.x, 0, flags); }
+  if (p->type == MPC_TYPE_PREDICT)  { mpc_optimise_unretained(p->data.predict.x, 0, flags & ~MPC_OPTIMISE_FACTOR); }
+  if (p->type == MPC_TYPE_MEMO)     { mpc_optimise_unretained(p->data.memo.x, 0, flags); }
+  if (p->type == MPC_TYPE_DFA)      { mpc_optimise_unretained(p->data.dfa.x, 0, flags); }
+  if (p->type == MPC_TYPE_CAPTURE)  { mpc_optimise_unretained(p->data.capture.x, 0, flags); }
+  if (p->type == MPC_TYPE_SKIP)     { mpc_optimise_unretained(p->data.capture.x, 0, flags); }
+  if (p->type == MPC_TYPE_TOKEN)    { mpc_optimise_unretained(p->data.token.x, 0, flags); }
+  if (p->type == MPC_TYPE_NOT)      { mpc_optimise_unretained(p->data.not.x, 0, flags); }
+  if (p->type == MPC_TYPE_MAYBE)    { mpc_optimise_unretained(p->data.not.x, 0, flags); }
+  if (p->type == MPC_TYPE_MANY)     { mpc_optimise_unretained(p->data.repeat.x, 0, flags); }
+  if (p->type == MPC_TYPE_MANY1)    { mpc_optimise_unretained(p->data.repeat.x, 0, flags); }
+  if (p->type == MPC_TYPE_COUNT)    { mpc_optimise_unretained(p->data.repeat.x, 0, flags); }
+  
+  if (p->type == MPC_TYPE_OR) { 
+    for(i = 0; i < p->data.or.n; i++) {
+      mpc_optimise_unretained(p->data.or.xs[i], 0, flags);
+    }
+  }
+  
+  if (p->type == MPC_TYPE_AND) {
+    for(i = 0; i < p->data.and.n; i++) {
+      mpc_optimise_unretained(p->data.and.xs[i], 0, flags);
+    }
+  }  
+  
+  /* Perform optimisations */
+  
+  n = mpc_nodecount_unretained(p, 1);
+  while ((pass = mpc_optimise_rewrite(p, flags)) != 0) {
+    m = mpc_nodecount_unretained(p, 1);
+    mpc_optimise_note(pass, m - n);
+    n = m;
+  }
+  
+}
+
+/*
+** FIRST sets are found over every parser reachable
+** from the one being optimised, including other
+** rules, by repeatedly recomputing each from those
+** of its children until nothing changes. A parser
+** which can succeed without consuming input is
+** nullable, and lets whatever follows it in an
+** `and` contribute to the set too.
+*/
+
+typedef struct {
+  unsigned char set[32];
+  char nullable;
+} mpc_first_t;
+
+typedef struct {
+  mpc_parser_t **nodes;
+  mpc_first_t *firsts;
+  int num;
+  int slots;
+  int *index;
+  int index_slots;
+} mpc_firsts_t;
+
+static int mpc_parser_children(mpc_parser_t *p, mpc_parser_t ***xs) {
+  switch (p->type) {
+    case MPC_TYPE_APPLY:    *xs = &p->data.apply.x;    return 1;
+    case MPC_TYPE_APPLY_TO: *xs = &p->data.apply_to.x; return 1;
+    case MPC_TYPE_PREDICT:  *xs = &p->data.predict.x;  return 1;
+    case MPC_TYPE_MEMO:     *xs = &p->data.memo.x;     return 1;
+    case MPC_TYPE_DFA:      *xs = &p->data.dfa.x;      return 1;
+    case MPC_TYPE_SPAN:     *xs = &p->data.span.x;     return 1;
+    case MPC_TYPE_CAPTURE:
+    case MPC_TYPE_SKIP:     *xs = &p->data.capture.x;  return 1;
+    case MPC_TYPE_TOKEN:    *xs = &p->data.token.x;    return 1;
+    case MPC_TYPE_EXPECT:   *xs = &p->data.expect.x;   return 1;
+    case MPC_TYPE_MAYBE:
+    case MPC_TYPE_NOT:      *xs = &p->data.not.x;      return 1;
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:    *xs = &p->data.repeat.x;   return 1;
+    case MPC_TYPE_OR:       *xs = p->data.or.xs;       return p->data.or.n;
+    case MPC_TYPE_AND:      *xs = p->data.and.xs;      return p->data.and.n;
+    default:                *xs = NULL;                return 0;
+  }
+}
+
+static int mpc_firsts_slot(mpc_firsts_t *f, mpc_parser_t *p) {
+  int j = (int)((((size_t)p >> 4) * 2654435761UL) & (size_t)(f->index_slots - 1));
+  while (f->index[j] != 0 && f->nodes[f->index[j]-1] != p) {
+    j = (j + 1) & (f->index_slots - 1);
+  }
+  return j;
+}
+
+static mpc_first_t *mpc_firsts_get(mpc_firsts_t *f, mpc_parser_t *p) {
+  return &f->firsts[f->index[mpc_firsts_slot(f, p)]-1];
+}
+
+static void mpc_firsts_collect(mpc_firsts_t *f, mpc_parser_t *p) {
+  
+  int j, n;
+  mpc_parser_t **xs;
+  
+  if (f->index[mpc_firsts_slot(f, p)] != 0) { return; }
+  
+  if (f->num == f->slots) {
+    f->slots *= 2;
+    f->nodes = realloc(f->nodes, sizeof(mpc_parser_t*) * f->slots);
+  }
+  
+  if (2 * (f->num + 1) > f->index_slots) {
+    free(f->index);
+    f->index_slots *= 2;
+    f->index = calloc(f->index_slots, sizeof(int));
+    for (j = 0; j < f->num; j++) {
+      f->index[mpc_firsts_slot(f, f->nodes[j])] = j + 1;
+    }
+  }
+  
+  f->nodes[f->num++] = p;
+  f->index[mpc_firsts_slot(f, p)] = f->num;
+  p->first = 1;
+  
+  n = mpc_parser_children(p, &xs);
+  for (j = 0; j < n; j++) { mpc_firsts_collect(f, xs[j]); }
+}
+
+static void mpc_first_union(mpc_first_t *s, const mpc_first_t *x) {
+  int j;
+  for (j = 0; j < 32; j++) { s->set[j] |= x->set[j]; }
+}
+
+static int mpc_first_char(mpc_parser_t *p, char c) {
+  switch (p->type) {
+    case MPC_TYPE_SINGLE: return c == p->data.single.x;
+    case MPC_TYPE_RANGE:  return c >= p->data.range.x && c <= p->data.range.y;
+    case MPC_TYPE_ONEOF:  return strchr(p->data.string.x, c) != 0;
+    case MPC_TYPE_NONEOF: return strchr(p->data.string.x, c) == 0;
+    default: return 1;
+  }
+}
+
+static int mpc_first_update(mpc_firsts_t *f, int k) {
+  
+  int j, c, changed = 0;
+  mpc_parser_t *p = f->nodes[k];
+  mpc_first_t *t = &f->firsts[k];
+  mpc_first_t s, *x;
+  
+  memset(&s, 0, sizeof(mpc_first_t));
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      for (c = 0; c < 256; c++) {
+        if (mpc_first_char(p, (char)c)) { s.set[c / 8] |= 1 << (c % 8); }
+      }
+      break;
+    
+    case MPC_TYPE_STRING:
+      c = (unsigned char)p->data.string.x[0];
+      if (c) { s.set[c / 8] |= 1 << (c % 8); } else { s.nullable = 1; }
+      break;
+    
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SATISFY:
+      memset(s.set, 0xFF, 32);
+      break;
+    
+    case MPC_TYPE_FAIL: break;
+    
+    case MPC_TYPE_ANCHOR:
+    case MPC_TYPE_PASS:
+    case MPC_TYPE_LIFT:
+    case MPC_TYPE_LIFT_VAL:
+    case MPC_TYPE_STATE:
+    case MPC_TYPE_NOT:
+      s.nullable = 1;
+      break;
+    
+    case MPC_TYPE_APPLY:    s = *mpc_firsts_get(f, p->data.apply.x);    break;
+    case MPC_TYPE_APPLY_TO: s = *mpc_firsts_get(f, p->data.apply_to.x); break;
+    case MPC_TYPE_PREDICT:  s = *mpc_firsts_get(f, p->data.predict.x);  break;
+    case MPC_TYPE_MEMO:     s = *mpc_firsts_get(f, p->data.memo.x);     break;
+    case MPC_TYPE_DFA:      s = *mpc_firsts_get(f, p->data.dfa.x);      break;
+    case MPC_TYPE_SPAN:     s = *mpc_firsts_get(f, p->data.span.x);     break;
+    case MPC_TYPE_CAPTURE:
+    case MPC_TYPE_SKIP:     s = *mpc_firsts_get(f, p->data.capture.x);  break;
+    case MPC_TYPE_TOKEN:    s = *mpc_firsts_get(f, p->data.token.x);    break;
+    case MPC_TYPE_EXPECT:   s = *mpc_firsts_get(f, p->data.expect.x);   break;
+    
+    case MPC_TYPE_MAYBE:
+      s = *mpc_firsts_get(f, p->data.not.x);
+      s.nullable = 1;
+      break;
+    
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      s = *mpc_firsts_get(f, p->data.repeat.x);
+      if (p->type == MPC_TYPE_MANY || (p->type == MPC_TYPE_COUNT && p->data.repeat.n == 0)) {
+        s.nullable = 1;
+      }
+      break;
+    
+    case MPC_TYPE_OR:
+      if (p->data.or.n == 0) { s.nullable = 1; }
+      for (j = 0; j < p->data.or.n; j++) {
+        x = mpc_firsts_get(f, p->data.or.xs[j]);
+        mpc_first_union(&s, x);
+        s.nullable |= x->nullable;
+      }
+      break;
+    
+    case MPC_TYPE_AND:
+      s.nullable = 1;
+      for (j = 0; j < p->data.and.n && s.nullable; j++) {
+        x = mpc_firsts_get(f, p->data.and.xs[j]);
+        mpc_first_union(&s, x);
+        s.nullable = x->nullable;
+      }
+      break;
+    
+    /* Undefined and unknown parsers could match anything */
+    default:
+      memset(s.set, 0xFF, 32);
+      s.nullable = 1;
+      break;
+  }
+  
+  for (j = 0; j < 32; j++) {
+    if (s.set[j] & ~t->set[j]) { t->set[j] |= s.set[j]; changed = 1; }
+  }
+  if (s.nullable && !t->nullable) { t->nullable = 1; changed = 1; }
+  
+  return changed;
+}
+
+static void mpc_dispatch_free(mpc_parser_t *p, int force) {
+  
+  int j, n;
+  mpc_parser_t **xs;
+  
+  if (p->retained && !force) { return; }
+  
+  if (p->type == MPC_TYPE_OR) {
+    free(p->data.or.dispatch);
+    p->data.or.dispatch = NULL;
+  }
+  
+  if (p->type == MPC_TYPE_MAYBE) {
+    free(p->data.not.lookahead);
+    p->data.not.lookahead = NULL;
+  }
+  
+  if (p->type == MPC_TYPE_MANY || p->type == MPC_TYPE_MANY1) {
+    free(p->data.repeat.lookahead);
+    p->data.repeat.lookahead = NULL;
+  }
+  
+  n = mpc_parser_children(p, &xs);
+  for (j = 0; j < n; j++) { mpc_dispatch_free(xs[j], 0); }
+}
+
+static void mpc_dispatch_build(mpc_firsts_t *f, mpc_parser_t *p, int force) {
+  
+  int j, n, c, w, skips = 0;
+  mpc_parser_t **xs;
+  mpc_first_t *x;
+  unsigned char *d;
+  
+  if (p->retained && !force) { return; }
+  
+  n = mpc_parser_children(p, &xs);
+  for (j = 0; j < n; j++) { mpc_dispatch_build(f, xs[j], 0); }
+  
+  if (p->type == MPC_TYPE_OR && p->data.or.n > 0) {
+    
+    w = (p->data.or.n + 7) / 8;
+    d = calloc(MPC_DISPATCH_ROWS, w);
+    
+    for (j = 0; j < p->data.or.n; j++) {
+      x = mpc_firsts_get(f, p->data.or.xs[j]);
+      for (c = 0; c < MPC_DISPATCH_ROWS; c++) {
+        if (x->nullable || (c < 256 && x->set[c / 8] & (1 << (c % 8)))) {
+          d[c * w + j / 8] |= 1 << (j % 8);
+        } else {
+          skips = 1;
+        }
+      }
+    }
+    
+    if (skips) {
+      p->data.or.dispatch = d;
+      p->data.or.gen = mpc_generation;
+      mpc_optimise_note(MPC_OPTIMISE_DISPATCH, 0);
+    } else {
+      free(d);
+    }
+  }
+  
+  if (p->type == MPC_TYPE_MAYBE
+  && !mpc_firsts_get(f, p->data.not.x)->nullable) {
+    p->data.not.lookahead = malloc(32);
+    memcpy(p->data.not.lookahead, mpc_firsts_get(f, p->data.not.x)->set, 32);
+    p->data.not.gen = mpc_generation;
+    mpc_optimise_note(MPC_OPTIMISE_DISPATCH, 0);
+  }
+  
+  if ((p->type == MPC_TYPE_MANY || p->type == MPC_TYPE_MANY1)
+  && !mpc_firsts_get(f, p->data.repeat.x)->nullable) {
+    p->data.repeat.lookahead = malloc(32);
+    memcpy(p->data.repeat.lookahead, mpc_firsts_get(f, p->data.repeat.x)->set, 32);
+    p->data.repeat.gen = mpc_generation;
+    mpc_optimise_note(MPC_OPTIMISE_DISPATCH, 0);
+  }
+}
+
+static void mpc_firsts_find(mpc_firsts_t *f, mpc_parser_t **ps, int n) {
+  
+  int k, changed = 1;
+  
+  f->num = 0;
+  f->slots = 64;
+  f->nodes = malloc(sizeof(mpc_parser_t*) * f->slots);
+  f->index_slots = 128;
+  f->index = calloc(f->index_slots, sizeof(int));
+  
+  for (k = 0; k < n; k++) { mpc_firsts_collect(f, ps[k]); }
+  f->firsts = calloc(f->num, sizeof(mpc_first_t));
+  
+  while (changed) {
+    changed = 0;
+    for (k = f->num-1; k >= 0; k--) { changed |= mpc_first_update(f, k); }
+  }
+}
+
+static void mpc_firsts_free(mpc_firsts_t *f) {
+  free(f->nodes);
+  free(f->firsts);
+  free(f->index);
+}
+
+static void mpc_dispatch_update(mpc_parser_t *p, int flags) {
+  
+  mpc_firsts_t f;
+  
+  mpc_dispatch_free(p, 1);
+  if (!(flags & MPC_OPTIMISE_DISPATCH)) { return; }
+  
+  mpc_firsts_find(&f, &p, 1);
+  mpc_dispatch_build(&f, p, 1);
+  mpc_firsts_free(&f);
+}
+
+/*
+** Rules which are LL(1) can be parsed without
+** backtracking. Then a parser which fails part way
+** through leaves the input where it stopped, so an
+** `or` trying its next alternative, or a `maybe` or
+** `many` giving up, carries on from the wrong place.
+** A checked predictive rule fails if that happens,
+** which is the same result as backtracking provided
+** the rule would have failed there anyway: whatever
+** the failed parser starts with must not start a
+** later alternative, or be able to come next when
+** nothing is matched in its place. What can come
+** next is found from FOLLOW sets across the rules,
+** as usual taking those nothing refers to as being
+** followed by the end of input. A rule also used by
+** parsers outside the grammar should not be followed
+** there by anything it can't be followed by inside.
+** A `not` always has to backtrack.
+*/
+
+typedef struct {
+  unsigned char set[32];
+  char fails;
+  char partial;
+  char last;
+} mpc_follow_t;
+
+static mpc_follow_t *mpc_follow_get(mpc_firsts_t *f, mpc_follow_t *fl, mpc_parser_t *p) {
+  return &fl[mpc_firsts_get(f, p) - f->firsts];
+}
+
+static int mpc_follow_some(const unsigned char *set) {
+  int j;
+  for (j = 0; j < 32; j++) { if (set[j]) { return 1; } }
+  return 0;
+}
+
+/* Finds a character in both sets, trying printable ones first */
+static int mpc_follow_clash(const unsigned char *a, const unsigned char *b) {
+  int j, c;
+  for (j = 0; j < 256; j++) {
+    c = (j + ' ') % 256;
+    if (a[c / 8] & b[c / 8] & (1 << (c % 8))) { return c; }
+  }
+  return -1;
+}
+
+/* Works out whether a parser can fail, fail part way, or only match at the end */
+static int mpc_follow_update(mpc_firsts_t *f, mpc_follow_t *fl, int k) {
+  
+  int j, n, fails = 0, partial = 0, last = 0, consumed = 0;
+  mpc_parser_t *p = f->nodes[k];
+  mpc_parser_t **xs;
+  mpc_follow_t *t = &fl[k], *x;
+  
+  n = mpc_parser_children(p, &xs);
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_PASS:
+    case MPC_TYPE_LIFT:
+    case MPC_TYPE_LIFT_VAL:
+    case MPC_TYPE_STATE:
+    case MPC_TYPE_MAYBE:
+    case MPC_TYPE_MANY:
+      break;
+    
+    case MPC_TYPE_STRING:
+      fails = p->data.string.x[0] != '\0';
+      partial = fails && p->data.string.x[1] != '\0';
+      break;
+    
+    case MPC_TYPE_ANCHOR:
+      fails = 1;
+      last = p->data.anchor.f == mpc_eoi_anchor;
+      break;
+    
+    case MPC_TYPE_NOT:
+      fails = 1;
+      break;
+    
+    case MPC_TYPE_MANY1:
+      fails = 1;
+      partial = mpc_follow_get(f, fl, xs[0])->partial;
+      break;
+    
+    case MPC_TYPE_COUNT:
+      x = mpc_follow_get(f, fl, xs[0]);
+      fails = p->data.repeat.n > 0 && x->fails;
+      partial = x->partial || (p->data.repeat.n > 1 && x->fails
+        && mpc_follow_some(mpc_firsts_get(f, xs[0])->set));
+      break;
+    
+    case MPC_TYPE_OR:
+      fails = last = n > 0;
+      for (j = 0; j < n; j++) {
+        x = mpc_follow_get(f, fl, xs[j]);
+        fails &= x->fails;
+        partial |= x->partial;
+        last &= x->last;
+      }
+      break;
+    
+    case MPC_TYPE_AND:
+      for (j = 0; j < n; j++) {
+        x = mpc_follow_get(f, fl, xs[j]);
+        fails |= x->fails;
+        partial |= x->partial || (consumed && x->fails);
+        last |= x->last;
+        consumed |= mpc_follow_some(mpc_firsts_get(f, xs[j])->set);
+      }
+      break;
+    
+    default:
+      if (n == 1) {
+        x = mpc_follow_get(f, fl, xs[0]);
+        fails = x->fails;
+        partial = x->partial;
+        last = x->last;
+      } else {
+        fails = 1;
+      }
+      break;
+  }
+  
+  if (fails <= t->fails && partial <= t->partial && last <= t->last) { return 0; }
+  t->fails |= fails;
+  t->partial |= partial;
+  t->last |= last;
+  return 1;
+}
+
+static int mpc_follow_add(mpc_follow_t *t, const unsigned char *set) {
+  int j, changed = 0;
+  for (j = 0; j < 32; j++) {
+    if (set[j] & ~t->set[j]) { t->set[j] |= set[j]; changed = 1; }
+  }
+  return changed;
+}
+
+/* Passes what can follow a parser on to its children */
+static int mpc_follow_push(mpc_firsts_t *f, mpc_follow_t *fl, int k) {
+  
+  int j, c, n, changed = 0;
+  unsigned char rest[32];
+  mpc_parser_t *p = f->nodes[k];
+  mpc_parser_t **xs;
+  mpc_follow_t *t = &fl[k];
+  mpc_first_t *x;
+  
+  n = mpc_parser_children(p, &xs);
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      changed |= mpc_follow_add(mpc_follow_get(f, fl, xs[0]), t->set);
+      changed |= mpc_follow_add(mpc_follow_get(f, fl, xs[0]), mpc_firsts_get(f, xs[0])->set);
+      break;
+    
+    case MPC_TYPE_AND:
+      memcpy(rest, t->set, 32);
+      for (j = n-1; j >= 0; j--) {
+        changed |= mpc_follow_add(mpc_follow_get(f, fl, xs[j]), rest);
+        x = mpc_firsts_get(f, xs[j]);
+        if (mpc_follow_get(f, fl, xs[j])->last) {
+          memset(rest, 0, 32);
+        } else if (x->nullable) {
+          for (c = 0; c < 32; c++) { rest[c] |= x->set[c]; }
+        } else {
+          memcpy(rest, x->set, 32);
+        }
+      }
+      break;
+    
+    default:
+      for (j = 0; j < n; j++) {
+        changed |= mpc_follow_add(mpc_follow_get(f, fl, xs[j]), t->set);
+      }
+      break;
+  }
+  
+  return changed;
+}
+
+static int mpc_follow_tail(mpc_firsts_t *f, mpc_follow_t *fl, mpc_follow_t *t,
+  mpc_parser_t *x, const char *type, char *m) {
+  
+  int c;
+  
+  if (!mpc_follow_get(f, fl, x)->partial) { return 0; }
+  
+  c = mpc_follow_clash(t->set, mpc_firsts_get(f, x)->set);
+  if (c < 0) { return 0; }
+  sprintf(m, "`%s` can be followed by %s, which its parser starts with",
+    type, mpc_err_char_unescape((char)c));
+  return 1;
+}
+
+static int mpc_follow_conflict(mpc_firsts_t *f, mpc_follow_t *fl, int k, char *m) {
+  
+  int j, l, c;
+  mpc_parser_t *p = f->nodes[k];
+  mpc_follow_t *t = &fl[k];
+  mpc_first_t *x, *y;
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_UNDEFINED:
+      strcpy(m, "a parser is undefined");
+      return 1;
+    
+    case MPC_TYPE_NOT:
+      strcpy(m, "`not` has to backtrack");
+      return 1;
+    
+    case MPC_TYPE_MAYBE: return mpc_follow_tail(f, fl, t, p->data.not.x, "maybe", m);
+    case MPC_TYPE_MANY:  return mpc_follow_tail(f, fl, t, p->data.repeat.x, "many", m);
+    case MPC_TYPE_MANY1: return mpc_follow_tail(f, fl, t, p->data.repeat.x, "many1", m);
+    
+    case MPC_TYPE_OR:
+      for (j = 0; j < p->data.or.n; j++) {
+        if (!mpc_follow_get(f, fl, p->data.or.xs[j])->partial) { continue; }
+        x = mpc_firsts_get(f, p->data.or.xs[j]);
+        for (l = j+1; l < p->data.or.n; l++) {
+          y = mpc_firsts_get(f, p->data.or.xs[l]);
+          c = mpc_follow_clash(x->set, y->set);
+          if (c >= 0) {
+            sprintf(m, "alternatives %i and %i of `or` both start with %s",
+              j+1, l+1, mpc_err_char_unescape((char)c));
+            return 1;
+          }
+          if (!y->nullable) { continue; }
+          c = mpc_follow_clash(x->set, t->set);
+          if (c >= 0) {
+            sprintf(m, "alternative %i of `or` can match nothing and be followed by %s, "
+              "which alternative %i starts with", l+1, mpc_err_char_unescape((char)c), j+1);
+            return 1;
+          }
+        }
+      }
+      return 0;
+    
+    default: return 0;
+  }
+}
+
+/* Finds a conflict reachable from a rule, only in the rule itself if `own` */
+static int mpc_follow_find(mpc_firsts_t *f, char **bad, char *seen, mpc_parser_t *p,
+  mpc_parser_t *rule, int own, mpc_parser_t **in) {
+  
+  int j, n, k = (int)(mpc_firsts_get(f, p) - f->firsts);
+  mpc_parser_t **xs;
+  
+  if (seen[k]) { return -1; }
+  if (p->retained && p != rule) {
+    if (own) { return -1; }
+    rule = p;
+  }
+  
+  seen[k] = 1;
+  if (bad[k]) { *in = rule; return k; }
+  
+  n = mpc_parser_children(p, &xs);
+  for (j = 0; j < n; j++) {
+    k = mpc_follow_find(f, bad, seen, xs[j], rule, own, in);
+    if (k >= 0) { return k; }
+  }
+  return -1;
+}
+
+/*
+** Returns for each rule NULL if it can be made predictive,
+** otherwise a description of what stops it.
+*/
+
+static char **mpc_predict_check(mpc_parser_t **ps, int n) {
+  
+  int j, k, changed = 1;
+  char m[256];
+  char **bad, **out, *seen;
+  mpc_parser_t *in = NULL;
+  mpc_follow_t *fl;
+  mpc_firsts_t f;
+  
+  mpc_firsts_find(&f, ps, n);
+  fl = calloc(f.num, sizeof(mpc_follow_t));
+  
+  while (changed) {
+    changed = 0;
+    for (k = f.num-1; k >= 0; k--) { changed |= mpc_follow_update(&f, fl, k); }
+  }
+  
+  changed = 1;
+  while (changed) {
+    changed = 0;
+    for (k = 0; k < f.num; k++) { changed |= mpc_follow_push(&f, fl, k); }
+  }
+  
+  bad = calloc(f.num, sizeof(char*));
+  for (k = 0; k < f.num; k++) {
+    if (mpc_follow_conflict(&f, fl, k, m)) {
+      bad[k] = malloc(strlen(m) + 1);
+      strcpy(bad[k], m);
+    }
+  }
+  
+  out = malloc(sizeof(char*) * n);
+  seen = malloc(f.num);
+  
+  for (j = 0; j < n; j++) {
+    memset(seen, 0, f.num);
+    k = mpc_follow_find(&f, bad, seen, ps[j], ps[j], 1, &in);
+    if (k < 0) {
+      memset(seen, 0, f.num);
+      k = mpc_follow_find(&f, bad, seen, ps[j], ps[j], 0, &in);
+    }
+    if (k < 0) { out[j] = NULL; continue; }
+    out[j] = malloc(strlen(bad[k]) + (in->name ? strlen(in->name) : 0) + 8);
+    if (in == ps[j]) {
+      strcpy(out[j], bad[k]);
+    } else {
+      sprintf(out[j], "in <%s>, %s", in->name ? in->name : "", bad[k]);
+    }
+  }
+  
+  for (k = 0; k < f.num; k++) { free(bad[k]); }
+  free(bad);
+  free(seen);
+  free(fl);
+  mpc_firsts_free(&f);
+  return out;
+}
+
+/*
+** Where every leaf of a string fold only matches
+** characters the string it builds is exactly the
+** input it consumed, less any nul characters. Such
+** folds are wrapped in a capture which, when parsing
+** a String, runs them without building anything and
+** then takes the input it passed over in one go. As
+** with regex DFAs, a `count` which can fail part way
+** through is only allowed directly inside an `and`.
+*/
+
+static int mpc_capture_text(mpc_parser_t *p, int force, int guarded) {
+  
+  int j;
+  
+  if (p->retained && !force) { return 0; }
+  
+  switch (p->type) {
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_SATISFY:
+    case MPC_TYPE_STRING:
+    case MPC_TYPE_SPAN:
+    case MPC_TYPE_DFA:
+      return 1;
+    case MPC_TYPE_CAPTURE: return mpc_capture_text(p->data.capture.x, 0, guarded);
+    case MPC_TYPE_EXPECT:  return mpc_capture_text(p->data.expect.x, 0, guarded);
+    case MPC_TYPE_LIFT:    return p->data.lift.lf == mpcf_ctor_str;
+    case MPC_TYPE_MAYBE:
+      return p->data.not.lf == mpcf_ctor_str && mpc_capture_text(p->data.not.x, 0, 0);
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+      return p->data.repeat.f == mpcf_strfold && mpc_capture_text(p->data.repeat.x, 0, 0);
+    case MPC_TYPE_COUNT:
+      return p->data.repeat.f == mpcf_strfold && p->data.repeat.dx == free
+        && (p->data.repeat.n <= 1 || guarded) && mpc_capture_text(p->data.repeat.x, 0, 0);
+    case MPC_TYPE_OR:
+      for (j = 0; j < p->data.or.n; j++) {
+        if (!mpc_capture_text(p->data.or.xs[j], 0, 0)) { return 0; }
+      }
+      return p->data.or.n > 0;
+    case MPC_TYPE_AND:
+      if (p->data.and.f != mpcf_strfold) { return 0; }
+      for (j = 0; j < p->data.and.n; j++) {
+        if (!mpc_capture_text(p->data.and.xs[j], 0, 1)) { return 0; }
+        if (j < p->data.and.n-1 && p->data.and.dxs[j] != free) { return 0; }
+      }
+      return p->data.and.n > 0;
+    default: return 0;
+  }
+}
+
+static void mpc_capture_update(mpc_parser_t *p, int force, int flags) {
+  
+  int j, n;
+  mpc_parser_t **xs;
+  
+  if ((p->retained && !force) || !(flags & MPC_OPTIMISE_CAPTURE)) { return; }
+  
+  switch (p->type) {
+    case MPC_TYPE_CAPTURE:
+    case MPC_TYPE_SKIP:
+    case MPC_TYPE_SPAN:
+    case MPC_TYPE_DFA:
+    case MPC_TYPE_TOKEN:
+      return;
+    case MPC_TYPE_MAYBE:
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+    case MPC_TYPE_OR:
+    case MPC_TYPE_AND:
+      if (!mpc_capture_text(p, force, 0)) { break; }
+      p->data.capture.x = mpc_optimise_inner(p);
+      p->type = MPC_TYPE_CAPTURE;
+      mpc_optimise_note(MPC_OPTIMISE_CAPTURE, 1);
+      return;
+    default: break;
+  }
+  
+  n = mpc_parser_children(p, &xs);
+  for (j = 0; j < n; j++) { mpc_capture_update(xs[j], 0, flags); }
+}
+
+void mpc_optimise_with(mpc_parser_t *p, int passes) {
+  mpc_dispatch_free(p, 1);
+  mpc_optimise_unretained(p, 1, passes);
+  mpc_capture_update(p, 1, passes);
+  mpc_dispatch_update(p, passes);
+}
+
+void mpc_optimise(mpc_parser_t *p) {
+  mpc_optimise_with(p, MPC_OPTIMISE_ALL);
+}
+
+
+/*
+** Compiled Parsers
+**
+** `mpc_compile` flattens a parser graph into an array
+** of instructions in the style of LPeg, which a small
+** machine then runs without recursion. Alternatives
+** push a choice point on an explicit stack holding
+** the position to go back to, and a failure pops
+** back to the latest one. Rules become subroutines
+** reached by `call`, so recursive grammars compile
+** to a fixed amount of code.
+**
+** Every compiled parser leaves exactly one value on
+** a value stack, and sequences and loops fold what
+** their children left there, so outputs are built by
+** the same fold and apply functions as usual. Values
+** which a failure unwinds past are destroyed with
+** the destructor their parent would have used.
+**
+** Errors are kept just as the interpreter keeps them.
+** An `expect` pushes a choice point of its own which
+** relabels any failure passing through it, unless it
+** only wraps a single primitive, which is then given
+** the label directly. Parsers it can't express
+** (`predictive` and anything else unusual) are handed
+** to the interpreter as they are.
+**
+** Programs refer back to the parsers they were made
+** from, which must outlive them and not be redefined.
+*/
+
+enum {
+  MPC_OP_END,
+  MPC_OP_FAIL,
+  MPC_OP_ANY,
+  MPC_OP_CHAR,
+  MPC_OP_SET,
+  MPC_OP_SATISFY,
+  MPC_OP_STRING,
+  MPC_OP_SPAN,
+  MPC_OP_ANCHOR,
+  MPC_OP_DFA,
+  MPC_OP_TEST,
+  MPC_OP_JUMP,
+  MPC_OP_CHOICE,
+  MPC_OP_COMMIT,
+  MPC_OP_PARTIAL_COMMIT,
+  MPC_OP_FAIL_TWICE,
+  MPC_OP_CALL,
+  MPC_OP_RETURN,
+  MPC_OP_MARK,
+  MPC_OP_OWN,
+  MPC_OP_FOLD,
+  MPC_OP_COUNT,
+  MPC_OP_APPLY,
+  MPC_OP_APPLY_TO,
+  MPC_OP_PUSH,
+  MPC_OP_LIFT,
+  MPC_OP_STATE,
+  MPC_OP_NATIVE
+};
+
+static const char *mpc_op_names[] = {
+  "end", "fail", "any", "char", "set", "satisfy", "string", "span", "anchor", "dfa",
+  "test", "jump", "choice", "commit", "partial_commit", "fail_twice",
+  "call", "return", "mark", "own", "fold", "count", "apply", "apply_to",
+  "push", "lift", "state", "native"
+};
+
+enum {
+  MPC_PROGRAM_SET = 33
+};
+
+typedef struct {
+  int op;
+  int x;
+  int y;
+  mpc_parser_t *p;
+  mpc_parser_t *e;
+} mpc_inst_t;
+
+typedef struct {
+  int pc;
+  int call;
+  int vals;
+  int marks;
+  int suppress;
+  long pos;
+  char last;
+  mpc_parser_t *p;
+} mpc_frame_t;
+
+struct mpc_program_t {
+  
+  mpc_parser_t *root;
+  
+  mpc_inst_t *code;
+  int code_num;
+  int code_slots;
+  
+  unsigned char *sets;
+  int sets_num;
+  int sets_slots;
+  
+  mpc_parser_t **subs;
+  int *subs_pc;
+  int subs_num;
+  int subs_slots;
+  
+};
+
+/*
+** The stacks a program runs on belong to the input
+** running it, and are kept for its next run, so that
+** a program is only ever read and may be shared.
+**
+** A run over a partial view stops at the first
+** instruction which reads up to its end, leaving its
+** stacks as they are and noting where it was, and
+** carries on from there once more input is in view.
+** While a suspended run is tried out by a push flush
+** any of its slots it overwrites are first kept aside
+** so they can be put back, and `keep_*` are the lowest
+** of each kept so far.
+*/
+
+typedef struct mpc_vm_t {
+  mpc_frame_t *stack;
+  int stack_slots;
+  mpc_val_t **vals;
+  mpc_dtor_t *dtors;
+  int vals_slots;
+  int *marks;
+  int marks_slots;
+  int running;
+  int pc;
+  int sp;
+  int vn;
+  int mn;
+  int depth;
+  int keep_sp;
+  int keep_vn;
+  int keep_mn;
+  mpc_frame_t *kept_stack;
+  mpc_val_t **kept_vals;
+  mpc_dtor_t *kept_dtors;
+  int *kept_marks;
+} mpc_vm_t;
+
+static int mpc_compile_emit(mpc_program_t *c, int op, int x, int y, mpc_parser_t *p) {
+  if (c->code_num == c->code_slots) {
+    c->code_slots = c->code_slots ? c->code_slots * 2 : 64;
+    c->code = realloc(c->code, sizeof(mpc_inst_t) * c->code_slots);
+  }
+  c->code[c->code_num].op = op;
+  c->code[c->code_num].x = x;
+  c->code[c->code_num].y = y;
+  c->code[c->code_num].p = p;
+  c->code[c->code_num].e = NULL;
+  return c->code_num++;
+}
+
+static int mpc_compile_set(mpc_program_t *c, const unsigned char *set) {
+  if (c->sets_num == c->sets_slots) {
+    c->sets_slots = c->sets_slots ? c->sets_slots * 2 : 16;
+    c->sets = realloc(c->sets, MPC_PROGRAM_SET * c->sets_slots);
+  }
+  memcpy(c->sets + MPC_PROGRAM_SET * c->sets_num, set, MPC_PROGRAM_SET);
+  return c->sets_num++;
+}
+
+static int mpc_compile_sub(mpc_program_t *c, mpc_parser_t *p) {
+  int j;
+  for (j = 0; j < c->subs_num; j++) {
+    if (c->subs[j] == p) { return j; }
+  }
+  if (c->subs_num == c->subs_slots) {
+    c->subs_slots = c->subs_slots ? c->subs_slots * 2 : 16;
+    c->subs = realloc(c->subs, sizeof(mpc_parser_t*) * c->subs_slots);
+    c->subs_pc = realloc(c->subs_pc, sizeof(int) * c->subs_slots);
+  }
+  c->subs[c->subs_num] = p;
+  c->subs_pc[c->subs_num] = -1;
+  return c->subs_num++;
+}
+
+/* A single character parser, possibly under some `expect`s */
+static mpc_parser_t *mpc_compile_class(mpc_parser_t *p) {
+  while (p->type == MPC_TYPE_EXPECT && !p->data.expect.x->retained) { p = p->data.expect.x; }
+  if (p->retained) { return NULL; }
+  switch (p->type) {
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      return p;
+    default: return NULL;
+  }
+}
+
+static void mpc_compile_class_set(mpc_parser_t *p, unsigned char *set) {
+  int c;
+  memset(set, 0, MPC_PROGRAM_SET);
+  for (c = 0; c < 256; c++) {
+    if (p->type == MPC_TYPE_ANY || mpc_first_char(p, (char)c)) { set[c / 8] |= 1 << (c % 8); }
+  }
+}
+
+/* The primitive an `expect` is all that wraps, which can then be labelled directly */
+static mpc_parser_t *mpc_compile_expected(mpc_parser_t *p) {
+  p = p->data.expect.x;
+  while (p->type == MPC_TYPE_EXPECT && !p->retained) { p = p->data.expect.x; }
+  if (p->retained) { return NULL; }
+  switch (p->type) {
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_SATISFY:
+    case MPC_TYPE_STRING:
+    case MPC_TYPE_ANCHOR:
+      return p;
+    default: return NULL;
+  }
+}
+
+/* Tests are owned by the parser they belong to and remember the one they skip */
+static int mpc_compile_test(mpc_program_t *c, const unsigned char *set, int target, mpc_parser_t *p, mpc_parser_t *x) {
+  int t = mpc_compile_emit(c, MPC_OP_TEST, mpc_compile_set(c, set), target, p);
+  c->code[t].e = x;
+  return t;
+}
+
+static int mpc_compile_lookahead(mpc_program_t *c, mpc_parser_t *p, mpc_parser_t *x, const unsigned char *lookahead, int gen, int target) {
+  unsigned char set[MPC_PROGRAM_SET];
+  if (lookahead == NULL || gen != mpc_generation) { return -1; }
+  memcpy(set, lookahead, 32);
+  set[32] = 0;
+  return mpc_compile_test(c, set, target, p, x);
+}
+
+/* The column of an `or` dispatch table for one alternative, if it rules anything out */
+static int mpc_compile_column(mpc_program_t *c, mpc_parser_t *p, int j, int target) {
+  
+  int r, w, all = 1;
+  unsigned char set[MPC_PROGRAM_SET];
+  
+  if (p->data.or.dispatch == NULL || p->data.or.gen != mpc_generation) { return -1; }
+  
+  w = (p->data.or.n + 7) / 8;
+  memset(set, 0, MPC_PROGRAM_SET);
+  for (r = 0; r < MPC_DISPATCH_ROWS; r++) {
+    if (p->data.or.dispatch[r * w + j / 8] & (1 << (j % 8))) {
+      set[r / 8] |= 1 << (r % 8);
+    } else {
+      all = 0;
+    }
+  }
+  
+  if (all) { return -1; }
+  return mpc_compile_test(c, set, target, p, p->data.or.xs[j]);
+}
+
+static void mpc_compile_node(mpc_program_t *c, mpc_parser_t *p, int force) {
+  
+  int j, l, t, e;
+  int *ends;
+  mpc_parser_t *q;
+  unsigned char set[MPC_PROGRAM_SET];
+  
+  if (p->retained && !force) {
+    mpc_compile_emit(c, MPC_OP_CALL, -1, mpc_compile_sub(c, p), p);
+    return;
+  }
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_ANY:    mpc_compile_emit(c, MPC_OP_ANY, 0, 0, p); break;
+    case MPC_TYPE_SINGLE: mpc_compile_emit(c, MPC_OP_CHAR, (unsigned char)p->data.single.x, 0, p); break;
+    
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      mpc_compile_class_set(p, set);
+      mpc_compile_emit(c, MPC_OP_SET, mpc_compile_set(c, set), 0, p);
+      break;
+    
+    case MPC_TYPE_SATISFY: mpc_compile_emit(c, MPC_OP_SATISFY, 0, 0, p); break;
+    case MPC_TYPE_STRING:  mpc_compile_emit(c, MPC_OP_STRING, (int)strlen(p->data.string.x), 0, p); break;
+    case MPC_TYPE_ANCHOR:  mpc_compile_emit(c, MPC_OP_ANCHOR, 0, 0, p); break;
+    
+    case MPC_TYPE_UNDEFINED:
+    case MPC_TYPE_FAIL:     mpc_compile_emit(c, MPC_OP_FAIL, 0, 0, p); break;
+    case MPC_TYPE_PASS:     mpc_compile_emit(c, MPC_OP_PUSH, 0, 0, p); break;
+    case MPC_TYPE_LIFT_VAL: mpc_compile_emit(c, MPC_OP_PUSH, 1, 0, p); break;
+    case MPC_TYPE_LIFT:     mpc_compile_emit(c, MPC_OP_LIFT, 0, 0, p); break;
+    case MPC_TYPE_STATE:    mpc_compile_emit(c, MPC_OP_STATE, 0, 0, p); break;
+    
+    case MPC_TYPE_EXPECT:
+      q = mpc_compile_expected(p);
+      if (q) {
+        mpc_compile_node(c, q, 0);
+        c->code[c->code_num-1].e = p;
+        break;
+      }
+      l = mpc_compile_emit(c, MPC_OP_CHOICE, -1, 0, p);
+      mpc_compile_node(c, p->data.expect.x, 0);
+      e = mpc_compile_emit(c, MPC_OP_COMMIT, -1, 0, p);
+      c->code[l].x = c->code_num;
+      c->code[e].x = c->code_num;
+      break;
+    
+    case MPC_TYPE_MEMO:   mpc_compile_node(c, p->data.memo.x, 0); break;
+    case MPC_TYPE_CAPTURE: mpc_compile_node(c, p->data.capture.x, 0); break;
+    
+    case MPC_TYPE_SKIP:
+      mpc_compile_node(c, p->data.capture.x, 0);
+      mpc_compile_emit(c, MPC_OP_APPLY, 0, 0, p);
+      break;
+    
+    case MPC_TYPE_SPAN:
+      memcpy(set, p->data.span.set, 32);
+      set[32] = 0;
+      mpc_compile_emit(c, MPC_OP_SPAN, mpc_compile_set(c, set), p->data.span.min, p);
+      break;
+    
+    case MPC_TYPE_DFA:
+      l = mpc_compile_emit(c, MPC_OP_DFA, 0, 0, p);
+      mpc_compile_node(c, p->data.dfa.x, 0);
+      c->code[l].x = c->code_num;
+      break;
+    
+    case MPC_TYPE_APPLY:
+      mpc_compile_node(c, p->data.apply.x, 0);
+      mpc_compile_emit(c, MPC_OP_APPLY, 0, 0, p);
+      break;
+    
+    case MPC_TYPE_APPLY_TO:
+      mpc_compile_node(c, p->data.apply_to.x, 0);
+      mpc_compile_emit(c, MPC_OP_APPLY_TO, 0, 0, p);
+      break;
+    
+    case MPC_TYPE_NOT:
+      l = mpc_compile_emit(c, MPC_OP_CHOICE, -1, 0, p);
+      mpc_compile_node(c, p->data.not.x, 0);
+      mpc_compile_emit(c, MPC_OP_OWN, 0, 0, p);
+      mpc_compile_emit(c, MPC_OP_FAIL_TWICE, 0, 0, p);
+      c->code[l].x = c->code_num;
+      mpc_compile_emit(c, MPC_OP_LIFT, 0, 0, p);
+      break;
+    
+    case MPC_TYPE_MAYBE:
+      t = mpc_compile_lookahead(c, p, p->data.not.x, p->data.not.lookahead, p->data.not.gen, -1);
+      l = mpc_compile_emit(c, MPC_OP_CHOICE, -1, 0, p);
+      mpc_compile_node(c, p->data.not.x, 0);
+      e = mpc_compile_emit(c, MPC_OP_COMMIT, -1, 0, p);
+      c->code[l].x = c->code_num;
+      mpc_compile_emit(c, MPC_OP_LIFT, 0, 0, p);
+      if (t >= 0) { c->code[t].y = c->code[l].x; }
+      c->code[e].x = c->code_num;
+      break;
+    
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+      
+      q = mpc_compile_class(p->data.repeat.x);
+      if (p->data.repeat.f == mpcf_strfold && q) {
+        mpc_compile_class_set(q, set);
+        mpc_compile_emit(c, MPC_OP_SPAN, mpc_compile_set(c, set), p->type == MPC_TYPE_MANY1, p);
+        break;
+      }
+      
+      mpc_compile_emit(c, MPC_OP_MARK, 0, 0, p);
+      e = mpc_compile_emit(c, MPC_OP_CHOICE, -1, 0, p);
+      l = c->code_num;
+      mpc_compile_lookahead(c, p, p->data.repeat.x, p->data.repeat.lookahead, p->data.repeat.gen, -1);
+      mpc_compile_node(c, p->data.repeat.x, 0);
+      mpc_compile_emit(c, MPC_OP_PARTIAL_COMMIT, l, 0, p);
+      c->code[e].x = c->code_num;
+      mpc_compile_emit(c, MPC_OP_FOLD, p->type == MPC_TYPE_MANY1, 0, p);
+      break;
+    
+    case MPC_TYPE_COUNT:
+      
+      if (p->data.repeat.n < 1) {
+        mpc_compile_emit(c, MPC_OP_NATIVE, 0, 0, p);
+        break;
+      }
+      
+      mpc_compile_emit(c, MPC_OP_MARK, 0, 0, p);
+      t = mpc_compile_emit(c, MPC_OP_CHOICE, -1, 0, p);
+      l = mpc_compile_emit(c, MPC_OP_COUNT, p->data.repeat.n, -1, p);
+      mpc_compile_node(c, p->data.repeat.x, 0);
+      mpc_compile_emit(c, MPC_OP_OWN, 0, 0, p);
+      mpc_compile_emit(c, MPC_OP_JUMP, l, 0, p);
+      c->code[l].y = mpc_compile_emit(c, MPC_OP_COMMIT, -1, 0, p);
+      c->code[c->code[l].y].x = c->code_num;
+      c->code[t].x = c->code_num;
+      mpc_compile_emit(c, MPC_OP_FOLD, p->data.repeat.n, 0, p);
+      break;
+    
+    case MPC_TYPE_OR:
+      
+      if (p->data.or.n == 0) {
+        mpc_compile_emit(c, MPC_OP_PUSH, 0, 0, p);
+        break;
+      }
+      
+      ends = malloc(sizeof(int) * p->data.or.n);
+      
+      for (j = 0; j < p->data.or.n; j++) {
+        t = mpc_compile_column(c, p, j, -1);
+        l = mpc_compile_emit(c, MPC_OP_CHOICE, -1, 0, p);
+        mpc_compile_node(c, p->data.or.xs[j], 0);
+        ends[j] = mpc_compile_emit(c, MPC_OP_COMMIT, -1, 0, p);
+        c->code[l].x = c->code_num;
+        if (t >= 0) { c->code[t].y = c->code_num; }
+      }
+      
+      /* Every alternative's error has been taken, so it fails with none */
+      mpc_compile_emit(c, MPC_OP_FAIL, 0, 0, p);
+      
+      for (j = 0; j < p->data.or.n; j++) { c->code[ends[j]].x = c->code_num; }
+      free(ends);
+      break;
+    
+    case MPC_TYPE_AND:
+      
+      if (p->data.and.n == 0) {
+        mpc_compile_emit(c, MPC_OP_PUSH, 0, 0, p);
+        break;
+      }
+      
+      mpc_compile_emit(c, MPC_OP_MARK, 0, 0, p);
+      for (j = 0; j < p->data.and.n; j++) {
+        mpc_compile_node(c, p->data.and.xs[j], 0);
+        if (j < p->data.and.n-1) { mpc_compile_emit(c, MPC_OP_OWN, j, 0, p); }
+      }
+      mpc_compile_emit(c, MPC_OP_FOLD, p->data.and.n, 0, p);
+      break;
+    
+    default:
+      mpc_compile_emit(c, MPC_OP_NATIVE, 0, 0, p);
+      break;
+  }
+  
+}
+
+mpc_program_t *mpc_compile(mpc_parser_t *p) {
+  
+  int j;
+  mpc_program_t *c = calloc(1, sizeof(mpc_program_t));
+  c->root = p;
+  
+  mpc_compile_node(c, p, 0);
+  mpc_compile_emit(c, MPC_OP_END, 0, 0, NULL);
+  
+  for (j = 0; j < c->subs_num; j++) {
+    c->subs_pc[j] = c->code_num;
+    mpc_compile_node(c, c->subs[j], 1);
+    mpc_compile_emit(c, MPC_OP_RETURN, 0, 0, c->subs[j]);
+  }
+  
+  for (j = 0; j < c->code_num; j++) {
+    if (c->code[j].op == MPC_OP_CALL) { c->code[j].x = c->subs_pc[c->code[j].y]; }
+  }
+  
+  return c;
+}
+
+void mpc_program_delete(mpc_program_t *c) {
+  free(c->code);
+  free(c->sets);
+  free(c->subs);
+  free(c->subs_pc);
+  free(c);
+}
+
+static void mpc_vm_delete(mpc_vm_t *m) {
+  free(m->stack);
+  free(m->vals);
+  free(m->dtors);
+  free(m->marks);
+  free(m);
+}
+
+static mpc_program_t *mpc_program_for(mpc_program_t *c, mpc_parser_t *p) {
+  if (c && c->root == p) { return c; }
+  if (c) { mpc_program_delete(c); }
+  return mpc_compile(p);
+}
+
+void mpc_program_print(mpc_program_t *c) {
+  
+  int j, k;
+  mpc_inst_t *in;
+  
+  for (j = 0; j < c->code_num; j++) {
+    
+    for (k = 0; k < c->subs_num; k++) {
+      if (c->subs_pc[k] == j) { printf("%s:\n", c->subs[k]->name); }
+    }
+    
+    in = &c->code[j];
+    printf("%5i  %-14s", j, mpc_op_names[in->op]);
+    
+    switch (in->op) {
+      case MPC_OP_CHAR:   printf(" '%c'", in->x); break;
+      case MPC_OP_STRING: printf(" \"%s\"", in->p->data.string.x); break;
+      case MPC_OP_SET:    printf(" #%i", in->x); break;
+      case MPC_OP_SPAN:   printf(" #%i min %i", in->x, in->y); break;
+      case MPC_OP_TEST:   printf(" #%i -> %i", in->x, in->y); break;
+      case MPC_OP_COUNT:  printf(" %i -> %i", in->x, in->y); break;
+      case MPC_OP_CALL:   printf(" %s (%i)", in->p->name, in->x); break;
+      case MPC_OP_FOLD:   printf(" %i", in->x); break;
+      case MPC_OP_DFA:
+      case MPC_OP_JUMP:
+      case MPC_OP_CHOICE:
+      case MPC_OP_COMMIT:
+      case MPC_OP_PARTIAL_COMMIT:
+        printf(" -> %i", in->x);
+        break;
+      default: break;
+    }
+    
+    printf("\n");
+  }
+  
+}
+
+static void mpc_vm_keep_vals(mpc_vm_t *m, int k) {
+  if (k >= m->keep_vn) { return; }
+  memcpy(m->kept_vals + k, m->vals + k, sizeof(mpc_val_t*) * (size_t)(m->keep_vn - k));
+  memcpy(m->kept_dtors + k, m->dtors + k, sizeof(mpc_dtor_t) * (size_t)(m->keep_vn - k));
+  m->keep_vn = k;
+}
+
+static void mpc_vm_keep_stack(mpc_vm_t *m, int k) {
+  if (k >= m->keep_sp) { return; }
+  memcpy(m->kept_stack + k, m->stack + k, sizeof(mpc_frame_t) * (size_t)(m->keep_sp - k));
+  m->keep_sp = k;
+}
+
+static void mpc_vm_keep_marks(mpc_vm_t *m, int k) {
+  if (k >= m->keep_mn) { return; }
+  memcpy(m->kept_marks + k, m->marks + k, sizeof(int) * (size_t)(m->keep_mn - k));
+  m->keep_mn = k;
+}
+
+static void mpc_vm_push(mpc_vm_t *m, int *vn, mpc_val_t *x) {
+  mpc_vm_keep_vals(m, *vn);
+  if (*vn == m->vals_slots) {
+    m->vals_slots = m->vals_slots ? m->vals_slots * 2 : 64;
+    m->vals = realloc(m->vals, sizeof(mpc_val_t*) * m->vals_slots);
+    m->dtors = realloc(m->dtors, sizeof(mpc_dtor_t) * m->vals_slots);
+  }
+  m->vals[*vn] = x;
+  m->dtors[*vn] = NULL;
+  (*vn)++;
+}
+
+static void mpc_vm_frame(mpc_vm_t *m, mpc_input_t *i, int *sp, int pc, int call, int vn, int mn, mpc_parser_t *p) {
+  mpc_vm_keep_stack(m, *sp);
+  if (*sp == m->stack_slots) {
+    m->stack_slots = m->stack_slots ? m->stack_slots * 2 : 64;
+    m->stack = realloc(m->stack, sizeof(mpc_frame_t) * m->stack_slots);
+  }
+  m->stack[*sp].pc = pc;
+  m->stack[*sp].call = call;
+  m->stack[*sp].vals = vn;
+  m->stack[*sp].marks = mn;
+  m->stack[*sp].suppress = i->suppress;
+  m->stack[*sp].pos = i->pos;
+  m->stack[*sp].last = i->last;
+  m->stack[*sp].p = p;
+  (*sp)++;
+}
+
+static void mpc_vm_unwind(mpc_vm_t *m, mpc_input_t *i, int *vn, int to) {
+  if (i->capture) { if (*vn > to) { *vn = to; } return; }
+  while (*vn > to) {
+    (*vn)--;
+    if (m->dtors[*vn]) { mpc_parse_dtor(i, m->dtors[*vn], m->vals[*vn]); }
+  }
+}
+
+static mpc_dtor_t mpc_vm_dtor(mpc_parser_t *p, int j) {
+  switch (p->type) {
+    case MPC_TYPE_AND: return p->data.and.dxs[j];
+    case MPC_TYPE_NOT: return p->data.not.dx;
+    default: return p->data.repeat.dx;
+  }
+}
+
+/* A primitive failing under an `expect` takes its label */
+static mpc_err_t *mpc_vm_expected(mpc_input_t *i, mpc_inst_t *in) {
+  return in->e ? mpc_err_new(i, in->e->data.expect.m) : NULL;
+}
+
+/* Gives -1 when a partial view runs out, with the run suspended */
+static int mpc_vm_run(mpc_input_t *i, mpc_program_t *c, mpc_result_t *r, int trial) {
+  
+  int pc = 0, sp = 0, vn = 0, mn = 0, ok, n;
+  int depth = 0, depth_max = i->depth_max ? i->depth_max : MPC_DEPTH_COMPILED;
+  const char *s = i->string;
+  long start, stop;
+  const unsigned char *set;
+  mpc_inst_t *in;
+  mpc_parser_t *p;
+  mpc_result_t x;
+  mpc_err_t *e = NULL;
+  mpc_fail_mark_t f;
+  mpc_vm_t *m = i->vm;
+  char *o, last;
+  
+  if (m->running) {
+    pc = m->pc;
+    sp = m->sp;
+    vn = m->vn;
+    mn = m->mn;
+    depth = m->depth;
+  }
+  
+  while (1) {
+    
+    in = &c->code[pc++];
+    p = in->p;
+    ok = 1;
+    
+    switch (in->op) {
+      
+      case MPC_OP_END:
+        if (!trial) { m->running = 0; }
+        r->output = m->vals[0];
+        return 1;
+      
+      case MPC_OP_FAIL:
+        ok = 0;
+        e = p->type == MPC_TYPE_FAIL ? mpc_err_fail(i, p->data.fail.m)
+          : p->type == MPC_TYPE_UNDEFINED ? mpc_err_fail(i, "Parser Undefined!") : NULL;
+        break;
+      
+      case MPC_OP_ANY:
+        ok = !mpc_input_ends(i, i->pos);
+        if (ok) {
+          mpc_input_success(i, s[i->pos], &o);
+          mpc_vm_push(m, &vn, o);
+        }
+        else { e = mpc_vm_expected(i, in); }
+        break;
+      
+      case MPC_OP_CHAR:
+        ok = !mpc_input_ends(i, i->pos) && (unsigned char)s[i->pos] == in->x;
+        if (ok) {
+          mpc_input_success(i, s[i->pos], &o);
+          mpc_vm_push(m, &vn, o);
+        }
+        else { e = mpc_vm_expected(i, in); }
+        break;
+      
+      case MPC_OP_SET:
+        set = c->sets + MPC_PROGRAM_SET * in->x;
+        n = mpc_input_ends(i, i->pos) ? MPC_DISPATCH_EOI : (unsigned char)s[i->pos];
+        ok = n != MPC_DISPATCH_EOI && set[n / 8] & (1 << (n % 8));
+        if (ok) {
+          mpc_input_success(i, s[i->pos], &o);
+          mpc_vm_push(m, &vn, o);
+        }
+        else { e = mpc_vm_expected(i, in); }
+        break;
+      
+      case MPC_OP_SATISFY:
+        ok = !mpc_input_ends(i, i->pos) && p->data.satisfy.f(s[i->pos]);
+        if (ok) {
+          mpc_input_success(i, s[i->pos], &o);
+          mpc_vm_push(m, &vn, o);
+        }
+        else { e = mpc_vm_expected(i, in); }
+        break;
+      
+      case MPC_OP_STRING:
+        ok = mpc_input_literal(i, p->data.string.x, (size_t)in->x);
+        if (ok) {
+          o = i->capture ? NULL : mpc_malloc(i, in->x + 1);
+          if (o) { memcpy(o, p->data.string.x, in->x + 1); }
+          if (in->x > 0) { i->last = s[i->pos + in->x - 1]; }
+          i->pos += in->x;
+          mpc_vm_push(m, &vn, o);
+        }
+        else { e = mpc_vm_expected(i, in); }
+        break;
+      
+      case MPC_OP_SPAN:
+        set = c->sets + MPC_PROGRAM_SET * in->x;
+        start = i->pos;
+        last = i->last;
+        ok = p->type == MPC_TYPE_SPAN
+          ? mpc_input_span(i, set, p->data.span.ranges, p->data.span.ranges_num, in->y, &o)
+          : mpc_input_span(i, set, NULL, 0, in->y, &o);
+        if (i->starved) {
+          if (ok) { mpc_free(i, o); }
+          i->pos = start;
+          i->last = last;
+          ok = 0;
+          break;
+        }
+        e = mpc_span_error(i, p->type == MPC_TYPE_SPAN ? p->data.span.x : p, ok);
+        if (ok) { mpc_vm_push(m, &vn, o); }
+        break;
+      
+      case MPC_OP_ANCHOR:
+        mpc_input_ends(i, i->pos);
+        ok = !i->starved && p->data.anchor.f(i->last, mpc_input_peekc(i));
+        if (ok) { mpc_vm_push(m, &vn, NULL); }
+        else { e = mpc_vm_expected(i, in); }
+        break;
+      
+      case MPC_OP_DFA:
+        start = i->pos;
+        last = i->last;
+        n = mpc_input_dfa(i, p->data.dfa.trans, p->data.dfa.accept, &o, &stop);
+        if (i->starved) {
+          if (n == 1) { mpc_free(i, o); }
+          i->pos = start;
+          i->last = last;
+          ok = 0;
+          break;
+        }
+        switch (n) {
+          case 1:
+            mpc_vm_push(m, &vn, o);
+            mpc_err_defer(i, p->data.dfa.x, start, last, stop);
+            pc = in->x;
+            break;
+          case 0:
+            /* Otherwise the compiled regex after it says what it expected */
+            if (i->suppress || i->origin.pos + stop < i->fail_pos) { ok = 0; e = NULL; }
+            break;
+        }
+        break;
+      
+      case MPC_OP_TEST:
+        set = c->sets + MPC_PROGRAM_SET * in->x;
+        n = mpc_input_ends(i, i->pos) ? MPC_DISPATCH_EOI : (unsigned char)s[i->pos];
+        if (i->starved) { ok = 0; break; }
+        if (set[n / 8] & (1 << (n % 8))) { break; }
+        /* A `many1` with nothing yet returns the error of what it would skip */
+        if (p->type == MPC_TYPE_MANY1 && vn == m->marks[mn-1]
+        &&  !i->suppress && i->origin.pos + i->pos >= i->fail_pos) { break; }
+        mpc_err_defer(i, in->e, i->pos, i->last, i->pos);
+        e = NULL;
+        if (in->y < 0) { ok = 0; } else { pc = in->y; }
+        break;
+      
+      case MPC_OP_JUMP: pc = in->x; break;
+      
+      case MPC_OP_CHOICE:
+        mpc_vm_frame(m, i, &sp, in->x, 0, vn, mn, p);
+        if (p->type == MPC_TYPE_NOT || p->type == MPC_TYPE_EXPECT) { i->suppress++; }
+        break;
+      
+      case MPC_OP_COMMIT:
+        sp--;
+        i->suppress = m->stack[sp].suppress;
+        pc = in->x;
+        break;
+      
+      case MPC_OP_PARTIAL_COMMIT:
+        mpc_vm_keep_stack(m, sp-1);
+        m->stack[sp-1].vals = vn;
+        m->stack[sp-1].marks = mn;
+        m->stack[sp-1].pos = i->pos;
+        m->stack[sp-1].last = i->last;
+        pc = in->x;
+        break;
+      
+      case MPC_OP_FAIL_TWICE:
+        sp--;
+        i->pos = m->stack[sp].pos;
+        i->last = m->stack[sp].last;
+        i->suppress = m->stack[sp].suppress;
+        mpc_vm_unwind(m, i, &vn, m->stack[sp].vals);
+        ok = 0;
+        e = mpc_err_new(i, "opposite");
+        break;
+      
+      case MPC_OP_CALL:
+        ok = depth < depth_max;
+        if (ok) {
+          mpc_vm_frame(m, i, &sp, pc, 1, vn, mn, p);
+          pc = in->x;
+          depth++;
+        } else {
+          e = mpc_err_fail(i, mpc_depth_failure);
+        }
+        break;
+      
+      case MPC_OP_RETURN:
+        pc = m->stack[--sp].pc;
+        depth--;
+        break;
+      
+      case MPC_OP_MARK:
+        mpc_vm_keep_marks(m, mn);
+        if (mn == m->marks_slots) {
+          m->marks_slots = m->marks_slots ? m->marks_slots * 2 : 64;
+          m->marks = realloc(m->marks, sizeof(int) * m->marks_slots);
+        }
+        m->marks[mn++] = vn;
+        break;
+      
+      case MPC_OP_OWN:
+        mpc_vm_keep_vals(m, vn-1);
+        m->dtors[vn-1] = mpc_vm_dtor(p, in->x);
+        break;
+      
+      case MPC_OP_FOLD:
+        n = vn - m->marks[mn-1];
+        ok = n >= in->x;
+        if (ok) {
+          mpc_err_merge(i, e);
+          e = NULL;
+          mn--;
+          vn -= n;
+          o = mpc_parse_fold(i, p->type == MPC_TYPE_AND ? p->data.and.f : p->data.repeat.f, n, m->vals + vn);
+          mpc_vm_push(m, &vn, o);
+        } else {
+          e = mpc_err_many1(i, e);
+        }
+        break;
+      
+      case MPC_OP_COUNT:
+        if (vn - m->marks[mn-1] == in->x) { pc = in->y; }
+        break;
+      
+      case MPC_OP_APPLY:
+        mpc_vm_keep_vals(m, vn-1);
+        m->vals[vn-1] = p->type != MPC_TYPE_SKIP ? mpc_parse_apply(i, p->data.apply.f, m->vals[vn-1])
+          : i->capture ? NULL : mpcf_input_free(i, m->vals[vn-1]);
+        break;
+      
+      case MPC_OP_APPLY_TO:
+        mpc_vm_keep_vals(m, vn-1);
+        m->vals[vn-1] = mpc_parse_apply_to(i, p->data.apply_to.f, m->vals[vn-1], p->data.apply_to.d);
+        break;
+      
+      case MPC_OP_PUSH:
+        mpc_vm_push(m, &vn, in->x ? p->data.lift.x : NULL);
+        break;
+      
+      case MPC_OP_LIFT:
+        mpc_vm_push(m, &vn, i->capture ? NULL : p->type == MPC_TYPE_LIFT ? p->data.lift.lf() : p->data.not.lf());
+        break;
+      
+      case MPC_OP_STATE:
+        mpc_vm_push(m, &vn, i->capture ? NULL : mpc_input_state_copy(i));
+        break;
+      
+      case MPC_OP_NATIVE:
+        /* Over a partial view it's first only recognised, taking back any failures */
+        if (i->partial) {
+          start = i->pos;
+          last = i->last;
+          mpc_fail_mark(i, &f);
+          i->depth = depth;
+          i->depth_stop = mpc_depth_stop(i, depth);
+          i->capture++;
+          mpc_parse_run(i, p, &x);
+          i->capture--;
+          i->depth = 0;
+          mpc_fail_rewind(i, &f);
+          mpc_input_memo_clear(i);
+          i->pos = start;
+          i->last = last;
+          if (i->starved) { ok = 0; break; }
+        }
+        i->depth = depth;
+        i->depth_stop = mpc_depth_stop(i, depth);
+        ok = mpc_parse_run(i, p, &x);
+        i->depth = 0;
+        if (ok) { mpc_vm_push(m, &vn, x.output); } else { e = x.error; }
+        break;
+      
+      default: ok = 0; break;
+    }
+    
+    if (ok) { continue; }
+    
+    /* Tokens scanned up to the end of the view may be cut short, so are dropped */
+    if (i->starved) {
+      i->starved = 0;
+      i->scanner = NULL;
+      mpc_input_memo_clear(i);
+      m->running = 1;
+      m->pc = (int)(in - c->code);
+      m->sp = sp;
+      m->vn = vn;
+      m->mn = mn;
+      m->depth = depth;
+      return -1;
+    }
+    
+    /*
+    ** Back to the latest choice, skipping the calls made
+    ** since. An `expect` or `count` there changes the
+    ** error and fails on, a `many1` leaves it for its
+    ** fold, and anything else takes it.
+    */
+    while (1) {
+      
+      while (sp > 0 && m->stack[sp-1].call) { sp--; depth--; }
+      
+      if (sp == 0) {
+        mpc_vm_unwind(m, i, &vn, 0);
+        if (!trial) { m->running = 0; }
+        r->error = e;
+        return 0;
+      }
+      
+      sp--;
+      pc = m->stack[sp].pc;
+      mn = m->stack[sp].marks;
+      i->pos = m->stack[sp].pos;
+      i->last = m->stack[sp].last;
+      i->suppress = m->stack[sp].suppress;
+      mpc_vm_unwind(m, i, &vn, m->stack[sp].vals);
+      
+      p = m->stack[sp].p;
+      if (p->type == MPC_TYPE_EXPECT) { e = mpc_err_new(i, p->data.expect.m); continue; }
+      if (p->type == MPC_TYPE_COUNT) { e = mpc_err_count(i, e, p->data.repeat.n); continue; }
+      if (p->type != MPC_TYPE_MANY1) { mpc_err_merge(i, e); e = NULL; }
+      break;
+    }
+  }
+  
+}
+
+static int mpc_vm_running(mpc_input_t *i) {
+  return i->vm && i->vm->running;
+}
+
+/* Starts or resumes a run, giving -1 if it is suspended again */
+static int mpc_parse_input_compiled(mpc_input_t *i, mpc_program_t *c, mpc_result_t *r) {
+  int x;
+  if (i->vm == NULL) { i->vm = calloc(1, sizeof(mpc_vm_t)); }
+  if (!i->vm->running) { mpc_fail_reset(i); }
+  x = mpc_vm_run(i, c, r, 0);
+  return x < 0 ? x : mpc_parse_finish(i, x, r);
+}
+
+/*
+** Runs a suspended program on as though its view were
+** the whole input, only recognising, and then puts
+** back everything it changed. Gives 1 if the run would
+** succeed, -1 if it would fail at the end of the view
+** and so could still succeed given more input, and 0
+** if it would fail anywhere else.
+*/
+
+static int mpc_vm_trial(mpc_input_t *i, mpc_program_t *c) {
+  
+  mpc_vm_t *m = i->vm;
+  mpc_result_t r;
+  mpc_fail_t *fails = malloc(sizeof(mpc_fail_t) * (size_t)(i->fails_num + 1));
+  long pos = i->pos, fail_pos = i->fail_pos;
+  char last = i->last, recieved = i->fail_recieved;
+  int suppress = i->suppress, num = i->fails_num, floor = i->fails_floor, x, j;
+  
+  if (num > 0) { memcpy(fails, i->fails, sizeof(mpc_fail_t) * (size_t)num); }
+  
+  m->keep_sp = m->sp;
+  m->keep_vn = m->vn;
+  m->keep_mn = m->mn;
+  m->kept_stack = malloc(sizeof(mpc_frame_t) * (size_t)(m->sp + 1));
+  m->kept_vals = malloc(sizeof(mpc_val_t*) * (size_t)(m->vn + 1));
+  m->kept_dtors = malloc(sizeof(mpc_dtor_t) * (size_t)(m->vn + 1));
+  m->kept_marks = malloc(sizeof(int) * (size_t)(m->mn + 1));
+  
+  i->capture++;
+  x = mpc_vm_run(i, c, &r, 1);
+  i->capture--;
+  
+  if (!x) {
+    mpc_err_merge(i, r.error);
+    mpc_fail_settle(i);
+    x = i->fail_pos == i->origin.pos + (long)i->length ? -1 : 0;
+    for (j = 0; j < i->fails_num; j++) {
+      if (i->fails[j].failure) { x = 0; }
+    }
+  }
+  
+  memcpy(m->stack + m->keep_sp, m->kept_stack + m->keep_sp, sizeof(mpc_frame_t) * (size_t)(m->sp - m->keep_sp));
+  memcpy(m->vals + m->keep_vn, m->kept_vals + m->keep_vn, sizeof(mpc_val_t*) * (size_t)(m->vn - m->keep_vn));
+  memcpy(m->dtors + m->keep_vn, m->kept_dtors + m->keep_vn, sizeof(mpc_dtor_t) * (size_t)(m->vn - m->keep_vn));
+  memcpy(m->marks + m->keep_mn, m->kept_marks + m->keep_mn, sizeof(int) * (size_t)(m->mn - m->keep_mn));
+  free(m->kept_stack);
+  free(m->kept_vals);
+  free(m->kept_dtors);
+  free(m->kept_marks);
+  m->keep_sp = 0;
+  m->keep_vn = 0;
+  m->keep_mn = 0;
+  
+  if (num > 0) { memcpy(i->fails, fails, sizeof(mpc_fail_t) * (size_t)num); }
+  free(fails);
+  i->fails_num = num;
+  i->fails_floor = floor;
+  i->fail_pos = fail_pos;
+  i->fail_recieved = recieved;
+  i->pos = pos;
+  i->last = last;
+  i->suppress = suppress;
+  i->scanner = NULL;
+  mpc_input_memo_clear(i);
+  return x;
+}
+
+int mpc_parse_compiled(const char *filename, const char *string, mpc_program_t *c, mpc_result_t *r) {
+  int x;
+  mpc_input_t *i = mpc_input_new_string(filename, string, strlen(string));
+  x = mpc_parse_input_compiled(i, c, r);
+  mpc_input_delete(i);
+  return x;
+}
+
+/*
+** Generated Parsers
+**
+** `mpca_lang_generate` reads a grammar just as
+** `mpca_lang` does and writes C source for it, with
+** a function for every parser reachable from its
+** rules doing what the interpreter would do there with
+** errors suppressed. Dispatch tables
+** become `switch`es, character classes and automata
+** become plain comparisons, and outputs are built by
+** calling the same fold and apply functions by name.
+** Nothing is built at startup.
+**
+** Generated code keeps no errors. When one of its
+** parses fails the grammar is built with `mpca_lang`,
+** the first time it's needed, and the input parsed
+** again by the interpreter, so messages are the same.
+** Only functions of this library can be named, so a
+** grammar needing any other can't be generated.
+*/
+
+enum {
+  MPC_GEN_VALUE   = 1,
+  MPC_GEN_CAPTURE = 2
+};
+
+enum {
+  MPC_GEN_PEEK     = 1,
+  MPC_GEN_TEXT     = 2,
+  MPC_GEN_STATE    = 4,
+  MPC_GEN_GROW     = 8,
+  MPC_GEN_REWIND   = 16,
+  MPC_GEN_BOUNDARY = 32,
+  MPC_GEN_TOKEN    = 64,
+  MPC_GEN_PREFIX   = 128
+};
+
+typedef void (*mpc_gen_fp_t)(void);
+
+typedef struct {
+  mpc_gen_fp_t f;
+  const char *name;
+} mpc_gen_name_t;
+
+static const mpc_gen_name_t mpc_gen_names[] = {
+  { (mpc_gen_fp_t)free,                     "free" },
+  { (mpc_gen_fp_t)mpcf_dtor_null,           "mpcf_dtor_null" },
+  { (mpc_gen_fp_t)mpcf_ctor_null,           "mpcf_ctor_null" },
+  { (mpc_gen_fp_t)mpcf_ctor_str,            "mpcf_ctor_str" },
+  { (mpc_gen_fp_t)mpcf_free,                "mpcf_free" },
+  { (mpc_gen_fp_t)mpcf_int,                 "mpcf_int" },
+  { (mpc_gen_fp_t)mpcf_hex,                 "mpcf_hex" },
+  { (mpc_gen_fp_t)mpcf_oct,                 "mpcf_oct" },
+  { (mpc_gen_fp_t)mpcf_float,               "mpcf_float" },
+  { (mpc_gen_fp_t)mpcf_strtriml,            "mpcf_strtriml" },
+  { (mpc_gen_fp_t)mpcf_strtrimr,            "mpcf_strtrimr" },
+  { (mpc_gen_fp_t)mpcf_strtrim,             "mpcf_strtrim" },
+  { (mpc_gen_fp_t)mpcf_escape,              "mpcf_escape" },
+  { (mpc_gen_fp_t)mpcf_escape_regex,        "mpcf_escape_regex" },
+  { (mpc_gen_fp_t)mpcf_escape_string_raw,   "mpcf_escape_string_raw" },
+  { (mpc_gen_fp_t)mpcf_escape_char_raw,     "mpcf_escape_char_raw" },
+  { (mpc_gen_fp_t)mpcf_unescape,            "mpcf_unescape" },
+  { (mpc_gen_fp_t)mpcf_unescape_regex,      "mpcf_unescape_regex" },
+  { (mpc_gen_fp_t)mpcf_unescape_string_raw, "mpcf_unescape_string_raw" },
+  { (mpc_gen_fp_t)mpcf_unescape_char_raw,   "mpcf_unescape_char_raw" },
+  { (mpc_gen_fp_t)mpcf_null,                "mpcf_null" },
+  { (mpc_gen_fp_t)mpcf_fst,                 "mpcf_fst" },
+  { (mpc_gen_fp_t)mpcf_snd,                 "mpcf_snd" },
+  { (mpc_gen_fp_t)mpcf_trd,                 "mpcf_trd" },
+  { (mpc_gen_fp_t)mpcf_fst_free,            "mpcf_fst_free" },
+  { (mpc_gen_fp_t)mpcf_snd_free,            "mpcf_snd_free" },
+  { (mpc_gen_fp_t)mpcf_trd_free,            "mpcf_trd_free" },
+  { (mpc_gen_fp_t)mpcf_strfold,             "mpcf_strfold" },
+  { (mpc_gen_fp_t)mpcf_maths,               "mpcf_maths" },
+  { (mpc_gen_fp_t)mpcf_fold_ast,            "mpcf_fold_ast" },
+  { (mpc_gen_fp_t)mpcf_str_ast,             "mpcf_str_ast" },
+  { (mpc_gen_fp_t)mpcf_state_ast,           "mpcf_state_ast" },
+  { (mpc_gen_fp_t)mpc_ast_delete,           "mpc_ast_delete" },
+  { (mpc_gen_fp_t)mpc_ast_add_root,         "mpc_ast_add_root" },
+  { (mpc_gen_fp_t)mpc_ast_tag,              "mpc_ast_tag" },
+  { (mpc_gen_fp_t)mpc_ast_add_tag,          "mpc_ast_add_tag" },
+  { (mpc_gen_fp_t)mpc_ast_add_root_tag,     "mpc_ast_add_root_tag" },
+  { NULL, NULL }
+};
+
+typedef struct {
+  FILE *f;
+  mpc_parser_t **ps;
+  int *uses;
+  int ps_num;
+  int ps_slots;
+  unsigned char *sets;
+  int sets_num;
+  int predict;
+  int predicts;
+  int needs;
+  mpc_scanner_t *scanner;
+  char *error;
+} mpc_gen_t;
+
+static void mpc_gen_out(mpc_gen_t *g, const char *fmt, ...) {
+  va_list va;
+  if (g->f == NULL) { return; }
+  va_start(va, fmt);
+  vfprintf(g->f, fmt, va);
+  va_end(va);
+}
+
+static void mpc_gen_fail(mpc_gen_t *g, const char *fmt, const char *x) {
+  if (g->error) { return; }
+  g->error = malloc(strlen(fmt) + strlen(x) + 1);
+  sprintf(g->error, fmt, x);
+}
+
+static const char *mpc_gen_name(mpc_gen_t *g, mpc_gen_fp_t f) {
+  int j;
+  for (j = 0; mpc_gen_names[j].name; j++) {
+    if (mpc_gen_names[j].f == f) { return mpc_gen_names[j].name; }
+  }
+  mpc_gen_fail(g, "Can't generate a call to a function outside of %s!", "mpc");
+  return "NULL";
+}
+
+static void mpc_gen_literal(mpc_gen_t *g, const char *s, size_t n) {
+  size_t j;
+  unsigned char c;
+  mpc_gen_out(g, "\"");
+  for (j = 0; j < n; j++) {
+    c = (unsigned char)s[j];
+    if      (c == '"' || c == '\\' || c == '?') { mpc_gen_out(g, "\\%c", c); }
+    else if (c == '\n' && j + 1 < n) { mpc_gen_out(g, "\\n\"\n  \""); }
+    else if (c == '\n') { mpc_gen_out(g, "\\n"); }
+    else if (c == '\t') { mpc_gen_out(g, "\\t"); }
+    else if (c >= ' ' && c < 127) { mpc_gen_out(g, "%c", c); }
+    else { mpc_gen_out(g, "\\%03o", c); }
+  }
+  mpc_gen_out(g, "\"");
+}
+
+static void mpc_gen_char(mpc_gen_t *g, int c) {
+  if (c > 0 && c < 127 && (isalnum(c) || strchr(" !#$%&()*+,-./:;<=>@[]^_`{|}~", c))) {
+    mpc_gen_out(g, "'%c'", c);
+  } else {
+    mpc_gen_out(g, "%i", c);
+  }
+}
+
+/* Parsers only there for errors or memoization are skipped */
+static mpc_parser_t *mpc_gen_skip(mpc_parser_t *p) {
+  while (!p->retained && (p->type == MPC_TYPE_EXPECT || p->type == MPC_TYPE_MEMO)) {
+    p = p->type == MPC_TYPE_EXPECT ? p->data.expect.x : p->data.memo.x;
+  }
+  return p;
+}
+
+static int mpc_gen_find(mpc_gen_t *g, mpc_parser_t *p) {
+  int j;
+  for (j = 0; j < g->ps_num; j++) {
+    if (g->ps[j] == p) { return j; }
+  }
+  return -1;
+}
+
+/* The function for a parser, with its output or only matching inside a capture */
+static void mpc_gen_ref(mpc_gen_t *g, mpc_parser_t *p, int use) {
+  mpc_gen_out(g, "mpcg_%c%i", use == MPC_GEN_CAPTURE ? 'c' : 'p', mpc_gen_find(g, mpc_gen_skip(p)));
+}
+
+/*
+** Every parser reachable from the rules is listed
+** along with how it's used. Inside a capture only
+** what is matched matters, and what's output is only
+** needed too if backtracking can be turned off, as
+** the interpreter then runs the capture's parser as
+** it is.
+*/
+
+static void mpc_gen_collect(mpc_gen_t *g, mpc_parser_t *p, int use) {
+  
+  int j, k;
+  
+  p = mpc_gen_skip(p);
+  k = mpc_gen_find(g, p);
+  
+  if (k >= 0 && (g->uses[k] & use) == use) { return; }
+  
+  if (k < 0) {
+    if (g->ps_num == g->ps_slots) {
+      g->ps_slots = g->ps_slots ? g->ps_slots * 2 : 64;
+      g->ps = realloc(g->ps, sizeof(mpc_parser_t*) * g->ps_slots);
+      g->uses = realloc(g->uses, sizeof(int) * g->ps_slots);
+    }
+    k = g->ps_num++;
+    g->ps[k] = p;
+    g->uses[k] = 0;
+  }
+  g->uses[k] |= use;
+  
+  switch (p->type) {
+    case MPC_TYPE_EXPECT:   mpc_gen_collect(g, p->data.expect.x, use); break;
+    case MPC_TYPE_MEMO:     mpc_gen_collect(g, p->data.memo.x, use); break;
+    case MPC_TYPE_APPLY:    mpc_gen_collect(g, p->data.apply.x, use); break;
+    case MPC_TYPE_APPLY_TO: mpc_gen_collect(g, p->data.apply_to.x, use); break;
+    case MPC_TYPE_TOKEN:    mpc_gen_collect(g, p->data.token.x, use); break;
+    case MPC_TYPE_SKIP:     mpc_gen_collect(g, p->data.capture.x, MPC_GEN_CAPTURE); break;
+    
+    case MPC_TYPE_DFA:
+      if (g->predict) { mpc_gen_collect(g, p->data.dfa.x, use); }
+      break;
+    
+    case MPC_TYPE_PREDICT:
+      g->predicts++;
+      mpc_gen_collect(g, p->data.predict.x, use);
+      break;
+    
+    case MPC_TYPE_CAPTURE:
+      mpc_gen_collect(g, p->data.capture.x, MPC_GEN_CAPTURE);
+      if (g->predict && use == MPC_GEN_VALUE) { mpc_gen_collect(g, p->data.capture.x, MPC_GEN_VALUE); }
+      break;
+    
+    case MPC_TYPE_NOT:
+    case MPC_TYPE_MAYBE:
+      mpc_gen_collect(g, p->data.not.x, use);
+      break;
+    
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      mpc_gen_collect(g, p->data.repeat.x, use);
+      break;
+    
+    case MPC_TYPE_OR:
+      for (j = 0; j < p->data.or.n; j++) { mpc_gen_collect(g, p->data.or.xs[j], use); }
+      break;
+    
+    case MPC_TYPE_AND:
+      for (j = 0; j < p->data.and.n; j++) { mpc_gen_collect(g, p->data.and.xs[j], use); }
+      break;
+    
+    default: break;
+  }
+  
+}
+
+static int mpc_gen_set(mpc_gen_t *g, const unsigned char *set) {
+  int j;
+  for (j = 0; j < g->sets_num; j++) {
+    if (memcmp(g->sets + j * 32, set, 32) == 0) { return j; }
+  }
+  g->sets = realloc(g->sets, 32 * (g->sets_num + 1));
+  memcpy(g->sets + g->sets_num * 32, set, 32);
+  return g->sets_num++;
+}
+
+static int mpc_gen_has(const unsigned char *set, int c) {
+  return c >= 0 && c < 256 && (set[c / 8] & (1 << (c % 8)));
+}
+
+/*
+** Tests whether `c`, from 0 to 256, is in a set of
+** bytes. A few runs of bytes are compared directly
+** and more than that are looked up in a table.
+*/
+
+static void mpc_gen_test(mpc_gen_t *g, const unsigned char *set, const char *c) {
+  
+  int j, k, n = 0;
+  
+  for (j = 0; j < 256; j++) {
+    if (mpc_gen_has(set, j) && !mpc_gen_has(set, j-1)) { n++; }
+  }
+  
+  if (n == 0) { mpc_gen_out(g, "0"); return; }
+  
+  if (n > 4) {
+    mpc_gen_out(g, "(%s < 256 && mpcg_sets[%i][%s / 8] & (1 << (%s %% 8)))", c, mpc_gen_set(g, set), c, c);
+    return;
+  }
+  
+  mpc_gen_out(g, "(");
+  for (j = 0, n = 0; j < 256; j = k + 1) {
+    if (!mpc_gen_has(set, j)) { k = j; continue; }
+    for (k = j; mpc_gen_has(set, k + 1); k++);
+    if (n++) { mpc_gen_out(g, " || "); }
+    if (k == j) {
+      mpc_gen_out(g, "%s == ", c);
+      mpc_gen_char(g, j);
+    } else if (j == 0) {
+      mpc_gen_out(g, "%s <= ", c);
+      mpc_gen_char(g, k);
+    } else {
+      mpc_gen_out(g, "(%s >= ", c);
+      mpc_gen_char(g, j);
+      mpc_gen_out(g, " && %s <= ", c);
+      mpc_gen_char(g, k);
+      mpc_gen_out(g, ")");
+    }
+  }
+  mpc_gen_out(g, ")");
+}
+
+static void mpc_gen_class(mpc_parser_t *p, unsigned char *set) {
+  int c;
+  if (p->type == MPC_TYPE_ONEOF || p->type == MPC_TYPE_NONEOF) {
+    memcpy(set, p->data.string.set, 32);
+    return;
+  }
+  memset(set, 0, 32);
+  for (c = 0; c < 256; c++) {
+    if (p->type == MPC_TYPE_ANY
+    || (p->type == MPC_TYPE_SINGLE && (char)c == p->data.single.x)
+    || (p->type == MPC_TYPE_RANGE && (char)c >= p->data.range.x && (char)c <= p->data.range.y)) {
+      set[c / 8] |= 1 << (c % 8);
+    }
+  }
+}
+
+static void mpc_gen_reach(const int *trans, char *seen, int q) {
+  int c;
+  seen[q] = 1;
+  for (c = 0; c < 256; c++) {
+    if (trans[q * 256 + c] >= 0 && !seen[trans[q * 256 + c]]) { mpc_gen_reach(trans, seen, trans[q * 256 + c]); }
+  }
+}
+
+/*
+** An automaton has a label for each state reachable
+** from the first. It returns the end of the longest
+** match, or -1, and the state it was found in. With
+** `empty` nothing at all is a match if the first
+** state accepts, as for a regex but not a scanner.
+*/
+
+static void mpc_gen_dfa(mpc_gen_t *g, const char *name, const int *trans, const char *accept, int n, int empty) {
+  
+  int q, t, c, any;
+  unsigned char set[32];
+  char *seen = calloc(n, 1);
+  char *into = calloc(n, 1);
+  
+  mpc_gen_reach(trans, seen, 0);
+  for (q = 0; q < n * 256; q++) {
+    if (seen[q / 256] && trans[q] >= 0) { into[trans[q]] = 1; }
+  }
+  
+  mpc_gen_out(g, "static long %s(const char *string, long j, long length, int *state) {\n", name);
+  mpc_gen_out(g, "  const unsigned char *s = (const unsigned char*)string;\n");
+  mpc_gen_out(g, "  long end = %s;\n", empty && accept[0] ? "j" : "-1");
+  mpc_gen_out(g, "  int c;\n");
+  mpc_gen_out(g, "  *state = 0;\n");
+  if (accept[0] && !empty && into[0]) { mpc_gen_out(g, "  goto t0;\n"); }
+  
+  for (q = 0; q < n; q++) {
+    
+    if (!seen[q]) { continue; }
+    
+    if (into[q]) { mpc_gen_out(g, "s%i:\n", q); }
+    if (accept[q] && (q > 0 || empty || into[q])) { mpc_gen_out(g, "  end = j; *state = %i;\n", q); }
+    if (accept[q] && !empty && into[q] && q == 0) { mpc_gen_out(g, "t0:\n"); }
+    
+    for (c = 0, any = 0; c < 256; c++) { any |= trans[q * 256 + c] >= 0; }
+    if (!any) { mpc_gen_out(g, "  return end;\n"); continue; }
+    
+    mpc_gen_out(g, "  if (j == length) { return end; }\n");
+    mpc_gen_out(g, "  c = s[j];\n");
+    
+    for (t = 0; t < n; t++) {
+      memset(set, 0, 32);
+      for (c = 0, any = 0; c < 256; c++) {
+        if (trans[q * 256 + c] == t) { set[c / 8] |= 1 << (c % 8); any = 1; }
+      }
+      if (!any) { continue; }
+      mpc_gen_out(g, "  if ");
+      mpc_gen_test(g, set, "c");
+      mpc_gen_out(g, " { j++; goto s%i; }\n", t);
+    }
+    mpc_gen_out(g, "  return end;\n");
+  }
+  
+  mpc_gen_out(g, "}\n\n");
+  free(seen);
+  free(into);
+}
+
+static void mpc_gen_fold(mpc_gen_t *g, mpc_fold_t f, const char *n, int use) {
+  if (f == mpcf_strfold && use == MPC_GEN_CAPTURE) { mpc_gen_out(g, "NULL"); return; }
+  mpc_gen_out(g, "%s(%s, xs)", mpc_gen_name(g, (mpc_gen_fp_t)f), n);
+}
+
+static void mpc_gen_dtor(mpc_gen_t *g, const char *indent, mpc_dtor_t d, const char *x) {
+  if (d == mpcf_dtor_null) { return; }
+  mpc_gen_out(g, "%s%s(%s);\n", indent, mpc_gen_name(g, (mpc_gen_fp_t)d), x);
+}
+
+static int mpc_gen_lookahead(mpc_gen_t *g, const unsigned char *lookahead, int gen) {
+  if (lookahead == NULL || gen != mpc_generation) { return 0; }
+  g->needs |= MPC_GEN_PEEK;
+  mpc_gen_out(g, "(c = mpcg_peek(i), ");
+  mpc_gen_test(g, lookahead, "c");
+  mpc_gen_out(g, ") && ");
+  return 1;
+}
+
+static void mpc_gen_recover(mpc_gen_t *g, const char *indent) {
+  if (g->predict) { mpc_gen_out(g, "%sif (i->backtrack < 1 && i->pos != pos) { i->dirty = 1; }\n", indent); }
+}
+
+/* A predictive alternative which failed having moved leaves the row's lookahead behind, so the rest all run */
+static void mpc_gen_alternatives(mpc_gen_t *g, mpc_parser_t *p, int use, const unsigned char *row) {
+  int j, k;
+  for (j = 0; j < p->data.or.n; j++) {
+    if (row && !mpc_gen_has(row, j)) { continue; }
+    mpc_gen_out(g, "      if (");
+    mpc_gen_ref(g, p->data.or.xs[j], use);
+    mpc_gen_out(g, "(i, o)) { return 1; }\n");
+    mpc_gen_recover(g, "      ");
+    if (g->predict && row && j < p->data.or.n - 1) {
+      mpc_gen_out(g, "      if (i->pos != pos) { return ");
+      for (k = j + 1; k < p->data.or.n; k++) {
+        if (k > j + 1) { mpc_gen_out(g, " || "); }
+        mpc_gen_ref(g, p->data.or.xs[k], use);
+        mpc_gen_out(g, "(i, o)");
+      }
+      mpc_gen_out(g, "; }\n");
+    }
+  }
+  mpc_gen_out(g, "      return 0;\n");
+}
+
+/* Alike rows of a dispatch table share a case, and the most common is the default */
+static void mpc_gen_dispatch(mpc_gen_t *g, mpc_parser_t *p, int use) {
+  
+  int r, s, k, n, best = 0, best_n = 0;
+  int w = (p->data.or.n + 7) / 8;
+  const unsigned char *d = p->data.or.dispatch;
+  
+  for (r = 0; r < MPC_DISPATCH_ROWS; r++) {
+    for (s = 0, n = 0; s < MPC_DISPATCH_ROWS; s++) { n += memcmp(d + r * w, d + s * w, w) == 0; }
+    if (n > best_n) { best = r; best_n = n; }
+  }
+  
+  g->needs |= MPC_GEN_PEEK;
+  mpc_gen_out(g, "  switch (mpcg_peek(i)) {\n");
+  
+  for (r = 0; r < MPC_DISPATCH_ROWS; r++) {
+    
+    for (s = 0; s < r; s++) {
+      if (memcmp(d + r * w, d + s * w, w) == 0) { break; }
+    }
+    if (s < r || memcmp(d + r * w, d + best * w, w) == 0) { continue; }
+    
+    for (s = r, k = 0; s < MPC_DISPATCH_ROWS; s++) {
+      if (memcmp(d + r * w, d + s * w, w) != 0) { continue; }
+      mpc_gen_out(g, k == 0 ? "    case " : k % 8 == 0 ? "\n    case " : " case ");
+      mpc_gen_char(g, s);
+      mpc_gen_out(g, ":");
+      k++;
+    }
+    mpc_gen_out(g, "\n");
+    mpc_gen_alternatives(g, p, use, d + r * w);
+  }
+  
+  mpc_gen_out(g, "    default:\n");
+  mpc_gen_alternatives(g, p, use, d + best * w);
+  mpc_gen_out(g, "  }\n");
+}
+
+/* Hands the parse over to another parser, when `cond` holds if given */
+static void mpc_gen_call(mpc_gen_t *g, const char *cond, mpc_parser_t *x, int use) {
+  if (cond) { mpc_gen_out(g, "  if (%s) { return ", cond); }
+  else { mpc_gen_out(g, "  return "); }
+  mpc_gen_ref(g, x, use);
+  mpc_gen_out(g, cond ? "(i, o); }\n" : "(i, o);\n");
+}
+
+static void mpc_gen_matched(mpc_gen_t *g, int use, const char *start) {
+  if (use == MPC_GEN_CAPTURE) {
+    mpc_gen_out(g, "  *o = NULL;\n");
+  } else {
+    g->needs |= MPC_GEN_TEXT;
+    mpc_gen_out(g, "  *o = mpcg_text(i->string + %s, i->pos - (%s));\n", start, start);
+  }
+}
+
+static void mpc_gen_body(mpc_gen_t *g, mpc_parser_t *p, int use) {
+  
+  int j, n;
+  unsigned char set[32];
+  char x[32];
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      mpc_gen_class(p, set);
+      mpc_gen_out(g, "  int c;\n");
+      mpc_gen_out(g, "  if (i->pos == i->length) { return 0; }\n");
+      mpc_gen_out(g, "  c = (unsigned char)i->string[i->pos];\n");
+      mpc_gen_out(g, "  if (!");
+      mpc_gen_test(g, set, "c");
+      mpc_gen_out(g, ") { return 0; }\n");
+      mpc_gen_out(g, "  i->last = i->string[i->pos++];\n");
+      mpc_gen_matched(g, use, "i->pos - 1");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_STRING:
+      n = (int)strlen(p->data.string.x);
+      mpc_gen_out(g, "  if (i->length - i->pos < %i || memcmp(i->string + i->pos, ", n);
+      mpc_gen_literal(g, p->data.string.x, n);
+      if (g->predict) {
+        g->needs |= MPC_GEN_PREFIX;
+        mpc_gen_out(g, ", %i) != 0) { return mpcg_prefix(i, ", n);
+        mpc_gen_literal(g, p->data.string.x, n);
+        mpc_gen_out(g, "); }\n");
+      } else {
+        mpc_gen_out(g, ", %i) != 0) { return 0; }\n", n);
+      }
+      if (n > 0) {
+        mpc_gen_out(g, "  i->pos += %i;\n", n);
+        mpc_gen_out(g, "  i->last = i->string[i->pos - 1];\n");
+      }
+      sprintf(x, "i->pos - %i", n);
+      mpc_gen_matched(g, use, x);
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_ANCHOR:
+      mpc_gen_out(g, "  *o = NULL;\n");
+      if (p->data.anchor.f == mpc_soi_anchor) {
+        mpc_gen_out(g, "  return i->last == '\\0';\n");
+      } else if (p->data.anchor.f == mpc_eoi_anchor) {
+        mpc_gen_out(g, "  return i->pos == i->length;\n");
+      } else if (p->data.anchor.f == mpc_boundary_anchor) {
+        g->needs |= MPC_GEN_BOUNDARY;
+        mpc_gen_out(g, "  return mpcg_boundary(i->last, i->pos < i->length ? i->string[i->pos] : '\\0');\n");
+      } else {
+        mpc_gen_fail(g, "Can't generate an %s with a function outside of mpc!", "anchor");
+        mpc_gen_out(g, "  return 0;\n");
+      }
+      break;
+    
+    case MPC_TYPE_UNDEFINED:
+      mpc_gen_fail(g, "Parser '%s' is never defined!", p->name ? p->name : "");
+      mpc_gen_out(g, "  (void) i; (void) o;\n");
+      mpc_gen_out(g, "  return 0;\n");
+      break;
+    
+    case MPC_TYPE_FAIL:
+      mpc_gen_out(g, "  (void) i; (void) o;\n");
+      mpc_gen_out(g, "  return 0;\n");
+      break;
+    
+    case MPC_TYPE_PASS:
+      mpc_gen_out(g, "  (void) i;\n");
+      mpc_gen_out(g, "  *o = NULL;\n");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_LIFT:
+      mpc_gen_out(g, "  (void) i;\n");
+      if (use == MPC_GEN_CAPTURE) {
+        mpc_gen_out(g, "  *o = NULL;\n");
+      } else {
+        mpc_gen_out(g, "  *o = %s();\n", mpc_gen_name(g, (mpc_gen_fp_t)p->data.lift.lf));
+      }
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_LIFT_VAL:
+      if (p->data.lift.x) { mpc_gen_fail(g, "Can't generate a %s of a value!", "lift"); }
+      mpc_gen_out(g, "  (void) i;\n");
+      mpc_gen_out(g, "  *o = NULL;\n");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_STATE:
+      g->needs |= MPC_GEN_STATE;
+      mpc_gen_out(g, "  *o = mpcg_state(i);\n");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_EXPECT: mpc_gen_call(g, NULL, p->data.expect.x, use); break;
+    case MPC_TYPE_MEMO:   mpc_gen_call(g, NULL, p->data.memo.x, use); break;
+    
+    case MPC_TYPE_APPLY:
+      mpc_gen_out(g, "  if (!");
+      mpc_gen_ref(g, p->data.apply.x, use);
+      mpc_gen_out(g, "(i, o)) { return 0; }\n");
+      if (p->data.apply.f != mpcf_free || use == MPC_GEN_VALUE) {
+        mpc_gen_out(g, "  *o = %s(*o);\n", mpc_gen_name(g, (mpc_gen_fp_t)p->data.apply.f));
+      }
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_APPLY_TO:
+      if (p->data.apply_to.f != (mpc_apply_to_t)mpc_ast_tag
+      &&  p->data.apply_to.f != (mpc_apply_to_t)mpc_ast_add_tag
+      &&  p->data.apply_to.f != (mpc_apply_to_t)mpc_ast_add_root_tag) {
+        mpc_gen_fail(g, "Can't generate an %s with anything but a tag!", "apply_to");
+        mpc_gen_out(g, "  (void) i; (void) o;\n");
+        mpc_gen_out(g, "  return 0;\n");
+        break;
+      }
+      mpc_gen_out(g, "  if (!");
+      mpc_gen_ref(g, p->data.apply_to.x, use);
+      mpc_gen_out(g, "(i, o)) { return 0; }\n");
+      mpc_gen_out(g, "  *o = %s(*o, ", mpc_gen_name(g, (mpc_gen_fp_t)p->data.apply_to.f));
+      mpc_gen_literal(g, p->data.apply_to.d, strlen(p->data.apply_to.d));
+      mpc_gen_out(g, ");\n");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_PREDICT:
+      if (p->data.predict.dx == NULL) {
+        mpc_gen_out(g, "  int x, checked = i->checked;\n");
+        mpc_gen_out(g, "  i->checked = 0;\n");
+        mpc_gen_out(g, "  i->backtrack--;\n");
+        mpc_gen_out(g, "  x = ");
+        mpc_gen_ref(g, p->data.predict.x, use);
+        mpc_gen_out(g, "(i, o);\n");
+        mpc_gen_out(g, "  i->backtrack++;\n");
+        mpc_gen_out(g, "  i->checked = checked;\n");
+        mpc_gen_out(g, "  return x;\n");
+        break;
+      }
+      mpc_gen_out(g, "  int x;\n");
+      mpc_gen_out(g, "  long pos = i->pos;\n");
+      mpc_gen_out(g, "  char last = i->last;\n");
+      mpc_gen_call(g, "i->backtrack < 1", p->data.predict.x, use);
+      mpc_gen_out(g, "  i->backtrack--;\n");
+      mpc_gen_out(g, "  i->checked++;\n");
+      mpc_gen_out(g, "  i->dirty = 0;\n");
+      mpc_gen_out(g, "  x = ");
+      mpc_gen_ref(g, p->data.predict.x, use);
+      mpc_gen_out(g, "(i, o);\n");
+      mpc_gen_out(g, "  i->checked--;\n");
+      mpc_gen_out(g, "  i->backtrack++;\n");
+      mpc_gen_out(g, "  if (x && !i->dirty) { return 1; }\n");
+      if (p->data.predict.dx != mpcf_dtor_null) {
+        mpc_gen_out(g, "  if (x) { %s(*o); }\n", mpc_gen_name(g, (mpc_gen_fp_t)p->data.predict.dx));
+      }
+      mpc_gen_out(g, "  i->pos = pos;\n");
+      mpc_gen_out(g, "  i->last = last;\n");
+      mpc_gen_out(g, "  return 0;\n");
+      break;
+    
+    case MPC_TYPE_NOT:
+      g->needs |= MPC_GEN_REWIND;
+      mpc_gen_out(g, "  mpc_val_t *x;\n");
+      mpc_gen_out(g, "  long pos = i->pos;\n");
+      mpc_gen_out(g, "  char last = i->last;\n");
+      mpc_gen_out(g, "  if (");
+      mpc_gen_ref(g, p->data.not.x, use);
+      mpc_gen_out(g, "(i, &x)) {\n");
+      mpc_gen_out(g, "    mpcg_rewind(i, pos, last);\n");
+      mpc_gen_dtor(g, "    ", p->data.not.dx, "x");
+      mpc_gen_out(g, "    return 0;\n");
+      mpc_gen_out(g, "  }\n");
+      mpc_gen_out(g, "  *o = %s();\n", mpc_gen_name(g, (mpc_gen_fp_t)p->data.not.lf));
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_MAYBE:
+      if (p->data.not.lookahead && p->data.not.gen == mpc_generation) { mpc_gen_out(g, "  int c;\n"); }
+      if (g->predict) { mpc_gen_out(g, "  long pos = i->pos;\n"); }
+      mpc_gen_out(g, "  if (");
+      mpc_gen_lookahead(g, p->data.not.lookahead, p->data.not.gen);
+      mpc_gen_ref(g, p->data.not.x, use);
+      mpc_gen_out(g, "(i, o)) { return 1; }\n");
+      mpc_gen_recover(g, "  ");
+      if (use == MPC_GEN_CAPTURE) {
+        mpc_gen_out(g, "  *o = NULL;\n");
+      } else {
+        mpc_gen_out(g, "  *o = %s();\n", mpc_gen_name(g, (mpc_gen_fp_t)p->data.not.lf));
+      }
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+      g->needs |= MPC_GEN_GROW;
+      mpc_gen_out(g, "  mpc_val_t *stk[%i], **xs = stk;\n", MPC_PARSE_STACK_MIN);
+      mpc_gen_out(g, "  int j = 0, slots = %i;\n", MPC_PARSE_STACK_MIN);
+      if (p->data.repeat.lookahead && p->data.repeat.gen == mpc_generation) { mpc_gen_out(g, "  int c;\n"); }
+      if (g->predict) { mpc_gen_out(g, "  long pos = i->pos;\n"); }
+      mpc_gen_out(g, "  while (");
+      mpc_gen_lookahead(g, p->data.repeat.lookahead, p->data.repeat.gen);
+      mpc_gen_ref(g, p->data.repeat.x, use);
+      mpc_gen_out(g, "(i, &xs[j])) {\n");
+      if (g->predict) { mpc_gen_out(g, "    pos = i->pos;\n"); }
+      mpc_gen_out(g, "    if (++j == slots) { xs = mpcg_grow(xs, stk, &slots); }\n");
+      mpc_gen_out(g, "  }\n");
+      mpc_gen_recover(g, "  ");
+      if (p->type == MPC_TYPE_MANY1) {
+        mpc_gen_out(g, "  if (j == 0) { return 0; }\n");
+      }
+      mpc_gen_out(g, "  *o = ");
+      mpc_gen_fold(g, p->data.repeat.f, "j", use);
+      mpc_gen_out(g, ";\n");
+      mpc_gen_out(g, "  if (xs != stk) { free(xs); }\n");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_COUNT:
+      n = p->data.repeat.n;
+      if (n < 1) { mpc_gen_fail(g, "Can't generate a %s of less than one!", "count"); n = 1; }
+      g->needs |= MPC_GEN_REWIND;
+      mpc_gen_out(g, "  mpc_val_t *xs[%i];\n", n);
+      mpc_gen_out(g, "  int j = 0;\n");
+      mpc_gen_out(g, "  long pos = i->pos;\n");
+      mpc_gen_out(g, "  char last = i->last;\n");
+      mpc_gen_out(g, "  while (");
+      mpc_gen_ref(g, p->data.repeat.x, use);
+      mpc_gen_out(g, "(i, &xs[j])) {\n");
+      mpc_gen_out(g, "    if (++j == %i) {\n", n);
+      mpc_gen_out(g, "      *o = ");
+      mpc_gen_fold(g, p->data.repeat.f, "j", use);
+      mpc_gen_out(g, ";\n");
+      mpc_gen_out(g, "      return 1;\n");
+      mpc_gen_out(g, "    }\n");
+      mpc_gen_out(g, "  }\n");
+      if (p->data.repeat.dx != mpcf_dtor_null) {
+        mpc_gen_out(g, "  while (j > 0) { %s(xs[--j]); }\n", mpc_gen_name(g, (mpc_gen_fp_t)p->data.repeat.dx));
+      }
+      mpc_gen_out(g, "  mpcg_rewind(i, pos, last);\n");
+      mpc_gen_out(g, "  return 0;\n");
+      break;
+    
+    case MPC_TYPE_OR:
+      
+      if (p->data.or.n == 0) {
+        mpc_gen_out(g, "  (void) i;\n");
+        mpc_gen_out(g, "  *o = NULL;\n");
+        mpc_gen_out(g, "  return 1;\n");
+        break;
+      }
+      
+      if (g->predict) { mpc_gen_out(g, "  long pos = i->pos;\n"); }
+      
+      if (p->data.or.dispatch && p->data.or.gen == mpc_generation) {
+        mpc_gen_dispatch(g, p, use);
+        break;
+      }
+      
+      if (!g->predict) {
+        mpc_gen_out(g, "  return ");
+        for (j = 0; j < p->data.or.n; j++) {
+          if (j) { mpc_gen_out(g, "\n      || "); }
+          mpc_gen_ref(g, p->data.or.xs[j], use);
+          mpc_gen_out(g, "(i, o)");
+        }
+        mpc_gen_out(g, ";\n");
+        break;
+      }
+      
+      for (j = 0; j < p->data.or.n; j++) {
+        mpc_gen_out(g, "  if (");
+        mpc_gen_ref(g, p->data.or.xs[j], use);
+        mpc_gen_out(g, "(i, o)) { return 1; }\n");
+        mpc_gen_recover(g, "  ");
+      }
+      mpc_gen_out(g, "  return 0;\n");
+      break;
+    
+    case MPC_TYPE_AND:
+      
+      n = p->data.and.n;
+      
+      if (n == 0) {
+        mpc_gen_out(g, "  (void) i;\n");
+        mpc_gen_out(g, "  *o = NULL;\n");
+        mpc_gen_out(g, "  return 1;\n");
+        break;
+      }
+      
+      g->needs |= MPC_GEN_REWIND;
+      mpc_gen_out(g, "  mpc_val_t *xs[%i];\n", n);
+      mpc_gen_out(g, "  long pos = i->pos;\n");
+      mpc_gen_out(g, "  char last = i->last;\n");
+      for (j = 0; j < n; j++) {
+        mpc_gen_out(g, "  if (!");
+        mpc_gen_ref(g, p->data.and.xs[j], use);
+        mpc_gen_out(g, "(i, &xs[%i])) { goto fail%i; }\n", j, j);
+      }
+      sprintf(x, "%i", n);
+      mpc_gen_out(g, "  *o = ");
+      mpc_gen_fold(g, p->data.and.f, x, use);
+      mpc_gen_out(g, ";\n");
+      mpc_gen_out(g, "  return 1;\n");
+      for (j = n-1; j >= 0; j--) {
+        mpc_gen_out(g, "fail%i:\n", j);
+        if (j > 0) {
+          sprintf(x, "xs[%i]", j-1);
+          mpc_gen_dtor(g, "  ", p->data.and.dxs[j-1], x);
+        }
+      }
+      mpc_gen_out(g, "  mpcg_rewind(i, pos, last);\n");
+      mpc_gen_out(g, "  return 0;\n");
+      break;
+    
+    case MPC_TYPE_DFA:
+      mpc_gen_out(g, "  int q;\n");
+      mpc_gen_out(g, "  long start = i->pos, end;\n");
+      if (g->predict) { mpc_gen_call(g, "i->backtrack + i->checked < 1", p->data.dfa.x, use); }
+      mpc_gen_out(g, "  end = mpcg_d%i(i->string, i->pos, i->length, &q);\n", mpc_gen_find(g, p));
+      mpc_gen_out(g, "  if (end < 0) { return 0; }\n");
+      mpc_gen_out(g, "  if (end > start) { i->last = i->string[end - 1]; }\n");
+      mpc_gen_out(g, "  i->pos = end;\n");
+      mpc_gen_matched(g, use, "start");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_SPAN:
+      mpc_gen_out(g, "  long start = i->pos;\n");
+      mpc_gen_out(g, "  int c;\n");
+      mpc_gen_out(g, "  while (i->pos < i->length) {\n");
+      mpc_gen_out(g, "    c = (unsigned char)i->string[i->pos];\n");
+      mpc_gen_out(g, "    if (!");
+      mpc_gen_test(g, p->data.span.set, "c");
+      mpc_gen_out(g, ") { break; }\n");
+      mpc_gen_out(g, "    i->pos++;\n");
+      mpc_gen_out(g, "  }\n");
+      if (p->data.span.min > 0) {
+        mpc_gen_out(g, "  if (i->pos - start < %i) { i->pos = start; return 0; }\n", p->data.span.min);
+      }
+      mpc_gen_out(g, "  if (i->pos > start) { i->last = i->string[i->pos - 1]; }\n");
+      mpc_gen_matched(g, use, "start");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_CAPTURE:
+      if (use == MPC_GEN_CAPTURE) {
+        mpc_gen_call(g, NULL, p->data.capture.x, MPC_GEN_CAPTURE);
+        break;
+      }
+      mpc_gen_out(g, "  long start = i->pos;\n");
+      if (g->predict) {
+        mpc_gen_call(g, "i->backtrack + i->checked < 1", p->data.capture.x, MPC_GEN_VALUE);
+      }
+      mpc_gen_out(g, "  if (!");
+      mpc_gen_ref(g, p->data.capture.x, MPC_GEN_CAPTURE);
+      mpc_gen_out(g, "(i, o)) { return 0; }\n");
+      mpc_gen_matched(g, use, "start");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_SKIP:
+      mpc_gen_out(g, "  if (!");
+      mpc_gen_ref(g, p->data.capture.x, MPC_GEN_CAPTURE);
+      mpc_gen_out(g, "(i, o)) { return 0; }\n");
+      mpc_gen_out(g, "  *o = NULL;\n");
+      mpc_gen_out(g, "  return 1;\n");
+      break;
+    
+    case MPC_TYPE_TOKEN:
+      if (p->data.token.s->trans == NULL) {
+        mpc_gen_call(g, NULL, p->data.token.x, use);
+        break;
+      }
+      if (g->scanner && g->scanner != p->data.token.s) {
+        mpc_gen_fail(g, "Can't generate tokens of more than one %s!", "scanner");
+      }
+      g->scanner = p->data.token.s;
+      g->needs |= MPC_GEN_TOKEN;
+      if (use == MPC_GEN_VALUE) { g->needs |= MPC_GEN_TEXT; }
+      mpc_gen_out(g, "  switch (mpcg_token(i, %i, o, %i)) {\n", p->data.token.kind, use == MPC_GEN_CAPTURE);
+      mpc_gen_out(g, "    case 1: return 1;\n");
+      mpc_gen_out(g, "    case 0: return 0;\n");
+      mpc_gen_out(g, "  }\n");
+      mpc_gen_call(g, NULL, p->data.token.x, use);
+      break;
+    
+    default:
+      mpc_gen_fail(g, "Can't generate a %s parser!", "satisfy");
+      mpc_gen_out(g, "  (void) i; (void) o;\n");
+      mpc_gen_out(g, "  return 0;\n");
+      break;
+  }
+  
+}
+
+static void mpc_gen_runtime(mpc_gen_t *g) {
+  
+  int j, k;
+  mpc_scanner_t *s = g->scanner;
+  
+  mpc_gen_out(g, "typedef struct {\n");
+  mpc_gen_out(g, "  const char *string;\n");
+  mpc_gen_out(g, "  long length;\n");
+  mpc_gen_out(g, "  long pos;\n");
+  mpc_gen_out(g, "  char last;\n");
+  mpc_gen_out(g, "  int backtrack;\n");
+  mpc_gen_out(g, "  int checked;\n");
+  mpc_gen_out(g, "  int dirty;\n");
+  mpc_gen_out(g, "  long lines_pos;\n");
+  mpc_gen_out(g, "  long lines_row;\n");
+  mpc_gen_out(g, "  long token_pos;\n");
+  mpc_gen_out(g, "  long token_end;\n");
+  mpc_gen_out(g, "  int token_state;\n");
+  mpc_gen_out(g, "} mpcg_input_t;\n\n");
+  
+  if (g->sets_num > 0) {
+    mpc_gen_out(g, "static const unsigned char mpcg_sets[%i][32] = {\n", g->sets_num);
+    for (j = 0; j < g->sets_num; j++) {
+      mpc_gen_out(g, "  {");
+      for (k = 0; k < 32; k++) { mpc_gen_out(g, k ? ",%i" : "%i", g->sets[j * 32 + k]); }
+      mpc_gen_out(g, j + 1 < g->sets_num ? "},\n" : "}\n");
+    }
+    mpc_gen_out(g, "};\n\n");
+  }
+  
+  if (g->needs & MPC_GEN_PEEK) {
+    mpc_gen_out(g, "static int mpcg_peek(mpcg_input_t *i) {\n");
+    mpc_gen_out(g, "  return i->pos < i->length ? (unsigned char)i->string[i->pos] : 256;\n");
+    mpc_gen_out(g, "}\n\n");
+  }
+  
+  if (g->needs & MPC_GEN_TEXT) {
+    mpc_gen_out(g, "static char *mpcg_text(const char *s, long n) {\n");
+    mpc_gen_out(g, "  char *x = malloc(n + 1);\n");
+    mpc_gen_out(g, "  memcpy(x, s, n);\n");
+    mpc_gen_out(g, "  x[n] = '\\0';\n");
+    mpc_gen_out(g, "  return x;\n");
+    mpc_gen_out(g, "}\n\n");
+  }
+  
+  if (g->needs & MPC_GEN_STATE) {
+    mpc_gen_out(g, "static mpc_state_t *mpcg_state(mpcg_input_t *i) {\n");
+    mpc_gen_out(g, "  mpc_state_t *s = malloc(sizeof(mpc_state_t));\n");
+    mpc_gen_out(g, "  long j;\n");
+    mpc_gen_out(g, "  while (i->lines_pos < i->pos) { if (i->string[i->lines_pos++] == '\\n') { i->lines_row++; } }\n");
+    mpc_gen_out(g, "  while (i->lines_pos > i->pos) { if (i->string[--i->lines_pos] == '\\n') { i->lines_row--; } }\n");
+    mpc_gen_out(g, "  for (j = i->pos; j > 0 && i->string[j-1] != '\\n'; j--);\n");
+    mpc_gen_out(g, "  s->pos = i->pos;\n");
+    mpc_gen_out(g, "  s->row = i->lines_row;\n");
+    mpc_gen_out(g, "  s->col = i->pos - j;\n");
+    mpc_gen_out(g, "  return s;\n");
+    mpc_gen_out(g, "}\n\n");
+  }
+  
+  if (g->needs & MPC_GEN_GROW) {
+    mpc_gen_out(g, "static mpc_val_t **mpcg_grow(mpc_val_t **xs, mpc_val_t **stk, int *slots) {\n");
+    mpc_gen_out(g, "  int n = *slots;\n");
+    mpc_gen_out(g, "  *slots = n + n / 2;\n");
+    mpc_gen_out(g, "  if (xs != stk) { return realloc(xs, sizeof(mpc_val_t*) * *slots); }\n");
+    mpc_gen_out(g, "  xs = malloc(sizeof(mpc_val_t*) * *slots);\n");
+    mpc_gen_out(g, "  memcpy(xs, stk, sizeof(mpc_val_t*) * n);\n");
+    mpc_gen_out(g, "  return xs;\n");
+    mpc_gen_out(g, "}\n\n");
+  }
+  
+  if (g->needs & MPC_GEN_REWIND) {
+    mpc_gen_out(g, "static void mpcg_rewind(mpcg_input_t *i, long pos, char last) {\n");
+    mpc_gen_out(g, "  if (i->backtrack < 1) { return; }\n");
+    mpc_gen_out(g, "  i->pos = pos;\n");
+    mpc_gen_out(g, "  i->last = last;\n");
+    mpc_gen_out(g, "}\n\n");
+  }
+  
+  if (g->needs & MPC_GEN_PREFIX) {
+    mpc_gen_out(g, "static int mpcg_prefix(mpcg_input_t *i, const char *c) {\n");
+    mpc_gen_out(g, "  if (i->backtrack > 0) { return 0; }\n");
+    mpc_gen_out(g, "  while (*c && i->pos < i->length && i->string[i->pos] == *c) { i->last = *c++; i->pos++; }\n");
+    mpc_gen_out(g, "  return 0;\n");
+    mpc_gen_out(g, "}\n\n");
+  }
+  
+  if (g->needs & MPC_GEN_BOUNDARY) {
+    mpc_gen_out(g, "static int mpcg_boundary(char prev, char next) {\n");
+    mpc_gen_out(g, "  const char *word = \"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_\";\n");
+    mpc_gen_out(g, "  if ( strchr(word, next) &&  prev == '\\0') { return 1; }\n");
+    mpc_gen_out(g, "  if ( strchr(word, prev) &&  next == '\\0') { return 1; }\n");
+    mpc_gen_out(g, "  if ( strchr(word, next) && !strchr(word, prev)) { return 1; }\n");
+    mpc_gen_out(g, "  if (!strchr(word, next) &&  strchr(word, prev)) { return 1; }\n");
+    mpc_gen_out(g, "  return 0;\n");
+    mpc_gen_out(g, "}\n\n");
+  }
+  
+  if (!(g->needs & MPC_GEN_TOKEN)) { return; }
+  
+  /* Tokens are the longest match of the scanner, and the last one is kept as several kinds may be tried */
+  mpc_gen_dfa(g, "mpcg_scan", s->trans, s->accept, s->states, 0);
+  
+  mpc_gen_out(g, "static const unsigned char mpcg_ends[%i][%i] = {\n", s->states, s->width);
+  for (j = 0; j < s->states; j++) {
+    mpc_gen_out(g, "  {");
+    for (k = 0; k < s->width; k++) { mpc_gen_out(g, k ? ",%i" : "%i", s->ends[j * s->width + k]); }
+    mpc_gen_out(g, j + 1 < s->states ? "},\n" : "}\n");
+  }
+  mpc_gen_out(g, "};\n\n");
+  
+  mpc_gen_out(g, "static int mpcg_token(mpcg_input_t *i, int kind, mpc_val_t **o, int capture) {\n");
+  mpc_gen_out(g, "  if (i->token_pos != i->pos) {\n");
+  mpc_gen_out(g, "    i->token_pos = i->pos;\n");
+  mpc_gen_out(g, "    i->token_end = -1;\n");
+  if (s->skip) {
+    mpc_gen_out(g, "    if (i->pos < i->length && strchr(\" \\f\\n\\r\\t\\v\", i->string[i->pos])) { return -1; }\n");
+  }
+  mpc_gen_out(g, "    i->token_end = mpcg_scan(i->string, i->pos, i->length, &i->token_state);\n");
+  mpc_gen_out(g, "  }\n");
+  mpc_gen_out(g, "  if (i->token_end < 0) { return -1; }\n");
+  mpc_gen_out(g, "  if (!(mpcg_ends[i->token_state][kind / 8] & (1 << (kind %% 8)))) { return 0; }\n");
+  mpc_gen_out(g, "  *o = capture ? NULL : mpcg_text(i->string + i->pos, i->token_end - i->pos);\n");
+  mpc_gen_out(g, "  i->pos = i->token_end;\n");
+  if (s->skip) {
+    mpc_gen_out(g, "  while (i->pos < i->length && strchr(\" \\f\\n\\r\\t\\v\", i->string[i->pos])) { i->pos++; }\n");
+  }
+  mpc_gen_out(g, "  i->last = i->string[i->pos - 1];\n");
+  mpc_gen_out(g, "  return 1;\n");
+  mpc_gen_out(g, "}\n\n");
+}
+
+static void mpc_gen_function(mpc_gen_t *g, int k, int use) {
+  
+  mpc_parser_t *p = g->ps[k];
+  char c = use == MPC_GEN_CAPTURE ? 'c' : 'p';
+  
+  if (p->name) { mpc_gen_out(g, "/* <%s> */\n", p->name); }
+  
+  mpc_gen_out(g, "static int mpcg_%c%i(mpcg_input_t *i, mpc_val_t **o) {\n", c, k);
+  mpc_gen_body(g, p, use);
+  mpc_gen_out(g, "}\n\n");
+}
+
+/*
+** Writes the whole source file. It is first written
+** nowhere, so that what the runtime at the top needs
+** is known, and any error found, before anything is.
+** The runtime's own tests need a second go to have
+** their sets counted too.
+*/
+
+static void mpc_gen_source(mpc_gen_t *g, mpca_grammar_st_t *st, int flags, const char *language, const char *name) {
+  
+  int j, k;
+  char x[32];
+  mpc_parser_t *p;
+  
+  mpc_gen_out(g, "/*\n** Generated by mpca_lang_generate. Do not edit.\n*/\n\n");
+  mpc_gen_out(g, "#include <stdlib.h>\n");
+  mpc_gen_out(g, "#include <string.h>\n\n");
+  mpc_gen_out(g, "#include \"mpc.h\"\n\n");
+  
+  mpc_gen_runtime(g);
+  
+  for (k = 0; k < g->ps_num; k++) {
+    if (g->uses[k] & MPC_GEN_VALUE)   { mpc_gen_out(g, "static int mpcg_p%i(mpcg_input_t *i, mpc_val_t **o);\n", k); }
+    if (g->uses[k] & MPC_GEN_CAPTURE) { mpc_gen_out(g, "static int mpcg_c%i(mpcg_input_t *i, mpc_val_t **o);\n", k); }
+  }
+  mpc_gen_out(g, "\n");
+  
+  for (k = 0; k < g->ps_num; k++) {
+    p = g->ps[k];
+    if (p->type != MPC_TYPE_DFA) { continue; }
+    sprintf(x, "mpcg_d%i", k);
+    mpc_gen_dfa(g, x, p->data.dfa.trans, p->data.dfa.accept, p->data.dfa.n, 1);
+  }
+  
+  for (k = 0; k < g->ps_num; k++) {
+    if (g->uses[k] & MPC_GEN_VALUE)   { mpc_gen_function(g, k, MPC_GEN_VALUE); }
+    if (g->uses[k] & MPC_GEN_CAPTURE) { mpc_gen_function(g, k, MPC_GEN_CAPTURE); }
+  }
+  
+  /* The grammar is only built for the interpreter if a parse fails */
+  mpc_gen_out(g, "static const char *mpcg_grammar = ");
+  mpc_gen_literal(g, language, strlen(language));
+  mpc_gen_out(g, ";\n\n");
+  
+  mpc_gen_out(g, "static mpc_parser_t *mpcg_rules[%i];\n\n", st->parsers_num);
+  
+  mpc_gen_out(g, "static mpc_parser_t *mpcg_rule(int k) {\n");
+  mpc_gen_out(g, "  mpc_err_t *e;\n");
+  mpc_gen_out(g, "  if (mpcg_rules[0] == NULL) {\n");
+  for (j = 0; j < st->parsers_num; j++) {
+    mpc_gen_out(g, "    mpcg_rules[%i] = mpc_new(\"%s\");\n", j, st->parsers[j]->name);
+  }
+  mpc_gen_out(g, "    e = mpca_lang(%i, mpcg_grammar", flags & ~MPCA_LANG_PREDICTIVE_REPORT);
+  for (j = 0; j < st->parsers_num; j++) {
+    mpc_gen_out(g, j % 4 == 0 ? ",\n      mpcg_rules[%i]" : ", mpcg_rules[%i]", j);
+  }
+  mpc_gen_out(g, ", NULL);\n");
+  mpc_gen_out(g, "    if (e) { mpc_err_delete(e); }\n");
+  mpc_gen_out(g, "  }\n");
+  mpc_gen_out(g, "  return mpcg_rules[k];\n");
+  mpc_gen_out(g, "}\n\n");
+  
+  mpc_gen_out(g, "void %s_cleanup(void) {\n", name);
+  mpc_gen_out(g, "  int j;\n");
+  mpc_gen_out(g, "  if (mpcg_rules[0] == NULL) { return; }\n");
+  mpc_gen_out(g, "  for (j = 0; j < %i; j++) { mpc_undefine(mpcg_rules[j]); }\n", st->parsers_num);
+  mpc_gen_out(g, "  for (j = 0; j < %i; j++) { mpc_delete(mpcg_rules[j]); mpcg_rules[j] = NULL; }\n", st->parsers_num);
+  mpc_gen_out(g, "}\n\n");
+  
+  mpc_gen_out(g, "static int mpcg_run(int(*f)(mpcg_input_t*,mpc_val_t**), int k,\n");
+  mpc_gen_out(g, "  const char *filename, const char *string, size_t length, mpc_result_t *r) {\n");
+  mpc_gen_out(g, "  mpcg_input_t i;\n");
+  mpc_gen_out(g, "  const char *end = memchr(string, '\\0', length);\n");
+  mpc_gen_out(g, "  if (end) { length = (size_t)(end - string); }\n");
+  mpc_gen_out(g, "  memset(&i, 0, sizeof(i));\n");
+  mpc_gen_out(g, "  i.string = string;\n");
+  mpc_gen_out(g, "  i.length = (long)length;\n");
+  mpc_gen_out(g, "  i.backtrack = 1;\n");
+  mpc_gen_out(g, "  i.token_pos = -1;\n");
+  mpc_gen_out(g, "  if (f(&i, &r->output)) { return 1; }\n");
+  mpc_gen_out(g, "  return mpc_nparse(filename, string, length, mpcg_rule(k), r);\n");
+  mpc_gen_out(g, "}\n\n");
+  
+  for (j = 0; j < st->parsers_num; j++) {
+    p = st->parsers[j];
+    mpc_gen_out(g, "int %s_parse_%s(const char *filename, const char *string, mpc_result_t *r) {\n", name, p->name);
+    mpc_gen_out(g, "  return mpcg_run(mpcg_p%i, %i, filename, string, strlen(string), r);\n", mpc_gen_find(g, p), j);
+    mpc_gen_out(g, "}\n\n");
+    mpc_gen_out(g, "int %s_nparse_%s(const char *filename, const char *string, size_t length, mpc_result_t *r) {\n", name, p->name);
+    mpc_gen_out(g, "  return mpcg_run(mpcg_p%i, %i, filename, string, length, r);\n", mpc_gen_find(g, p), j);
+    mpc_gen_out(g, "}\n\n");
+  }
+}
+
+static void mpc_gen_header(FILE *f, mpca_grammar_st_t *st, const char *name) {
+  
+  int j;
+  const char *x;
+  
+  fprintf(f, "/*\n** Generated by mpca_lang_generate. Do not edit.\n*/\n\n");
+  fprintf(f, "#ifndef ");
+  for (x = name; *x; x++) { fputc(toupper((unsigned char)*x), f); }
+  fprintf(f, "_H\n#define ");
+  for (x = name; *x; x++) { fputc(toupper((unsigned char)*x), f); }
+  fprintf(f, "_H\n\n#include \"mpc.h\"\n\n");
+  
+  for (j = 0; j < st->parsers_num; j++) {
+    fprintf(f, "int %s_parse_%s(const char *filename, const char *string, mpc_result_t *r);\n", name, st->parsers[j]->name);
+    fprintf(f, "int %s_nparse_%s(const char *filename, const char *string, size_t length, mpc_result_t *r);\n", name, st->parsers[j]->name);
+  }
+  fprintf(f, "void %s_cleanup(void);\n\n#endif\n", name);
+}
+
+mpc_err_t *mpca_lang_generate(int flags, const char *language, const char *name, FILE *source, FILE *header) {
+  
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+  mpc_gen_t g;
+  int j;
+  
+  st.va = NULL;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+  st.scanner = NULL;
+  
+  i = mpc_input_new_string("<mpca_lang_generate>", language, strlen(language));
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+  
+  memset(&g, 0, sizeof(g));
+  
+  if (err == NULL) {
+    
+    /* Values inside captures are only needed if something is predictive, which isn't known until it's found */
+    g.predict = 1;
+    for (j = 0; j < st.parsers_num; j++) { mpc_gen_collect(&g, st.parsers[j], MPC_GEN_VALUE); }
+    if (g.predicts == 0) {
+      g.predict = 0;
+      g.ps_num = 0;
+      for (j = 0; j < st.parsers_num; j++) { mpc_gen_collect(&g, st.parsers[j], MPC_GEN_VALUE); }
+    }
+    
+    mpc_gen_source(&g, &st, flags, language, name);
+    mpc_gen_source(&g, &st, flags, language, name);
+    
+    if (g.error) {
+      err = mpc_err_file("<mpca_lang_generate>", g.error);
+    } else {
+      g.f = source;
+      mpc_gen_source(&g, &st, flags, language, name);
+      if (header) { mpc_gen_header(header, &st, name); }
+    }
+  }
+  
+  for (j = 0; j < st.parsers_num; j++) { mpc_undefine(st.parsers[j]); }
+  for (j = 0; j < st.parsers_num; j++) { mpc_delete(st.parsers[j]); }
+  free(st.parsers);
+  free(g.ps);
+  free(g.uses);
+  free(g.sets);
+  free(g.error);
+  return err;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "mpc.h"
+
+/*
+** Writes a C parser for a grammar file, see `mpca_lang_generate`.
+** The functions it declares are prefixed with the grammar's name,
+** so lispy.grammar gives lispy_parse_lispy and friends.
+*/
+
+static void usage(void) {
+  fprintf(stderr, "usage: mpcgen [-p] [-a] [-w] [-k] [-t] <input.grammar> <output.c>\n");
+  fprintf(stderr, "  -p  predictive, -a  predictive where possible, -w  whitespace sensitive\n");
+  fprintf(stderr, "  -k  packrat, -t  scan terminals as tokens\n");
+}
+
+static char *read_all(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  char *s;
+  long n;
+  if (f == NULL) { return NULL; }
+  fseek(f, 0, SEEK_END);
+  n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  s = malloc(n + 1);
+  n = (long)fread(s, 1, n, f);
+  s[n] = '\0';
+  fclose(f);
+  return s;
+}
+
+int main(int argc, char **argv) {
+
+  int flags = MPCA_LANG_DEFAULT, i;
+  char *grammar, *name, *header_name, *x;
+  const char *base;
+  FILE *source, *header;
+  mpc_err_t *err;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if      (strcmp(argv[i], "-p") == 0) { flags |= MPCA_LANG_PREDICTIVE; }
+    else if (strcmp(argv[i], "-a") == 0) { flags |= MPCA_LANG_AUTO_PREDICTIVE; }
+    else if (strcmp(argv[i], "-w") == 0) { flags |= MPCA_LANG_WHITESPACE_SENSITIVE; }
+    else if (strcmp(argv[i], "-k") == 0) { flags |= MPCA_LANG_PACKRAT; }
+    else if (strcmp(argv[i], "-t") == 0) { flags |= MPCA_LANG_TOKENS; }
+    else { usage(); return 1; }
+  }
+
+  if (argc - i != 2) {
+    usage();
+    return 1;
+  }
+
+  grammar = read_all(argv[i]);
+  if (grammar == NULL) {
+    fprintf(stderr, "Unable to open %s\n", argv[i]);
+    return 1;
+  }
+
+  //the name is the grammar file's, without directories or extension
+  base = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+  name = malloc(strlen(base) + 1);
+  strcpy(name, base);
+  if (strchr(name, '.')) { *strchr(name, '.') = '\0'; }
+  for (x = name; *x; x++) { if (!isalnum((unsigned char)*x)) { *x = '_'; } }
+
+  //the header sits next to the source, with .h for .c
+  header_name = malloc(strlen(argv[i+1]) + 3);
+  strcpy(header_name, argv[i+1]);
+  x = strrchr(header_name, '.');
+  if (x && strcmp(x, ".c") == 0) { strcpy(x, ".h"); } else { strcat(header_name, ".h"); }
+
+  source = fopen(argv[i+1], "w");
+  header = fopen(header_name, "w");
+  if (source == NULL || header == NULL) {
+    fprintf(stderr, "Unable to write %s\n", source ? header_name : argv[i+1]);
+    return 1;
+  }
+
+  err = mpca_lang_generate(flags, grammar, name, source, header);
+
+  fclose(source);
+  fclose(header);
+
+  if (err) {
+    mpc_err_print(err);
+    mpc_err_delete(err);
+    remove(argv[i+1]);
+    remove(header_name);
+  }
+
+  free(grammar);
+  free(name);
+  free(header_name);
+  return err != NULL;
+}
@@ -25,6 +25,9 @@ enum { LVAL_NUM, LVAL_ERR, LVAL_SYM, LVAL_SEXPR };
 /* definitions */
 void usage(void);
 void throw_error(mpc_result_t *r);
+void eval_print(mpc_ast_t *t);
+void read_tags(void);
+int read_file(char *filename, mpc_parser_t *form);
 void prepare_ast(char *input, char *ast);
 lval *lval_num(long result);
 lval *lval_err(char *err);
@@ -53,21 +56,42 @@ int main(int argc, char **argv) {
   mpca_lang(MPCA_LANG_DEFAULT,
       "                                                   \
       number   : /-?[0-9]+/ ;                             \
-      operator : '+' | '-' | '*' | '/' ;                  \
+      symbol   : '+' | '-' | '*' | '/' ;                  \
       sexpr    : '(' <expr>* ')' ;                        \
-      expr     : <number> | <symbol> | <sexpr>            \
-      lispy    : /^/ <operator> <expr>+ /$/ ;             \
+      expr     : <number> | <symbol> | <sexpr> ;          \
+      lispy    : /^/ <symbol> <expr>+ /$/ ;               \
       ",
       Number, Symbol, Sexpr, Expr, Lispy);
+  read_tags();
+
+  //a file argument is evaluated one top-level form at a time
+  if (argc > 1) {
+    int status = read_file(argv[1], Sexpr);
+    mpc_cleanup(5, Number, Symbol, Sexpr, Expr, Lispy);
+    return status;
+  }
 
   puts("Lispy version 0.0.1");
   puts("Press Ctrl-C to quit\n");
 
+  //input is pushed line by line so a form may span several lines
+  mpc_push_t *push = mpc_push_begin("<stdin>", Lispy, MPC_SESSION_ARENA);
+  //lval_read recurses on the C stack, so forms may only nest so deep
+  mpc_push_depth_limit(push, 4096);
+
   while(1) {
-    char *input = readline("lispy > "); //uses malloc
+    int pending = mpc_push_pending(push) > 0;
+    char *input = readline(pending ? "      .. > " : "lispy > "); //uses malloc
     char ast[81]; //I don't know how to malloc ;(
 
-    if (strcmp(input, "") == 0) {
+    //Ctrl-D ends the session
+    if (input == NULL) {
+      putchar('\n');
+      break;
+    }
+
+    if (!pending && strcmp(input, "") == 0) {
+      free(input);
       continue;
     }
 
@@ -75,9 +99,9 @@ int main(int argc, char **argv) {
 
     //parse user input
     mpc_result_t r;
-    if(strstr(input, "\\h")) {
+    if(!pending && strstr(input, "\\h")) {
       usage();
-    } else if(strstr(input, "\\a")) {
+    } else if(!pending && strstr(input, "\\a")) {
       prepare_ast(input, ast);
       if(mpc_parse("<stdin>", ast, Lispy, &r)) {
         //parsed successfully
@@ -85,7 +109,7 @@ int main(int argc, char **argv) {
       } else {
         throw_error(&r);
       } 
-    } else if(strstr(input, "\\i")) {
+    } else if(!pending && strstr(input, "\\i")) {
       prepare_ast(input, ast);
       if(mpc_parse("<stdin>", ast, Lispy, &r)) {
         //parsed successfully
@@ -102,19 +126,39 @@ int main(int argc, char **argv) {
         throw_error(&r);
       }
     } else {
-      if(mpc_parse("<stdin>", input, Lispy, &r)) {
-        lval *result = lval_read(r.output);
-        lval_print(result);
-        lval_delete(result);
-      } else {
+      //keep the line break so tokens on adjacent lines stay apart
+      size_t len = strlen(input);
+      char *line = malloc(len + 1);
+      memcpy(line, input, len);
+      line[len] = '\n';
+
+      //a line ends whatever form it completes
+      int status = mpc_push_feed(push, line, len + 1, &r);
+      if(status == MPC_PUSH_MORE) {
+        status = mpc_push_flush(push, &r);
+      }
+      while(status == MPC_PUSH_OK) {
+        eval_print(r.output);
+        status = mpc_push_flush(push, &r);
+      }
+      if(status == MPC_PUSH_ERROR) {
         throw_error(&r);
       }
+
+      free(line);
     }
 
     free(input); //frees memory
 
   }
 
+  //report anything left unfinished at the end of input
+  mpc_result_t r;
+  switch(mpc_push_end(push, &r)) {
+    case MPC_PUSH_OK: eval_print(r.output); break;
+    case MPC_PUSH_ERROR: throw_error(&r); break;
+  }
+
   mpc_cleanup(5, Number, Symbol, Sexpr, Expr, Lispy);
 
   return 0;
@@ -144,6 +188,37 @@ void throw_error(mpc_result_t *r) {
   mpc_err_delete(r->error);
 }
 
+void eval_print(mpc_ast_t *t) {
+  lval *result = lval_read(t);
+  lval_print(result);
+  putchar('\n');
+  lval_delete(result);
+  mpc_ast_delete(t);
+}
+
+int read_file(char *filename, mpc_parser_t *form) {
+  FILE *f = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "rb");
+  if (f == NULL) {
+    printf("Unable to open %s\n", filename);
+    return 1;
+  }
+
+  //only the current form is held in memory
+  mpc_stream_t *stream = mpc_stream_begin(filename, f, form);
+  mpc_result_t r;
+  int status;
+  while((status = mpc_stream_next(stream, &r)) == MPC_STREAM_OK) {
+    eval_print(r.output);
+  }
+  if(status == MPC_STREAM_ERROR) {
+    throw_error(&r);
+  }
+  mpc_stream_end(stream);
+
+  if (f != stdin) { fclose(f); }
+  return status == MPC_STREAM_ERROR;
+}
+
 /* lval constructors */
 
 lval *lval_num(long result) {
@@ -203,26 +278,37 @@ void lval_delete(lval *v) {
 
 lval *lval_read_num(mpc_ast_t *t) {
   errno = 0;
-  long x = strtol(t->contents, NULL, 10);
-  return errno == ERANGE
+  long x = strtol(mpc_ast_contents(t), NULL, 10);
+  return errno != ERANGE
     ? lval_num(x)
     : lval_err("invalid number");
 }
 
+/* tag ids of the grammar rules, looked up once in main */
+static int tag_number, tag_symbol, tag_sexpr, tag_root, tag_regex;
+
+void read_tags(void) {
+  tag_number = mpc_tag_id("number");
+  tag_symbol = mpc_tag_id("symbol");
+  tag_sexpr = mpc_tag_id("sexpr");
+  tag_root = mpc_tag_id(">");
+  tag_regex = mpc_tag_id("regex");
+}
+
 lval *lval_read(mpc_ast_t *t) {
   /* return primitive types number and symbol */
-  if(strstr(t->tag, "number")) { return lval_num(t->contents); }
-  if(strstr(t->tag, "symbol")) { return lval_sym(t->contents); }
+  if(mpc_ast_has_tag_id(t, tag_number)) { return lval_read_num(t); }
+  if(mpc_ast_has_tag_id(t, tag_symbol)) { return lval_sym(mpc_ast_contents(t)); }
 
   /* when root (>) or s-expr */
   lval *x = NULL;
-  if(strcmp(t->tag, ">") == 0) { x = lval_sexpr(); }
-  if(strstr(t->tag, "sexpr")) { x = lval_sexpr(); }
+  if(mpc_ast_tag_id(t) == tag_root) { x = lval_sexpr(); }
+  if(mpc_ast_has_tag_id(t, tag_sexpr)) { x = lval_sexpr(); }
 
   for(int i = 0; i < t->children_num; i++) {
-    if(strcmp(t->children[i]->contents, "(") == 0) { continue; }
-    if(strcmp(t->children[i]->contents, ")") == 0) { continue; }
-    if(strcmp(t->children[i]->tag, "regex") == 0) { continue; }
+    if(strcmp(mpc_ast_contents(t->children[i]), "(") == 0) { continue; }
+    if(strcmp(mpc_ast_contents(t->children[i]), ")") == 0) { continue; }
+    if(mpc_ast_tag_id(t->children[i]) == tag_regex) { continue; }
     x = lval_add(x, lval_read(t->children[i]));
   }
 
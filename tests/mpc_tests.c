@@ -0,0 +1,961 @@
+/*
+** Output printed by the library is read back by
+** putting a file in place of standard output, where
+** the platform allows it.
+*/
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MPC_TESTS_STDOUT
+#if !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MPC_TESTS_STDOUT
+#include <unistd.h>
+#endif
+
+#include "../mpc.h"
+#include "../lispy_parser.h"
+
+/*
+** Differential Tests
+**
+** Most of what sits on top of `mpc_parse` is meant to
+** change how fast a parse runs and not what it returns,
+** so each test runs the same inputs through a feature
+** and through a plain parse and compares the two. ASTs
+** and errors are compared as printed, so positions,
+** tags and every expected label have to agree.
+*/
+
+static int tests_run = 0;
+static int tests_failed = 0;
+static int outcome_text = 0;
+
+static void check(int ok, const char *what, const char *input) {
+  tests_run++;
+  if (ok) { return; }
+  tests_failed++;
+  printf("FAILED %s on \"%s\"\n", what, input);
+}
+
+static char *copy(const char *s) {
+  return strcpy(malloc(strlen(s) + 1), s);
+}
+
+/* Everything written to a temporary file, which is closed */
+static char *file_text(FILE *f) {
+
+  long n = ftell(f);
+  char *s = malloc(n + 1);
+
+  rewind(f);
+  n = (long)fread(s, 1, n, f);
+  s[n] = '\0';
+  fclose(f);
+  return s;
+}
+
+/* The printed AST, or string, or error of a result, which is consumed */
+static char *outcome(int ok, mpc_result_t *r) {
+
+  FILE *f = tmpfile();
+
+  if (ok && outcome_text) {
+    fprintf(f, "%s\n", (char*)r->output);
+    free(r->output);
+  } else if (ok) {
+    mpc_ast_print_to(r->output, f);
+    mpc_ast_delete(r->output);
+  } else {
+    mpc_err_print_to(r->error, f);
+    mpc_err_delete(r->error);
+  }
+
+  return file_text(f);
+}
+
+static void check_same(const char *what, const char *input, char *expected, char *actual) {
+  int ok = strcmp(expected, actual) == 0;
+  check(ok, what, input);
+  if (!ok) { printf("expected:\n%s\nactual:\n%s\n", expected, actual); }
+  free(expected);
+  free(actual);
+}
+
+static char *parse(mpc_parser_t *p, const char *input) {
+  mpc_result_t r;
+  return outcome(mpc_parse("<test>", input, p, &r), &r);
+}
+
+/*
+** Grammars
+*/
+
+enum { LISPY_NUMBER, LISPY_SYMBOL, LISPY_SEXPR, LISPY_EXPR, LISPY_LISPY, LISPY_RULES };
+
+static const char *lispy_grammar =
+  " number : /-?[0-9]+/ ;                    "
+  " symbol : '+' | '-' | '*' | '/' ;         "
+  " sexpr  : '(' <expr>* ')' ;               "
+  " expr   : <number> | <symbol> | <sexpr> ; "
+  " lispy  : /^/ <symbol> <expr>+ /$/ ;      ";
+
+static const char *lispy_inputs[] = {
+  "+ 1 2", "- -1 (* 2 3) 4", "* (- 1 (+ 2 3)) 4 5 6 7", "/ 10\n  (+ 1\n     2)",
+  "", "+", "+ 1 (", "(+ 1", "+ 1 2)", "- 12a", "+ 1 - -",
+  "/ (1 2 (3 (4 (5 6", "+ 1 2\n  (3\n 4 ]", "  + 1 2  ", NULL
+};
+
+static void lispy_new(mpc_parser_t **ps, int flags) {
+  ps[LISPY_NUMBER] = mpc_new("number");
+  ps[LISPY_SYMBOL] = mpc_new("symbol");
+  ps[LISPY_SEXPR]  = mpc_new("sexpr");
+  ps[LISPY_EXPR]   = mpc_new("expr");
+  ps[LISPY_LISPY]  = mpc_new("lispy");
+  mpca_lang(flags, lispy_grammar,
+    ps[LISPY_NUMBER], ps[LISPY_SYMBOL], ps[LISPY_SEXPR], ps[LISPY_EXPR], ps[LISPY_LISPY], NULL);
+}
+
+static void lispy_delete(mpc_parser_t **ps) {
+  mpc_cleanup(LISPY_RULES,
+    ps[LISPY_NUMBER], ps[LISPY_SYMBOL], ps[LISPY_SEXPR], ps[LISPY_EXPR], ps[LISPY_LISPY]);
+}
+
+/* Alternatives sharing a prefix, so parses backtrack */
+
+enum { KV_WORD, KV_PAIR, KV_LIST, KV_RULES };
+
+static const char *kv_grammar =
+  " word : /[a-z]+/ ;                              "
+  " pair : <word> ':' <word> | <word> '=' <word> ; "
+  " list : /^/ (<pair> (',' <pair>)*)? /$/ ;       ";
+
+static const char *kv_inputs[] = {
+  "a:b", "a=b, c:d", "a = b , c : dd", "", "a", "a:", "a=b,", "a:b c", "a:1", "a=b;c", NULL
+};
+
+static void kv_new(mpc_parser_t **ps, int flags) {
+  ps[KV_WORD] = mpc_new("word");
+  ps[KV_PAIR] = mpc_new("pair");
+  ps[KV_LIST] = mpc_new("list");
+  mpca_lang(flags, kv_grammar, ps[KV_WORD], ps[KV_PAIR], ps[KV_LIST], NULL);
+}
+
+static void kv_delete(mpc_parser_t **ps) {
+  mpc_cleanup(KV_RULES, ps[KV_WORD], ps[KV_PAIR], ps[KV_LIST]);
+}
+
+/* Many forms, so the input spans several pipe chunks */
+static char *lispy_long(int forms, const char *tail) {
+  char *s = malloc(forms * 16 + strlen(tail) + 8), *p = s;
+  int j;
+  p += sprintf(p, "+");
+  for (j = 0; j < forms; j++) { p += sprintf(p, " (* %i (- 2 3))", j % 1000); }
+  strcpy(p, tail);
+  return s;
+}
+
+/*
+** Pipe Inputs
+*/
+
+static char *parse_pipe(mpc_parser_t *p, const char *input) {
+  mpc_result_t r;
+  FILE *f = tmpfile();
+  int ok;
+  fputs(input, f);
+  rewind(f);
+  ok = mpc_parse_pipe("<test>", f, p, &r);
+  fclose(f);
+  return outcome(ok, &r);
+}
+
+static void test_pipe(void) {
+
+  mpc_parser_t *ps[LISPY_RULES];
+  const char **in;
+  char *s;
+
+  lispy_new(ps, MPCA_LANG_DEFAULT);
+
+  for (in = lispy_inputs; *in; in++) {
+    check_same("pipe", *in, parse(ps[LISPY_LISPY], *in), parse_pipe(ps[LISPY_LISPY], *in));
+  }
+
+  s = lispy_long(2000, "");
+  check_same("pipe", "long", parse(ps[LISPY_LISPY], s), parse_pipe(ps[LISPY_LISPY], s));
+  free(s);
+
+  s = lispy_long(2000, " (+ 1 ]");
+  check_same("pipe", "long error", parse(ps[LISPY_LISPY], s), parse_pipe(ps[LISPY_LISPY], s));
+  free(s);
+
+  lispy_delete(ps);
+}
+
+/*
+** File Inputs
+*/
+
+/* Parses the input from a file, after `skip` bytes of it have been read */
+static char *parse_file(mpc_parser_t *p, const char *input, int skip, long *after) {
+  mpc_result_t r;
+  FILE *f = tmpfile();
+  int j, ok;
+  for (j = 0; j < skip; j++) { fputc('#', f); }
+  fputs(input, f);
+  rewind(f);
+  for (j = 0; j < skip; j++) { fgetc(f); }
+  ok = mpc_parse_file("<test>", f, p, &r);
+  *after = ftell(f) - skip;
+  fclose(f);
+  return outcome(ok, &r);
+}
+
+static void test_file(void) {
+
+  mpc_parser_t *ps[LISPY_RULES];
+  const char **in;
+  long after;
+  int skip;
+
+  lispy_new(ps, MPCA_LANG_DEFAULT);
+
+  /* Reading from part way through, not at a page boundary */
+  for (skip = 0; skip < 6000; skip += 5000) {
+    for (in = lispy_inputs; *in; in++) {
+      check_same("file", *in, parse(ps[LISPY_LISPY], *in), parse_file(ps[LISPY_LISPY], *in, skip, &after));
+    }
+  }
+
+  /* The file is left just past what was parsed */
+  free(parse_file(ps[LISPY_EXPR], "(+ 1 2) (3 4)", 5000, &after));
+  check(after == 8, "file", "(+ 1 2) (3 4)");
+
+  lispy_delete(ps);
+}
+
+/*
+** Push Parsing
+*/
+
+/* Feeds the input in chunks and returns what is reported first */
+static char *parse_push(mpc_parser_t *p, const char *input, size_t chunk, int flags) {
+  
+  mpc_result_t r;
+  mpc_push_t *s = mpc_push_begin("<test>", p, flags);
+  size_t n = strlen(input), j;
+  int x = MPC_PUSH_MORE;
+  char *reported;
+  
+  for (j = 0; j < n && x == MPC_PUSH_MORE; j += chunk) {
+    x = mpc_push_feed(s, input + j, n - j < chunk ? n - j : chunk, &r);
+  }
+  
+  if (x == MPC_PUSH_MORE) { x = mpc_push_end(s, &r); return outcome(x == MPC_PUSH_OK, &r); }
+  
+  /* Whatever follows the first form isn't compared */
+  reported = outcome(x == MPC_PUSH_OK, &r);
+  x = mpc_push_end(s, &r);
+  if (x != MPC_PUSH_DONE) { free(outcome(x == MPC_PUSH_OK, &r)); }
+  return reported;
+}
+
+static void test_push(void) {
+
+  mpc_parser_t *ps[LISPY_RULES];
+  mpc_push_t *s;
+  mpc_result_t r;
+  const char **in;
+  size_t chunk;
+  int x;
+
+  lispy_new(ps, MPCA_LANG_DEFAULT);
+
+  /* Empty input is no form at all rather than an error */
+  for (in = lispy_inputs; *in; in++) {
+    if (**in == '\0') { continue; }
+    for (chunk = 1; chunk < 4; chunk++) {
+      check_same("push", *in, parse(ps[LISPY_LISPY], *in), parse_push(ps[LISPY_LISPY], *in, chunk, MPC_SESSION_DEFAULT));
+    }
+  }
+  
+  /* Slices must still point at text seen in earlier chunks */
+  for (in = lispy_inputs; *in; in++) {
+    if (**in == '\0') { continue; }
+    check_same("push", *in, parse(ps[LISPY_LISPY], *in), parse_push(ps[LISPY_LISPY], *in, 1, MPC_SESSION_SLICES));
+  }
+
+  /* A form ending at the last whitespace might still go on */
+  s = mpc_push_begin("<test>", ps[LISPY_LISPY], MPC_SESSION_DEFAULT);
+  x = mpc_push_feed(s, "+ 1 ", 4, &r);
+  check(x == MPC_PUSH_MORE, "push", "+ 1 ");
+  x = mpc_push_feed(s, "2\n", 2, &r);
+  check(x == MPC_PUSH_MORE, "push", "+ 1 2\n");
+  x = mpc_push_end(s, &r);
+  check_same("push", "+ 1 2\n", parse(ps[LISPY_LISPY], "+ 1 2\n"), outcome(x == MPC_PUSH_OK, &r));
+
+  /* Flushing after each line, as a REPL does */
+  s = mpc_push_begin("<test>", ps[LISPY_LISPY], MPC_SESSION_DEFAULT);
+  x = mpc_push_feed(s, "+ 1 (2\n", 7, &r);
+  if (x == MPC_PUSH_MORE) { x = mpc_push_flush(s, &r); }
+  check(x == MPC_PUSH_MORE, "push", "+ 1 (2\n");
+  x = mpc_push_feed(s, "3)\n", 3, &r);
+  if (x == MPC_PUSH_MORE) { x = mpc_push_flush(s, &r); }
+  check_same("push", "+ 1 (2\n3)\n", parse(ps[LISPY_LISPY], "+ 1 (2\n3)\n"), outcome(x == MPC_PUSH_OK, &r));
+  check(mpc_push_end(s, &r) == MPC_PUSH_DONE, "push", "+ 1 (2\n3)\n");
+
+  /* A form is reported as soon as what follows shows it has ended */
+  s = mpc_push_begin("<test>", ps[LISPY_EXPR], MPC_SESSION_DEFAULT);
+  x = mpc_push_feed(s, "(+ 1 2) (3", 10, &r);
+  check_same("push", "(+ 1 2) (3", parse(ps[LISPY_EXPR], "(+ 1 2) "), outcome(x == MPC_PUSH_OK, &r));
+  x = mpc_push_feed(s, NULL, 0, &r);
+  check(x == MPC_PUSH_MORE, "push", "(+ 1 2) (3");
+  x = mpc_push_feed(s, " 4)", 3, &r);
+  check(x == MPC_PUSH_MORE, "push", "(+ 1 2) (3 4)");
+  x = mpc_push_end(s, &r);
+  check_same("push", "(3 4)", copy(
+    "> \n"
+    "  sexpr|> \n"
+    "    char:1:9 '('\n"
+    "    expr|number|regex:1:10 '3'\n"
+    "    expr|number|regex:1:12 '4'\n"
+    "    char:1:13 ')'\n"), outcome(x == MPC_PUSH_OK, &r));
+
+  lispy_delete(ps);
+}
+
+/*
+** Sessions
+*/
+
+static const int session_flags[] = {
+  MPC_SESSION_DEFAULT, MPC_SESSION_ARENA, MPC_SESSION_SLICES, MPC_SESSION_FLAT,
+  MPC_SESSION_ARENA | MPC_SESSION_COMPILED, MPC_SESSION_SLICES | MPC_SESSION_COMPILED,
+  MPC_SESSION_FLAT | MPC_SESSION_COMPILED, -1
+};
+
+static char *parse_in(mpc_session_t *s, int flags, mpc_parser_t *p, const char *input) {
+  mpc_result_t r;
+  mpc_ast_flat_t *f;
+  int x = mpc_session_parse(s, input, strlen(input), p, &r);
+  if (x && (flags & MPC_SESSION_FLAT)) {
+    f = r.output;
+    r.output = mpc_ast_unflatten(f, 0);
+    mpc_ast_flat_delete(f);
+  }
+  return outcome(x, &r);
+}
+
+/* A fold of the user's own, so its nodes aren't in any arena */
+static mpc_val_t *fold_pair(int n, mpc_val_t **xs) {
+  (void)n;
+  return mpc_ast_build(2, "pair", xs[0], xs[1]);
+}
+
+static void test_session(void) {
+
+  mpc_parser_t *ps[LISPY_RULES], *pairs;
+  mpc_session_t *s;
+  const char **in;
+  const int *flags;
+  char *big;
+  int k;
+
+  lispy_new(ps, MPCA_LANG_DEFAULT);
+  pairs = mpca_many(mpc_and(2, fold_pair,
+    mpca_tag(mpc_apply(mpc_tok(mpc_digits()), mpcf_str_ast), "number"),
+    mpca_tag(mpc_apply(mpc_tok(mpc_char(';')), mpcf_str_ast), "end"),
+    (mpc_dtor_t)mpc_ast_delete));
+
+  /* A long input in between grows the pools the short ones then reuse */
+  big = lispy_long(2000, " (+ 1 ]");
+  for (flags = session_flags; *flags >= 0; flags++) {
+    s = mpc_session_new("<test>", *flags);
+    for (k = 0; k < 3; k++) {
+      for (in = lispy_inputs; *in; in++) {
+        check_same("session", *in, parse(ps[LISPY_LISPY], *in), parse_in(s, *flags, ps[LISPY_LISPY], *in));
+      }
+      check_same("session", "long error", parse(ps[LISPY_LISPY], big), parse_in(s, *flags, ps[LISPY_LISPY], big));
+    }
+    check_same("session", "1; 22 ; 333;", parse(pairs, "1; 22 ; 333;"), parse_in(s, *flags, pairs, "1; 22 ; 333;"));
+    mpc_session_delete(s);
+  }
+  free(big);
+
+  mpc_delete(pairs);
+  lispy_delete(ps);
+}
+
+/*
+** Flat ASTs
+*/
+
+/* Whether node `i` of `f` and its subtree match `a` */
+static int flat_same(mpc_ast_flat_t *f, int i, mpc_ast_t *a) {
+  int j, c;
+  if (strcmp(mpc_ast_flat_tag(f, i), a->tag) != 0) { return 0; }
+  if (strcmp(mpc_ast_flat_contents(f, i), mpc_ast_contents(a)) != 0) { return 0; }
+  if (f->tag_id[i] != mpc_ast_tag_id(a) || f->children_num[i] != a->children_num) { return 0; }
+  if (f->state[i].pos != a->state.pos) { return 0; }
+  c = mpc_ast_flat_first(f, i);
+  for (j = 0; j < a->children_num; j++) {
+    if (!flat_same(f, c, a->children[j])) { return 0; }
+    c = mpc_ast_flat_next(f, c);
+  }
+  return 1;
+}
+
+static char *flat_print(mpc_ast_flat_t *f) {
+  FILE *t = tmpfile();
+  long n;
+  char *s;
+  mpc_ast_flat_print_to(f, t);
+  n = ftell(t);
+  s = malloc(n + 1);
+  rewind(t);
+  n = (long)fread(s, 1, n, t);
+  s[n] = '\0';
+  fclose(t);
+  return s;
+}
+
+static void test_flat(void) {
+
+  mpc_parser_t *ps[LISPY_RULES];
+  mpc_ast_flat_t *f;
+  mpc_result_t r;
+  const char **in;
+  char *big;
+
+  lispy_new(ps, MPCA_LANG_DEFAULT);
+
+  big = lispy_long(2000, "");
+  for (in = lispy_inputs; *in; in++) {
+    if (!mpc_parse("<test>", *in, ps[LISPY_LISPY], &r)) { mpc_err_delete(r.error); continue; }
+    f = mpc_ast_flatten(r.output);
+    check(f->num > 0 && f->size[0] == f->num, "flat", *in);
+    check(flat_same(f, 0, r.output), "flat", *in);
+    check_same("flat", *in, outcome(1, &r), flat_print(f));
+    mpc_ast_flat_delete(f);
+  }
+  check(mpc_parse("<test>", big, ps[LISPY_LISPY], &r), "flat", "long");
+  f = mpc_ast_flatten(r.output);
+  check(flat_same(f, 0, r.output), "flat", "long");
+  mpc_ast_delete(r.output);
+  mpc_ast_flat_delete(f);
+  free(big);
+
+  lispy_delete(ps);
+}
+
+/*
+** Tag IDs
+*/
+
+static void test_tags(void) {
+
+  mpc_parser_t *ps[LISPY_RULES];
+  mpc_result_t r;
+  int root, expr, number, regex, sexpr, last;
+  mpc_ast_flat_t *f;
+  mpc_ast_t *a;
+
+  lispy_new(ps, MPCA_LANG_DEFAULT);
+  root = mpc_tag_id(">");
+  expr = mpc_tag_id("expr");
+  number = mpc_tag_id("number");
+  regex = mpc_tag_id("regex");
+  sexpr = mpc_tag_id("sexpr");
+  last = mpc_tag_id("tags");
+
+  /* Joined tags carry the ID of each of their names, outermost first */
+  check(mpc_parse("<test>", "+ 1 (2)", ps[LISPY_LISPY], &r), "tags", "+ 1 (2)");
+  a = r.output;
+  check(mpc_ast_tag_id(a) == root, "tags", ">");
+  check(strcmp(a->children[2]->tag, "expr|number|regex") == 0, "tags", "expr|number|regex");
+  check(mpc_ast_tag_id(a->children[2]) == expr, "tags", "expr|number|regex");
+  check(mpc_ast_has_tag_id(a->children[2], expr), "tags", "expr");
+  check(mpc_ast_has_tag_id(a->children[2], number), "tags", "number");
+  check(mpc_ast_has_tag_id(a->children[2], regex), "tags", "regex");
+  check(!mpc_ast_has_tag_id(a->children[2], sexpr), "tags", "sexpr");
+  check(mpc_ast_has_tag_id(a->children[3], sexpr), "tags", "expr|sexpr");
+  check(!mpc_ast_has_tag_id(a->children[3], number), "tags", "expr|sexpr");
+  
+  /* Parsing interned nothing, joined tags included */
+  check(mpc_tag_name(last + 1) == NULL, "tags", "+ 1 (2)");
+  
+  /* The sets go with the tags into flat trees */
+  f = mpc_ast_flatten(a);
+  check(mpc_ast_flat_has_tag_id(f, 3, number), "tags", "flat");
+  check(!mpc_ast_flat_has_tag_id(f, 3, sexpr), "tags", "flat");
+  mpc_ast_flat_delete(f);
+  
+  /* Adding a tag keeps the IDs already there, and unknown names have none */
+  mpc_ast_add_tag(a->children[2], "unknown");
+  mpc_ast_add_tag(a->children[2], "sexpr");
+  check(strcmp(a->children[2]->tag, "sexpr|unknown|expr|number|regex") == 0, "tags", "add");
+  check(mpc_ast_tag_id(a->children[2]) == sexpr, "tags", "add");
+  check(mpc_ast_has_tag_id(a->children[2], number), "tags", "add");
+  mpc_ast_tag(a->children[2], "regex");
+  check(!mpc_ast_has_tag_id(a->children[2], number), "tags", "retag");
+  check(mpc_ast_tag_id(a->children[2]) == regex, "tags", "retag");
+  mpc_ast_delete(a);
+
+  /* The table goes with the last parser */
+  lispy_delete(ps);
+  check(mpc_tag_name(number) == NULL, "tags", "cleanup");
+}
+
+/*
+** Optimiser Passes
+*/
+
+static const char *regexes[] = {
+  "(ab|ac)+", "(ab|ac|ad)*x", "-?[0-9]+(\\.[0-9]+)?", "[a-c]+x?", "(a|ab)(c|bcd)",
+  "^(abc|abd|b)$", "x{3}|xy", NULL
+};
+
+static const char *regex_inputs[] = {
+  "ab", "abac", "-b", "aab", "adx", "x", "", "1.", "-12.5", "abcd", "abd", "abcdx",
+  "xxx", "xy", "1.5x", NULL
+};
+
+static void test_optimise_lispy(int flags) {
+
+  mpc_parser_t *plain[LISPY_RULES], *optimised[LISPY_RULES];
+  const char **in;
+
+  lispy_new(plain, flags | MPCA_LANG_NO_OPTIMISE);
+  lispy_new(optimised, flags);
+
+  for (in = lispy_inputs; *in; in++) {
+    check_same("optimise", *in, parse(plain[LISPY_LISPY], *in), parse(optimised[LISPY_LISPY], *in));
+  }
+
+  lispy_delete(plain);
+  lispy_delete(optimised);
+}
+
+static void test_optimise(void) {
+
+  mpc_parser_t *plain, *optimised;
+  const char **re, **in;
+  const char *span_long = "abcxyzabcxyzabcxyzabcxyzabcxyzabcxyz-";
+
+  outcome_text = 1;
+  for (re = regexes; *re; re++) {
+    plain = mpc_re_with(*re, MPC_OPTIMISE_NONE);
+    optimised = mpc_re(*re);
+    for (in = regex_inputs; *in; in++) {
+      check_same("optimise", *in, parse(plain, *in), parse(optimised, *in));
+    }
+    mpc_delete(plain);
+    mpc_delete(optimised);
+  }
+
+  /* Factoring the alternatives must not relabel what they expected */
+  optimised = mpc_re("(ab|ac)+");
+  check_same("optimise", "-b", copy("<test>:1:1: error: expected 'a' at '-'\n"), parse(optimised, "-b"));
+  mpc_delete(optimised);
+
+  /* A span matches what a `many` of its class does */
+  plain = mpc_many1(mpcf_strfold, mpc_or(2, mpc_range('a', 'c'), mpc_oneof("xyz")));
+  optimised = mpc_span1(mpc_or(2, mpc_range('a', 'c'), mpc_oneof("xyz")));
+  for (in = regex_inputs; *in; in++) {
+    check_same("span", *in, parse(plain, *in), parse(optimised, *in));
+  }
+  check_same("span", span_long, parse(plain, span_long), parse(optimised, span_long));
+  mpc_delete(plain);
+  mpc_delete(optimised);
+  outcome_text = 0;
+
+  test_optimise_lispy(MPCA_LANG_DEFAULT);
+  test_optimise_lispy(MPCA_LANG_PREDICTIVE);
+}
+
+/*
+** Language Flags
+*/
+
+/* Each flag is compared against the same language read without it */
+static void test_lang_flags(const char *what, int base, int flags) {
+
+  mpc_parser_t *lispy[LISPY_RULES], *kv[KV_RULES], *lispy_flags[LISPY_RULES], *kv_flags[KV_RULES];
+  const char **in;
+
+  lispy_new(lispy, base);
+  lispy_new(lispy_flags, base | flags);
+  kv_new(kv, base);
+  kv_new(kv_flags, base | flags);
+
+  for (in = lispy_inputs; *in; in++) {
+    check_same(what, *in, parse(lispy[LISPY_LISPY], *in), parse(lispy_flags[LISPY_LISPY], *in));
+  }
+  for (in = kv_inputs; *in; in++) {
+    check_same(what, *in, parse(kv[KV_LIST], *in), parse(kv_flags[KV_LIST], *in));
+  }
+
+  lispy_delete(lispy);
+  lispy_delete(lispy_flags);
+  kv_delete(kv);
+  kv_delete(kv_flags);
+}
+
+#ifdef MPC_TESTS_STDOUT
+/* Reads the key-value language, returning what it printed */
+static char *kv_printed(mpc_parser_t **ps, int flags) {
+
+  FILE *f = tmpfile();
+  int out;
+
+  fflush(stdout);
+  out = dup(fileno(stdout));
+  dup2(fileno(f), fileno(stdout));
+  kv_new(ps, flags);
+  fflush(stdout);
+  dup2(out, fileno(stdout));
+  close(out);
+  fseek(f, 0, SEEK_END);
+  return file_text(f);
+}
+#endif
+
+static void test_lang(void) {
+
+  mpc_parser_t *start, *rest;
+#ifdef MPC_TESTS_STDOUT
+  mpc_parser_t *kv[KV_RULES];
+#endif
+
+  test_lang_flags("tokens", MPCA_LANG_DEFAULT, MPCA_LANG_TOKENS);
+  test_lang_flags("tokens", MPCA_LANG_WHITESPACE_SENSITIVE, MPCA_LANG_TOKENS);
+  test_lang_flags("tokens", MPCA_LANG_PACKRAT, MPCA_LANG_TOKENS);
+
+  /* Tokens are the longest match, so a keyword doesn't match the start of a longer word */
+  start = mpc_new("start");
+  rest = mpc_new("rest");
+  mpca_lang(MPCA_LANG_TOKENS, " start : /^/ \"let\" <rest> /$/ ; rest : /[a-z]+/ ; ", start, rest, NULL);
+  check_same("tokens", "letrec", copy("<test>:1:1: error: expected \"let\" at 'l'\n"), parse(start, "letrec"));
+  check_same("tokens", "let rec",
+    copy("> \n  regex \n  string:1:1 'let'\n  rest|regex:1:5 'rec'\n  regex \n"), parse(start, "let rec"));
+  mpc_cleanup(2, start, rest);
+
+  test_lang_flags("auto predictive", MPCA_LANG_DEFAULT, MPCA_LANG_AUTO_PREDICTIVE);
+  test_lang_flags("auto predictive", MPCA_LANG_TOKENS, MPCA_LANG_AUTO_PREDICTIVE);
+  test_lang_flags("auto predictive", MPCA_LANG_PACKRAT, MPCA_LANG_AUTO_PREDICTIVE);
+
+#ifdef MPC_TESTS_STDOUT
+  /* A rule is reported as backtracking both where it has a conflict and where a rule it uses does */
+  check_same("predictive report", kv_grammar, copy(
+    "Predictive Rules\n"
+    "================\n"
+    "<word>: predictive\n"
+    "<pair>: backtracking, alternatives 1 and 2 of `or` both start with 'a'\n"
+    "<list>: backtracking, in <pair>, alternatives 1 and 2 of `or` both start with 'a'\n"),
+    kv_printed(kv, MPCA_LANG_AUTO_PREDICTIVE | MPCA_LANG_PREDICTIVE_REPORT));
+  kv_delete(kv);
+#endif
+}
+
+/*
+** Packrat Memoisation
+*/
+
+static void test_memo(void) {
+
+  mpc_parser_t *lispy[LISPY_RULES], *kv[KV_RULES], *memo[KV_RULES];
+  mpc_session_t *s;
+  const char **in;
+  char *big;
+
+  lispy_new(lispy, MPCA_LANG_PACKRAT);
+  kv_new(kv, MPCA_LANG_DEFAULT);
+  kv_new(memo, MPCA_LANG_PACKRAT);
+
+  /* Only String inputs are memoised, so a pipe runs the same parsers without */
+  for (in = lispy_inputs; *in; in++) {
+    check_same("memo", *in, parse_pipe(lispy[LISPY_LISPY], *in), parse(lispy[LISPY_LISPY], *in));
+  }
+
+  /* Memoised results must not outlive the parse that made them */
+  s = mpc_session_new("<test>", MPC_SESSION_ARENA);
+  for (in = kv_inputs; *in; in++) {
+    check_same("memo", *in, parse(kv[KV_LIST], *in), parse(memo[KV_LIST], *in));
+    check_same("memo", *in, parse(kv[KV_LIST], *in), parse_in(s, MPC_SESSION_ARENA, memo[KV_LIST], *in));
+  }
+  mpc_session_delete(s);
+
+  big = lispy_long(2000, " (+ 1 ]");
+  check_same("memo", "long error", parse_pipe(lispy[LISPY_LISPY], big), parse(lispy[LISPY_LISPY], big));
+  free(big);
+
+  lispy_delete(lispy);
+  kv_delete(kv);
+  kv_delete(memo);
+}
+
+/*
+** Regex DFAs
+*/
+
+static void test_dfa(void) {
+
+  mpc_parser_t *plain, *dfa, *number, *top;
+  const char **re, **in;
+
+  outcome_text = 1;
+  for (re = regexes; *re; re++) {
+    plain = mpc_re_with(*re, MPC_OPTIMISE_ALL & ~MPC_OPTIMISE_DFA);
+    dfa = mpc_re(*re);
+    for (in = regex_inputs; *in; in++) {
+      check_same("dfa", *in, parse(plain, *in), parse(dfa, *in));
+    }
+    mpc_delete(plain);
+    mpc_delete(dfa);
+  }
+  outcome_text = 0;
+
+  /* A DFA failing part way reports what the regex inside it expected */
+  number = mpc_new("number");
+  top = mpc_new("top");
+  mpca_lang(MPCA_LANG_DEFAULT,
+    " number : /-?[0-9]+(\\.[0-9]+)?/ ; top : /^/ <number> /$/ ; ", number, top, NULL);
+  check_same("dfa", "-2.",
+    copy("<test>:1:4: error: expected one or more of one of '0123456789' at end of input\n"),
+    parse(top, "-2."));
+  mpc_cleanup(2, number, top);
+}
+
+/*
+** Compiled Parsers
+*/
+
+static char *parse_compiled(mpc_parser_t *p, const char *input) {
+  mpc_result_t r;
+  mpc_program_t *c = mpc_compile(p);
+  char *x = outcome(mpc_parse_compiled("<test>", input, c, &r), &r);
+  mpc_program_delete(c);
+  return x;
+}
+
+static void test_compiled_flags(int flags) {
+
+  mpc_parser_t *lispy[LISPY_RULES], *kv[KV_RULES];
+  const char **in;
+
+  lispy_new(lispy, flags);
+  kv_new(kv, flags);
+
+  for (in = lispy_inputs; *in; in++) {
+    check_same("compiled", *in, parse(lispy[LISPY_LISPY], *in), parse_compiled(lispy[LISPY_LISPY], *in));
+  }
+  for (in = kv_inputs; *in; in++) {
+    check_same("compiled", *in, parse(kv[KV_LIST], *in), parse_compiled(kv[KV_LIST], *in));
+  }
+
+  lispy_delete(lispy);
+  kv_delete(kv);
+}
+
+static void test_compiled(void) {
+
+  mpc_parser_t *p;
+  const char **re, **in;
+
+  test_compiled_flags(MPCA_LANG_DEFAULT);
+  test_compiled_flags(MPCA_LANG_PREDICTIVE);
+  test_compiled_flags(MPCA_LANG_WHITESPACE_SENSITIVE);
+
+  outcome_text = 1;
+  for (re = regexes; *re; re++) {
+    p = mpc_re(*re);
+    for (in = regex_inputs; *in; in++) {
+      check_same("compiled", *in, parse(p, *in), parse_compiled(p, *in));
+    }
+    mpc_delete(p);
+  }
+  outcome_text = 0;
+}
+
+/*
+** Nesting Depth
+*/
+
+/* An expression nested `n` deep, missing its last parenthesis if `broken` */
+static char *lispy_nested(int n, int broken) {
+  char *s = malloc(2 * n + 8), *p = s;
+  int j;
+  p += sprintf(p, "+ ");
+  for (j = 0; j < n; j++) { *p++ = '('; }
+  *p++ = '1';
+  for (j = broken; j < n; j++) { *p++ = ')'; }
+  *p = '\0';
+  return s;
+}
+
+static char *parse_session(mpc_parser_t *p, const char *input, int flags, int depth) {
+  mpc_result_t r;
+  mpc_session_t *s = mpc_session_new("<test>", flags);
+  char *x;
+  mpc_session_depth_limit(s, depth);
+  x = outcome(mpc_session_parse(s, input, strlen(input), p, &r), &r);
+  mpc_session_delete(s);
+  return x;
+}
+
+static char *parse_stream(mpc_parser_t *p, const char *input) {
+  mpc_result_t r;
+  FILE *f = tmpfile();
+  mpc_stream_t *s;
+  char *x;
+  fputs(input, f);
+  rewind(f);
+  s = mpc_stream_begin("<test>", f, p);
+  x = outcome(mpc_stream_next(s, &r) == MPC_STREAM_OK, &r);
+  mpc_stream_end(s);
+  fclose(f);
+  return x;
+}
+
+/* Returns how deeply the sexprs nest in a tree of `lispy_nested` and deletes it */
+static long lispy_depth(mpc_ast_t *t) {
+  mpc_ast_t *a;
+  long n = 0;
+  for (a = t; a->children_num > 2; a = a->children[a->children_num == 3 ? 1 : 2]) {
+    if (strstr(a->tag, "sexpr")) { n++; }
+  }
+  mpc_ast_delete(t);
+  return n;
+}
+
+/* Pushes the input in one go and returns how deeply the sexprs nest, or -1 */
+static long push_nested(mpc_parser_t *p, const char *input, int flags) {
+  mpc_result_t r;
+  mpc_push_t *s = mpc_push_begin("<test>", p, flags);
+  if (mpc_push_feed(s, input, strlen(input), &r) != MPC_PUSH_MORE
+  ||  mpc_push_end(s, &r) != MPC_PUSH_OK) { return -1; }
+  return lispy_depth(r.output);
+}
+
+static void test_depth(void) {
+
+  mpc_parser_t *ps[LISPY_RULES];
+  mpc_session_t *x;
+  mpc_result_t r;
+  mpc_ast_flat_t *f;
+  char *s;
+
+  lispy_new(ps, MPCA_LANG_DEFAULT);
+
+  /* The interpreter stops by default before its stack runs out */
+  s = lispy_nested(2500, 0);
+  check_same("depth", "2500 deep", copy("<test>: error: Maximum Depth Exceeded at 1:2050!\n"),
+    parse(ps[LISPY_LISPY], s));
+  check_same("depth", "2500 deep", parse_session(ps[LISPY_LISPY], s, MPC_SESSION_DEFAULT, 6000),
+    parse_session(ps[LISPY_LISPY], s, MPC_SESSION_COMPILED, 0));
+  free(s);
+
+  s = lispy_nested(2500, 1);
+  check_same("depth", "2500 deep, broken", parse_session(ps[LISPY_LISPY], s, MPC_SESSION_DEFAULT, 6000),
+    parse_session(ps[LISPY_LISPY], s, MPC_SESSION_COMPILED, 0));
+  free(s);
+  
+  /* Far deeper input fails cleanly when interpreted and parses when pushed */
+  s = lispy_nested(50000, 0);
+  check_same("depth", "50000 deep", copy("<test>: error: Maximum Depth Exceeded at 1:2050!\n"),
+    parse(ps[LISPY_LISPY], s));
+  check_same("depth", "50000 deep", copy("<test>: error: Maximum Depth Exceeded at 1:2050!\n"),
+    parse_stream(ps[LISPY_LISPY], s));
+  check(push_nested(ps[LISPY_LISPY], s, MPC_SESSION_DEFAULT) == 50000, "depth", "50000 deep");
+  check(push_nested(ps[LISPY_LISPY], s, MPC_SESSION_ARENA) == 50000, "depth", "50000 deep");
+  free(s);
+  
+  /* Flat trees are built and rebuilt without recursing */
+  s = lispy_nested(200000, 0);
+  check_same("depth", "200000 deep, flat", copy("<test>: error: Maximum Depth Exceeded at 1:2050!\n"),
+    parse_session(ps[LISPY_LISPY], s, MPC_SESSION_FLAT, 0));
+  x = mpc_session_new("<test>", MPC_SESSION_FLAT | MPC_SESSION_COMPILED);
+  if (mpc_session_parse(x, s, strlen(s), ps[LISPY_LISPY], &r)) {
+    f = r.output;
+    check(f->size[0] == f->num, "depth", "200000 deep, flat");
+    check(lispy_depth(mpc_ast_unflatten(f, 0)) == 200000, "depth", "200000 deep, flat");
+    mpc_ast_flat_delete(f);
+  } else {
+    check(0, "depth", "200000 deep, flat");
+    mpc_err_delete(r.error);
+  }
+  mpc_session_delete(x);
+  free(s);
+
+  /* The rules entered are lispy, then a sexpr and an expr for each level */
+  s = lispy_nested(100, 1);
+  check_same("depth", "limited", copy("<test>: error: Maximum Depth Exceeded at 1:27!\n"),
+    parse_session(ps[LISPY_LISPY], s, MPC_SESSION_DEFAULT, 50));
+  check_same("depth", "limited", copy("<test>: error: Maximum Depth Exceeded at 1:27!\n"),
+    parse_session(ps[LISPY_LISPY], s, MPC_SESSION_COMPILED, 50));
+  free(s);
+
+  lispy_delete(ps);
+}
+
+/*
+** Generated Parsers
+**
+** `lispy_parser.c` is generated by `mpcgen` from
+** `lispy.grammar`, which is the same as `lispy_grammar`.
+*/
+
+static void test_generated(void) {
+
+  mpc_parser_t *ps[LISPY_RULES];
+  const char **in;
+  mpc_result_t r;
+  char *s;
+
+  lispy_new(ps, MPCA_LANG_DEFAULT);
+
+  for (in = lispy_inputs; *in; in++) {
+    check_same("generated", *in, parse(ps[LISPY_LISPY], *in),
+      outcome(lispy_parse_lispy("<test>", *in, &r), &r));
+  }
+
+  s = lispy_long(2000, " (+ 1 ]");
+  check_same("generated", "long error", parse(ps[LISPY_LISPY], s),
+    outcome(lispy_parse_lispy("<test>", s, &r), &r));
+  free(s);
+
+  s = lispy_nested(500, 1);
+  check_same("generated", "500 deep, broken", parse(ps[LISPY_LISPY], s),
+    outcome(lispy_parse_lispy("<test>", s, &r), &r));
+  free(s);
+
+  lispy_delete(ps);
+  lispy_cleanup();
+}
+
+int main(void) {
+
+  test_pipe();
+  test_file();
+  test_push();
+  test_session();
+  test_flat();
+  test_tags();
+  test_optimise();
+  test_lang();
+  test_memo();
+  test_dfa();
+  test_compiled();
+  test_depth();
+  test_generated();
+
+  printf("%i tests, %i failed\n", tests_run, tests_failed);
+  return tests_failed != 0;
+}